@@ -0,0 +1,859 @@
+//--------------------------------------------------------------------------------------
+// ColorConversion.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "ColorConversion.h"
+#include "CpuSimd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace ColorConversion;
+using namespace CpuSimd;
+
+// Whether StoreHalf() is a conversion instruction rather than integer arithmetic
+#if CPU_SIMD_AVX512 || (CPU_SIMD_AVX2 && FLOAT16_F16C) || (CPU_SIMD_NEON && FLOAT16_NEON)
+#define COLOR_CONVERSION_HALF_INSTRUCTIONS 1
+#endif
+
+namespace
+{
+    // Rows are converted this many columns at a time, with the chroma of the columns kept on the stack
+    const uint32_t c_chunkWidth = 256;
+
+    // Multiplying by this rather than dividing by 255 gives the same FP16 values for all 256 codes
+    const float c_unormScale = 1.0f / 255.0f;
+
+    // Runs func(index, thread) for every index in [0, count), on the thread pool if there is one
+    template<typename Func>
+    void ParallelFor(ThreadPool* threadPool, uint32_t count, const Func& func)
+    {
+        if (threadPool)
+        {
+            threadPool->ParallelFor(count, func);
+            return;
+        }
+        for (uint32_t index = 0; index < count; index++)
+        {
+            func(index, 0);
+        }
+    }
+
+    inline Float LoadSamples(const uint8_t* p)             { return LoadUint8(p); }
+    inline Float LoadSamples(const uint16_t* p)            { return LoadUint16(p); }
+    inline void StoreSamples(uint8_t* p, Float v)          { StoreUint8(p, v); }
+    inline void StoreSamples(uint16_t* p, Float v)         { StoreUint16(p, v); }
+
+    inline float Clamp(float value, float low, float high)
+    {
+        return std::min(std::max(value, low), high);
+    }
+
+    // Rounds to nearest even, like the vector stores
+    template<typename Sample>
+    inline Sample RoundSample(float value, float maxCode)
+    {
+        return static_cast<Sample>(std::nearbyint(Clamp(value, 0.0f, maxCode)));
+    }
+
+    // Normalized luma is in [0, 1] and chroma in [-0.5, 0.5]. A sample is the normalized value times the scale plus
+    // the offset.
+    struct Coefficients
+    {
+        float   lumaScale;
+        float   lumaOffset;
+        float   chromaScale;
+        float   chromaOffset;
+        float   maxCode;
+
+        float   kr, kg, kb;         // Contributions of R, G and B to luma
+        float   redFromV;
+        float   greenFromU;
+        float   greenFromV;
+        float   blueFromU;
+    };
+
+    Coefficients GetCoefficients(const YuvFormat& format)
+    {
+        Coefficients c;
+        const float step = float(1u << (format.bitDepth - 8));
+        c.maxCode = float((1u << format.bitDepth) - 1);
+        if (format.fullRange)
+        {
+            c.lumaScale = c.maxCode;
+            c.lumaOffset = 0.0f;
+            c.chromaScale = c.maxCode;
+        }
+        else
+        {
+            c.lumaScale = 219.0f * step;
+            c.lumaOffset = 16.0f * step;
+            c.chromaScale = 224.0f * step;
+        }
+        c.chromaOffset = 128.0f * step;
+
+        c.kr = (format.matrix == YuvMatrix::Bt709) ? 0.2126f : 0.299f;
+        c.kb = (format.matrix == YuvMatrix::Bt709) ? 0.0722f : 0.114f;
+        c.kg = 1.0f - c.kr - c.kb;
+        c.redFromV = 2.0f * (1.0f - c.kr);
+        c.blueFromU = 2.0f * (1.0f - c.kb);
+        c.greenFromU = -2.0f * c.kb * (1.0f - c.kb) / c.kg;
+        c.greenFromV = -2.0f * c.kr * (1.0f - c.kr) / c.kg;
+        return c;
+    }
+
+    // Where the U and V samples of a row of chroma are, and how far apart consecutive ones are
+    template<typename Sample>
+    void GetChromaRows(Sample* frame, const YuvFormat& format, uint32_t width, uint32_t height, uint32_t chromaRow,
+        Sample*& uRowOut, Sample*& vRowOut, size_t& stepOut)
+    {
+        const size_t chromaWidth = (width + 1) / 2;
+        const size_t chromaHeight = (height + 1) / 2;
+        Sample* chroma = frame + size_t(width) * height;
+        if (format.interleavedChroma)
+        {
+            uRowOut = chroma + chromaRow * chromaWidth * 2;
+            vRowOut = uRowOut + 1;
+            stepOut = 2;
+        }
+        else
+        {
+            uRowOut = chroma + chromaRow * chromaWidth;
+            vRowOut = uRowOut + chromaWidth * chromaHeight;
+            stepOut = 1;
+        }
+    }
+
+    // Converts the two rows of pixels that share a row of chroma
+    template<typename Sample>
+    void YuvToTensorRows(const Sample* frame, const YuvFormat& format, uint32_t width, uint32_t height, uint32_t chromaRow, float* tensor)
+    {
+        const Coefficients c = GetCoefficients(format);
+        const size_t planeSize = size_t(width) * height;
+
+        const Sample* uRow;
+        const Sample* vRow;
+        size_t chromaStep;
+        GetChromaRows(frame, format, width, height, chromaRow, uRow, vRow, chromaStep);
+
+        // Samples in the high bits are scaled down with the rest of the normalization
+        const float sampleScale = format.msbAligned ? 1.0f / float(1u << (16 - format.bitDepth)) : 1.0f;
+        const float lumaScale = sampleScale / c.lumaScale;
+        const float lumaOffset = -c.lumaOffset / c.lumaScale;
+        const float chromaScale = sampleScale / c.chromaScale;
+        const float chromaOffset = -c.chromaOffset / c.chromaScale;
+
+        const Float lumaScaleVector = Set(lumaScale);
+        const Float lumaOffsetVector = Set(lumaOffset);
+        const Float zero = Zero();
+        const Float one = Set(1.0f);
+
+        const uint32_t firstRow = chromaRow * 2;
+        const uint32_t endRow = std::min(firstRow + 2, height);
+
+        // What the chroma adds to each of R, G and B, for every column of the chunk
+        float red[c_chunkWidth], green[c_chunkWidth], blue[c_chunkWidth];
+
+        for (uint32_t chunkStart = 0; chunkStart < width; chunkStart += c_chunkWidth)
+        {
+            const uint32_t chunkEnd = std::min(chunkStart + c_chunkWidth, width);
+            for (uint32_t x = chunkStart; x < chunkEnd; x += 2)
+            {
+                const size_t i = (x / 2) * chromaStep;
+                const float u = uRow[i] * chromaScale + chromaOffset;
+                const float v = vRow[i] * chromaScale + chromaOffset;
+                const uint32_t column = x - chunkStart;
+                red[column] = red[column + 1] = c.redFromV * v;
+                green[column] = green[column + 1] = c.greenFromU * u + c.greenFromV * v;
+                blue[column] = blue[column + 1] = c.blueFromU * u;
+            }
+
+            for (uint32_t y = firstRow; y < endRow; y++)
+            {
+                const Sample* lumaRow = frame + size_t(y) * width;
+                float* redRow = tensor + size_t(y) * width;
+                float* greenRow = redRow + planeSize;
+                float* blueRow = greenRow + planeSize;
+
+                uint32_t x = chunkStart;
+                for (; x + c_width <= chunkEnd; x += c_width)
+                {
+                    const uint32_t column = x - chunkStart;
+                    const Float luma = MultiplyAdd(LoadSamples(lumaRow + x), lumaScaleVector, lumaOffsetVector);
+                    Store(redRow + x, Min(Max(Add(luma, Load(red + column)), zero), one));
+                    Store(greenRow + x, Min(Max(Add(luma, Load(green + column)), zero), one));
+                    Store(blueRow + x, Min(Max(Add(luma, Load(blue + column)), zero), one));
+                }
+                for (; x < chunkEnd; x++)
+                {
+                    const uint32_t column = x - chunkStart;
+                    const float luma = lumaRow[x] * lumaScale + lumaOffset;
+                    redRow[x] = Clamp(luma + red[column], 0.0f, 1.0f);
+                    greenRow[x] = Clamp(luma + green[column], 0.0f, 1.0f);
+                    blueRow[x] = Clamp(luma + blue[column], 0.0f, 1.0f);
+                }
+            }
+        }
+    }
+
+    template<typename Sample>
+    void TensorToYuvRows(const float* tensor, uint32_t width, uint32_t height, const YuvFormat& format, uint32_t chromaRow, Sample* frame)
+    {
+        const Coefficients c = GetCoefficients(format);
+        const size_t planeSize = size_t(width) * height;
+
+        Sample* uRow;
+        Sample* vRow;
+        size_t chromaStep;
+        GetChromaRows(frame, format, width, height, chromaRow, uRow, vRow, chromaStep);
+
+        const Float zero = Zero();
+        const Float one = Set(1.0f);
+        const Float kr = Set(c.kr);
+        const Float kg = Set(c.kg);
+        const Float kb = Set(c.kb);
+        const Float lumaScale = Set(c.lumaScale);
+        const Float lumaOffset = Set(c.lumaOffset);
+
+        const uint32_t firstRow = chromaRow * 2;
+        const uint32_t endRow = std::min(firstRow + 2, height);
+
+        // Sums of the clamped R, G and B of the rows, for every column of the chunk
+        float red[c_chunkWidth], green[c_chunkWidth], blue[c_chunkWidth];
+
+        for (uint32_t chunkStart = 0; chunkStart < width; chunkStart += c_chunkWidth)
+        {
+            const uint32_t chunkEnd = std::min(chunkStart + c_chunkWidth, width);
+
+            for (uint32_t y = firstRow; y < endRow; y++)
+            {
+                const float* redRow = tensor + size_t(y) * width;
+                const float* greenRow = redRow + planeSize;
+                const float* blueRow = greenRow + planeSize;
+                Sample* lumaRow = frame + size_t(y) * width;
+                const bool firstOfPair = (y == firstRow);
+
+                uint32_t x = chunkStart;
+                for (; x + c_width <= chunkEnd; x += c_width)
+                {
+                    const uint32_t column = x - chunkStart;
+                    const Float r = Min(Max(Load(redRow + x), zero), one);
+                    const Float g = Min(Max(Load(greenRow + x), zero), one);
+                    const Float b = Min(Max(Load(blueRow + x), zero), one);
+                    const Float luma = MultiplyAdd(kr, r, MultiplyAdd(kg, g, Multiply(kb, b)));
+                    StoreSamples(lumaRow + x, MultiplyAdd(luma, lumaScale, lumaOffset));
+
+                    Store(red + column, firstOfPair ? r : Add(r, Load(red + column)));
+                    Store(green + column, firstOfPair ? g : Add(g, Load(green + column)));
+                    Store(blue + column, firstOfPair ? b : Add(b, Load(blue + column)));
+                }
+                for (; x < chunkEnd; x++)
+                {
+                    const uint32_t column = x - chunkStart;
+                    const float r = Clamp(redRow[x], 0.0f, 1.0f);
+                    const float g = Clamp(greenRow[x], 0.0f, 1.0f);
+                    const float b = Clamp(blueRow[x], 0.0f, 1.0f);
+                    const float luma = c.kr * r + c.kg * g + c.kb * b;
+                    lumaRow[x] = RoundSample<Sample>(luma * c.lumaScale + c.lumaOffset, c.maxCode);
+
+                    red[column] = firstOfPair ? r : r + red[column];
+                    green[column] = firstOfPair ? g : g + green[column];
+                    blue[column] = firstOfPair ? b : b + blue[column];
+                }
+            }
+
+            // Chroma of the average of each block, which is only one column or row wide at odd edges
+            for (uint32_t x = chunkStart; x < chunkEnd; x += 2)
+            {
+                const uint32_t column = x - chunkStart;
+                const bool pair = (x + 1 < chunkEnd);
+                const float scale = 1.0f / float((pair ? 2 : 1) * (endRow - firstRow));
+                const float r = (red[column] + (pair ? red[column + 1] : 0.0f)) * scale;
+                const float g = (green[column] + (pair ? green[column + 1] : 0.0f)) * scale;
+                const float b = (blue[column] + (pair ? blue[column + 1] : 0.0f)) * scale;
+
+                const float luma = c.kr * r + c.kg * g + c.kb * b;
+                const float u = (b - luma) / c.blueFromU;
+                const float v = (r - luma) / c.redFromV;
+
+                const size_t i = (x / 2) * chromaStep;
+                uRow[i] = RoundSample<Sample>(u * c.chromaScale + c.chromaOffset, c.maxCode);
+                vRow[i] = RoundSample<Sample>(v * c.chromaScale + c.chromaOffset, c.maxCode);
+            }
+        }
+    }
+
+    // Packs the first three bytes of 4-byte pixels, optionally swapping the first and third (BGRA8 to RGB8)
+    void DropAlpha(const uint8_t* pixels, uint32_t count, bool swapRedBlue, uint8_t* rgb)
+    {
+        const uint32_t first = swapRedBlue ? 2 : 0;
+        uint32_t i = 0;
+#if CPU_SIMD_AVX512 || CPU_SIMD_AVX2
+        // Each store writes 4 bytes beyond its 4 pixels, which the next one overwrites
+        const __m128i shuffle = swapRedBlue ?
+            _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1) :
+            _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        for (; i + 6 <= count; i += 4)
+        {
+            const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + size_t(i) * 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb + size_t(i) * 3), _mm_shuffle_epi8(input, shuffle));
+        }
+#elif CPU_SIMD_NEON
+        for (; i + 16 <= count; i += 16)
+        {
+            const uint8x16x4_t input = vld4q_u8(pixels + size_t(i) * 4);
+            uint8x16x3_t packed;
+            packed.val[0] = input.val[first];
+            packed.val[1] = input.val[1];
+            packed.val[2] = input.val[2 - first];
+            vst3q_u8(rgb + size_t(i) * 3, packed);
+        }
+#endif
+        for (; i < count; i++)
+        {
+            rgb[i * 3] = pixels[i * 4 + first];
+            rgb[i * 3 + 1] = pixels[i * 4 + 1];
+            rgb[i * 3 + 2] = pixels[i * 4 + 2 - first];
+        }
+    }
+
+    // Expands RGB8 to 4-byte pixels with 255 as the fourth byte, optionally swapping the first and third (RGB8 to
+    // BGRA8). The vector path reads up to 4 bytes past the end of rgb.
+    void AddAlpha(const uint8_t* rgb, uint32_t count, bool swapRedBlue, uint8_t* pixels)
+    {
+        const uint32_t first = swapRedBlue ? 2 : 0;
+        uint32_t i = 0;
+#if CPU_SIMD_AVX512 || CPU_SIMD_AVX2
+        const __m128i shuffle = swapRedBlue ?
+            _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1) :
+            _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32(int32_t(0xFF000000));
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + size_t(i) * 3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + size_t(i) * 4), _mm_or_si128(_mm_shuffle_epi8(input, shuffle), alpha));
+        }
+#elif CPU_SIMD_NEON
+        for (; i + 16 <= count; i += 16)
+        {
+            const uint8x16x3_t input = vld3q_u8(rgb + size_t(i) * 3);
+            uint8x16x4_t expanded;
+            expanded.val[0] = input.val[first];
+            expanded.val[1] = input.val[1];
+            expanded.val[2] = input.val[2 - first];
+            expanded.val[3] = vdupq_n_u8(255);
+            vst4q_u8(pixels + size_t(i) * 4, expanded);
+        }
+#endif
+        for (; i < count; i++)
+        {
+            pixels[i * 4] = rgb[i * 3 + first];
+            pixels[i * 4 + 1] = rgb[i * 3 + 1];
+            pixels[i * 4 + 2] = rgb[i * 3 + 2 - first];
+            pixels[i * 4 + 3] = 255;
+        }
+    }
+
+#if COLOR_CONVERSION_HALF_INSTRUCTIONS
+
+    // Planar output takes each channel straight from the pixels. Interleaved output reorders a chunk of the row
+    // to RGB on the stack, and then converts it as one run of bytes.
+    void ImageRowToTensor(const uint8_t* pixels, uint32_t width, TensorLayout layout, size_t planeSize, uint16_t* tensorRow)
+    {
+        const Float scale = Set(c_unormScale);
+
+        if (layout == TensorLayout::Nchw)
+        {
+            uint32_t x = 0;
+            for (; x + c_width <= width; x += c_width)
+            {
+                for (uint32_t channel = 0; channel < 3; channel++)
+                {
+                    StoreHalf(tensorRow + channel * planeSize + x, Multiply(LoadUint8Channel(pixels + size_t(x) * 4, 2 - channel), scale));
+                }
+            }
+            for (; x < width; x++)
+            {
+                for (uint32_t channel = 0; channel < 3; channel++)
+                {
+                    tensorRow[channel * planeSize + x] = Float16Compressor::compressRoundToNearest(pixels[x * 4 + 2 - channel] * c_unormScale);
+                }
+            }
+            return;
+        }
+
+        uint8_t rgb[c_chunkWidth * 3];
+        for (uint32_t chunkStart = 0; chunkStart < width; chunkStart += c_chunkWidth)
+        {
+            const uint32_t pixelCount = std::min(c_chunkWidth, width - chunkStart);
+            DropAlpha(pixels + size_t(chunkStart) * 4, pixelCount, true, rgb);
+
+            const uint32_t count = pixelCount * 3;
+            uint16_t* output = tensorRow + size_t(chunkStart) * 3;
+            uint32_t i = 0;
+            for (; i + c_width <= count; i += c_width)
+            {
+                StoreHalf(output + i, Multiply(LoadUint8(rgb + i), scale));
+            }
+            for (; i < count; i++)
+            {
+                output[i] = Float16Compressor::compressRoundToNearest(rgb[i] * c_unormScale);
+            }
+        }
+    }
+#else
+    // Without conversion instructions, looking up the FP16 value of each code is several times faster
+    struct UnormToHalfTable
+    {
+        uint16_t values[256];
+
+        UnormToHalfTable()
+        {
+            for (uint32_t code = 0; code < 256; code++)
+            {
+                values[code] = Float16Compressor::compressRoundToNearest(code * c_unormScale);
+            }
+        }
+    };
+
+    void ImageRowToTensor(const uint8_t* pixels, uint32_t width, TensorLayout layout, size_t planeSize, uint16_t* tensorRow)
+    {
+        static const UnormToHalfTable s_table;
+        const uint16_t* table = s_table.values;
+
+        if (layout == TensorLayout::Nchw)
+        {
+            uint16_t* redRow = tensorRow;
+            uint16_t* greenRow = redRow + planeSize;
+            uint16_t* blueRow = greenRow + planeSize;
+            for (uint32_t x = 0; x < width; x++)
+            {
+                redRow[x] = table[pixels[x * 4 + 2]];
+                greenRow[x] = table[pixels[x * 4 + 1]];
+                blueRow[x] = table[pixels[x * 4]];
+            }
+            return;
+        }
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            tensorRow[x * 3] = table[pixels[x * 4 + 2]];
+            tensorRow[x * 3 + 1] = table[pixels[x * 4 + 1]];
+            tensorRow[x * 3 + 2] = table[pixels[x * 4]];
+        }
+    }
+#endif
+
+    inline Float LoadElements(const float* p)              { return Load(p); }
+    inline Float LoadElements(const uint16_t* p)           { return LoadHalf(p); }
+    inline float LoadElement(const float* p)               { return *p; }
+    inline float LoadElement(const uint16_t* p)            { return Float16Compressor::decompress(*p); }
+
+    // NaN becomes 0, as with the vector Max()
+    inline float Saturate(float value)
+    {
+        return std::min(std::max(0.0f, value), 1.0f);
+    }
+
+    // Encodes linear values in [0, 1] to 8-bit sRGB codes, exactly. The bin of a value gives the code at the bottom
+    // of the bin. Bins are narrower than the smallest step between codes, so at most one more step falls inside one.
+    class SrgbEncoder
+    {
+    public:
+        SrgbEncoder()
+        {
+            m_thresholds[0] = 0.0f;
+            for (uint32_t code = 1; code < 256; code++)
+            {
+                // The smallest float that encodes to code - 0.5 or more
+                const double encoded = (code - 0.5) / 255.0;
+                const double linear = (encoded <= 0.04045) ? encoded / 12.92 : std::pow((encoded + 0.055) / 1.055, 2.4);
+                float threshold = static_cast<float>(linear);
+                if (threshold < linear)
+                {
+                    threshold = std::nextafter(threshold, 2.0f);
+                }
+                // Scaling by a power of two is exact, so comparing scaled values gives the same codes
+                m_thresholds[code] = threshold * c_binCount;
+            }
+            m_thresholds[256] = 2.0f * c_binCount;
+
+            uint32_t code = 0;
+            for (uint32_t bin = 0; bin <= c_binCount; bin++)
+            {
+                while (m_thresholds[code + 1] <= float(bin))
+                {
+                    code++;
+                }
+                m_codes[bin] = static_cast<uint8_t>(code);
+            }
+        }
+
+        // Takes a linear value in [0, 1] multiplied by GetScale()
+        float Encode(float scaled) const
+        {
+            const uint32_t code = m_codes[static_cast<uint32_t>(scaled)];
+            return float(code + uint32_t(scaled >= m_thresholds[code + 1]));
+        }
+
+        static float GetScale() { return float(c_binCount); }
+
+    private:
+        static const uint32_t c_binCount = 4096;
+
+        uint8_t m_codes[c_binCount + 1];
+        float   m_thresholds[257];          // Smallest scaled linear value of each code
+    };
+
+    const SrgbEncoder& GetSrgbEncoder()
+    {
+        static const SrgbEncoder s_encoder;
+        return s_encoder;
+    }
+
+    template<typename Element>
+    void ConvertElements(const Element* elements, uint32_t count, float* values)
+    {
+        uint32_t i = 0;
+        for (; i + c_width <= count; i += c_width)
+        {
+            Store(values + i, LoadElements(elements + i));
+        }
+        for (; i < count; i++)
+        {
+            values[i] = LoadElement(elements + i);
+        }
+    }
+
+    // Repeats each pixel of source scale times, starting phase repeats into the first one
+    template<uint32_t channels>
+    void RepeatPixels(const float* source, uint32_t phase, uint32_t count, uint32_t scale, float* destination)
+    {
+        uint32_t i = 0;
+        if (scale == 2 && phase == 0)
+        {
+            for (; i + 2 <= count; i += 2, source += channels)
+            {
+                for (uint32_t channel = 0; channel < channels; channel++)
+                {
+                    destination[i * channels + channel] = source[channel];
+                    destination[(i + 1) * channels + channel] = source[channel];
+                }
+            }
+        }
+
+        for (; i < count; i++)
+        {
+            for (uint32_t channel = 0; channel < channels; channel++)
+            {
+                destination[i * channels + channel] = source[channel];
+            }
+            if (++phase == scale)
+            {
+                phase = 0;
+                source += channels;
+            }
+        }
+    }
+
+    // The base values under count pixels from column x of the output, with channels values per pixel. The base
+    // row is converted to FP32 first, so each value is only converted once.
+    template<typename Element>
+    void ExpandBaseRow(const Element* baseRow, uint32_t x, uint32_t count, uint32_t channels, uint32_t scale, float* converted, float* expanded)
+    {
+        const uint32_t first = x / scale;
+        const uint32_t last = (x + count - 1) / scale;
+        if (scale == 1)
+        {
+            ConvertElements(baseRow + size_t(first) * channels, count * channels, expanded);
+            return;
+        }
+
+        ConvertElements(baseRow + size_t(first) * channels, (last - first + 1) * channels, converted);
+        if (channels == 1)
+        {
+            RepeatPixels<1>(converted, x % scale, count, scale, expanded);
+        }
+        else
+        {
+            RepeatPixels<3>(converted, x % scale, count, scale, expanded);
+        }
+    }
+
+    // Adds the base if there is one, saturates, and scales to [0, 255] or encodes to sRGB
+    template<typename Element>
+    void ConvertValues(const Element* tensor, const float* base, uint32_t count, const SrgbEncoder* srgb, float* values)
+    {
+        const float scale = srgb ? SrgbEncoder::GetScale() : 255.0f;
+        const Float scaleVector = Set(scale);
+        const Float zero = Zero();
+        const Float one = Set(1.0f);
+
+        uint32_t i = 0;
+        for (; i + c_width <= count; i += c_width)
+        {
+            Float value = LoadElements(tensor + i);
+            if (base)
+            {
+                value = Add(value, Load(base + i));
+            }
+            Store(values + i, Multiply(Min(Max(value, zero), one), scaleVector));
+        }
+        for (; i < count; i++)
+        {
+            values[i] = Saturate(LoadElement(tensor + i) + (base ? base[i] : 0.0f)) * scale;
+        }
+
+        if (srgb)
+        {
+            for (i = 0; i < count; i++)
+            {
+                values[i] = srgb->Encode(values[i]);
+            }
+        }
+    }
+
+    // Rounds values in [0, 255] to bytes
+    void StoreBytes(const float* values, uint32_t count, uint8_t* bytes)
+    {
+        uint32_t i = 0;
+        for (; i + c_width <= count; i += c_width)
+        {
+            StoreUint8(bytes + i, Load(values + i));
+        }
+        for (; i < count; i++)
+        {
+            bytes[i] = static_cast<uint8_t>(std::nearbyint(values[i]));
+        }
+    }
+
+    uint32_t GetBytesPerPixel(PixelFormat format)
+    {
+        switch (format)
+        {
+        case PixelFormat::Rgb8:
+            return 3;
+        case PixelFormat::Gray8:
+            return 1;
+        default:
+            return 4;
+        }
+    }
+
+    // Planar tensors are converted a channel at a time and then interleaved into pixels. Interleaved tensors are
+    // converted as one run of values per chunk, whose bytes are already in RGB8 order.
+    template<typename Element>
+    void TensorRowToImage(
+        const Element* tensor,
+        const Element* base,
+        uint32_t baseScale,
+        uint32_t width,
+        uint32_t height,
+        TensorLayout layout,
+        PixelFormat format,
+        const SrgbEncoder* srgb,
+        uint32_t y,
+        uint8_t* imageRow)
+    {
+        const uint32_t channels = (format == PixelFormat::Gray8) ? 1 : 3;
+        const bool planar = (layout == TensorLayout::Nchw) || (channels == 1);
+        const uint32_t bytesPerPixel = GetBytesPerPixel(format);
+        const size_t planeSize = size_t(width) * height;
+        const uint32_t baseWidth = base ? width / baseScale : 0;
+        const size_t basePlaneSize = base ? size_t(baseWidth) * (height / baseScale) : 0;
+        const size_t baseRowStart = base ? size_t(y / baseScale) * baseWidth : 0;
+
+        float values[3 * c_chunkWidth];
+        float baseValues[3 * c_chunkWidth];
+        float converted[3 * c_chunkWidth];
+        uint8_t bytes[4 * c_chunkWidth + 16];
+
+        for (uint32_t chunkStart = 0; chunkStart < width; chunkStart += c_chunkWidth)
+        {
+            const uint32_t count = std::min(c_chunkWidth, width - chunkStart);
+            uint8_t* output = imageRow + size_t(chunkStart) * bytesPerPixel;
+
+            if (!planar)
+            {
+                if (base)
+                {
+                    ExpandBaseRow(base + baseRowStart * 3, chunkStart, count, 3, baseScale, converted, baseValues);
+                }
+                ConvertValues(tensor + (size_t(y) * width + chunkStart) * 3, base ? baseValues : nullptr, count * 3, srgb, values);
+
+                uint8_t* rgb = (format == PixelFormat::Rgb8) ? output : bytes;
+                StoreBytes(values, count * 3, rgb);
+                if (format != PixelFormat::Rgb8)
+                {
+                    AddAlpha(rgb, count, format == PixelFormat::Bgra8, output);
+                }
+                continue;
+            }
+
+            for (uint32_t channel = 0; channel < channels; channel++)
+            {
+                if (base)
+                {
+                    ExpandBaseRow(base + channel * basePlaneSize + baseRowStart, chunkStart, count, 1, baseScale, converted, baseValues);
+                }
+                ConvertValues(tensor + channel * planeSize + size_t(y) * width + chunkStart, base ? baseValues : nullptr, count, srgb,
+                    values + channel * c_chunkWidth);
+            }
+
+            if (format == PixelFormat::Gray8)
+            {
+                StoreBytes(values, count, output);
+                continue;
+            }
+
+            // RGB8 is interleaved on the stack with the same vector stores, and then packed
+            const uint32_t first = (format == PixelFormat::Bgra8) ? 2 : 0;
+            const float* byte0 = values + first * c_chunkWidth;
+            const float* byte1 = values + c_chunkWidth;
+            const float* byte2 = values + (2 - first) * c_chunkWidth;
+            uint8_t* pixels = (format == PixelFormat::Rgb8) ? bytes : output;
+
+            uint32_t x = 0;
+            for (; x + c_width <= count; x += c_width)
+            {
+                StorePixels(pixels + size_t(x) * 4, Load(byte0 + x), Load(byte1 + x), Load(byte2 + x));
+            }
+            for (; x < count; x++)
+            {
+                pixels[x * 4] = static_cast<uint8_t>(std::nearbyint(byte0[x]));
+                pixels[x * 4 + 1] = static_cast<uint8_t>(std::nearbyint(byte1[x]));
+                pixels[x * 4 + 2] = static_cast<uint8_t>(std::nearbyint(byte2[x]));
+                pixels[x * 4 + 3] = 255;
+            }
+
+            if (format == PixelFormat::Rgb8)
+            {
+                DropAlpha(bytes, count, false, output);
+            }
+        }
+    }
+
+    template<typename Element>
+    void TensorToImageRows(
+        const Element* tensor,
+        const Element* base,
+        uint32_t baseScale,
+        uint32_t width,
+        uint32_t height,
+        TensorLayout layout,
+        PixelFormat format,
+        bool srgb,
+        uint8_t* image,
+        uint32_t rowPitch,
+        ThreadPool* threadPool)
+    {
+        const SrgbEncoder* encoder = srgb ? &GetSrgbEncoder() : nullptr;
+        ParallelFor(threadPool, height, [&](uint32_t y, uint32_t)
+        {
+            TensorRowToImage(tensor, base, baseScale, width, height, layout, format, encoder, y, image + size_t(y) * rowPitch);
+        });
+    }
+}
+
+size_t ColorConversion::GetYuvFrameSize(const YuvFormat& format, uint32_t width, uint32_t height)
+{
+    const size_t sampleSize = (format.bitDepth > 8) ? 2 : 1;
+    const size_t chromaSize = size_t((width + 1) / 2) * ((height + 1) / 2);
+    return (size_t(width) * height + chromaSize * 2) * sampleSize;
+}
+
+void ColorConversion::YuvToTensor(
+    const uint8_t* frame,
+    const YuvFormat& format,
+    uint32_t width,
+    uint32_t height,
+    float* tensor,
+    ThreadPool* threadPool)
+{
+    ParallelFor(threadPool, (height + 1) / 2, [&](uint32_t chromaRow, uint32_t)
+    {
+        if (format.bitDepth > 8)
+        {
+            YuvToTensorRows(reinterpret_cast<const uint16_t*>(frame), format, width, height, chromaRow, tensor);
+        }
+        else
+        {
+            YuvToTensorRows(frame, format, width, height, chromaRow, tensor);
+        }
+    });
+}
+
+void ColorConversion::TensorToYuv(
+    const float* tensor,
+    uint32_t width,
+    uint32_t height,
+    const YuvFormat& format,
+    uint8_t* frame,
+    ThreadPool* threadPool)
+{
+    ParallelFor(threadPool, (height + 1) / 2, [&](uint32_t chromaRow, uint32_t)
+    {
+        if (format.bitDepth > 8)
+        {
+            TensorToYuvRows(tensor, width, height, format, chromaRow, reinterpret_cast<uint16_t*>(frame));
+        }
+        else
+        {
+            TensorToYuvRows(tensor, width, height, format, chromaRow, frame);
+        }
+    });
+}
+
+void ColorConversion::ImageToTensor(
+    const uint8_t* image,
+    uint32_t rowPitch,
+    uint32_t width,
+    uint32_t height,
+    TensorLayout layout,
+    uint16_t* tensor,
+    ThreadPool* threadPool)
+{
+    const size_t planeSize = size_t(width) * height;
+    const size_t rowStride = (layout == TensorLayout::Nchw) ? width : size_t(width) * 3;
+    ParallelFor(threadPool, height, [&](uint32_t y, uint32_t)
+    {
+        ImageRowToTensor(image + size_t(y) * rowPitch, width, layout, planeSize, tensor + y * rowStride);
+    });
+}
+
+void ColorConversion::TensorToImage(
+    const float* tensor,
+    const float* base,
+    uint32_t baseScale,
+    uint32_t width,
+    uint32_t height,
+    TensorLayout layout,
+    PixelFormat format,
+    bool srgb,
+    uint8_t* image,
+    uint32_t rowPitch,
+    ThreadPool* threadPool)
+{
+    TensorToImageRows(tensor, base, baseScale, width, height, layout, format, srgb, image, rowPitch, threadPool);
+}
+
+void ColorConversion::TensorToImage(
+    const uint16_t* tensor,
+    const uint16_t* base,
+    uint32_t baseScale,
+    uint32_t width,
+    uint32_t height,
+    TensorLayout layout,
+    PixelFormat format,
+    bool srgb,
+    uint8_t* image,
+    uint32_t rowPitch,
+    ThreadPool* threadPool)
+{
+    TensorToImageRows(tensor, base, baseScale, width, height, layout, format, srgb, image, rowPitch, threadPool);
+}
@@ -0,0 +1,125 @@
+//--------------------------------------------------------------------------------------
+// ColorConversion.h
+//
+// Conversions between video frames or images and the RGB tensors the models take and
+// produce: planar FP32 for the CPU engine, and FP16 in either layout as the sample's
+// shaders write for DirectML. Each conversion is a single pass, vectorized with CpuSimd,
+// that converts the color space, normalizes and planarizes together, so frames never go
+// through an intermediate 8-bit RGB image. Work is split into tasks of rows; for 4:2:0
+// video, two rows, which share a row of chroma.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+namespace ColorConversion
+{
+    enum class YuvMatrix
+    {
+        Bt601,
+        Bt709,
+    };
+
+    // Layout of a 4:2:0 frame in memory: a full-resolution luma plane followed by chroma at half the width and
+    // height, rounded up, either as separate U and V planes (I420, as in Y4M) or as one plane of interleaved U and V
+    // pairs (NV12). Samples of more than 8 bits take two bytes each, in the low bits (as in Y4M) or in the high bits
+    // (as in P010). Limited range puts black at 16 and white at 235, scaled to the bit depth.
+    struct YuvFormat
+    {
+        uint32_t    bitDepth = 8;
+        bool        msbAligned = false;
+        bool        interleavedChroma = false;
+        bool        fullRange = false;
+        YuvMatrix   matrix = YuvMatrix::Bt709;
+    };
+
+    enum class TensorLayout
+    {
+        Nchw,   // Planar R, G and B
+        Nhwc,   // Interleaved RGB
+    };
+
+    enum class PixelFormat
+    {
+        Rgba8,
+        Bgra8,
+        Rgb8,   // Packed, as ImageRGB8 holds it
+        Gray8,  // One byte per pixel, from a single-channel tensor
+    };
+
+    size_t GetYuvFrameSize(const YuvFormat& format, uint32_t width, uint32_t height);
+
+    // Writes the planar RGB tensor [3][height][width] with values clamped to [0, 1]. Each chroma sample is used for
+    // its 2x2 block of pixels.
+    void YuvToTensor(
+        const uint8_t* frame,
+        const YuvFormat& format,
+        uint32_t width,
+        uint32_t height,
+        float* tensor,
+        ThreadPool* threadPool);
+
+    // Converts the RGB values clamped to [0, 1], and averages each 2x2 block for chroma. The format must have its
+    // samples in the low bits.
+    void TensorToYuv(
+        const float* tensor,
+        uint32_t width,
+        uint32_t height,
+        const YuvFormat& format,
+        uint8_t* frame,
+        ThreadPool* threadPool);
+
+    // The CPU equivalent of ImageToTensor.hlsl. Converts BGRA8 pixels, as LoadBGRAImage returns them, to an FP16 RGB
+    // tensor [height][width][3] or [3][height][width] with values in [0, 1], dropping alpha. Image rows are rowPitch
+    // bytes apart. For an image within a batch, offset the tensor by 3 * width * height values per image, as the
+    // shader's BatchIndex does.
+    void ImageToTensor(
+        const uint8_t* image,
+        uint32_t rowPitch,
+        uint32_t width,
+        uint32_t height,
+        TensorLayout layout,
+        uint16_t* tensor,
+        ThreadPool* threadPool);
+
+    // The CPU equivalent of the TensorToImage.hlsli pixel shaders, with the model's final residual add fused in, so
+    // that the sum is never stored. Reads an FP32 or FP16 tensor [height][width][3] or [3][height][width], or one
+    // channel for Gray8, adds base if it is not null, and writes pixels with the values saturated to [0, 1], sRGB
+    // encoded if requested, and alpha 1. The base is the model input, of the same type, layout and channel count,
+    // at 1 / baseScale of the width and height, and is upsampled with nearest neighbor sampling (see
+    // Graph::SplitResidualOutput). Image rows are rowPitch bytes apart. For an image within a batch, offset the
+    // tensor and base by their size per image, as the shader's BatchIndex does.
+    void TensorToImage(
+        const float* tensor,
+        const float* base,
+        uint32_t baseScale,
+        uint32_t width,
+        uint32_t height,
+        TensorLayout layout,
+        PixelFormat format,
+        bool srgb,
+        uint8_t* image,
+        uint32_t rowPitch,
+        ThreadPool* threadPool);
+
+    void TensorToImage(
+        const uint16_t* tensor,
+        const uint16_t* base,
+        uint32_t baseScale,
+        uint32_t width,
+        uint32_t height,
+        TensorLayout layout,
+        PixelFormat format,
+        bool srgb,
+        uint8_t* image,
+        uint32_t rowPitch,
+        ThreadPool* threadPool);
+}
@@ -0,0 +1,669 @@
+//--------------------------------------------------------------------------------------
+// CpuInference.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "CpuInference.h"
+#include "CpuKernels.h"
+#include "Float16Compressor.h"
+#include "ModelContainer.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+using namespace SuperResolutionModel;
+
+namespace
+{
+    // The Winograd transforms cost about as much per channel as the multiplies they save per pair of input and
+    // output channels, so they only pay off with enough filters. The last layer, which has one per color, runs
+    // faster as a direct convolution.
+    const uint32_t c_minWinogradFilters = 16;
+
+    // Layout tuning keeps the best of this many runs, after one to warm up
+    const int c_tuningRuns = 3;
+
+    // Whether no value of a differs from that of b by more than threshold. Compares in chunks, so the inner loop
+    // vectorizes, and a changed tile usually stops at its first chunk.
+    bool IsWithinThreshold(const std::vector<float>& a, const std::vector<float>& b, float threshold)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+
+        const size_t c_chunkSize = 256;
+        for (size_t i = 0; i < a.size(); i += c_chunkSize)
+        {
+            const size_t end = std::min(i + c_chunkSize, a.size());
+            float maxDifference = 0.0f;
+            for (size_t j = i; j < end; j++)
+            {
+                const float difference = std::fabs(a[j] - b[j]);
+                maxDifference = (difference > maxDifference) ? difference : maxDifference;
+            }
+            if (maxDifference > threshold)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Rounds values to the nearest FP16 value, as storing them in an FP16 tensor does
+    void RoundToFloat16(float* values, size_t count)
+    {
+        uint16_t half[1024];
+        for (size_t i = 0; i < count; i += 1024)
+        {
+            const size_t chunk = std::min<size_t>(1024, count - i);
+            Float16Compressor::compress(values + i, half, chunk);
+            Float16Compressor::decompress(half, values + i, chunk);
+        }
+    }
+}
+
+bool CpuInference::Initialize(const Graph& graph, const WeightMapType& weights)
+{
+    m_graph = graph;
+    m_opTraceNames.clear();
+    for (const OpDesc& op : graph.GetOps())
+    {
+        m_opTraceNames.push_back(Trace::Intern(graph.GetTensors()[op.output].name));
+    }
+    m_convLayers.resize(graph.GetConvLayers().size());
+    m_arenaLayout = {};
+    std::fill_n(m_plannedSize, 3, 0);
+
+    std::vector<const TensorDesc*> convInputs(m_convLayers.size());
+    for (const OpDesc& op : graph.GetOps())
+    {
+        if (IsConvolution(op))
+        {
+            m_convLayers[op.convLayer].upsampleFactor = op.upsampleFactor;
+            convInputs[op.convLayer] = &graph.GetTensors()[op.inputs[0]];
+        }
+    }
+
+    // The ops between two barriers run side by side, and are profiled together
+    m_groupStarts.clear();
+    for (uint32_t i = 0; i < graph.GetOps().size(); i++)
+    {
+        if (i == 0 || graph.GetOps()[i].barrierBefore)
+        {
+            m_groupStarts.push_back(i);
+        }
+    }
+    m_groupStarts.push_back(static_cast<uint32_t>(graph.GetOps().size()));
+    SetProfiling(m_profiling);
+
+    std::vector<float> filter, bias, subpixelFilter, subpixelBias;
+
+    for (size_t i = 0; i < m_convLayers.size(); i++)
+    {
+        const ConvLayerDesc& desc = graph.GetConvLayers()[i];
+        ConvLayer& layer = m_convLayers[i];
+
+        std::copy(desc.filterSizes, desc.filterSizes + 4, layer.filterSizes);
+        layer.useBiasAndActivation = UsesBiasAndActivation(desc);
+
+        if (!ModelContainer::FoldConvLayer(weights, desc, ModelContainer::Layout::NCHW, filter, bias))
+        {
+            return false;
+        }
+
+        if (m_precision == Precision::Float16)
+        {
+            RoundToFloat16(filter.data(), filter.size());
+            RoundToFloat16(bias.data(), bias.size());
+        }
+
+        // INT8 inputs are unsigned, which covers the model input and the results of ReLU
+        layer.quantized = false;
+        if (m_precision == Precision::Int8)
+        {
+            const auto range = m_activationRanges.find(convInputs[i]->name);
+            if (range == m_activationRanges.end())
+            {
+                std::cerr << "No activation range for " << convInputs[i]->name << ", the input of " << desc.name << std::endl;
+                return false;
+            }
+            layer.quantized = (range->second.min >= 0.0f);
+            layer.inputScale = Quantization::GetUnsignedScale(range->second);
+        }
+
+        // A convolution of an upsampled input runs one filter per phase at the input resolution instead
+        if (layer.upsampleFactor > 1)
+        {
+            CpuKernels::MakeSubpixelFilter(filter.data(), bias.empty() ? nullptr : bias.data(), desc.filterSizes,
+                layer.upsampleFactor, subpixelFilter, subpixelBias, layer.filterSizes);
+            filter.swap(subpixelFilter);
+            bias.swap(subpixelBias);
+        }
+
+        // Winograd filters are transformed once here rather than every frame
+        layer.algorithm = (CpuKernels::SupportsConvAlgorithm(layer.filterSizes, m_convAlgorithm) && layer.filterSizes[0] >= c_minWinogradFilters)
+            ? m_convAlgorithm : CpuKernels::ConvAlgorithm::Direct;
+        layer.layout = m_convLayout;
+        layer.filter.clear();
+        if (layer.quantized)
+        {
+            layer.algorithm = CpuKernels::ConvAlgorithm::Direct;
+            layer.packedFilter.clear();
+            CpuKernels::PackInt8ConvFilter(filter.data(), layer.filterSizes, layer.packedInt8Filter, layer.packedOutputScales);
+            for (float& scale : layer.packedOutputScales)
+            {
+                scale *= layer.inputScale;
+            }
+        }
+        else if (layer.algorithm == CpuKernels::ConvAlgorithm::Direct)
+        {
+            CpuKernels::PackConvFilter(filter.data(), layer.filterSizes, layer.layout, layer.packedFilter);
+            layer.filter = filter;
+        }
+        else
+        {
+            CpuKernels::PackWinogradFilter(filter.data(), layer.filterSizes, layer.algorithm, layer.packedFilter);
+        }
+        CpuKernels::PackConvBias(bias.empty() ? nullptr : bias.data(), layer.filterSizes[0], layer.packedBias);
+    }
+
+    return true;
+}
+
+void CpuInference::SetTileSize(uint32_t tileWidth, uint32_t tileHeight)
+{
+    m_tileWidth = tileWidth;
+    m_tileHeight = tileHeight;
+}
+
+void CpuInference::SetTemporalReuse(bool enable, float threshold)
+{
+    m_temporalReuse = enable;
+    m_reuseThreshold = threshold;
+    m_reuseCounts = ReuseCounts();
+    if (!enable)
+    {
+        std::vector<ReuseTile>().swap(m_reuseTiles);
+        std::fill(m_reuseSize, m_reuseSize + 5, 0);
+    }
+}
+
+uint32_t CpuInference::TuneConvLayouts(uint32_t batchSize, uint32_t height, uint32_t width, LayoutTuning::MeasuredTimes& times)
+{
+    const std::vector<TensorDesc>& tensors = m_graph.GetTensors();
+    const std::vector<OpDesc>& ops = m_graph.GetOps();
+
+    // Tiles are extended by the halo on both sides, except at the edges of the frame
+    const uint32_t halo = m_graph.GetInputHalo();
+    if (m_tileWidth > 0)
+    {
+        width = std::min(width, m_tileWidth + 2 * halo);
+    }
+    if (m_tileHeight > 0)
+    {
+        height = std::min(height, m_tileHeight + 2 * halo);
+    }
+
+    const std::string device = LayoutTuning::GetCpuDevice(m_threadPool ? m_threadPool->GetThreadCount() : 1);
+    std::vector<std::string> layoutNames;
+    for (CpuKernels::ConvLayout layout : CpuKernels::c_convLayouts)
+    {
+        layoutNames.push_back(CpuKernels::GetConvLayoutName(layout));
+    }
+
+    std::vector<float> input, output, scratch, packedFilter;
+    uint32_t measurementCount = 0;
+
+    for (const OpDesc& op : ops)
+    {
+        if (!IsConvolution(op) || m_convLayers[op.convLayer].filter.empty())
+        {
+            continue;
+        }
+
+        ConvLayer& layer = m_convLayers[op.convLayer];
+        const uint32_t scale = tensors[op.inputs[0]].scale;
+        const uint32_t inputSizes[4] = { batchSize, layer.filterSizes[1], height * scale, width * scale };
+        const std::string shape = LayoutTuning::GetConvShape(inputSizes, layer.filterSizes, layer.useBiasAndActivation);
+
+        // The values don't matter for the time, but keep them finite
+        input.assign(size_t(inputSizes[0]) * inputSizes[1] * inputSizes[2] * inputSizes[3], 0.5f);
+        output.resize(size_t(inputSizes[0]) * layer.filterSizes[0] * inputSizes[2] * inputSizes[3]);
+
+        for (CpuKernels::ConvLayout layout : CpuKernels::c_convLayouts)
+        {
+            const std::string key = LayoutTuning::GetKey(device, shape, CpuKernels::GetConvLayoutName(layout));
+            if (times.count(key) > 0)
+            {
+                continue;
+            }
+
+            CpuKernels::PackConvFilter(layer.filter.data(), layer.filterSizes, layout, packedFilter);
+            scratch.resize(CpuKernels::GetConv2DScratchSize(inputSizes[0], inputSizes[2], inputSizes[3], layer.filterSizes, layout));
+
+            double best = std::numeric_limits<double>::max();
+            for (int run = 0; run <= c_tuningRuns; run++)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                CpuKernels::Conv2D(input.data(), inputSizes[0], inputSizes[2], inputSizes[3], packedFilter.data(),
+                    layer.packedBias.data(), layer.filterSizes, layout, layer.useBiasAndActivation, nullptr, output.data(),
+                    scratch.data(), m_threadPool);
+                const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                if (run > 0)
+                {
+                    best = std::min(best, milliseconds);
+                }
+            }
+            times[key] = best;
+            measurementCount++;
+        }
+
+        std::string fastest;
+        LayoutTuning::FindFastestLayout(times, device, shape, layoutNames, fastest);
+        for (CpuKernels::ConvLayout layout : CpuKernels::c_convLayouts)
+        {
+            if (fastest == CpuKernels::GetConvLayoutName(layout) && layout != layer.layout)
+            {
+                layer.layout = layout;
+                CpuKernels::PackConvFilter(layer.filter.data(), layer.filterSizes, layout, layer.packedFilter);
+            }
+        }
+    }
+
+    // The scratch sizes depend on the layouts
+    std::fill_n(m_plannedSize, 3, 0);
+    return measurementCount;
+}
+
+void CpuInference::SetThreadPool(ThreadPool* threadPool)
+{
+    m_threadPool = threadPool;
+
+    // Winograd convolutions need scratch space for each thread
+    std::fill_n(m_plannedSize, 3, 0);
+    SetProfiling(m_profiling);
+}
+
+void CpuInference::SetProfiling(bool enable)
+{
+    m_profiling = enable;
+    if (m_threadPool)
+    {
+        m_threadPool->SetProfiling(enable);
+    }
+
+    m_layerProfiles.clear();
+    if (!enable)
+    {
+        return;
+    }
+
+    const std::vector<OpDesc>& ops = m_graph.GetOps();
+    for (size_t group = 0; group + 1 < m_groupStarts.size(); group++)
+    {
+        LayerProfile profile = {};
+        for (uint32_t i = m_groupStarts[group]; i < m_groupStarts[group + 1]; i++)
+        {
+            profile.name += (profile.name.empty() ? "" : " + ") + m_graph.GetTensors()[ops[i].output].name;
+        }
+        m_layerProfiles.push_back(profile);
+    }
+}
+
+size_t CpuInference::GetWorkingSetSize() const
+{
+    size_t size = m_arena.capacity() + m_tileInput.capacity() + m_tileOutput.capacity();
+    for (const ReuseTile& tile : m_reuseTiles)
+    {
+        size += tile.input.capacity() + tile.output.capacity();
+    }
+    return size * sizeof(float);
+}
+
+void CpuInference::PlanArena(uint32_t batchSize, uint32_t height, uint32_t width)
+{
+    const uint32_t size[3] = { batchSize, height, width };
+    if (std::equal(size, size + 3, m_plannedSize))
+    {
+        return;
+    }
+    std::copy(size, size + 3, m_plannedSize);
+
+    const std::vector<TensorDesc>& tensors = m_graph.GetTensors();
+    const std::vector<OpDesc>& ops = m_graph.GetOps();
+
+    std::vector<uint64_t> bufferSizes(m_graph.GetBufferCount(), 0);
+    for (const TensorDesc& tensor : tensors)
+    {
+        const uint64_t tensorSize = uint64_t(batchSize) * tensor.channels * height * width * tensor.scale * tensor.scale * sizeof(float);
+        bufferSizes[tensor.buffer] = std::max(bufferSizes[tensor.buffer], tensorSize);
+    }
+
+    // Convolutions copy their input to a zero-bordered scratch buffer. Those of an upsampled input also need room
+    // for their phases, which are the size of the output.
+    std::vector<uint64_t> temporarySizes(ops.size(), 0);
+    for (size_t i = 0; i < ops.size(); i++)
+    {
+        if (IsConvolution(ops[i]))
+        {
+            const uint32_t scale = tensors[ops[i].inputs[0]].scale;
+            temporarySizes[i] = GetConvScratchSize(m_convLayers[ops[i].convLayer], batchSize, height * scale, width * scale);
+            if (ops[i].upsampleFactor > 1)
+            {
+                temporarySizes[i] += bufferSizes[tensors[ops[i].output].buffer];
+            }
+        }
+    }
+
+    // Offsets stay aligned to a cache line
+    m_arenaLayout = MemoryPlanner::PlanGraph(m_graph, bufferSizes, temporarySizes, 64);
+
+    // Nothing in the arena outlives a frame, so grow it without copying, and to the exact size
+    const size_t arenaSize = m_arenaLayout.arenaSize / sizeof(float);
+    if (m_arena.size() < arenaSize)
+    {
+        std::vector<float>(arenaSize).swap(m_arena);
+    }
+}
+
+void CpuInference::Run(const float* input, uint32_t batchSize, uint32_t height, uint32_t width, float* output)
+{
+    const uint32_t tileWidth = (m_tileWidth > 0) ? std::min(m_tileWidth, width) : width;
+    const uint32_t tileHeight = (m_tileHeight > 0) ? std::min(m_tileHeight, height) : height;
+
+    Trace::Scope scope("Model");
+    if (tileWidth == width && tileHeight == height && !m_temporalReuse)
+    {
+        RunFrame(input, batchSize, height, width, output);
+        return;
+    }
+
+    const uint32_t halo = m_graph.GetInputHalo();
+    const uint32_t upscaleFactor = m_graph.GetUpscaleFactor();
+    const uint32_t outputWidth = width * upscaleFactor;
+    const size_t outputPlaneSize = size_t(outputWidth) * height * upscaleFactor;
+    const uint32_t planeCount = batchSize * m_graph.GetInput().channels;
+
+    if (m_temporalReuse)
+    {
+        const uint32_t size[5] = { batchSize, height, width, tileHeight, tileWidth };
+        if (!std::equal(size, size + 5, m_reuseSize))
+        {
+            std::copy(size, size + 5, m_reuseSize);
+            m_reuseTiles.clear();
+            m_reuseTiles.resize(size_t((height + tileHeight - 1) / tileHeight) * ((width + tileWidth - 1) / tileWidth));
+        }
+    }
+
+    size_t tileIndex = 0;
+    for (uint32_t y0 = 0; y0 < height; y0 += tileHeight)
+    {
+        for (uint32_t x0 = 0; x0 < width; x0 += tileWidth)
+        {
+            const uint32_t y1 = std::min(y0 + tileHeight, height);
+            const uint32_t x1 = std::min(x0 + tileWidth, width);
+
+            // Extend the tile by the halo, except at the image edges, where the convolutions zero pad as usual
+            const uint32_t haloY0 = (y0 > halo) ? y0 - halo : 0;
+            const uint32_t haloX0 = (x0 > halo) ? x0 - halo : 0;
+            const uint32_t haloY1 = std::min(y1 + halo, height);
+            const uint32_t haloX1 = std::min(x1 + halo, width);
+            const uint32_t haloHeight = haloY1 - haloY0;
+            const uint32_t haloWidth = haloX1 - haloX0;
+
+            m_tileInput.resize(size_t(planeCount) * haloHeight * haloWidth);
+            m_tileOutput.resize(m_tileInput.size() * upscaleFactor * upscaleFactor);
+
+            for (uint32_t plane = 0; plane < planeCount; plane++)
+            {
+                for (uint32_t y = haloY0; y < haloY1; y++)
+                {
+                    std::copy_n(
+                        input + (size_t(plane) * height + y) * width + haloX0,
+                        haloWidth,
+                        &m_tileInput[(size_t(plane) * haloHeight + y - haloY0) * haloWidth]);
+                }
+            }
+
+            // The output of a tile depends on nothing outside its input with the halo, so if that is unchanged, so is
+            // the output
+            const uint32_t coreOutputWidth = (x1 - x0) * upscaleFactor;
+            const uint32_t coreOutputHeight = (y1 - y0) * upscaleFactor;
+            ReuseTile* reuseTile = m_temporalReuse ? &m_reuseTiles[tileIndex++] : nullptr;
+            if (reuseTile)
+            {
+                m_reuseCounts.tileCount++;
+                if (!reuseTile->output.empty() && IsWithinThreshold(m_tileInput, reuseTile->input, m_reuseThreshold))
+                {
+                    m_reuseCounts.reusedTileCount++;
+                    for (uint32_t plane = 0; plane < planeCount; plane++)
+                    {
+                        for (uint32_t y = 0; y < coreOutputHeight; y++)
+                        {
+                            std::copy_n(
+                                &reuseTile->output[(size_t(plane) * coreOutputHeight + y) * coreOutputWidth],
+                                coreOutputWidth,
+                                output + plane * outputPlaneSize + size_t(y0 * upscaleFactor + y) * outputWidth + x0 * upscaleFactor);
+                        }
+                    }
+                    continue;
+                }
+                reuseTile->input = m_tileInput;
+                reuseTile->output.resize(size_t(planeCount) * coreOutputHeight * coreOutputWidth);
+            }
+
+            Trace::Begin("Tile");
+            RunFrame(m_tileInput.data(), batchSize, haloHeight, haloWidth, m_tileOutput.data());
+            Trace::End();
+
+            // Keep only the part of the output that the tile itself covers
+            const uint32_t tileOutputWidth = haloWidth * upscaleFactor;
+            const size_t tileOutputPlaneSize = size_t(tileOutputWidth) * haloHeight * upscaleFactor;
+
+            for (uint32_t plane = 0; plane < planeCount; plane++)
+            {
+                for (uint32_t y = y0 * upscaleFactor; y < y1 * upscaleFactor; y++)
+                {
+                    const float* tileRow = &m_tileOutput[plane * tileOutputPlaneSize + size_t(y - haloY0 * upscaleFactor) * tileOutputWidth + (x0 - haloX0) * upscaleFactor];
+                    std::copy_n(tileRow, coreOutputWidth, output + plane * outputPlaneSize + size_t(y) * outputWidth + x0 * upscaleFactor);
+                    if (reuseTile)
+                    {
+                        std::copy_n(tileRow, coreOutputWidth, &reuseTile->output[(size_t(plane) * coreOutputHeight + y - y0 * upscaleFactor) * coreOutputWidth]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void CpuInference::RunFrame(const float* input, uint32_t batchSize, uint32_t height, uint32_t width, float* output)
+{
+    const std::vector<TensorDesc>& tensors = m_graph.GetTensors();
+    const std::vector<OpDesc>& ops = m_graph.GetOps();
+
+    PlanArena(batchSize, height, width);
+
+    if (m_recordActivationRanges)
+    {
+        RecordActivationRange(m_graph.GetInput(), input, batchSize, height, width);
+    }
+
+    for (size_t group = 0; group + 1 < m_groupStarts.size(); group++)
+    {
+        const uint32_t firstOp = m_groupStarts[group];
+        const uint32_t opCount = m_groupStarts[group + 1] - firstOp;
+
+        const auto start = std::chrono::steady_clock::now();
+        const double busyStart = (m_profiling && m_threadPool) ? m_threadPool->GetBusySeconds() : 0.0;
+
+        // Each op splits its own work across the pool as well, so the threads that finish one op help with the others
+        if (opCount > 1 && m_threadPool)
+        {
+            m_threadPool->ParallelFor(opCount, [&](uint32_t index, uint32_t)
+            {
+                RunOp(firstOp + index, input, batchSize, height, width, output);
+            });
+        }
+        else
+        {
+            for (uint32_t i = firstOp; i < firstOp + opCount; i++)
+            {
+                RunOp(i, input, batchSize, height, width, output);
+            }
+        }
+
+        if (m_profiling)
+        {
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            m_layerProfiles[group].seconds += seconds;
+            m_layerProfiles[group].busySeconds += m_threadPool ? m_threadPool->GetBusySeconds() - busyStart : seconds;
+        }
+
+        // Recording updates shared ranges, so it waits for the whole group
+        if (m_recordActivationRanges)
+        {
+            for (uint32_t i = firstOp; i < firstOp + opCount; i++)
+            {
+                RecordActivationRange(tensors[ops[i].output], GetTensorData(ops[i].output, output), batchSize, height, width);
+            }
+        }
+    }
+}
+
+void CpuInference::RunOp(uint32_t op, const float* input, uint32_t batchSize, uint32_t height, uint32_t width, float* output)
+{
+    const std::vector<TensorDesc>& tensors = m_graph.GetTensors();
+    const OpDesc& desc = m_graph.GetOps()[op];
+
+    // Only the model input lives in the input buffer, and no op writes it.
+    auto getInput = [&](uint32_t tensor) -> const float*
+    {
+        return (tensors[tensor].buffer == c_inputBuffer) ? input : GetTensorData(tensor, output);
+    };
+
+    // Named after the tensor the op produces
+    Trace::Scope scope(m_opTraceNames[op]);
+
+    const TensorDesc& inputTensor = tensors[desc.inputs[0]];
+    const uint32_t layerHeight = height * inputTensor.scale;
+    const uint32_t layerWidth = width * inputTensor.scale;
+    float* layerOutput = GetTensorData(desc.output, output);
+
+    switch (desc.type)
+    {
+    case OpType::Upsample:
+        CpuKernels::Upsample(getInput(desc.inputs[0]), batchSize * inputTensor.channels, layerHeight, layerWidth,
+            desc.upsampleFactor, layerOutput, m_threadPool);
+        break;
+
+    case OpType::Convolution:
+    case OpType::ConvolutionAdd:
+    {
+        const ConvLayer& layer = m_convLayers[desc.convLayer];
+        float* scratch = &m_arena[m_arenaLayout.temporaryOffsets[op] / sizeof(float)];
+
+        float* phases = scratch + GetConvScratchSize(layer, batchSize, layerHeight, layerWidth) / sizeof(float);
+        float* convOutput = (layer.upsampleFactor > 1) ? phases : layerOutput;
+
+        // Accumulates onto the added tensor, which may be the output itself. The graph only fuses adds into
+        // convolutions of an input at their own resolution, whose output is not shuffled afterwards.
+        CpuKernels::ConvAddend convAddend = {};
+        const CpuKernels::ConvAddend* addend = nullptr;
+        if (desc.type == OpType::ConvolutionAdd)
+        {
+            convAddend = { getInput(desc.inputs[1]), desc.addendUpsampleFactor };
+            addend = &convAddend;
+        }
+
+        if (layer.quantized)
+        {
+            CpuKernels::Int8Conv2D(getInput(desc.inputs[0]), batchSize, layerHeight, layerWidth, layer.inputScale,
+                layer.packedInt8Filter.data(), layer.packedOutputScales.data(), layer.packedBias.data(), layer.filterSizes,
+                layer.useBiasAndActivation, addend, convOutput, scratch, m_threadPool);
+        }
+        else if (layer.algorithm == CpuKernels::ConvAlgorithm::Direct)
+        {
+            CpuKernels::Conv2D(getInput(desc.inputs[0]), batchSize, layerHeight, layerWidth, layer.packedFilter.data(),
+                layer.packedBias.data(), layer.filterSizes, layer.layout, layer.useBiasAndActivation, addend, convOutput,
+                scratch, m_threadPool);
+        }
+        else
+        {
+            CpuKernels::WinogradConv2D(getInput(desc.inputs[0]), batchSize, layerHeight, layerWidth, layer.packedFilter.data(),
+                layer.packedBias.data(), layer.filterSizes, layer.algorithm, layer.useBiasAndActivation, addend, convOutput,
+                scratch, m_threadPool);
+        }
+
+        if (layer.upsampleFactor > 1)
+        {
+            CpuKernels::DepthToSpace(phases, batchSize, tensors[desc.output].channels, layerHeight, layerWidth,
+                layer.upsampleFactor, layerOutput, m_threadPool);
+        }
+        break;
+    }
+
+    case OpType::Add:
+        // The output may be one of the inputs, when the graph adds in-place.
+        if (desc.addendUpsampleFactor > 1)
+        {
+            CpuKernels::AddUpsampled(getInput(desc.inputs[0]), getInput(desc.inputs[1]), batchSize * inputTensor.channels,
+                layerHeight, layerWidth, desc.addendUpsampleFactor, layerOutput, m_threadPool);
+        }
+        else
+        {
+            CpuKernels::Add(getInput(desc.inputs[0]), getInput(desc.inputs[1]),
+                size_t(batchSize) * inputTensor.channels * layerHeight * layerWidth, layerOutput, m_threadPool);
+        }
+        break;
+    }
+
+    const TensorDesc& outputTensor = tensors[desc.output];
+    if (m_precision == Precision::Float16)
+    {
+        RoundToFloat16(layerOutput, size_t(batchSize) * outputTensor.channels * height * width * outputTensor.scale * outputTensor.scale);
+    }
+}
+
+// Bytes, rounded up so that what follows stays aligned
+uint64_t CpuInference::GetConvScratchSize(const ConvLayer& layer, uint32_t batchSize, uint32_t height, uint32_t width) const
+{
+    uint64_t size = 0;
+    if (layer.quantized)
+    {
+        size = CpuKernels::GetInt8Conv2DScratchSize(batchSize, height, width, layer.filterSizes);
+    }
+    else if (layer.algorithm == CpuKernels::ConvAlgorithm::Direct)
+    {
+        size = CpuKernels::GetConv2DScratchSize(batchSize, height, width, layer.filterSizes, layer.layout);
+    }
+    else
+    {
+        size = CpuKernels::GetWinogradConv2DScratchSize(width, layer.filterSizes, layer.algorithm) *
+            (m_threadPool ? m_threadPool->GetThreadCount() : 1);
+    }
+    size *= sizeof(float);
+    return (size + 63) & ~uint64_t(63);
+}
+
+float* CpuInference::GetTensorData(uint32_t tensor, float* output)
+{
+    const uint32_t buffer = m_graph.GetTensors()[tensor].buffer;
+    return (buffer == c_outputBuffer) ? output : &m_arena[m_arenaLayout.bufferOffsets[buffer] / sizeof(float)];
+}
+
+// Tensors are planar, with sizes relative to the model input of the frame or tile
+void CpuInference::RecordActivationRange(const TensorDesc& tensor, const float* data, uint32_t batchSize, uint32_t height, uint32_t width)
+{
+    auto range = m_activationRanges.emplace(tensor.name, Quantization::EmptyActivationRange()).first;
+    Quantization::UpdateActivationRange(range->second, data,
+        size_t(batchSize) * tensor.channels * height * width * tensor.scale * tensor.scale);
+}
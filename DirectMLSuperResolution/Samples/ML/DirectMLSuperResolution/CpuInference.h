@@ -0,0 +1,190 @@
+//--------------------------------------------------------------------------------------
+// CpuInference.h
+//
+// Headless CPU implementation of the super-resolution model. It executes the same graph
+// as the DirectML path (see SuperResolutionModel.h) in FP32, or with INT8 convolutions, and
+// has no D3D12 or DirectML dependency, so it also builds and runs on non-Windows hosts.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CpuKernels.h"
+#include "LayoutTuning.h"
+#include "LoadWeights.h"
+#include "MemoryPlanner.h"
+#include "Quantization.h"
+#include "SuperResolutionModel.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class CpuInference
+{
+public:
+    CpuInference() = default;
+
+    CpuInference(const CpuInference&) = delete;
+    CpuInference& operator=(const CpuInference&) = delete;
+
+    // Folds the batch normalization weights into the convolution filters of the graph and packs them for the CPU
+    // kernels.
+    bool Initialize(const SuperResolutionModel::Graph& graph, const WeightMapType& weights);
+
+    // Algorithm for the 3x3 convolutions, including the phase filters of a 5x5 convolution of an upsampled input.
+    // Other filter sizes, and layers with only a few filters, always run the direct convolution. Takes effect at the
+    // next Initialize().
+    void SetConvAlgorithm(CpuKernels::ConvAlgorithm algorithm) { m_convAlgorithm = algorithm; }
+    CpuKernels::ConvAlgorithm GetConvAlgorithm(uint32_t convLayer) const { return m_convLayers[convLayer].algorithm; }
+
+    // Layout of the direct FP32 convolutions (see CpuKernels::ConvLayout). Takes effect at the next Initialize().
+    void SetConvLayout(CpuKernels::ConvLayout layout) { m_convLayout = layout; }
+    CpuKernels::ConvLayout GetConvLayout(uint32_t convLayer) const { return m_convLayers[convLayer].layout; }
+
+    // Picks the fastest layout for each direct FP32 convolution, for frames of the given size, or the tiles of them
+    // if tiling. Layouts that have no time for this device and shape yet are measured on the thread pool, and their
+    // times added. Returns the number of measurements made. Call after Initialize(), SetTileSize() and
+    // SetThreadPool().
+    uint32_t TuneConvLayouts(uint32_t batchSize, uint32_t height, uint32_t width, LayoutTuning::MeasuredTimes& times);
+
+    enum class Precision
+    {
+        Float32,
+        Float16,        // FP16 weights and results of each op, like the DirectML path. Arithmetic is still FP32.
+        Int8            // Per-channel INT8 weights and unsigned INT8 inputs, with 32-bit integer accumulation
+    };
+
+    // Precision of the convolutions. Int8 needs the activation range of the input of each convolution (see
+    // SetActivationRanges()); convolutions of an input that can be negative keep running in FP32. Takes effect at
+    // the next Initialize().
+    void SetPrecision(Precision precision) { m_precision = precision; }
+    bool IsQuantized(uint32_t convLayer) const { return m_convLayers[convLayer].quantized; }
+
+    // Activation ranges by tensor name, used by Initialize() to quantize the inputs of the convolutions. When
+    // recording, every run widens the range of each tensor to the values it produces, which calibrates them.
+    void SetActivationRanges(const Quantization::ActivationRanges& ranges) { m_activationRanges = ranges; }
+    const Quantization::ActivationRanges& GetActivationRanges() const { return m_activationRanges; }
+    void SetRecordActivationRanges(bool record) { m_recordActivationRanges = record; }
+
+    const SuperResolutionModel::Graph& GetGraph() const { return m_graph; }
+
+    // Runs the model on a batch of planar images (batchSize x channels x height x width, values in [0, 1]). The
+    // output is a batch of planar images that are GetGraph().GetUpscaleFactor() times as large in both dimensions.
+    void Run(const float* input, uint32_t batchSize, uint32_t height, uint32_t width, float* output);
+
+    // Runs the model in tiles of at most tileWidth x tileHeight input pixels. Each tile is extended by
+    // Graph::GetInputHalo() pixels of context, so the output is identical to running the whole frame, but the
+    // intermediate buffers only hold one tile. Zero (the default) disables tiling.
+    void SetTileSize(uint32_t tileWidth, uint32_t tileHeight);
+
+    // Temporal reuse for video. Each Run() compares the input of every tile, with its halo, to the input the tile
+    // last ran on, and only runs the tiles where a value differs by more than threshold, copying the output kept from
+    // their last run for the others. With a threshold of zero, the output is identical to running every tile.
+    // Without a tile size, the whole frame is one tile. The kept inputs and outputs take about as much memory as the
+    // frame's input and output, and are dropped when the frame or tile size changes, or reuse is disabled.
+    void SetTemporalReuse(bool enable, float threshold = 0.0f);
+
+    // Tiles considered and tiles reused since reuse was enabled
+    struct ReuseCounts
+    {
+        uint64_t    tileCount = 0;
+        uint64_t    reusedTileCount = 0;
+    };
+    const ReuseCounts& GetReuseCounts() const { return m_reuseCounts; }
+
+    // Bytes of intermediate storage currently allocated.
+    size_t GetWorkingSetSize() const;
+
+    // Arena layout of the last frame or tile run, in bytes.
+    const MemoryPlanner::ArenaLayout& GetArenaLayout() const { return m_arenaLayout; }
+
+    // Runs the kernels on a thread pool, along with the ops between two barriers of the graph, which are
+    // independent of each other. nullptr (the default) runs everything on the calling thread. Run() must be called
+    // from the thread that constructed the pool, and the pool must outlive its use here.
+    void SetThreadPool(ThreadPool* threadPool);
+
+    // Time taken by the ops between each pair of barriers, summed over the runs since profiling was enabled.
+    // Together with the busy time of the threads, this gives the parallel efficiency of each layer.
+    struct LayerProfile
+    {
+        std::string name;               // Outputs of the ops, joined by " + "
+        double      seconds;            // Wall time
+        double      busySeconds;        // Summed over the threads of the pool, or the wall time without one
+    };
+
+    // Enabling profiling resets the profiles, and profiles the thread pool as well.
+    void SetProfiling(bool enable);
+    const std::vector<LayerProfile>& GetLayerProfiles() const { return m_layerProfiles; }
+
+private:
+    void RunFrame(const float* input, uint32_t batchSize, uint32_t height, uint32_t width, float* output);
+    void RunOp(uint32_t op, const float* input, uint32_t batchSize, uint32_t height, uint32_t width, float* output);
+    void PlanArena(uint32_t batchSize, uint32_t height, uint32_t width);
+
+    // Storage of a tensor that is not the model input
+    float* GetTensorData(uint32_t tensor, float* output);
+
+    void RecordActivationRange(const SuperResolutionModel::TensorDesc& tensor, const float* data, uint32_t batchSize, uint32_t height, uint32_t width);
+
+    struct ConvLayer
+    {
+        uint32_t            filterSizes[4];         // Of the phase filters, if the input is upsampled
+        uint32_t            upsampleFactor;         // See Graph::FuseUpsampleConvolutions()
+        bool                useBiasAndActivation;
+        CpuKernels::ConvAlgorithm algorithm;
+        CpuKernels::ConvLayout layout;              // Of a direct convolution
+        std::vector<float>  filter;                 // Folded, of a direct FP32 convolution, to pack for another layout
+        std::vector<float>  packedFilter;           // Transformed filters, for a Winograd algorithm
+        std::vector<float>  packedBias;
+
+        // Runs Int8Conv2D instead, with the output scale of each filter premultiplied by the input scale
+        bool                quantized;
+        float               inputScale;
+        std::vector<int8_t> packedInt8Filter;
+        std::vector<float>  packedOutputScales;
+    };
+
+    uint64_t GetConvScratchSize(const ConvLayer& layer, uint32_t batchSize, uint32_t height, uint32_t width) const;
+
+    SuperResolutionModel::Graph     m_graph;
+    std::vector<const char*>        m_opTraceNames;             // Interned, as the graph may be replaced before the trace is written
+    std::vector<ConvLayer>          m_convLayers;
+    CpuKernels::ConvAlgorithm       m_convAlgorithm = CpuKernels::ConvAlgorithm::Winograd4x4;
+    CpuKernels::ConvLayout          m_convLayout = CpuKernels::ConvLayout::NCHW;
+    Precision                       m_precision = Precision::Float32;
+    Quantization::ActivationRanges  m_activationRanges;
+    bool                            m_recordActivationRanges = false;
+
+    // Intermediate buffers and convolution scratch space, packed by MemoryPlanner the same as on the GPU. The
+    // layout is planned again whenever the frame or tile size changes.
+    std::vector<float>              m_arena;
+    MemoryPlanner::ArenaLayout      m_arenaLayout = {};
+    uint32_t                        m_plannedSize[3] = {};      // Batch size, height and width
+
+    uint32_t                        m_tileWidth = 0;
+    uint32_t                        m_tileHeight = 0;
+    std::vector<float>              m_tileInput;
+    std::vector<float>              m_tileOutput;
+
+    // Input with halo, and output without, of each tile's last run, in row-major order of the tiles
+    struct ReuseTile
+    {
+        std::vector<float>          input;
+        std::vector<float>          output;
+    };
+
+    bool                            m_temporalReuse = false;
+    float                           m_reuseThreshold = 0.0f;
+    std::vector<ReuseTile>          m_reuseTiles;
+    uint32_t                        m_reuseSize[5] = {};        // Batch size, height, width, tile height and width
+    ReuseCounts                     m_reuseCounts;
+
+    ThreadPool*                     m_threadPool = nullptr;
+    std::vector<uint32_t>           m_groupStarts;              // First op after each barrier, then the op count
+    bool                            m_profiling = false;
+    std::vector<LayerProfile>       m_layerProfiles;            // One per group of ops
+};
@@ -0,0 +1,1388 @@
+//--------------------------------------------------------------------------------------
+// CpuKernels.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "CpuKernels.h"
+#include "CpuSimd.h"
+#include "SuperResolutionModel.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace CpuKernels;
+
+namespace
+{
+    // Each convolution tile is this many vectors wide. With 32 vector registers there is room for two vectors of
+    // accumulators per output channel in the block.
+    const uint32_t c_tileVectors = (CpuSimd::c_registerCount >= 32) ? 2 : 1;
+    const uint32_t c_tileWidth = CpuSimd::c_width * c_tileVectors;
+
+    uint32_t RoundUp(uint32_t a, uint32_t b)
+    {
+        return (a + b - 1) / b * b;
+    }
+
+    // Elementwise kernels split their work into tasks of at least this many elements
+    const size_t c_elementsPerTask = 16384;
+
+    // Runs func(index, thread) for every index in [0, count), on the thread pool if there is one
+    template<typename Func>
+    void ParallelFor(ThreadPool* threadPool, uint32_t count, const Func& func)
+    {
+        if (threadPool)
+        {
+            threadPool->ParallelFor(count, func);
+            return;
+        }
+        for (uint32_t index = 0; index < count; index++)
+        {
+            func(index, 0);
+        }
+    }
+
+    // Where a tile finds the addend values of one of its rows
+    struct AddendRow
+    {
+        const float*    row;            // Addend row of the tile's first output channel, from column 0
+        size_t          planeSize;      // Of the addend
+        uint32_t        factor;
+        uint32_t        x0;             // First output column of the tile
+    };
+
+    AddendRow GetAddendRow(const CpuKernels::ConvAddend& addend, size_t plane, uint32_t y, uint32_t x0, uint32_t height, uint32_t width)
+    {
+        const uint32_t addendWidth = width / addend.factor;
+        const size_t planeSize = size_t(height / addend.factor) * addendWidth;
+        return { addend.data + plane * planeSize + size_t(y / addend.factor) * addendWidth, planeSize, addend.factor, x0 };
+    }
+
+    // Stores a row of output channel o of a tile's results, plus the addend values in its place if addend is not
+    // null. An addend of the output's size may be the output itself, as each value is read before it is written
+    // over.
+    inline void StoreTileRow(const float* values, const AddendRow* addend, uint32_t o, uint32_t count, float* dst)
+    {
+        if (!addend)
+        {
+            memcpy(dst, values, count * sizeof(float));
+            return;
+        }
+
+        const float* row = addend->row + o * addend->planeSize;
+        if (addend->factor == 1)
+        {
+            row += addend->x0;
+            for (uint32_t x = 0; x < count; x++)
+            {
+                dst[x] = values[x] + row[x];
+            }
+            return;
+        }
+
+        // Each addend value covers factor output columns
+        const float* src = row + addend->x0 / addend->factor;
+        uint32_t phase = addend->x0 % addend->factor;
+        for (uint32_t x = 0; x < count; x++)
+        {
+            dst[x] = values[x] + *src;
+            if (++phase == addend->factor)
+            {
+                phase = 0;
+                src++;
+            }
+        }
+    }
+
+    // Computes one tile of c_tileWidth output columns for a block of c_convOutputBlock output channels. The
+    // accumulators stay in vector registers for the whole reduction over input channels and filter taps.
+    inline void ConvTile(
+        const float* src,               // Top left of the tile's receptive field in the first padded input plane
+        size_t srcPlaneSize,
+        uint32_t srcRowPitch,
+        const float* filter,            // Packed filter block
+        const float* bias,              // Packed bias block
+        uint32_t C,
+        uint32_t KH,
+        uint32_t KW,
+        bool relu,
+        const AddendRow* addend,        // Added after ReLU, or nullptr
+        float* dst,                     // First output channel of the block
+        size_t dstPlaneSize,
+        uint32_t outputCount,
+        uint32_t columnCount)
+    {
+        CpuSimd::Float acc[c_convOutputBlock][c_tileVectors];
+        for (uint32_t o = 0; o < c_convOutputBlock; o++)
+        {
+            for (uint32_t v = 0; v < c_tileVectors; v++)
+            {
+                acc[o][v] = CpuSimd::Set(bias[o]);
+            }
+        }
+
+        for (uint32_t c = 0; c < C; c++, src += srcPlaneSize)
+        {
+            for (uint32_t ky = 0; ky < KH; ky++)
+            {
+                const float* srcRow = src + ky * srcRowPitch;
+                for (uint32_t kx = 0; kx < KW; kx++, filter += c_convOutputBlock)
+                {
+                    CpuSimd::Float in[c_tileVectors];
+                    for (uint32_t v = 0; v < c_tileVectors; v++)
+                    {
+                        in[v] = CpuSimd::Load(srcRow + kx + v * CpuSimd::c_width);
+                    }
+
+                    for (uint32_t o = 0; o < c_convOutputBlock; o++)
+                    {
+                        const CpuSimd::Float w = CpuSimd::Set(filter[o]);
+                        for (uint32_t v = 0; v < c_tileVectors; v++)
+                        {
+                            acc[o][v] = CpuSimd::MultiplyAdd(w, in[v], acc[o][v]);
+                        }
+                    }
+                }
+            }
+        }
+
+        float result[c_tileWidth];
+        for (uint32_t o = 0; o < outputCount; o++, dst += dstPlaneSize)
+        {
+            for (uint32_t v = 0; v < c_tileVectors; v++)
+            {
+                if (relu)
+                {
+                    acc[o][v] = CpuSimd::Max(acc[o][v], CpuSimd::Zero());
+                }
+                CpuSimd::Store(result + v * CpuSimd::c_width, acc[o][v]);
+            }
+            StoreTileRow(result, addend, o, columnCount, dst);
+        }
+    }
+
+    // Blocked layouts compute c_blockedOutputBlock filters, in two vectors, for as many columns as leave room in the
+    // registers for the filter vectors.
+    const uint32_t c_blockedTileVectors = 2;
+    const uint32_t c_blockedOutputBlock = CpuSimd::c_width * c_blockedTileVectors;
+    const uint32_t c_blockedTileWidth = (CpuSimd::c_registerCount - 4) / c_blockedTileVectors;
+
+    // Channels of a pixel that are stored together
+    uint32_t GetChannelBlock(ConvLayout layout, uint32_t channels)
+    {
+        switch (layout)
+        {
+        case ConvLayout::NHWC:      return channels;
+        case ConvLayout::NCHWc8:    return 8;
+        case ConvLayout::NCHWc16:   return 16;
+        default:                    return 1;
+        }
+    }
+
+    // ConvTile for the blocked layouts. Each input value is broadcast and multiplied with a vector of filters, and
+    // the accumulators are transposed to planar output at the end.
+    inline void BlockedConvTile(
+        const float* src,               // Top left of the tile's receptive field in the first padded channel block
+        size_t srcBlockSize,
+        uint32_t srcRowPitch,
+        uint32_t channelBlock,
+        const float* filter,            // Packed filter block
+        const float* bias,              // Packed bias block
+        uint32_t C,
+        uint32_t KH,
+        uint32_t KW,
+        bool relu,
+        const AddendRow* addend,        // Added after ReLU, or nullptr
+        float* dst,                     // First output channel of the block
+        size_t dstPlaneSize,
+        uint32_t outputCount,
+        uint32_t columnCount)
+    {
+        CpuSimd::Float acc[c_blockedTileWidth][c_blockedTileVectors];
+        for (uint32_t v = 0; v < c_blockedTileVectors; v++)
+        {
+            const CpuSimd::Float b = CpuSimd::Load(bias + v * CpuSimd::c_width);
+            for (uint32_t x = 0; x < c_blockedTileWidth; x++)
+            {
+                acc[x][v] = b;
+            }
+        }
+
+        for (uint32_t c0 = 0; c0 < C; c0 += channelBlock, src += srcBlockSize)
+        {
+            const uint32_t channels = std::min(channelBlock, C - c0);
+            for (uint32_t c = 0; c < channels; c++)
+            {
+                for (uint32_t ky = 0; ky < KH; ky++)
+                {
+                    const float* srcRow = src + ky * srcRowPitch + c;
+                    for (uint32_t kx = 0; kx < KW; kx++, filter += c_blockedOutputBlock)
+                    {
+                        CpuSimd::Float w[c_blockedTileVectors];
+                        for (uint32_t v = 0; v < c_blockedTileVectors; v++)
+                        {
+                            w[v] = CpuSimd::Load(filter + v * CpuSimd::c_width);
+                        }
+
+                        const float* srcColumn = srcRow + kx * channelBlock;
+                        for (uint32_t x = 0; x < c_blockedTileWidth; x++)
+                        {
+                            const CpuSimd::Float in = CpuSimd::Set(srcColumn[x * channelBlock]);
+                            for (uint32_t v = 0; v < c_blockedTileVectors; v++)
+                            {
+                                acc[x][v] = CpuSimd::MultiplyAdd(w[v], in, acc[x][v]);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        float result[c_blockedTileWidth][c_blockedOutputBlock];
+        for (uint32_t x = 0; x < columnCount; x++)
+        {
+            for (uint32_t v = 0; v < c_blockedTileVectors; v++)
+            {
+                if (relu)
+                {
+                    acc[x][v] = CpuSimd::Max(acc[x][v], CpuSimd::Zero());
+                }
+                CpuSimd::Store(result[x] + v * CpuSimd::c_width, acc[x][v]);
+            }
+        }
+
+        for (uint32_t o = 0; o < outputCount; o++, dst += dstPlaneSize)
+        {
+            float row[c_blockedTileWidth];
+            for (uint32_t x = 0; x < columnCount; x++)
+            {
+                row[x] = result[x][o];
+            }
+            StoreTileRow(row, addend, o, columnCount, dst);
+        }
+    }
+
+    // Conv2D in one of the blocked layouts. The padded input holds [batch][C / channelBlock][height][width][channelBlock].
+    void BlockedConv2D(
+        const float* input,
+        uint32_t batchSize,
+        uint32_t height,
+        uint32_t width,
+        const float* packedFilter,
+        const float* packedBias,
+        const uint32_t* filterSizes,
+        uint32_t channelBlock,
+        bool relu,
+        const CpuKernels::ConvAddend* addend,
+        float* output,
+        float* scratch,
+        ThreadPool* threadPool)
+    {
+        const uint32_t K = filterSizes[0];
+        const uint32_t C = filterSizes[1];
+        const uint32_t KH = filterSizes[2];
+        const uint32_t KW = filterSizes[3];
+
+        uint32_t startPadding[2], endPadding[2];
+        SuperResolutionModel::GetConvPadding(filterSizes, startPadding, endPadding);
+
+        const uint32_t channelBlockCount = (C + channelBlock - 1) / channelBlock;
+        const uint32_t paddedHeight = height + KH - 1;
+        const uint32_t paddedWidth = RoundUp(width, c_blockedTileWidth) + KW - 1;
+        const uint32_t rowPitch = paddedWidth * channelBlock;
+        const size_t paddedBlockSize = size_t(paddedHeight) * rowPitch;
+        const size_t planeSize = size_t(height) * width;
+
+        // One task per image and block of channels
+        ParallelFor(threadPool, batchSize * channelBlockCount, [&](uint32_t task, uint32_t)
+        {
+            const uint32_t n = task / channelBlockCount;
+            const uint32_t c0 = task % channelBlockCount * channelBlock;
+            const uint32_t channels = std::min(channelBlock, C - c0);
+
+            float* dst = scratch + task * paddedBlockSize;
+            std::fill_n(dst, paddedBlockSize, 0.0f);
+            for (uint32_t c = 0; c < channels; c++)
+            {
+                const float* src = input + (size_t(n) * C + c0 + c) * planeSize;
+                for (uint32_t y = 0; y < height; y++)
+                {
+                    float* dstRow = dst + size_t(y + startPadding[0]) * rowPitch + startPadding[1] * channelBlock + c;
+                    for (uint32_t x = 0; x < width; x++)
+                    {
+                        dstRow[x * channelBlock] = src[size_t(y) * width + x];
+                    }
+                }
+            }
+        });
+
+        const size_t filterBlockSize = size_t(C) * KH * KW * c_blockedOutputBlock;
+        const uint32_t blockCount = RoundUp(K, c_blockedOutputBlock) / c_blockedOutputBlock;
+
+        // One task per block of filters, image and row, in that order
+        ParallelFor(threadPool, blockCount * batchSize * height, [&](uint32_t task, uint32_t)
+        {
+            const uint32_t y = task % height;
+            const uint32_t n = task / height % batchSize;
+            const uint32_t block = task / height / batchSize;
+
+            const float* blockFilter = packedFilter + block * filterBlockSize;
+            const float* blockBias = packedBias + block * c_blockedOutputBlock;
+            const uint32_t blockOutputs = std::min(c_blockedOutputBlock, K - block * c_blockedOutputBlock);
+            const float* batchInput = scratch + size_t(n) * channelBlockCount * paddedBlockSize;
+            const size_t outputOffset = (size_t(n) * K + block * c_blockedOutputBlock) * planeSize + size_t(y) * width;
+
+            for (uint32_t x0 = 0; x0 < width; x0 += c_blockedTileWidth)
+            {
+                const AddendRow addendRow = addend ? GetAddendRow(*addend, size_t(n) * K + block * c_blockedOutputBlock, y, x0, height, width) : AddendRow();
+                BlockedConvTile(batchInput + size_t(y) * rowPitch + x0 * channelBlock, paddedBlockSize, rowPitch, channelBlock,
+                    blockFilter, blockBias, C, KH, KW, relu, addend ? &addendRow : nullptr,
+                    output + outputOffset + x0, planeSize, blockOutputs, std::min(c_blockedTileWidth, width - x0));
+            }
+        });
+    }
+
+    // Input channels per 32-bit lane of an INT8 dot product
+    const uint32_t c_int8ChannelGroup = 4;
+
+    // INT8 version of ConvTile. The padded input holds c_int8ChannelGroup channels per pixel, so one load gives the
+    // bytes of a channel group for CpuSimd::c_width consecutive columns.
+    inline void Int8ConvTile(
+        const uint8_t* src,             // Top left of the tile's receptive field in the first padded channel group
+        size_t srcGroupSize,            // Bytes per padded channel group
+        uint32_t srcRowPitch,           // Bytes
+        const int8_t* filter,           // Packed filter block
+        const float* scale,             // Packed output scale block
+        const float* bias,              // Packed bias block
+        uint32_t groupCount,
+        uint32_t KH,
+        uint32_t KW,
+        bool relu,
+        const AddendRow* addend,        // Added after ReLU, or nullptr
+        float* dst,                     // First output channel of the block
+        size_t dstPlaneSize,
+        uint32_t outputCount,
+        uint32_t columnCount)
+    {
+#if CPU_SIMD_INT8
+        CpuSimd::Int acc[c_convOutputBlock][c_tileVectors];
+        for (uint32_t o = 0; o < c_convOutputBlock; o++)
+        {
+            for (uint32_t v = 0; v < c_tileVectors; v++)
+            {
+                acc[o][v] = CpuSimd::ZeroInt();
+            }
+        }
+
+        for (uint32_t g = 0; g < groupCount; g++, src += srcGroupSize)
+        {
+            for (uint32_t ky = 0; ky < KH; ky++)
+            {
+                const uint8_t* srcRow = src + ky * srcRowPitch;
+                for (uint32_t kx = 0; kx < KW; kx++, filter += c_convOutputBlock * c_int8ChannelGroup)
+                {
+                    CpuSimd::Int in[c_tileVectors];
+                    for (uint32_t v = 0; v < c_tileVectors; v++)
+                    {
+                        in[v] = CpuSimd::LoadInt(srcRow + (kx + v * CpuSimd::c_width) * c_int8ChannelGroup);
+                    }
+
+                    for (uint32_t o = 0; o < c_convOutputBlock; o++)
+                    {
+                        int32_t weights;
+                        memcpy(&weights, filter + o * c_int8ChannelGroup, sizeof(weights));
+                        const CpuSimd::Int w = CpuSimd::SetInt(weights);
+                        for (uint32_t v = 0; v < c_tileVectors; v++)
+                        {
+                            acc[o][v] = CpuSimd::DotProductAdd(acc[o][v], in[v], w);
+                        }
+                    }
+                }
+            }
+        }
+
+        float result[c_tileWidth];
+        for (uint32_t o = 0; o < outputCount; o++, dst += dstPlaneSize)
+        {
+            const CpuSimd::Float outputScale = CpuSimd::Set(scale[o]);
+            const CpuSimd::Float outputBias = CpuSimd::Set(bias[o]);
+            for (uint32_t v = 0; v < c_tileVectors; v++)
+            {
+                CpuSimd::Float value = CpuSimd::MultiplyAdd(CpuSimd::ToFloat(acc[o][v]), outputScale, outputBias);
+                if (relu)
+                {
+                    value = CpuSimd::Max(value, CpuSimd::Zero());
+                }
+                CpuSimd::Store(result + v * CpuSimd::c_width, value);
+            }
+            StoreTileRow(result, addend, o, columnCount, dst);
+        }
+#else
+        int32_t acc[c_convOutputBlock][c_tileWidth] = {};
+
+        for (uint32_t g = 0; g < groupCount; g++, src += srcGroupSize)
+        {
+            for (uint32_t ky = 0; ky < KH; ky++)
+            {
+                const uint8_t* srcRow = src + ky * srcRowPitch;
+                for (uint32_t kx = 0; kx < KW; kx++, filter += c_convOutputBlock * c_int8ChannelGroup)
+                {
+                    for (uint32_t o = 0; o < c_convOutputBlock; o++)
+                    {
+                        for (uint32_t i = 0; i < c_int8ChannelGroup; i++)
+                        {
+                            const int32_t w = filter[o * c_int8ChannelGroup + i];
+                            for (uint32_t x = 0; x < c_tileWidth; x++)
+                            {
+                                acc[o][x] += srcRow[(kx + x) * c_int8ChannelGroup + i] * w;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        for (uint32_t o = 0; o < outputCount; o++, dst += dstPlaneSize)
+        {
+            float result[c_tileWidth];
+            for (uint32_t x = 0; x < columnCount; x++)
+            {
+                const float value = acc[o][x] * scale[o] + bias[o];
+                result[x] = (relu && value < 0.0f) ? 0.0f : value;
+            }
+            StoreTileRow(result, addend, o, columnCount, dst);
+        }
+#endif
+    }
+
+    // Winograd transforms for 3x3 filters, from Lavin and Gray, "Fast Algorithms for Convolutional Neural Networks".
+    const float c_winograd2InputTransform[4 * 4] =
+    {
+        1,  0, -1,  0,
+        0,  1,  1,  0,
+        0, -1,  1,  0,
+        0,  1,  0, -1,
+    };
+    const float c_winograd2FilterTransform[4 * 3] =
+    {
+        1.0f,  0.0f, 0.0f,
+        0.5f,  0.5f, 0.5f,
+        0.5f, -0.5f, 0.5f,
+        0.0f,  0.0f, 1.0f,
+    };
+    const float c_winograd2OutputTransform[2 * 4] =
+    {
+        1,  1,  1,  0,
+        0,  1, -1, -1,
+    };
+
+    const float c_winograd4InputTransform[6 * 6] =
+    {
+        4,  0, -5,  0,  1,  0,
+        0, -4, -4,  1,  1,  0,
+        0,  4, -4, -1,  1,  0,
+        0, -2, -1,  2,  1,  0,
+        0,  2, -1, -2,  1,  0,
+        0,  4,  0, -5,  0,  1,
+    };
+    const float c_winograd4FilterTransform[6 * 3] =
+    {
+         1.0f / 4,   0.0f,        0.0f,
+        -1.0f / 6,  -1.0f / 6,   -1.0f / 6,
+        -1.0f / 6,   1.0f / 6,   -1.0f / 6,
+         1.0f / 24,  1.0f / 12,   1.0f / 6,
+         1.0f / 24, -1.0f / 12,   1.0f / 6,
+         0.0f,       0.0f,        1.0f,
+    };
+    const float c_winograd4OutputTransform[4 * 6] =
+    {
+        1,  1,  1,  1,  1,  0,
+        0,  1, -1,  2, -2,  0,
+        0,  1,  1,  4,  4,  0,
+        0,  1, -1,  8, -8,  1,
+    };
+
+    // Columns per phase of a row of the Winograd input copy. Loads for the last chunk of blocks may reach one block
+    // past a multiple of c_tileWidth.
+    uint32_t GetWinogradPhaseWidth(uint32_t blocksX)
+    {
+        return RoundUp(blocksX, c_tileWidth) + CpuSimd::c_width;
+    }
+
+    // out = L in L^T, for an N x N tile of vectors and an R x N matrix L. The matrix is a template argument so that the
+    // loops unroll into multiply-adds by constants, and zero coefficients drop out.
+    template<uint32_t R, uint32_t N, const float (&L)[R * N]>
+    inline void TransformTile(const CpuSimd::Float* in, CpuSimd::Float* out)
+    {
+        CpuSimd::Float rows[R * N];
+        for (uint32_t i = 0; i < R; i++)
+        {
+            for (uint32_t s = 0; s < N; s++)
+            {
+                CpuSimd::Float acc = CpuSimd::Zero();
+                for (uint32_t r = 0; r < N; r++)
+                {
+                    if (L[i * N + r] != 0.0f)
+                    {
+                        acc = CpuSimd::MultiplyAdd(CpuSimd::Set(L[i * N + r]), in[r * N + s], acc);
+                    }
+                }
+                rows[i * N + s] = acc;
+            }
+        }
+
+        for (uint32_t i = 0; i < R; i++)
+        {
+            for (uint32_t j = 0; j < R; j++)
+            {
+                CpuSimd::Float acc = CpuSimd::Zero();
+                for (uint32_t s = 0; s < N; s++)
+                {
+                    if (L[j * N + s] != 0.0f)
+                    {
+                        acc = CpuSimd::MultiplyAdd(CpuSimd::Set(L[j * N + s]), rows[i * N + s], acc);
+                    }
+                }
+                out[i * R + j] = acc;
+            }
+        }
+    }
+
+    // Winograd F(M x M, 3 x 3). The output blocks are processed c_tileWidth at a time, one block per vector lane, so
+    // that the multiplies between transformed tiles and filters run in the same register-tiled loop as ConvTile.
+    template<uint32_t M, const float (&BT)[(M + 2) * (M + 2)], const float (&AT)[M * (M + 2)]>
+    void WinogradConv2DImpl(
+        const float* input,
+        uint32_t batchSize,
+        uint32_t height,
+        uint32_t width,
+        const float* packedFilter,
+        const float* packedBias,
+        const uint32_t* filterSizes,
+        bool relu,
+        const CpuKernels::ConvAddend* addend,
+        float* output,
+        float* scratch,
+        ThreadPool* threadPool)
+    {
+        const uint32_t T = M + 2;
+        const uint32_t K = filterSizes[0];
+        const uint32_t C = filterSizes[1];
+        const uint32_t blockCount = RoundUp(K, c_convOutputBlock) / c_convOutputBlock;
+
+        // Zero-bordered copy of the T input rows of one row of blocks, for every channel. Each row is split by column
+        // modulo M, so that column s of the input tile of consecutive blocks is contiguous: for s < M it is at
+        // [s][block], and for the two columns that overlap the next block, at [s - M][block + 1].
+        const uint32_t blocksY = (height + M - 1) / M;
+        const uint32_t blocksX = (width + M - 1) / M;
+        const uint32_t phaseWidth = GetWinogradPhaseWidth(blocksX);
+        const uint32_t paddedWidth = M * phaseWidth;
+        const size_t planeSize = size_t(height) * width;
+
+        // Per thread, [C][T][paddedWidth], then the transformed tiles, [C][T * T][c_tileWidth], and their products
+        // with the filters, [paddedK][T * T][c_tileWidth]. Keeping the elements of a tile together lets the transforms
+        // read and write whole cache lines.
+        const size_t threadScratchSize = size_t(C) * T * paddedWidth + size_t(T) * T * (C + RoundUp(K, c_convOutputBlock)) * c_tileWidth;
+
+        // One task per image and row of blocks
+        ParallelFor(threadPool, batchSize * blocksY, [&](uint32_t task, uint32_t thread)
+        {
+            const uint32_t n = task / blocksY;
+            const uint32_t by = task % blocksY;
+
+            float* rows = scratch + thread * threadScratchSize;
+            float* transformedInput = rows + size_t(C) * T * paddedWidth;
+            float* transformedOutput = transformedInput + size_t(C) * T * T * c_tileWidth;
+
+            float blockOutputs[M * M * c_tileWidth];
+
+            for (uint32_t c = 0; c < C; c++)
+            {
+                for (uint32_t r = 0; r < T; r++)
+                {
+                    float* dst = rows + (size_t(c) * T + r) * paddedWidth;
+                    std::fill_n(dst, paddedWidth, 0.0f);
+
+                    const uint32_t y = by * M + r - 1;
+                    if (by * M + r == 0 || y >= height)
+                    {
+                        continue;
+                    }
+                    const float* src = &input[(size_t(n) * C + c) * planeSize + size_t(y) * width];
+
+                    // Padded column i * M + p is input column i * M + p - 1. The blocks of M columns that are
+                    // entirely inside the input are split without bounds checks.
+                    const uint32_t fullEnd = (width + 1) / M;
+                    for (uint32_t p = 0; p < M; p++)
+                    {
+                        float* phase = dst + p * phaseWidth;
+                        for (uint32_t i = 1; i < fullEnd; i++)
+                        {
+                            phase[i] = src[i * M + p - 1];
+                        }
+                    }
+                    auto splitColumn = [&](uint32_t x) { dst[(x + 1) % M * phaseWidth + (x + 1) / M] = src[x]; };
+                    for (uint32_t x = 0; x < std::min(M - 1, width); x++)
+                    {
+                        splitColumn(x);
+                    }
+                    for (uint32_t x = std::max(fullEnd * M, M) - 1; x < width; x++)
+                    {
+                        splitColumn(x);
+                    }
+                }
+            }
+
+            for (uint32_t bx0 = 0; bx0 < blocksX; bx0 += c_tileWidth)
+            {
+                const uint32_t blockCountX = std::min(c_tileWidth, blocksX - bx0);
+
+                // Input transform, B^T d B for the T x T input tile of each block
+                for (uint32_t c = 0; c < C; c++)
+                {
+                    // Lanes past the last block read other blocks or padding, and their results are not stored
+                    const float* src = rows + size_t(c) * T * paddedWidth + bx0;
+
+                    for (uint32_t v = 0; v < c_tileVectors; v++)
+                    {
+                        CpuSimd::Float tile[T * T], transformed[T * T];
+                        for (uint32_t r = 0; r < T; r++)
+                        {
+                            for (uint32_t s = 0; s < T; s++)
+                            {
+                                tile[r * T + s] = CpuSimd::Load(src + r * paddedWidth + s % M * phaseWidth + s / M + v * CpuSimd::c_width);
+                            }
+                        }
+                        TransformTile<T, T, BT>(tile, transformed);
+                        for (uint32_t i = 0; i < T * T; i++)
+                        {
+                            CpuSimd::Store(transformedInput + (size_t(c) * T * T + i) * c_tileWidth + v * CpuSimd::c_width, transformed[i]);
+                        }
+                    }
+                }
+
+                // One matrix multiply per tile element, over the input channels
+                for (uint32_t e = 0; e < T * T; e++)
+                {
+                    const float* elementInput = transformedInput + e * c_tileWidth;
+
+                    for (uint32_t block = 0; block < blockCount; block++)
+                    {
+                        const float* filter = packedFilter + (size_t(e) * blockCount + block) * C * c_convOutputBlock;
+
+                        CpuSimd::Float acc[c_convOutputBlock][c_tileVectors];
+                        for (uint32_t o = 0; o < c_convOutputBlock; o++)
+                        {
+                            for (uint32_t v = 0; v < c_tileVectors; v++)
+                            {
+                                acc[o][v] = CpuSimd::Zero();
+                            }
+                        }
+
+                        for (uint32_t c = 0; c < C; c++, filter += c_convOutputBlock)
+                        {
+                            CpuSimd::Float in[c_tileVectors];
+                            for (uint32_t v = 0; v < c_tileVectors; v++)
+                            {
+                                in[v] = CpuSimd::Load(elementInput + size_t(c) * T * T * c_tileWidth + v * CpuSimd::c_width);
+                            }
+
+                            for (uint32_t o = 0; o < c_convOutputBlock; o++)
+                            {
+                                const CpuSimd::Float w = CpuSimd::Set(filter[o]);
+                                for (uint32_t v = 0; v < c_tileVectors; v++)
+                                {
+                                    acc[o][v] = CpuSimd::MultiplyAdd(w, in[v], acc[o][v]);
+                                }
+                            }
+                        }
+
+                        for (uint32_t o = 0; o < c_convOutputBlock; o++)
+                        {
+                            float* dst = transformedOutput + (size_t(block * c_convOutputBlock + o) * T * T + e) * c_tileWidth;
+                            for (uint32_t v = 0; v < c_tileVectors; v++)
+                            {
+                                CpuSimd::Store(dst + v * CpuSimd::c_width, acc[o][v]);
+                            }
+                        }
+                    }
+                }
+
+                // Output transform, A^T m A, plus bias and activation, then store the parts of the blocks that are
+                // inside the output
+                for (uint32_t k = 0; k < K; k++)
+                {
+                    for (uint32_t v = 0; v < c_tileVectors; v++)
+                    {
+                        CpuSimd::Float tile[T * T], transformed[M * M];
+                        for (uint32_t i = 0; i < T * T; i++)
+                        {
+                            tile[i] = CpuSimd::Load(transformedOutput + (size_t(k) * T * T + i) * c_tileWidth + v * CpuSimd::c_width);
+                        }
+                        TransformTile<M, T, AT>(tile, transformed);
+
+                        const CpuSimd::Float bias = CpuSimd::Set(packedBias[k]);
+                        for (uint32_t i = 0; i < M * M; i++)
+                        {
+                            CpuSimd::Float value = CpuSimd::Add(transformed[i], bias);
+                            if (relu)
+                            {
+                                value = CpuSimd::Max(value, CpuSimd::Zero());
+                            }
+                            CpuSimd::Store(blockOutputs + i * c_tileWidth + v * CpuSimd::c_width, value);
+                        }
+                    }
+
+                    for (uint32_t a = 0; a < M && by * M + a < height; a++)
+                    {
+                        const size_t rowOffset = (size_t(n) * K + k) * planeSize + size_t(by * M + a) * width;
+                        const float* src = blockOutputs + a * M * c_tileWidth;
+
+                        // Interleave the lanes back into columns, clipping the last block to the output
+                        float row[M * c_tileWidth];
+                        const uint32_t x0 = bx0 * M;
+                        const uint32_t columnCount = std::min(width, (bx0 + blockCountX) * M) - x0;
+                        const uint32_t fullBlocks = std::min(blockCountX, width / M - bx0);
+                        for (uint32_t j = 0; j < fullBlocks; j++)
+                        {
+                            for (uint32_t b = 0; b < M; b++)
+                            {
+                                row[j * M + b] = src[b * c_tileWidth + j];
+                            }
+                        }
+                        for (uint32_t x = fullBlocks * M; x < columnCount; x++)
+                        {
+                            row[x] = src[x % M * c_tileWidth + x / M];
+                        }
+                        const AddendRow addendRow = addend ? GetAddendRow(*addend, size_t(n) * K + k, by * M + a, x0, height, width) : AddendRow();
+                        StoreTileRow(row, addend ? &addendRow : nullptr, 0, columnCount, output + rowOffset + x0);
+                    }
+                }
+            }
+        });
+    }
+}
+
+const char* CpuKernels::GetConvLayoutName(ConvLayout layout)
+{
+    switch (layout)
+    {
+    case ConvLayout::NHWC:      return "nhwc";
+    case ConvLayout::NCHWc8:    return "nchwc8";
+    case ConvLayout::NCHWc16:   return "nchwc16";
+    default:                    return "nchw";
+    }
+}
+
+uint32_t CpuKernels::GetConvOutputBlock(ConvLayout layout)
+{
+    return (layout == ConvLayout::NCHW) ? c_convOutputBlock : c_blockedOutputBlock;
+}
+
+void CpuKernels::PackConvFilter(
+    const float* filter,
+    const uint32_t* filterSizes,
+    ConvLayout layout,
+    std::vector<float>& packedFilterOut)
+{
+    const uint32_t K = filterSizes[0];
+    const uint32_t C = filterSizes[1];
+    const uint32_t H = filterSizes[2];
+    const uint32_t W = filterSizes[3];
+    const uint32_t outputBlock = GetConvOutputBlock(layout);
+    const uint32_t blockCount = RoundUp(K, outputBlock) / outputBlock;
+    const uint32_t filterSize = C * H * W;
+
+    packedFilterOut.assign(size_t(blockCount) * filterSize * outputBlock, 0.0f);
+
+    for (uint32_t k = 0; k < K; k++)
+    {
+        float* dst = packedFilterOut.data() + size_t(k / outputBlock) * filterSize * outputBlock + k % outputBlock;
+        const float* src = filter + size_t(k) * filterSize;
+
+        for (uint32_t i = 0; i < filterSize; i++)
+        {
+            dst[i * outputBlock] = src[i];
+        }
+    }
+}
+
+void CpuKernels::PackConvBias(
+    const float* bias,
+    uint32_t outputChannels,
+    std::vector<float>& packedBiasOut)
+{
+    packedBiasOut.assign(RoundUp(outputChannels, std::max(c_convOutputBlock, c_blockedOutputBlock)), 0.0f);
+    if (bias)
+    {
+        std::copy(bias, bias + outputChannels, packedBiasOut.begin());
+    }
+}
+
+void CpuKernels::Conv2D(
+    const float* input,
+    uint32_t batchSize,
+    uint32_t height,
+    uint32_t width,
+    const float* packedFilter,
+    const float* packedBias,
+    const uint32_t* filterSizes,
+    ConvLayout layout,
+    bool relu,
+    const ConvAddend* addend,
+    float* output,
+    float* scratch,
+    ThreadPool* threadPool)
+{
+    if (layout != ConvLayout::NCHW)
+    {
+        BlockedConv2D(input, batchSize, height, width, packedFilter, packedBias, filterSizes,
+            GetChannelBlock(layout, filterSizes[1]), relu, addend, output, scratch, threadPool);
+        return;
+    }
+
+    const uint32_t K = filterSizes[0];
+    const uint32_t C = filterSizes[1];
+    const uint32_t KH = filterSizes[2];
+    const uint32_t KW = filterSizes[3];
+
+    uint32_t startPadding[2], endPadding[2];
+    SuperResolutionModel::GetConvPadding(filterSizes, startPadding, endPadding);
+
+    // Copy the input into a zero-bordered scratch buffer, so the inner loops don't need bounds checks. Rows are
+    // padded to a whole number of tiles; the extra output columns are computed but never stored.
+    const uint32_t paddedHeight = height + KH - 1;
+    const uint32_t paddedWidth = RoundUp(width, c_tileWidth) + KW - 1;
+    const size_t paddedPlaneSize = size_t(paddedHeight) * paddedWidth;
+    const size_t planeSize = size_t(height) * width;
+
+    ParallelFor(threadPool, C * batchSize, [&](uint32_t plane, uint32_t)
+    {
+        float* dst = scratch + plane * paddedPlaneSize;
+        std::fill_n(dst, paddedPlaneSize, 0.0f);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            memcpy(
+                &dst[size_t(y + startPadding[0]) * paddedWidth + startPadding[1]],
+                &input[plane * planeSize + size_t(y) * width],
+                width * sizeof(float));
+        }
+    });
+
+    const size_t filterBlockSize = size_t(C) * KH * KW * c_convOutputBlock;
+    const uint32_t blockCount = RoundUp(K, c_convOutputBlock) / c_convOutputBlock;
+
+    // One task per block of filters, image and row, in that order
+    ParallelFor(threadPool, blockCount * batchSize * height, [&](uint32_t task, uint32_t)
+    {
+        const uint32_t y = task % height;
+        const uint32_t n = task / height % batchSize;
+        const uint32_t block = task / height / batchSize;
+
+        const float* blockFilter = packedFilter + block * filterBlockSize;
+        const float* blockBias = packedBias + block * c_convOutputBlock;
+        const uint32_t blockOutputs = std::min(c_convOutputBlock, K - block * c_convOutputBlock);
+        const float* batchInput = scratch + size_t(n) * C * paddedPlaneSize;
+        const size_t outputOffset = (size_t(n) * K + block * c_convOutputBlock) * planeSize + size_t(y) * width;
+
+        for (uint32_t x0 = 0; x0 < width; x0 += c_tileWidth)
+        {
+            const AddendRow addendRow = addend ? GetAddendRow(*addend, size_t(n) * K + block * c_convOutputBlock, y, x0, height, width) : AddendRow();
+            ConvTile(batchInput + size_t(y) * paddedWidth + x0, paddedPlaneSize, paddedWidth, blockFilter, blockBias,
+                C, KH, KW, relu, addend ? &addendRow : nullptr, output + outputOffset + x0, planeSize,
+                blockOutputs, std::min(c_tileWidth, width - x0));
+        }
+    });
+}
+
+size_t CpuKernels::GetConv2DScratchSize(
+    uint32_t batchSize,
+    uint32_t height,
+    uint32_t width,
+    const uint32_t* filterSizes,
+    ConvLayout layout)
+{
+    const size_t paddedHeight = height + filterSizes[2] - 1;
+    if (layout != ConvLayout::NCHW)
+    {
+        const uint32_t channelBlock = GetChannelBlock(layout, filterSizes[1]);
+        const size_t paddedWidth = RoundUp(width, c_blockedTileWidth) + filterSizes[3] - 1;
+        return paddedHeight * paddedWidth * RoundUp(filterSizes[1], channelBlock) * batchSize;
+    }
+
+    const size_t paddedWidth = RoundUp(width, c_tileWidth) + filterSizes[3] - 1;
+    return paddedHeight * paddedWidth * filterSizes[1] * batchSize;
+}
+
+void CpuKernels::PackInt8ConvFilter(
+    const float* filter,
+    const uint32_t* filterSizes,
+    std::vector<int8_t>& packedFilterOut,
+    std::vector<float>& packedScalesOut)
+{
+    const uint32_t K = filterSizes[0];
+    const uint32_t C = filterSizes[1];
+    const uint32_t H = filterSizes[2];
+    const uint32_t W = filterSizes[3];
+    const uint32_t blockCount = RoundUp(K, c_convOutputBlock) / c_convOutputBlock;
+    const uint32_t groupCount = RoundUp(C, c_int8ChannelGroup) / c_int8ChannelGroup;
+    const size_t filterSize = size_t(C) * H * W;
+
+    packedFilterOut.assign(size_t(blockCount) * groupCount * H * W * c_convOutputBlock * c_int8ChannelGroup, 0);
+    packedScalesOut.assign(size_t(blockCount) * c_convOutputBlock, 0.0f);
+
+    for (uint32_t k = 0; k < K; k++)
+    {
+        const float* src = filter + k * filterSize;
+
+        float maxMagnitude = 0.0f;
+        for (size_t i = 0; i < filterSize; i++)
+        {
+            maxMagnitude = std::max(maxMagnitude, std::abs(src[i]));
+        }
+        const float scale = (maxMagnitude > 0.0f) ? maxMagnitude / 127.0f : 1.0f;
+        packedScalesOut[k] = scale;
+
+        const uint32_t block = k / c_convOutputBlock;
+        const uint32_t o = k % c_convOutputBlock;
+        for (uint32_t c = 0; c < C; c++)
+        {
+            for (uint32_t y = 0; y < H; y++)
+            {
+                for (uint32_t x = 0; x < W; x++)
+                {
+                    const size_t tap = ((size_t(block) * groupCount + c / c_int8ChannelGroup) * H + y) * W + x;
+                    packedFilterOut[(tap * c_convOutputBlock + o) * c_int8ChannelGroup + c % c_int8ChannelGroup] =
+                        static_cast<int8_t>(std::lround(src[(size_t(c) * H + y) * W + x] / scale));
+                }
+            }
+        }
+    }
+}
+
+void CpuKernels::Int8Conv2D(
+    const float* input,
+    uint32_t batchSize,
+    uint32_t height,
+    uint32_t width,
+    float inputScale,
+    const int8_t* packedFilter,
+    const float* packedOutputScales,
+    const float* packedBias,
+    const uint32_t* filterSizes,
+    bool relu,
+    const ConvAddend* addend,
+    float* output,
+    float* scratch,
+    ThreadPool* threadPool)
+{
+    const uint32_t K = filterSizes[0];
+    const uint32_t C = filterSizes[1];
+    const uint32_t KH = filterSizes[2];
+    const uint32_t KW = filterSizes[3];
+    const uint32_t groupCount = RoundUp(C, c_int8ChannelGroup) / c_int8ChannelGroup;
+
+    uint32_t startPadding[2], endPadding[2];
+    SuperResolutionModel::GetConvPadding(filterSizes, startPadding, endPadding);
+
+    // Quantize the input into a zero-bordered scratch buffer laid out as [N][C / 4][H][W][4], with padding as in
+    // Conv2D
+    const uint32_t paddedHeight = height + KH - 1;
+    const uint32_t paddedWidth = RoundUp(width, c_tileWidth) + KW - 1;
+    const uint32_t rowPitch = paddedWidth * c_int8ChannelGroup;
+    const size_t paddedGroupSize = size_t(paddedHeight) * rowPitch;
+    const size_t planeSize = size_t(height) * width;
+    const float inverseScale = 1.0f / inputScale;
+
+    uint8_t* padded = reinterpret_cast<uint8_t*>(scratch);
+
+    // Round half up, which truncation does once the value is clamped to be positive
+    auto quantize = [inverseScale](float value)
+    {
+        return static_cast<uint32_t>(std::min(std::max(value * inverseScale + 0.5f, 0.0f), 255.0f));
+    };
+
+    // Each pixel of a group is one 32-bit word, which is built and stored at once. Channels past C read a row of
+    // zeros.
+    static_assert(c_int8ChannelGroup == 4, "A channel group must fill a 32-bit word");
+    std::vector<float> zeroRow(width, 0.0f);
+
+    // One task per image and channel group
+    ParallelFor(threadPool, batchSize * groupCount, [&](uint32_t task, uint32_t)
+    {
+        const uint32_t n = task / groupCount;
+        const uint32_t g = task % groupCount;
+        uint8_t* group = padded + size_t(task) * paddedGroupSize;
+        memset(group, 0, paddedGroupSize);
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const float* src[c_int8ChannelGroup];
+            for (uint32_t i = 0; i < c_int8ChannelGroup; i++)
+            {
+                const uint32_t c = g * c_int8ChannelGroup + i;
+                src[i] = (c < C) ? &input[(size_t(n) * C + c) * planeSize + size_t(y) * width] : zeroRow.data();
+            }
+            uint32_t* dst = reinterpret_cast<uint32_t*>(group + size_t(y + startPadding[0]) * rowPitch + startPadding[1] * c_int8ChannelGroup);
+            const float* src0 = src[0];
+            const float* src1 = src[1];
+            const float* src2 = src[2];
+            const float* src3 = src[3];
+
+            for (uint32_t x = 0; x < width; x++)
+            {
+                dst[x] = quantize(src0[x]) | (quantize(src1[x]) << 8) | (quantize(src2[x]) << 16) | (quantize(src3[x]) << 24);
+            }
+        }
+    });
+
+    const size_t filterBlockSize = size_t(groupCount) * KH * KW * c_convOutputBlock * c_int8ChannelGroup;
+    const uint32_t blockCount = RoundUp(K, c_convOutputBlock) / c_convOutputBlock;
+
+    // Unlike Conv2D, every block of filters runs on a row before the next, while the input rows it reads are still
+    // in cache. The quantized input is small enough for that to pay off. One task per image, row and block of
+    // filters, in that order.
+    ParallelFor(threadPool, batchSize * height * blockCount, [&](uint32_t task, uint32_t)
+    {
+        const uint32_t block = task % blockCount;
+        const uint32_t y = task / blockCount % height;
+        const uint32_t n = task / blockCount / height;
+
+        const uint8_t* batchInput = padded + size_t(n) * groupCount * paddedGroupSize;
+        const int8_t* blockFilter = packedFilter + block * filterBlockSize;
+        const uint32_t blockOutputs = std::min(c_convOutputBlock, K - block * c_convOutputBlock);
+        const size_t outputOffset = (size_t(n) * K + block * c_convOutputBlock) * planeSize + size_t(y) * width;
+
+        for (uint32_t x0 = 0; x0 < width; x0 += c_tileWidth)
+        {
+            const AddendRow addendRow = addend ? GetAddendRow(*addend, size_t(n) * K + block * c_convOutputBlock, y, x0, height, width) : AddendRow();
+            Int8ConvTile(batchInput + size_t(y) * rowPitch + x0 * c_int8ChannelGroup, paddedGroupSize, rowPitch,
+                blockFilter, packedOutputScales + block * c_convOutputBlock, packedBias + block * c_convOutputBlock,
+                groupCount, KH, KW, relu, addend ? &addendRow : nullptr, output + outputOffset + x0,
+                planeSize, blockOutputs, std::min(c_tileWidth, width - x0));
+        }
+    });
+}
+
+size_t CpuKernels::GetInt8Conv2DScratchSize(
+    uint32_t batchSize,
+    uint32_t height,
+    uint32_t width,
+    const uint32_t* filterSizes)
+{
+    const size_t paddedHeight = height + filterSizes[2] - 1;
+    const size_t paddedWidth = RoundUp(width, c_tileWidth) + filterSizes[3] - 1;
+    const size_t groupCount = RoundUp(filterSizes[1], c_int8ChannelGroup) / c_int8ChannelGroup;
+    const size_t bytes = paddedHeight * paddedWidth * groupCount * c_int8ChannelGroup * batchSize;
+    return (bytes + sizeof(float) - 1) / sizeof(float);
+}
+
+void CpuKernels::MakeSubpixelFilter(
+    const float* filter,
+    const float* bias,
+    const uint32_t* filterSizes,
+    uint32_t factor,
+    std::vector<float>& filterOut,
+    std::vector<float>& biasOut,
+    uint32_t* filterSizesOut)
+{
+    const uint32_t K = filterSizes[0];
+    const uint32_t C = filterSizes[1];
+    const uint32_t KH = filterSizes[2];
+    const uint32_t KW = filterSizes[3];
+
+    uint32_t subpixelSize[2];
+    SuperResolutionModel::GetSubpixelFilterSize(filterSizes, factor, subpixelSize);
+    const uint32_t SH = subpixelSize[0];
+    const uint32_t SW = subpixelSize[1];
+
+    uint32_t startPadding[2], endPadding[2];
+    SuperResolutionModel::GetConvPadding(filterSizes, startPadding, endPadding);
+
+    filterSizesOut[0] = K * factor * factor;
+    filterSizesOut[1] = C;
+    filterSizesOut[2] = SH;
+    filterSizesOut[3] = SW;
+
+    // Input offset of each tap, relative to the input pixel the phase's output block belongs to, plus the padding of
+    // the phase filter. The offsets are floor((phase + tap - padding) / factor), kept non-negative.
+    auto getPhaseTap = [&](uint32_t phase, uint32_t tap, uint32_t padding, uint32_t subpixelFilterSize)
+    {
+        const uint32_t shift = (padding + factor - 1) / factor;
+        return (phase + tap + shift * factor - padding) / factor - shift + subpixelFilterSize / 2;
+    };
+
+    filterOut.assign(size_t(filterSizesOut[0]) * C * SH * SW, 0.0f);
+    for (uint32_t py = 0; py < factor; py++)
+    {
+        for (uint32_t px = 0; px < factor; px++)
+        {
+            const uint32_t phase = py * factor + px;
+
+            for (uint32_t k = 0; k < K; k++)
+            {
+                for (uint32_t c = 0; c < C; c++)
+                {
+                    const float* src = filter + (size_t(k) * C + c) * KH * KW;
+                    float* dst = &filterOut[((size_t(phase) * K + k) * C + c) * SH * SW];
+
+                    for (uint32_t y = 0; y < KH; y++)
+                    {
+                        const uint32_t sy = getPhaseTap(py, y, startPadding[0], SH);
+                        for (uint32_t x = 0; x < KW; x++)
+                        {
+                            dst[sy * SW + getPhaseTap(px, x, startPadding[1], SW)] += src[y * KW + x];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    biasOut.clear();
+    if (bias != nullptr)
+    {
+        for (uint32_t phase = 0; phase < factor * factor; phase++)
+        {
+            biasOut.insert(biasOut.end(), bias, bias + K);
+        }
+    }
+}
+
+void CpuKernels::DepthToSpace(
+    const float* input,
+    uint32_t batchSize,
+    uint32_t channels,
+    uint32_t height,
+    uint32_t width,
+    uint32_t factor,
+    float* output,
+    ThreadPool* threadPool)
+{
+    const size_t planeSize = size_t(height) * width;
+    const uint32_t outputWidth = width * factor;
+
+    // One task per output plane
+    ParallelFor(threadPool, batchSize * channels, [&](uint32_t plane, uint32_t)
+    {
+        const uint32_t n = plane / channels;
+        const uint32_t c = plane % channels;
+
+        for (uint32_t py = 0; py < factor; py++)
+        {
+            for (uint32_t px = 0; px < factor; px++)
+            {
+                const float* src = input + ((size_t(n) * factor * factor + py * factor + px) * channels + c) * planeSize;
+                float* dst = output + size_t(plane) * planeSize * factor * factor + py * outputWidth + px;
+
+                for (uint32_t y = 0; y < height; y++)
+                {
+                    for (uint32_t x = 0; x < width; x++)
+                    {
+                        dst[size_t(y) * factor * outputWidth + x * factor] = src[size_t(y) * width + x];
+                    }
+                }
+            }
+        }
+    });
+}
+
+bool CpuKernels::SupportsConvAlgorithm(const uint32_t* filterSizes, ConvAlgorithm algorithm)
+{
+    return algorithm == ConvAlgorithm::Direct || (filterSizes[2] == 3 && filterSizes[3] == 3);
+}
+
+uint32_t CpuKernels::GetWinogradTransforms(
+    ConvAlgorithm algorithm,
+    const float** inputTransformOut,
+    const float** filterTransformOut,
+    const float** outputTransformOut)
+{
+    if (algorithm == ConvAlgorithm::Winograd2x2)
+    {
+        *inputTransformOut = c_winograd2InputTransform;
+        *filterTransformOut = c_winograd2FilterTransform;
+        *outputTransformOut = c_winograd2OutputTransform;
+        return 2;
+    }
+
+    *inputTransformOut = c_winograd4InputTransform;
+    *filterTransformOut = c_winograd4FilterTransform;
+    *outputTransformOut = c_winograd4OutputTransform;
+    return 4;
+}
+
+void CpuKernels::PackWinogradFilter(
+    const float* filter,
+    const uint32_t* filterSizes,
+    ConvAlgorithm algorithm,
+    std::vector<float>& packedFilterOut)
+{
+    const uint32_t K = filterSizes[0];
+    const uint32_t C = filterSizes[1];
+    const uint32_t blockCount = RoundUp(K, c_convOutputBlock) / c_convOutputBlock;
+
+    const float *inputTransform, *G, *outputTransform;
+    const uint32_t T = GetWinogradTransforms(algorithm, &inputTransform, &G, &outputTransform) + 2;
+
+    packedFilterOut.assign(size_t(T) * T * blockCount * C * c_convOutputBlock, 0.0f);
+
+    for (uint32_t k = 0; k < K; k++)
+    {
+        for (uint32_t c = 0; c < C; c++)
+        {
+            const float* g = filter + (size_t(k) * C + c) * 9;
+
+            // G g, then (G g) G^T
+            float rows[6 * 3];
+            for (uint32_t i = 0; i < T; i++)
+            {
+                for (uint32_t x = 0; x < 3; x++)
+                {
+                    rows[i * 3 + x] = G[i * 3] * g[x] + G[i * 3 + 1] * g[3 + x] + G[i * 3 + 2] * g[6 + x];
+                }
+            }
+
+            for (uint32_t i = 0; i < T; i++)
+            {
+                for (uint32_t j = 0; j < T; j++)
+                {
+                    const float value = rows[i * 3] * G[j * 3] + rows[i * 3 + 1] * G[j * 3 + 1] + rows[i * 3 + 2] * G[j * 3 + 2];
+                    const size_t e = i * T + j;
+                    packedFilterOut[((e * blockCount + k / c_convOutputBlock) * C + c) * c_convOutputBlock + k % c_convOutputBlock] = value;
+                }
+            }
+        }
+    }
+}
+
+void CpuKernels::WinogradConv2D(
+    const float* input,
+    uint32_t batchSize,
+    uint32_t height,
+    uint32_t width,
+    const float* packedFilter,
+    const float* packedBias,
+    const uint32_t* filterSizes,
+    ConvAlgorithm algorithm,
+    bool relu,
+    const ConvAddend* addend,
+    float* output,
+    float* scratch,
+    ThreadPool* threadPool)
+{
+    if (algorithm == ConvAlgorithm::Winograd2x2)
+    {
+        WinogradConv2DImpl<2, c_winograd2InputTransform, c_winograd2OutputTransform>(
+            input, batchSize, height, width, packedFilter, packedBias, filterSizes, relu, addend, output, scratch, threadPool);
+    }
+    else
+    {
+        WinogradConv2DImpl<4, c_winograd4InputTransform, c_winograd4OutputTransform>(
+            input, batchSize, height, width, packedFilter, packedBias, filterSizes, relu, addend, output, scratch, threadPool);
+    }
+}
+
+size_t CpuKernels::GetWinogradConv2DScratchSize(
+    uint32_t width,
+    const uint32_t* filterSizes,
+    ConvAlgorithm algorithm)
+{
+    const size_t M = (algorithm == ConvAlgorithm::Winograd2x2) ? 2 : 4;
+    const size_t T = M + 2;
+    const size_t paddedWidth = M * GetWinogradPhaseWidth((width + M - 1) / M);
+    const size_t paddedK = RoundUp(filterSizes[0], c_convOutputBlock);
+
+    return T * paddedWidth * filterSizes[1] +
+        T * T * (filterSizes[1] + paddedK) * c_tileWidth;
+}
+
+void CpuKernels::Upsample(
+    const float* input,
+    uint32_t planeCount,
+    uint32_t height,
+    uint32_t width,
+    uint32_t factor,
+    float* output,
+    ThreadPool* threadPool)
+{
+    const uint32_t outputWidth = width * factor;
+
+    ParallelFor(threadPool, planeCount, [&](uint32_t plane, uint32_t)
+    {
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const float* src = input + (size_t(plane) * height + y) * width;
+            float* dst = output + (size_t(plane) * height + y) * factor * outputWidth;
+
+            for (uint32_t x = 0; x < width; x++)
+            {
+                for (uint32_t i = 0; i < factor; i++)
+                {
+                    dst[x * factor + i] = src[x];
+                }
+            }
+
+            // The remaining rows repeat the first one
+            for (uint32_t i = 1; i < factor; i++)
+            {
+                memcpy(dst + i * outputWidth, dst, outputWidth * sizeof(float));
+            }
+        }
+    });
+}
+
+void CpuKernels::Add(
+    const float* a,
+    const float* b,
+    size_t count,
+    float* output,
+    ThreadPool* threadPool)
+{
+    const uint32_t taskCount = static_cast<uint32_t>((count + c_elementsPerTask - 1) / c_elementsPerTask);
+
+    ParallelFor(threadPool, taskCount, [&](uint32_t task, uint32_t)
+    {
+        const size_t end = std::min(count, (task + 1) * c_elementsPerTask);
+        for (size_t i = task * c_elementsPerTask; i < end; i++)
+        {
+            output[i] = a[i] + b[i];
+        }
+    });
+}
+
+void CpuKernels::AddUpsampled(
+    const float* a,
+    const float* b,
+    uint32_t planeCount,
+    uint32_t height,
+    uint32_t width,
+    uint32_t factor,
+    float* output,
+    ThreadPool* threadPool)
+{
+    const uint32_t bWidth = width / factor;
+
+    // One task per plane, reading each row of b for factor rows of the output
+    ParallelFor(threadPool, planeCount, [&](uint32_t plane, uint32_t)
+    {
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const size_t offset = (size_t(plane) * height + y) * width;
+            const float* bRow = b + (size_t(plane) * (height / factor) + y / factor) * bWidth;
+
+            for (uint32_t x = 0; x < bWidth; x++)
+            {
+                for (uint32_t i = 0; i < factor; i++)
+                {
+                    output[offset + x * factor + i] = a[offset + x * factor + i] + bRow[x];
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,247 @@
+//--------------------------------------------------------------------------------------
+// CpuKernels.h
+//
+// Portable FP32 kernels for the operators used by the super-resolution model, and an
+// INT8 convolution. All tensors are planar (NCHW). Direct convolutions can work on a copy
+// of their input in another layout (see ConvLayout).
+//
+// Every kernel takes an optional thread pool, and runs single-threaded without one. The
+// convolutions split their work into tasks of one row of output for one block of filters.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+namespace CpuKernels
+{
+    // Convolutions produce this many output channels at a time. Packed filters and biases are padded to a
+    // multiple of this.
+    static const uint32_t c_convOutputBlock = 8;
+
+    // Layout of the zero-bordered copy of its input that a direct convolution works on. With NCHW, each vector
+    // holds a row of output columns for one filter, and a tile covers c_convOutputBlock filters. The others keep a
+    // block of channels of each pixel together, either all of them (NHWC) or 8 or 16 (NCHWc8, NCHWc16), and each
+    // vector holds one output column for consecutive filters, so a tile covers a few columns for
+    // GetConvOutputBlock() filters. Which is faster depends on the layer shape and the CPU. The input and output
+    // tensors are NCHW whatever the layout.
+    enum class ConvLayout
+    {
+        NCHW,
+        NHWC,
+        NCHWc8,
+        NCHWc16
+    };
+
+    static const ConvLayout c_convLayouts[] = { ConvLayout::NCHW, ConvLayout::NHWC, ConvLayout::NCHWc8, ConvLayout::NCHWc16 };
+
+    // Lowercase, e.g. "nchwc8"
+    const char* GetConvLayoutName(ConvLayout layout);
+
+    // Output channels per block of a filter packed for the layout
+    uint32_t GetConvOutputBlock(ConvLayout layout);
+
+    // Reorders filter weights from [K][C][H][W] to [K / B][C][H][W][B], where B is GetConvOutputBlock(layout), so
+    // that the weights for one block of output channels are contiguous. The last block is zero padded.
+    void PackConvFilter(
+        const float* filter,
+        const uint32_t* filterSizes,
+        ConvLayout layout,
+        std::vector<float>& packedFilterOut);
+
+    // A tensor that a convolution adds after ReLU as it stores its output, with the batch size and channels of the
+    // output. It is read with nearest neighbor sampling by factor, so it has 1 / factor of the output's height and
+    // width. With a factor of 1 it may be the output itself, as each value is read before it is written over.
+    struct ConvAddend
+    {
+        const float*    data;
+        uint32_t        factor;
+    };
+
+    // Pads a per-output-channel bias to the packed filter's output channel count, for any layout or algorithm.
+    // Pass nullptr for no bias.
+    void PackConvBias(
+        const float* bias,
+        uint32_t outputChannels,
+        std::vector<float>& packedBiasOut);
+
+    // Stride 1 cross-correlation with "same" padding, plus optional bias and ReLU. The output has the same batch
+    // size, height and width as the input, and filterSizes[0] channels. Each block of filter weights is applied to
+    // the whole batch before moving on, so larger batches reuse the weights while they are in cache. The filter
+    // must be packed for the layout, and the scratch buffer must hold GetConv2DScratchSize() floats. If addend is
+    // not null, it is added as the output is stored.
+    void Conv2D(
+        const float* input,
+        uint32_t batchSize,
+        uint32_t height,
+        uint32_t width,
+        const float* packedFilter,
+        const float* packedBias,
+        const uint32_t* filterSizes,
+        ConvLayout layout,
+        bool relu,
+        const ConvAddend* addend,
+        float* output,
+        float* scratch,
+        ThreadPool* threadPool);
+
+    size_t GetConv2DScratchSize(
+        uint32_t batchSize,
+        uint32_t height,
+        uint32_t width,
+        const uint32_t* filterSizes,
+        ConvLayout layout);
+
+    // Winograd F(m x m, 3 x 3) computes each m x m block of outputs from an (m + 2) x (m + 2) block of inputs. The
+    // blocks are transformed so that each pair of input and output channels takes (m + 2)^2 multiplies instead of
+    // 9 m^2, at the cost of the transforms and of larger rounding errors for larger m.
+    enum class ConvAlgorithm
+    {
+        Direct,
+        Winograd2x2,        // F(2x2, 3x3), 2.25x fewer multiplies
+        Winograd4x4         // F(4x4, 3x3), 4x fewer multiplies
+    };
+
+    // Winograd algorithms only apply to 3x3 filters.
+    bool SupportsConvAlgorithm(const uint32_t* filterSizes, ConvAlgorithm algorithm);
+
+    // The transform matrices of a Winograd algorithm, row-major: B^T is (m + 2) x (m + 2), G is (m + 2) x 3 and A^T is
+    // m x (m + 2). Returns m.
+    uint32_t GetWinogradTransforms(
+        ConvAlgorithm algorithm,
+        const float** inputTransformOut,
+        const float** filterTransformOut,
+        const float** outputTransformOut);
+
+    // Transforms each 3x3 filter g to G g G^T and packs the result as [(m + 2)^2][K / c_convOutputBlock][C][c_convOutputBlock].
+    // The last block of output channels is zero padded.
+    void PackWinogradFilter(
+        const float* filter,
+        const uint32_t* filterSizes,
+        ConvAlgorithm algorithm,
+        std::vector<float>& packedFilterOut);
+
+    // Same as Conv2D, with a filter packed by PackWinogradFilter. The input is copied and transformed one row of
+    // blocks at a time, for all filters at once, so each task is a row of blocks. The scratch buffer must hold
+    // GetWinogradConv2DScratchSize() floats for each thread of the pool, and does not depend on the batch size or
+    // height.
+    void WinogradConv2D(
+        const float* input,
+        uint32_t batchSize,
+        uint32_t height,
+        uint32_t width,
+        const float* packedFilter,
+        const float* packedBias,
+        const uint32_t* filterSizes,
+        ConvAlgorithm algorithm,
+        bool relu,
+        const ConvAddend* addend,
+        float* output,
+        float* scratch,
+        ThreadPool* threadPool);
+
+    size_t GetWinogradConv2DScratchSize(
+        uint32_t width,
+        const uint32_t* filterSizes,
+        ConvAlgorithm algorithm);
+
+    // Quantizes each output channel of a filter to INT8 with a scale of its largest magnitude / 127, and packs it as
+    // [K / c_convOutputBlock][C / 4][H][W][c_convOutputBlock][4], so that each output channel's weights for four input
+    // channels form one 32-bit dot product operand. Input channels and the last block are zero padded. The scales are
+    // padded like PackConvBias.
+    void PackInt8ConvFilter(
+        const float* filter,
+        const uint32_t* filterSizes,
+        std::vector<int8_t>& packedFilterOut,
+        std::vector<float>& packedScalesOut);
+
+    // Same as Conv2D, with the input quantized to unsigned 8 bits as round(input / inputScale), clamped to
+    // [0, 255], so negative inputs become zero. Products are summed in 32-bit integers, then multiplied by
+    // packedOutputScales, which are the input scale times the filter scales of PackInt8ConvFilter, before the bias
+    // and ReLU. Uses VNNI dot products where CPU_SIMD_INT8 is defined, and otherwise scalar code that is only meant
+    // as a reference, being much slower than Conv2D. The scratch buffer must hold GetInt8Conv2DScratchSize() floats.
+    void Int8Conv2D(
+        const float* input,
+        uint32_t batchSize,
+        uint32_t height,
+        uint32_t width,
+        float inputScale,
+        const int8_t* packedFilter,
+        const float* packedOutputScales,
+        const float* packedBias,
+        const uint32_t* filterSizes,
+        bool relu,
+        const ConvAddend* addend,
+        float* output,
+        float* scratch,
+        ThreadPool* threadPool);
+
+    size_t GetInt8Conv2DScratchSize(
+        uint32_t batchSize,
+        uint32_t height,
+        uint32_t width,
+        const uint32_t* filterSizes);
+
+    // Turns a filter that is applied after a nearest neighbor upsample by factor into factor x factor phase filters
+    // that are applied to the original input (see SuperResolutionModel::GetSubpixelFilterSize). Filter k of phase
+    // (py, px) is output channel (py * factor + px) * K + k, the order DepthToSpace expects. The bias, if any, is
+    // repeated for each phase; pass nullptr for no bias.
+    void MakeSubpixelFilter(
+        const float* filter,
+        const float* bias,
+        const uint32_t* filterSizes,
+        uint32_t factor,
+        std::vector<float>& filterOut,
+        std::vector<float>& biasOut,
+        uint32_t* filterSizesOut);
+
+    // Interleaves factor x factor phases of channels planes each into planes that are factor times as large in both
+    // dimensions. For a batch, the input holds batch size x phases x channels planes.
+    void DepthToSpace(
+        const float* input,
+        uint32_t batchSize,
+        uint32_t channels,
+        uint32_t height,
+        uint32_t width,
+        uint32_t factor,
+        float* output,
+        ThreadPool* threadPool);
+
+    // Nearest neighbor upsample of each plane by an integer factor. For a batch, pass batch size x channels planes.
+    void Upsample(
+        const float* input,
+        uint32_t planeCount,
+        uint32_t height,
+        uint32_t width,
+        uint32_t factor,
+        float* output,
+        ThreadPool* threadPool);
+
+    // output[i] = a[i] + b[i]. The output may alias either input.
+    void Add(
+        const float* a,
+        const float* b,
+        size_t count,
+        float* output,
+        ThreadPool* threadPool);
+
+    // Same as Add, with b upsampled by an integer factor with nearest neighbor sampling. a and the output have
+    // planeCount planes of height x width, which are multiples of the factor. The output may alias a.
+    void AddUpsampled(
+        const float* a,
+        const float* b,
+        uint32_t planeCount,
+        uint32_t height,
+        uint32_t width,
+        uint32_t factor,
+        float* output,
+        ThreadPool* threadPool);
+}
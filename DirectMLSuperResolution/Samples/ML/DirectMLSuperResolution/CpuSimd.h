@@ -0,0 +1,389 @@
+//--------------------------------------------------------------------------------------
+// CpuSimd.h
+//
+// Thin wrapper over the widest FP32 vector instruction set enabled at compile time
+// (AVX-512, AVX2/FMA, SSE2 or NEON), with a scalar fallback. Used by the CPU kernels.
+// Where the instruction set also has 8-bit dot products (VNNI), CPU_SIMD_INT8 is defined
+// and the Int type is available. Float16 stores use the conversion instructions where the
+// instruction set has them (F16C with AVX2, where Float16Compressor.h enables it).
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Float16Compressor.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define CPU_SIMD_AVX512 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define CPU_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CPU_SIMD_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define CPU_SIMD_NEON 1
+#endif
+
+#if (CPU_SIMD_AVX512 && defined(__AVX512VNNI__)) || (CPU_SIMD_AVX2 && defined(__AVXVNNI__))
+#define CPU_SIMD_INT8 1
+#endif
+
+namespace CpuSimd
+{
+#if CPU_SIMD_AVX512
+    typedef __m512 Float;
+    static const uint32_t c_width = 16;
+    static const uint32_t c_registerCount = 32;
+    static const char* const c_name = "AVX-512";
+
+    inline Float Zero()                                 { return _mm512_setzero_ps(); }
+    inline Float Set(float v)                           { return _mm512_set1_ps(v); }
+    inline Float Load(const float* p)                   { return _mm512_loadu_ps(p); }
+    inline void Store(float* p, Float v)                { _mm512_storeu_ps(p, v); }
+    inline Float MultiplyAdd(Float a, Float b, Float c) { return _mm512_fmadd_ps(a, b, c); }
+    inline Float Add(Float a, Float b)                  { return _mm512_add_ps(a, b); }
+    inline Float Multiply(Float a, Float b)             { return _mm512_mul_ps(a, b); }
+    inline Float Max(Float a, Float b)                  { return _mm512_max_ps(a, b); }
+    inline Float Min(Float a, Float b)                  { return _mm512_min_ps(a, b); }
+#elif CPU_SIMD_AVX2
+    typedef __m256 Float;
+    static const uint32_t c_width = 8;
+    static const uint32_t c_registerCount = 16;
+    static const char* const c_name = "AVX2";
+
+    inline Float Zero()                                 { return _mm256_setzero_ps(); }
+    inline Float Set(float v)                           { return _mm256_set1_ps(v); }
+    inline Float Load(const float* p)                   { return _mm256_loadu_ps(p); }
+    inline void Store(float* p, Float v)                { _mm256_storeu_ps(p, v); }
+    inline Float MultiplyAdd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+    inline Float Add(Float a, Float b)                  { return _mm256_add_ps(a, b); }
+    inline Float Multiply(Float a, Float b)             { return _mm256_mul_ps(a, b); }
+    inline Float Max(Float a, Float b)                  { return _mm256_max_ps(a, b); }
+    inline Float Min(Float a, Float b)                  { return _mm256_min_ps(a, b); }
+#elif CPU_SIMD_SSE2
+    typedef __m128 Float;
+    static const uint32_t c_width = 4;
+    static const uint32_t c_registerCount = 16;
+    static const char* const c_name = "SSE2";
+
+    inline Float Zero()                                 { return _mm_setzero_ps(); }
+    inline Float Set(float v)                           { return _mm_set1_ps(v); }
+    inline Float Load(const float* p)                   { return _mm_loadu_ps(p); }
+    inline void Store(float* p, Float v)                { _mm_storeu_ps(p, v); }
+    inline Float MultiplyAdd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    inline Float Add(Float a, Float b)                  { return _mm_add_ps(a, b); }
+    inline Float Multiply(Float a, Float b)             { return _mm_mul_ps(a, b); }
+    inline Float Max(Float a, Float b)                  { return _mm_max_ps(a, b); }
+    inline Float Min(Float a, Float b)                  { return _mm_min_ps(a, b); }
+#elif CPU_SIMD_NEON
+    typedef float32x4_t Float;
+    static const uint32_t c_width = 4;
+    static const uint32_t c_registerCount = 32;
+    static const char* const c_name = "NEON";
+
+    inline Float Zero()                                 { return vdupq_n_f32(0.0f); }
+    inline Float Set(float v)                           { return vdupq_n_f32(v); }
+    inline Float Load(const float* p)                   { return vld1q_f32(p); }
+    inline void Store(float* p, Float v)                { vst1q_f32(p, v); }
+    inline Float MultiplyAdd(Float a, Float b, Float c) { return vfmaq_f32(c, a, b); }
+    inline Float Add(Float a, Float b)                  { return vaddq_f32(a, b); }
+    inline Float Multiply(Float a, Float b)             { return vmulq_f32(a, b); }
+    inline Float Max(Float a, Float b)                  { return vmaxq_f32(a, b); }
+    inline Float Min(Float a, Float b)                  { return vminq_f32(a, b); }
+#else
+    typedef float Float;
+    static const uint32_t c_width = 1;
+    static const uint32_t c_registerCount = 16;
+    static const char* const c_name = "scalar";
+
+    inline Float Zero()                                 { return 0.0f; }
+    inline Float Set(float v)                           { return v; }
+    inline Float Load(const float* p)                   { return *p; }
+    inline void Store(float* p, Float v)                { *p = v; }
+    inline Float MultiplyAdd(Float a, Float b, Float c) { return a * b + c; }
+    inline Float Add(Float a, Float b)                  { return a + b; }
+    inline Float Multiply(Float a, Float b)             { return a * b; }
+    inline Float Max(Float a, Float b)                  { return a > b ? a : b; }
+    inline Float Min(Float a, Float b)                  { return a < b ? a : b; }
+#endif
+
+    // c_width unsigned 8- or 16-bit samples to and from Float lanes. Stores round to nearest even and saturate.
+#if CPU_SIMD_AVX512
+    inline Float LoadUint8(const uint8_t* p)            { return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))); }
+    inline Float LoadUint16(const uint16_t* p)          { return _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)))); }
+
+    inline void StoreUint8(uint8_t* p, Float v)
+    {
+        const __m512i i = _mm512_max_epi32(_mm512_cvtps_epi32(v), _mm512_setzero_si512());
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm512_cvtusepi32_epi8(i));
+    }
+
+    inline void StoreUint16(uint16_t* p, Float v)
+    {
+        const __m512i i = _mm512_max_epi32(_mm512_cvtps_epi32(v), _mm512_setzero_si512());
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtusepi32_epi16(i));
+    }
+#elif CPU_SIMD_AVX2
+    inline Float LoadUint8(const uint8_t* p)            { return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)))); }
+    inline Float LoadUint16(const uint16_t* p)          { return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))); }
+
+    inline void StoreUint8(uint8_t* p, Float v)
+    {
+        const __m256i i = _mm256_cvtps_epi32(v);
+        const __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(words, words));
+    }
+
+    inline void StoreUint16(uint16_t* p, Float v)
+    {
+        const __m256i i = _mm256_cvtps_epi32(v);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packus_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1)));
+    }
+#elif CPU_SIMD_SSE2
+    inline Float LoadUint8(const uint8_t* p)
+    {
+        int32_t bytes;
+        memcpy(&bytes, p, sizeof(bytes));
+        const __m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), _mm_setzero_si128());
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, _mm_setzero_si128()));
+    }
+
+    inline Float LoadUint16(const uint16_t* p)
+    {
+        const __m128i words = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, _mm_setzero_si128()));
+    }
+
+    inline void StoreUint8(uint8_t* p, Float v)
+    {
+        const __m128i i = _mm_cvtps_epi32(v);
+        const __m128i words = _mm_packs_epi32(i, i);
+        const int32_t bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+        memcpy(p, &bytes, sizeof(bytes));
+    }
+
+    // SSE2 only packs to signed 16 bits, so the values are offset into that range and back
+    inline void StoreUint16(uint16_t* p, Float v)
+    {
+        const __m128i i = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(65535.0f)));
+        const __m128i offset = _mm_sub_epi32(i, _mm_set1_epi32(32768));
+        const __m128i words = _mm_xor_si128(_mm_packs_epi32(offset, offset), _mm_set1_epi16(-32768));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), words);
+    }
+#elif CPU_SIMD_NEON
+    inline Float LoadUint8(const uint8_t* p)
+    {
+        uint32_t bytes;
+        memcpy(&bytes, p, sizeof(bytes));
+        return vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vcreate_u8(bytes)))));
+    }
+
+    inline Float LoadUint16(const uint16_t* p)          { return vcvtq_f32_u32(vmovl_u16(vld1_u16(p))); }
+
+    inline void StoreUint8(uint8_t* p, Float v)
+    {
+        const uint16x4_t words = vqmovun_s32(vcvtnq_s32_f32(v));
+        const uint32_t bytes = vget_lane_u32(vreinterpret_u32_u8(vqmovn_u16(vcombine_u16(words, words))), 0);
+        memcpy(p, &bytes, sizeof(bytes));
+    }
+
+    inline void StoreUint16(uint16_t* p, Float v)       { vst1_u16(p, vqmovun_s32(vcvtnq_s32_f32(v))); }
+#else
+    inline Float LoadUint8(const uint8_t* p)            { return *p; }
+    inline Float LoadUint16(const uint16_t* p)          { return *p; }
+    inline void StoreUint8(uint8_t* p, Float v)         { *p = static_cast<uint8_t>(std::nearbyint(v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v))); }
+    inline void StoreUint16(uint16_t* p, Float v)       { *p = static_cast<uint16_t>(std::nearbyint(v < 0.0f ? 0.0f : (v > 65535.0f ? 65535.0f : v))); }
+#endif
+
+    // Byte `channel` of each of c_width 4-byte pixels, such as BGRA8, as Float lanes
+#if CPU_SIMD_AVX512
+    inline Float LoadUint8Channel(const uint8_t* p, uint32_t channel)
+    {
+        const __m512i pixels = _mm512_loadu_si512(p);
+        return _mm512_cvtepi32_ps(_mm512_and_si512(_mm512_srl_epi32(pixels, _mm_cvtsi32_si128(int(channel * 8))), _mm512_set1_epi32(0xFF)));
+    }
+#elif CPU_SIMD_AVX2
+    inline Float LoadUint8Channel(const uint8_t* p, uint32_t channel)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        return _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(pixels, _mm_cvtsi32_si128(int(channel * 8))), _mm256_set1_epi32(0xFF)));
+    }
+#elif CPU_SIMD_SSE2
+    inline Float LoadUint8Channel(const uint8_t* p, uint32_t channel)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        return _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(pixels, _mm_cvtsi32_si128(int(channel * 8))), _mm_set1_epi32(0xFF)));
+    }
+#elif CPU_SIMD_NEON
+    inline Float LoadUint8Channel(const uint8_t* p, uint32_t channel)
+    {
+        const uint32x4_t pixels = vreinterpretq_u32_u8(vld1q_u8(p));
+        return vcvtq_f32_u32(vandq_u32(vshlq_u32(pixels, vdupq_n_s32(-int32_t(channel * 8))), vdupq_n_u32(0xFF)));
+    }
+#else
+    inline Float LoadUint8Channel(const uint8_t* p, uint32_t channel) { return p[channel]; }
+#endif
+
+    // c_width 4-byte pixels, such as RGBA8 or BGRA8, of the rounded lanes of byte0, byte1 and byte2, with 255 as the
+    // fourth byte. The values must be in [0, 255].
+#if CPU_SIMD_AVX512
+    inline void StorePixels(uint8_t* p, Float byte0, Float byte1, Float byte2)
+    {
+        __m512i pixels = _mm512_or_si512(_mm512_cvtps_epi32(byte0), _mm512_set1_epi32(int32_t(0xFF000000)));
+        pixels = _mm512_or_si512(pixels, _mm512_slli_epi32(_mm512_cvtps_epi32(byte1), 8));
+        pixels = _mm512_or_si512(pixels, _mm512_slli_epi32(_mm512_cvtps_epi32(byte2), 16));
+        _mm512_storeu_si512(p, pixels);
+    }
+#elif CPU_SIMD_AVX2
+    inline void StorePixels(uint8_t* p, Float byte0, Float byte1, Float byte2)
+    {
+        __m256i pixels = _mm256_or_si256(_mm256_cvtps_epi32(byte0), _mm256_set1_epi32(int32_t(0xFF000000)));
+        pixels = _mm256_or_si256(pixels, _mm256_slli_epi32(_mm256_cvtps_epi32(byte1), 8));
+        pixels = _mm256_or_si256(pixels, _mm256_slli_epi32(_mm256_cvtps_epi32(byte2), 16));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), pixels);
+    }
+#elif CPU_SIMD_SSE2
+    inline void StorePixels(uint8_t* p, Float byte0, Float byte1, Float byte2)
+    {
+        __m128i pixels = _mm_or_si128(_mm_cvtps_epi32(byte0), _mm_set1_epi32(int32_t(0xFF000000)));
+        pixels = _mm_or_si128(pixels, _mm_slli_epi32(_mm_cvtps_epi32(byte1), 8));
+        pixels = _mm_or_si128(pixels, _mm_slli_epi32(_mm_cvtps_epi32(byte2), 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), pixels);
+    }
+#elif CPU_SIMD_NEON
+    inline void StorePixels(uint8_t* p, Float byte0, Float byte1, Float byte2)
+    {
+        uint32x4_t pixels = vorrq_u32(vreinterpretq_u32_s32(vcvtnq_s32_f32(byte0)), vdupq_n_u32(0xFF000000));
+        pixels = vorrq_u32(pixels, vshlq_n_u32(vreinterpretq_u32_s32(vcvtnq_s32_f32(byte1)), 8));
+        pixels = vorrq_u32(pixels, vshlq_n_u32(vreinterpretq_u32_s32(vcvtnq_s32_f32(byte2)), 16));
+        vst1q_u8(p, vreinterpretq_u8_u32(pixels));
+    }
+#else
+    inline void StorePixels(uint8_t* p, Float byte0, Float byte1, Float byte2)
+    {
+        p[0] = static_cast<uint8_t>(std::nearbyint(byte0));
+        p[1] = static_cast<uint8_t>(std::nearbyint(byte1));
+        p[2] = static_cast<uint8_t>(std::nearbyint(byte2));
+        p[3] = 255;
+    }
+#endif
+
+    // c_width Float16 values. NaNs are not made quiet.
+#if CPU_SIMD_AVX512
+    inline Float LoadHalf(const uint16_t* p)            { return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))); }
+#elif CPU_SIMD_AVX2 && FLOAT16_F16C
+    inline Float LoadHalf(const uint16_t* p)            { return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); }
+#elif CPU_SIMD_SSE2
+    // Moving the exponent and mantissa into place and multiplying by 2^(127 - 15) rebiases normal values and
+    // normalizes subnormal ones. Infinity and NaN get the maximum exponent instead.
+    inline Float LoadHalf(const uint16_t* p)
+    {
+        const __m128i halves = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128());
+        const __m128i magnitude = _mm_and_si128(halves, _mm_set1_epi32(0x7FFF));
+        const __m128i sign = _mm_slli_epi32(_mm_xor_si128(halves, magnitude), 16);
+        const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(magnitude, 13)), _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+        const __m128i special = _mm_and_si128(_mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7BFF)), _mm_set1_epi32(0xFF << 23));
+        return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, special)));
+    }
+#elif CPU_SIMD_NEON && FLOAT16_NEON
+    inline Float LoadHalf(const uint16_t* p)            { return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p))); }
+#else
+    inline Float LoadHalf(const uint16_t* p)
+    {
+        float values[c_width];
+        for (uint32_t i = 0; i < c_width; i++)
+        {
+            values[i] = Float16Compressor::decompress(p[i]);
+        }
+        Float v;
+        memcpy(&v, values, sizeof(v));
+        return v;
+    }
+#endif
+
+    // c_width Float16 values, rounded to nearest even
+#if CPU_SIMD_AVX512
+    inline void StoreHalf(uint16_t* p, Float v)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    }
+#elif CPU_SIMD_AVX2 && FLOAT16_F16C
+    inline void StoreHalf(uint16_t* p, Float v)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    }
+#elif CPU_SIMD_SSE2
+    // Float16Compressor::compressRoundToNearest, without branches
+    inline void StoreHalf(uint16_t* p, Float v)
+    {
+        const __m128i bits = _mm_castps_si128(v);
+        const __m128i sign = _mm_and_si128(_mm_srai_epi32(bits, 16), _mm_set1_epi32(int32_t(0xFFFF8000)));
+        const __m128i magnitude = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+
+        // Adding 0.5 lines the subnormal bits up with the bottom of the mantissa, and the FPU rounds
+        const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(magnitude), _mm_set1_ps(0.5f))), _mm_set1_epi32(0x3F000000));
+
+        // Rebias and round to nearest even, saturating to infinity
+        const __m128i odd = _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(1));
+        __m128i normal = _mm_add_epi32(_mm_sub_epi32(magnitude, _mm_set1_epi32(((127 - 15) << 23) - 0xFFF)), odd);
+        const __m128i overflow = _mm_cmpgt_epi32(normal, _mm_set1_epi32((0x1F << 23) - 1));
+        normal = _mm_srli_epi32(_mm_or_si128(_mm_andnot_si128(overflow, normal), _mm_and_si128(overflow, _mm_set1_epi32(0x1F << 23))), 13);
+
+        // Inf stays inf, NaN keeps the top of its payload and becomes quiet
+        const __m128i nan = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7F800000));
+        const __m128i payload = _mm_and_si128(nan, _mm_or_si128(_mm_set1_epi32(0x200), _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(0x3FF))));
+        const __m128i special = _mm_or_si128(_mm_set1_epi32(0x7C00), payload);
+
+        const __m128i isSubnormal = _mm_cmpgt_epi32(_mm_set1_epi32(0x38800000), magnitude);
+        const __m128i isSpecial = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7F7FFFFF));
+        __m128i result = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+        result = _mm_or_si128(_mm_andnot_si128(isSpecial, result), _mm_and_si128(isSpecial, special));
+
+        // The sign is extended through the upper bits, so the signed pack keeps every value
+        result = _mm_or_si128(result, sign);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(result, result));
+    }
+#elif CPU_SIMD_NEON && FLOAT16_NEON
+    inline void StoreHalf(uint16_t* p, Float v)         { vst1_u16(p, vreinterpret_u16_f16(vcvt_f16_f32(v))); }
+#else
+    inline void StoreHalf(uint16_t* p, Float v)
+    {
+        float values[c_width];
+        memcpy(values, &v, sizeof(values));
+        for (uint32_t i = 0; i < c_width; i++)
+        {
+            p[i] = Float16Compressor::compressRoundToNearest(values[i]);
+        }
+    }
+#endif
+
+    // 32-bit integer lanes, one per Float lane. DotProductAdd() adds the dot product of the four unsigned bytes of
+    // each lane of a with the four signed bytes of the same lane of b, without saturation.
+#if CPU_SIMD_INT8 && CPU_SIMD_AVX512
+    typedef __m512i Int;
+
+    inline Int ZeroInt()                                { return _mm512_setzero_si512(); }
+    inline Int SetInt(int32_t v)                        { return _mm512_set1_epi32(v); }
+    inline Int LoadInt(const void* p)                   { return _mm512_loadu_si512(p); }
+    inline Int DotProductAdd(Int acc, Int a, Int b)     { return _mm512_dpbusd_epi32(acc, a, b); }
+    inline Float ToFloat(Int v)                         { return _mm512_cvtepi32_ps(v); }
+#elif CPU_SIMD_INT8 && CPU_SIMD_AVX2
+    typedef __m256i Int;
+
+    inline Int ZeroInt()                                { return _mm256_setzero_si256(); }
+    inline Int SetInt(int32_t v)                        { return _mm256_set1_epi32(v); }
+    inline Int LoadInt(const void* p)                   { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+    inline Int DotProductAdd(Int acc, Int a, Int b)     { return _mm256_dpbusd_avx_epi32(acc, a, b); }
+    inline Float ToFloat(Int v)                         { return _mm256_cvtepi32_ps(v); }
+#endif
+}
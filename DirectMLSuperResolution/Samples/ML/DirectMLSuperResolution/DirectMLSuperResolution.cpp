@@ -12,21 +12,51 @@
 #include "ATGColors.h"
 #include "ControllerFont.h"
 #include "FindMedia.h"
+#include "LayoutTuning.h"
 #include "ReadData.h"
-#include "Float16Compressor.h"
+#include "Trace.h"
 
 // Use video frames as input to the DirectML model, instead of a static texture.
 #define USE_VIDEO 1
 
-// Force the default NCHW (batch/channels/height/width) tensor format, instead of determining
-// this based on the GPU vendor. Setting this may help run on older Nvidia hardware.
-#define FORCE_NCHW 0
+// Measure the convolutions of the model in the NCHW (batch/channels/height/width) and NHWC
+// tensor layouts on the GPU at startup, and use the faster one. The times are cached by GPU,
+// driver and shape in c_layoutCachePath, so only the first startup on a device measures.
+// Set to 0 to always use the default NCHW layout.
+#define TUNE_TENSOR_LAYOUT 1
 
 // Let DirectML manage the data in the weight tensors. This can be faster on some hardware.
 #define DML_MANAGED_WEIGHTS 1
 
+// Have the residual add read the model input through an upsampling view, instead of storing a nearest neighbor
+// upscale of it first (see SuperResolutionModel::Graph::FuseUpsampleAdds). This saves a dispatch and an intermediate
+// buffer of the output's size. Set to 0 to run the upsample as a separate operator.
+#define FUSE_UPSAMPLE_ADDS 1
+
+// Only run the model when its input changed, i.e. for a new video frame, and otherwise display the output it left
+// from the last one. The DirectML graph runs on the whole frame, so this reuses whole frames; the CPU engine can
+// reuse the tiles that didn't change (see CpuInference::SetTemporalReuse).
+#define REUSE_UNCHANGED_FRAMES 1
+
+// Record the phases of each frame, which PIX events mark, and the recording of each model layer into the portable
+// trace as well (see Trace.h). Press T to write the most recent frames to c_tracePath, to open in Perfetto or
+// chrome://tracing. The times are those of the CPU recording the commands, not of the GPU running them.
+#define TRACE_FRAMES 1
+
+// Keep percentiles of the frame time and of the GPU time of the convert, inference and present stages, and write them
+// to c_statisticsPath every c_statisticsInterval seconds, a JSON object per line (see FrameStatistics.h).
+#define EXPORT_FRAME_STATISTICS 1
+
+// A PIX event that is also a scope of the portable trace
+#define BEGIN_EVENT(context, name) do { PIXBeginEvent(context, PIX_COLOR_DEFAULT, L##name); Trace::Begin(name); } while (0)
+#define END_EVENT(context) do { PIXEndEvent(context); Trace::End(); } while (0)
+
 const wchar_t* c_videoPath = L"FH3_540p60.mp4";
 const wchar_t* c_imagePath = L"Assets\\FH3_1_540p.png";
+const char* c_layoutCachePath = "TensorLayouts.txt";
+const char* c_tracePath = "DirectMLSuperResolution.trace.json";
+const char* c_statisticsPath = "DirectMLSuperResolution.statistics.json";
+const double c_statisticsInterval = 10.0;
 
 const float c_pipSize = 0.45f;   // Relative size of the picture-in-picture window
 
@@ -51,6 +81,7 @@ namespace
         UINT Height;
         UINT Width;
         bool UseNhwc;
+        UINT BatchIndex;
     };
 
     std::vector<uint8_t> LoadBGRAImage(const wchar_t* filename, uint32_t& width, uint32_t& height)
@@ -198,6 +229,66 @@ namespace
         return minimumImpliedSizeInBytes;
     }
 
+    // 5D views of the tensors of an element-wise operator whose second input is read upsampled by factor with nearest
+    // neighbor sampling, so that the strides do the index transform and the upsampled tensor is never stored. Rows
+    // and columns of the output are split in two dimensions each, (y / factor, y % factor) and likewise for x, and
+    // the second input has a zero stride in the dimensions of the remainders. Of the six dimensions with the channels
+    // and batch, ordered by output stride, the first pair that is contiguous in both views is merged.
+    void GetUpsampledInputViews(
+        _In_reads_(4) const uint32_t* sizes,            // Output, which is also the size of the first input
+        TensorLayout layout,
+        uint32_t factor,
+        _Out_writes_(5) uint32_t* viewSizesOut,
+        _Out_writes_(5) uint32_t* viewStridesOut,       // Output and first input
+        _Out_writes_(5) uint32_t* upsampledStridesOut)  // Second input
+    {
+        const uint32_t inputSizes[4] = { sizes[0], sizes[1], sizes[2] / factor, sizes[3] / factor };
+        uint32_t strides[4], inputStrides[4];
+        GetStrides(sizes, layout, strides);
+        GetStrides(inputSizes, layout, inputStrides);
+
+        struct Dimension
+        {
+            uint32_t size;
+            uint32_t stride;
+            uint32_t inputStride;
+        };
+
+        std::vector<Dimension> dimensions =
+        {
+            { sizes[0], strides[0], inputStrides[0] },
+            { sizes[1], strides[1], inputStrides[1] },
+            { inputSizes[2], strides[2] * factor, inputStrides[2] },
+            { factor, strides[2], 0 },
+            { inputSizes[3], strides[3] * factor, inputStrides[3] },
+            { factor, strides[3], 0 },
+        };
+        std::stable_sort(dimensions.begin(), dimensions.end(),
+            [](const Dimension& a, const Dimension& b) { return a.stride > b.stride; });
+
+        // NCHW merges the batch and channels, NHWC the batch and rows
+        for (size_t i = 0; dimensions.size() > 5 && i + 1 < dimensions.size(); i++)
+        {
+            const Dimension& next = dimensions[i + 1];
+            if (dimensions[i].stride == next.size * next.stride && dimensions[i].inputStride == next.size * next.inputStride)
+            {
+                dimensions[i] = { dimensions[i].size * next.size, next.stride, next.inputStride };
+                dimensions.erase(dimensions.begin() + i + 1);
+            }
+        }
+        if (dimensions.size() > 5)
+        {
+            throw std::exception("GetUpsampledInputViews");
+        }
+
+        for (size_t i = 0; i < 5; i++)
+        {
+            viewSizesOut[i] = dimensions[i].size;
+            viewStridesOut[i] = dimensions[i].stride;
+            upsampledStridesOut[i] = dimensions[i].inputStride;
+        }
+    }
+
     UINT GetDescriptorCount(size_t numOps, IDMLCompiledOperator** ops, IDMLOperatorInitializer* initializer)
     {
         auto bindingProps = initializer->GetBindingProperties();
@@ -217,12 +308,16 @@ namespace
 Sample::Sample()
     : m_ctrlConnected(false)
     , m_tensorLayout(TensorLayout::Default)
+    , m_batchFrameIndex(0)
     , m_useDml(true)
+    , m_modelInputChanged(true)
     , m_showPip(true)
     , m_zoomWindowSize(0.05f)
     , m_zoomX(0.5f)
     , m_zoomY(0.5f)
     , m_zoomUpdated(false)
+    , m_frameStatistics({ "frame", "convert", "inference", "present" })
+    , m_gpuTimestampPeriod(0.0)
 {
     // Use gamma-correct rendering.
     // Renders only 2D, so no need for a depth buffer.
@@ -245,6 +340,13 @@ void Sample::Initialize(HWND window, int width, int height)
     m_gamePad = std::make_unique<GamePad>();
 
     m_keyboard = std::make_unique<Keyboard>();
+
+#if TRACE_FRAMES
+    Trace::Enable();
+#endif
+#if EXPORT_FRAME_STATISTICS
+    m_frameStatistics.OpenExport(c_statisticsPath, c_statisticsInterval, 0.0);
+#endif
     
     m_deviceResources->SetWindow(window, width, height);
 
@@ -259,6 +361,8 @@ void Sample::Initialize(HWND window, int width, int height)
 // Executes basic render loop.
 void Sample::Tick()
 {
+    Trace::Scope frameScope("Frame");
+
     m_timer.Tick([&]()
     {
         Update(m_timer);
@@ -271,10 +375,13 @@ void Sample::Tick()
 void Sample::Update(DX::StepTimer const& timer)
 {
     PIXBeginEvent(PIX_COLOR_DEFAULT, L"Update");
+    Trace::Begin("Update");
 
     float elapsedTime = float(timer.GetElapsedSeconds());
 
     m_fps.Tick(elapsedTime);
+    m_frameStatistics.Record(e_statFrame, timer.GetElapsedSeconds());
+    m_frameStatistics.ExportIfDue(timer.GetTotalSeconds());
 
     auto pad = m_gamePad->GetState(0);
     if (pad.IsConnected())
@@ -368,6 +475,12 @@ void Sample::Update(DX::StepTimer const& timer)
         m_zoomUpdated = true;
     }
 
+    if (m_keyboardButtons.IsKeyPressed(Keyboard::T))
+    {
+        Trace::WriteChromeTrace(c_tracePath);
+    }
+
+    Trace::End();
     PIXEndEvent();
 }
 #pragma endregion
@@ -386,7 +499,16 @@ void Sample::Render()
     // Get the latest video frame
     RECT r = { 0, 0, static_cast<LONG>(m_origTextureWidth), static_cast<LONG>(m_origTextureHeight) };
     MFVideoNormalizedRect rect = { 0.0f, 0.0f, 1.0f, 1.0f };
-    m_player->TransferFrame(m_sharedVideoTexture, rect, r);
+    if (m_player->TransferFrame(m_sharedVideoTexture, rect, r))
+    {
+        m_modelInputChanged = true;
+    }
+#endif
+
+#if REUSE_UNCHANGED_FRAMES
+    const bool runModel = m_useDml && m_modelInputChanged;
+#else
+    const bool runModel = m_useDml;
 #endif
 
     // Prepare the command list to render a new frame.
@@ -395,12 +517,16 @@ void Sample::Render()
     
     auto commandList = m_deviceResources->GetCommandList();
 
+    // The previous frame of this back buffer is done, so its timestamps can be read
+    ReadFrameTimestamps();
+    RecordFrameTimestamp(e_timestampStart);
+
     // If requested, run the current frame texture through the DirectML model to upscale it.
-    if (m_useDml)
+    if (runModel)
     {
         // Convert image to tensor format (original texture -> model input)
         {
-            PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Convert input image");
+            BEGIN_EVENT(commandList, "Convert input image");
 
             ID3D12DescriptorHeap* pHeaps[] = { m_SRVDescriptorHeap->Heap() };
             commandList->SetDescriptorHeaps(_countof(pHeaps), pHeaps);
@@ -411,8 +537,9 @@ void Sample::Render()
             imageLayoutCB.Height = m_origTextureHeight;
             imageLayoutCB.Width = m_origTextureWidth;
             imageLayoutCB.UseNhwc = (m_tensorLayout == TensorLayout::NHWC);
+            imageLayoutCB.BatchIndex = m_batchFrameIndex;
 
-            commandList->SetComputeRoot32BitConstants(e_crpIdxCB, 3, &imageLayoutCB, 0);
+            commandList->SetComputeRoot32BitConstants(e_crpIdxCB, 4, &imageLayoutCB, 0);
             commandList->SetComputeRootDescriptorTable(e_crpIdxSRV, m_SRVDescriptorHeap->GetGpuHandle(e_descTexture));
             commandList->SetComputeRootDescriptorTable(e_crpIdxUAV, m_SRVDescriptorHeap->GetGpuHandle(e_descModelInput));
 
@@ -421,48 +548,46 @@ void Sample::Render()
 
             commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
 
-            PIXEndEvent(commandList);
+            END_EVENT(commandList);
         }
+        RecordFrameTimestamp(e_timestampConverted);
 
-        // Run the DirectML operations (model input -> model output)
+        // Run the DirectML operations (model input -> model output) once the batch is full. Until then, each
+        // frame only fills its slot of the model input, and the output still holds the previous batch.
+        if (m_batchFrameIndex == c_modelBatchSize - 1)
         {
-            PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"DML ops");
+            BEGIN_EVENT(commandList, "DML ops");
+
+            // Until the batch runs, unchanged frames still have to fill its slots
+            m_modelInputChanged = false;
 
             ID3D12DescriptorHeap* pHeaps[] = { m_dmlDescriptorHeap->Heap() };
             commandList->SetDescriptorHeaps(_countof(pHeaps), pHeaps);
 
-            // Create an upsampled (nearest neighbor) version of the image first
-            m_dmlCommandRecorder->RecordDispatch(commandList, m_dmlUpsampleOps[0].Get(), m_dmlUpsampleBindings[0].Get());
-            // No UAV barrier is required here since we don't use the result right away.
-
-            // Run the intermediate model steps: 3 convolutions (with premultiplied batch normalization
-            // baked into the weights), an upsample, 3 convolutions w/ premultiplied batch norm, 1 final convolution.
-            // This generates a residual image.
-            for (int i = 0; i < c_numConvLayers; i++)
+            // Run the operations of the model graph in order. The graph tells which ones depend on the results of
+            // earlier ones; ops between barriers don't, e.g. the first convolution and the upsample of the input,
+            // unless the final add reads the input upsampled.
+            const auto& ops = m_modelGraph.GetOps();
+            for (size_t i = 0; i < m_modelOps.size(); i++)
             {
-                // Convolution
-                m_dmlCommandRecorder->RecordDispatch(commandList, m_dmlConvOps[i].Get(), m_dmlConvBindings[i].Get());
-                commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
-
-                if (i == 2)
+                if (ops[i].barrierBefore)
                 {
-                    // Intermediate upsample
-                    m_dmlCommandRecorder->RecordDispatch(commandList, m_dmlUpsampleOps[1].Get(), m_dmlUpsampleBindings[1].Get());
                     commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
                 }
-            }
 
-            // Add the residual image to the original nearest-neighbor upscale
-            m_dmlCommandRecorder->RecordDispatch(commandList, m_dmlAddResidualOp.Get(), m_dmlAddResidualBinding.Get());
+                Trace::Scope layerScope(m_modelOps[i].traceName);
+                m_dmlCommandRecorder->RecordDispatch(commandList, m_modelOps[i].compiledOp.Get(), m_modelOps[i].binding.Get());
+            }
             // UAV barrier handled below
     
-            PIXEndEvent(commandList);
+            END_EVENT(commandList);
+            RecordFrameTimestamp(e_timestampInferred);
         }
     }
 
     // Render either the DML result or a bilinear upscale to a texture
     {
-        PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Render to texture");
+        BEGIN_EVENT(commandList, "Render to texture");
 
         D3D12_RESOURCE_BARRIER barriers[] = {
             CD3DX12_RESOURCE_BARRIER::Transition(m_finalResultTexture.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET),
@@ -498,8 +623,14 @@ void Sample::Render()
             imageLayoutCB.Height = m_origTextureHeight * 2;
             imageLayoutCB.Width = m_origTextureWidth * 2;
             imageLayoutCB.UseNhwc = (m_tensorLayout == TensorLayout::NHWC);
+            imageLayoutCB.BatchIndex = m_batchFrameIndex;   // Displays the frame from c_modelBatchSize frames ago
+            if (!runModel)
+            {
+                // The model didn't run, so show the slot of the previous frame again
+                imageLayoutCB.BatchIndex = (m_batchFrameIndex + c_modelBatchSize - 1) % c_modelBatchSize;
+            }
 
-            commandList->SetGraphicsRoot32BitConstants(e_rrpIdxCB, 3, &imageLayoutCB, 0);
+            commandList->SetGraphicsRoot32BitConstants(e_rrpIdxCB, 4, &imageLayoutCB, 0);
             commandList->SetGraphicsRootDescriptorTable(e_rrpIdxSRV, m_SRVDescriptorHeap->GetGpuHandle(e_descModelOutput));
         }
         // Bilinear upscale of original image (original texture -> final result texture)
@@ -519,8 +650,13 @@ void Sample::Render()
 
         // Draw quad.
         commandList->DrawIndexedInstanced(6, 1, 0, 0, 0);
+
+        if (runModel)
+        {
+            m_batchFrameIndex = (m_batchFrameIndex + 1) % c_modelBatchSize;
+        }
             
-        PIXEndEvent(commandList);
+        END_EVENT(commandList);
     }
     
     // Render the result to the screen
@@ -528,7 +664,7 @@ void Sample::Render()
     auto scissorRect = m_deviceResources->GetScissorRect();
 
     {
-        PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Render to screen");
+        BEGIN_EVENT(commandList, "Render to screen");
 
         D3D12_RESOURCE_BARRIER barriers[] = {
             CD3DX12_RESOURCE_BARRIER::Transition(m_finalResultTexture.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
@@ -559,13 +695,13 @@ void Sample::Render()
 
         commandList->DrawIndexedInstanced(6, 1, 0, 0, 0);
         
-        PIXEndEvent(commandList);
+        END_EVENT(commandList);
     }
 
     // Draw zoomed picture-in-picture window
     if (m_showPip)
     {
-        PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Render PIP");
+        BEGIN_EVENT(commandList, "Render PIP");
 
         // Use nearest-neighbor interpolation so individual pixels are visible.
         commandList->SetGraphicsRootSignature(m_texRootSignatureNN.Get());
@@ -594,12 +730,12 @@ void Sample::Render()
 
         commandList->DrawIndexedInstanced(6, 1, 0, 0, 0);
         
-        PIXEndEvent(commandList);
+        END_EVENT(commandList);
     }
     
     // Render the UI
     {
-        PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Render UI");
+        BEGIN_EVENT(commandList, "Render UI");
 
         commandList->RSSetViewports(1, &viewport);
         commandList->RSSetScissorRects(1, &scissorRect);
@@ -680,15 +816,17 @@ void Sample::Render()
 
         m_spriteBatch->End();
 
-        PIXEndEvent(commandList);
+        END_EVENT(commandList);
     }
 
+    RecordFrameTimestamp(e_timestampRendered);
+
     // Show the new frame.
-    PIXBeginEvent(m_deviceResources->GetCommandQueue(), PIX_COLOR_DEFAULT, L"Present");
+    BEGIN_EVENT(m_deviceResources->GetCommandQueue(), "Present");
 
     m_deviceResources->Present();
 
-    PIXEndEvent(m_deviceResources->GetCommandQueue());
+    END_EVENT(m_deviceResources->GetCommandQueue());
 
     m_graphicsMemory->Commit(m_deviceResources->GetCommandQueue());
 }
@@ -721,7 +859,7 @@ void Sample::UpdateZoomVertexBuffer()
 void Sample::Clear()
 {
     auto commandList = m_deviceResources->GetCommandList();
-    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Clear");
+    BEGIN_EVENT(commandList, "Clear");
 
     // Clear the views.
     auto rtvDescriptor = m_deviceResources->GetRenderTargetView();
@@ -736,7 +874,65 @@ void Sample::Clear()
     commandList->RSSetViewports(1, &viewport);
     commandList->RSSetScissorRects(1, &scissorRect);
 
-    PIXEndEvent(commandList);
+    END_EVENT(commandList);
+}
+
+// Writes a GPU timestamp of the current frame. The last one of the frame resolves them for ReadFrameTimestamps().
+void Sample::RecordFrameTimestamp(uint32_t timestamp)
+{
+    auto commandList = m_deviceResources->GetCommandList();
+    const UINT frameIndex = m_deviceResources->GetCurrentFrameIndex();
+    const UINT firstQuery = frameIndex * e_timestampCount;
+
+    commandList->EndQuery(m_frameTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstQuery + timestamp);
+    m_frameTimestampMasks[frameIndex] |= 1u << timestamp;
+
+    if (timestamp == e_timestampRendered)
+    {
+        commandList->ResolveQueryData(m_frameTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstQuery, e_timestampCount,
+            m_frameTimestampReadback.Get(), firstQuery * sizeof(uint64_t));
+    }
+}
+
+// Records the GPU times of the stages of the previous frame of the current back buffer, which the GPU has finished.
+// Stages that didn't run in that frame, such as inference while a batch fills, have no timestamps and aren't recorded.
+void Sample::ReadFrameTimestamps()
+{
+    const UINT frameIndex = m_deviceResources->GetCurrentFrameIndex();
+    const uint32_t mask = m_frameTimestampMasks[frameIndex];
+    m_frameTimestampMasks[frameIndex] = 0;
+    if (!(mask & (1u << e_timestampRendered)))
+    {
+        return;
+    }
+
+    const UINT firstQuery = frameIndex * e_timestampCount;
+    const D3D12_RANGE readRange = { firstQuery * sizeof(uint64_t), (firstQuery + e_timestampCount) * sizeof(uint64_t) };
+    uint64_t* timestamps = nullptr;
+    DX::ThrowIfFailed(m_frameTimestampReadback->Map(0, &readRange, reinterpret_cast<void**>(&timestamps)));
+    timestamps += firstQuery;
+
+    auto seconds = [&](uint32_t begin, uint32_t end)
+    {
+        return m_gpuTimestampPeriod * double(timestamps[end] - timestamps[begin]);
+    };
+
+    // Each stage starts at the latest timestamp before it
+    uint32_t previous = e_timestampStart;
+    if (mask & (1u << e_timestampConverted))
+    {
+        m_frameStatistics.Record(e_statConvert, seconds(previous, e_timestampConverted));
+        previous = e_timestampConverted;
+    }
+    if (mask & (1u << e_timestampInferred))
+    {
+        m_frameStatistics.Record(e_statInference, seconds(previous, e_timestampInferred));
+        previous = e_timestampInferred;
+    }
+    m_frameStatistics.Record(e_statPresent, seconds(previous, e_timestampRendered));
+
+    const D3D12_RANGE writtenRange = { 0, 0 };
+    m_frameTimestampReadback->Unmap(0, &writtenRange);
 }
 #pragma endregion
 
@@ -791,6 +987,9 @@ void Sample::CreateDeviceDependentResources()
 
     m_graphicsMemory = std::make_unique<GraphicsMemory>(device);
 
+    // The model output is new, so it has to be computed again
+    m_modelInputChanged = true;
+
     // Create descriptor heaps.
     {
         m_SRVDescriptorHeap = std::make_unique<DescriptorHeap>(device,
@@ -809,6 +1008,28 @@ void Sample::CreateDeviceDependentResources()
             e_fontDescCount);
     }
 
+    // Create the queries for the GPU times of the frame statistics, a set per back buffer.
+    {
+        const UINT queryCount = m_deviceResources->GetBackBufferCount() * e_timestampCount;
+        D3D12_QUERY_HEAP_DESC queryHeapDesc = { D3D12_QUERY_HEAP_TYPE_TIMESTAMP, queryCount, 0 };
+        DX::ThrowIfFailed(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(m_frameTimestampHeap.ReleaseAndGetAddressOf())));
+
+        DX::ThrowIfFailed(
+            device->CreateCommittedResource(
+                &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+                D3D12_HEAP_FLAG_NONE,
+                &CD3DX12_RESOURCE_DESC::Buffer(queryCount * sizeof(uint64_t)),
+                D3D12_RESOURCE_STATE_COPY_DEST,
+                nullptr,
+                IID_PPV_ARGS(m_frameTimestampReadback.ReleaseAndGetAddressOf())));
+
+        m_frameTimestampMasks.assign(m_deviceResources->GetBackBufferCount(), 0);
+
+        UINT64 frequency = 0;
+        DX::ThrowIfFailed(m_deviceResources->GetCommandQueue()->GetTimestampFrequency(&frequency));
+        m_gpuTimestampPeriod = 1.0 / double(frequency);
+    }
+
     CreateTextureResources();
     CreateDirectMLResources();
     InitializeDirectMLResources();
@@ -1152,7 +1373,7 @@ void Sample::CreateDirectMLResources()
         descRange[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0); // u0
 
         CD3DX12_ROOT_PARAMETER rootParameters[3];
-        rootParameters[e_crpIdxCB].InitAsConstants(3, 0);
+        rootParameters[e_crpIdxCB].InitAsConstants(4, 0);
         rootParameters[e_crpIdxSRV].InitAsDescriptorTable(1, &descRange[0], D3D12_SHADER_VISIBILITY_ALL);
         rootParameters[e_crpIdxUAV].InitAsDescriptorTable(1, &descRange[1], D3D12_SHADER_VISIBILITY_ALL);
 
@@ -1199,7 +1420,7 @@ void Sample::CreateDirectMLResources()
         descRange[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_NONE); // t0
 
         CD3DX12_ROOT_PARAMETER rootParameters[2];
-        rootParameters[e_rrpIdxCB].InitAsConstants(3, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[e_rrpIdxCB].InitAsConstants(4, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
         rootParameters[e_rrpIdxSRV].InitAsDescriptorTable(1, &descRange[0], D3D12_SHADER_VISIBILITY_PIXEL);
 
         CD3DX12_ROOT_SIGNATURE_DESC rootSignature(_countof(rootParameters), rootParameters,
@@ -1283,30 +1504,6 @@ void Sample::CreateDirectMLResources()
         DX::ThrowIfFailed(DMLCreateDevice(device, DML_CREATE_DEVICE_FLAG_NONE, IID_PPV_ARGS(&m_dmlDevice)));
 #endif
 
-#if FORCE_NCHW
-        m_tensorLayout = TensorLayout::Default;
-#else
-        // Determine the best tensor layout based on the GPU vendor.
-        // This is a fairly coarse-grained method, but recent Nvidia GPUs tend to use NHWC
-        // layouts, while others use the default NCHW. 
-        ComPtr<IDXGIAdapter1> adapter;
-        DX::ThrowIfFailed(m_deviceResources->GetDXGIFactory()->EnumAdapterByLuid(device->GetAdapterLuid(), IID_PPV_ARGS(&adapter)));
-
-        DXGI_ADAPTER_DESC adapterDesc;
-        adapter->GetDesc(&adapterDesc);
-
-        if (adapterDesc.VendorId == 0x10DE) // Nvidia
-        {
-            // This is faster on recent Nvidia hardware, but may be a problem on older hardware.
-            // If necessary, set FORCE_NCHW to override this.
-            m_tensorLayout = TensorLayout::NHWC;
-        }
-        else
-        {
-            m_tensorLayout = TensorLayout::Default;
-        }
-#endif
-
         DML_FEATURE_QUERY_TENSOR_DATA_TYPE_SUPPORT fp16Query = { DML_TENSOR_DATA_TYPE_FLOAT16 };
         DML_FEATURE_DATA_TENSOR_DATA_TYPE_SUPPORT fp16Supported = {};
         DX::ThrowIfFailed(m_dmlDevice->CheckFeatureSupport(DML_FEATURE_TENSOR_DATA_TYPE_SUPPORT, sizeof(fp16Query), &fp16Query, sizeof(fp16Supported), &fp16Supported));
@@ -1319,100 +1516,119 @@ void Sample::CreateDirectMLResources()
         DX::ThrowIfFailed(m_dmlDevice->CreateCommandRecorder(IID_PPV_ARGS(&m_dmlCommandRecorder)));
     }
 
-    uint64_t modelInputBufferSize = 0;
-    uint64_t modelOutputBufferSize = 0;
-    uint64_t intermediateBufferMaxSize[] = { 0, 0 };
-
     // DirectML operator resources--implementation of the super-resolution model
     {
-        // Create an upscaled (nearest neighbor) version of the image first
-        uint32_t modelInputSizes[] = { 1, 3, m_origTextureHeight, m_origTextureWidth };
-        uint32_t upscaledInputSizes[4];
-        CreateUpsampleLayer(modelInputSizes, &modelInputBufferSize, &modelOutputBufferSize, upscaledInputSizes, &m_dmlUpsampleOps[0]);
+        // The layers, the order they run in and the buffers they use all come from the graph description, so
+        // retrained or resized variants of the model only need new assets. The sample displays RGB images
+        // upscaled 2x, next to a bilinear upscale.
+        if (!m_modelGraph.Load("Assets\\model.txt") ||
+            m_modelGraph.GetInput().channels != 3 ||
+            m_modelGraph.GetUpscaleFactor() != 2)
+        {
+            throw std::exception("loadModelGraph");
+        }
+#if FUSE_UPSAMPLE_ADDS
+        m_modelGraph.FuseUpsampleAdds();
+#endif
 
-        // Create the residual with three convolutions, an upsample, and four more convolutions
-        WeightMapType weights;
-        if (!LoadWeights("Assets\\weights.bin", weights))
+        // The layout determines the strides of every tensor, so pick it before creating any operator
+#if TUNE_TENSOR_LAYOUT
+        m_tensorLayout = SelectTensorLayout();
+#else
+        m_tensorLayout = TensorLayout::Default;
+#endif
+
+        // Use the pre-baked model container (see Tools/BakeWeights.cpp) if there is one. Otherwise bake the
+        // original weights file in memory.
+        ModelContainer::Reader weights;
+        if (!weights.Open("Assets\\weights.srm"))
         {
-            throw std::exception("loadWeights");
+            WeightMapType originalWeights;
+            std::vector<ModelContainer::TensorData> bakedTensors;
+            std::vector<uint8_t> bakedBytes;
+            if (!LoadWeights("Assets\\weights.bin", originalWeights) ||
+                !ModelContainer::Bake(m_modelGraph, originalWeights, bakedTensors) ||
+                !ModelContainer::Serialize(bakedTensors, bakedBytes) ||
+                !weights.Open(std::move(bakedBytes)))
+            {
+                throw std::exception("loadWeights");
+            }
         }
 
         ResourceUploadBatch weightUploadBatch(device);
         weightUploadBatch.Begin();
-        
-        uint32_t filterSizes[] = { 32, 3, 5, 5 };
-        uint32_t intermediateInputSizes[2][4];
-        CreateConvolutionLayer(modelInputSizes, filterSizes, true, &modelInputBufferSize,
-            &intermediateBufferMaxSize[0], intermediateInputSizes[0], &m_dmlConvOps[0]);
-        CreateWeightTensors(weights, "conv1/weights", "conv1/BatchNorm/scale", "conv1/BatchNorm/shift",
-            filterSizes, weightUploadBatch, &m_modelConvFilterWeights[0], &m_modelConvBiasWeights[0]);
-
-        // Which intermediate resource to use as input for the current operation. The other will be
-        // used as output. Then the next op will swap the order.
-        int inputIndex = 0;
-
-        filterSizes[0] = 64;	// output filters
-        filterSizes[1] = 32;	// input channels
-        filterSizes[2] = 3;		// filter height
-        filterSizes[3] = 3;		// filter width
-        CreateConvolutionLayer(intermediateInputSizes[inputIndex], filterSizes, true, &intermediateBufferMaxSize[inputIndex],
-            &intermediateBufferMaxSize[1 - inputIndex], intermediateInputSizes[1 - inputIndex], &m_dmlConvOps[1]);
-        CreateWeightTensors(weights, "conv2/weights", "conv2/BatchNorm/scale", "conv2/BatchNorm/shift",
-            filterSizes, weightUploadBatch, &m_modelConvFilterWeights[1], &m_modelConvBiasWeights[1]);
-        inputIndex = 1 - inputIndex;
-        
-        filterSizes[1] = 64;
-        CreateConvolutionLayer(intermediateInputSizes[inputIndex], filterSizes, true, &intermediateBufferMaxSize[inputIndex],
-            &intermediateBufferMaxSize[1 - inputIndex], intermediateInputSizes[1 - inputIndex], &m_dmlConvOps[2]);
-        CreateWeightTensors(weights, "conv3/weights", "conv3/BatchNorm/scale", "conv3/BatchNorm/shift", 
-            filterSizes, weightUploadBatch, &m_modelConvFilterWeights[2], &m_modelConvBiasWeights[2]);
-        inputIndex = 1 - inputIndex;
-
-        CreateUpsampleLayer(intermediateInputSizes[inputIndex], &intermediateBufferMaxSize[inputIndex],
-            &intermediateBufferMaxSize[1 - inputIndex], intermediateInputSizes[1 - inputIndex], &m_dmlUpsampleOps[1]);
-        inputIndex = 1 - inputIndex;
-
-        filterSizes[0] = 32;
-        filterSizes[2] = 5;
-        filterSizes[3] = 5;
-        CreateConvolutionLayer(intermediateInputSizes[inputIndex], filterSizes, true, &intermediateBufferMaxSize[inputIndex],
-            &intermediateBufferMaxSize[1 - inputIndex], intermediateInputSizes[1 - inputIndex], &m_dmlConvOps[3]);
-        CreateWeightTensors(weights, "conv_up1/conv/weights", "conv_up1/conv/BatchNorm/scale", "conv_up1/conv/BatchNorm/shift",
-            filterSizes, weightUploadBatch, &m_modelConvFilterWeights[3], &m_modelConvBiasWeights[3]);
-        inputIndex = 1 - inputIndex;
-
-        filterSizes[1] = 32;
-        filterSizes[2] = 3;
-        filterSizes[3] = 3;
-        CreateConvolutionLayer(intermediateInputSizes[inputIndex], filterSizes, true, &intermediateBufferMaxSize[inputIndex],
-            &intermediateBufferMaxSize[1 - inputIndex], intermediateInputSizes[1 - inputIndex], &m_dmlConvOps[4]);
-        CreateWeightTensors(weights, "conv4/weights", "conv4/BatchNorm/scale", "conv4/BatchNorm/shift", 
-            filterSizes, weightUploadBatch, &m_modelConvFilterWeights[4], &m_modelConvBiasWeights[4]);
-        inputIndex = 1 - inputIndex;
-        
-        CreateConvolutionLayer(intermediateInputSizes[inputIndex], filterSizes, true, &intermediateBufferMaxSize[inputIndex],
-            &intermediateBufferMaxSize[1 - inputIndex], intermediateInputSizes[1 - inputIndex], &m_dmlConvOps[5]);
-        CreateWeightTensors(weights, "conv5/weights", "conv5/BatchNorm/scale", "conv5/BatchNorm/shift", 
-            filterSizes, weightUploadBatch, &m_modelConvFilterWeights[5], &m_modelConvBiasWeights[5]);
-        inputIndex = 1 - inputIndex;
-
-        filterSizes[0] = 3;
-        CreateConvolutionLayer(intermediateInputSizes[inputIndex], filterSizes, false, &intermediateBufferMaxSize[inputIndex],
-            &intermediateBufferMaxSize[1 - inputIndex], intermediateInputSizes[1 - inputIndex], &m_dmlConvOps[6]);
-        CreateWeightTensors(weights, "conv6/weights", nullptr, nullptr, filterSizes, weightUploadBatch,
-            &m_modelConvFilterWeights[6], nullptr);
-        inputIndex = 1 - inputIndex;
-    
-        // Finally add the residual to the original upsampled image
-        assert(memcmp(upscaledInputSizes, intermediateInputSizes[inputIndex], 4 * sizeof(uint16_t)) == 0);
 
-        CreateAdditionLayer(upscaledInputSizes, &m_dmlAddResidualOp);
+        const auto& ops = m_modelGraph.GetOps();
+        m_modelOps.clear();
+        m_modelOps.resize(ops.size());
+
+        for (size_t i = 0; i < ops.size(); i++)
+        {
+            const SuperResolutionModel::OpDesc& opDesc = ops[i];
+            ModelOperation& op = m_modelOps[i];
+
+            // The graph's names go when it is loaded again, e.g. after a device loss, and the trace may outlive them
+            op.traceName = Trace::Intern(m_modelGraph.GetTensors()[opDesc.output].name);
+
+            uint32_t inputSizes[4], outputSizes[4];
+            GetModelTensorSizes(opDesc.inputs[0], inputSizes);
+
+            switch (opDesc.type)
+            {
+            case SuperResolutionModel::OpType::Upsample:
+                CreateUpsampleLayer(inputSizes, opDesc.upsampleFactor, outputSizes, &op.compiledOp);
+                break;
+
+            case SuperResolutionModel::OpType::Convolution:
+            {
+                const SuperResolutionModel::ConvLayerDesc& layer = m_modelGraph.GetConvLayers()[opDesc.convLayer];
+                bool useBiasAndActivation = SuperResolutionModel::UsesBiasAndActivation(layer);
+
+                CreateConvolutionLayer(inputSizes, layer.filterSizes, useBiasAndActivation, outputSizes, &op.compiledOp);
+                CreateWeightTensors(weights, layer, weightUploadBatch, &op.filterWeights,
+                    useBiasAndActivation ? &op.biasWeights : nullptr);
+                break;
+            }
+
+            case SuperResolutionModel::OpType::Add:
+                CreateAdditionLayer(inputSizes, opDesc.addendUpsampleFactor, &op.compiledOp);
+                memcpy(outputSizes, inputSizes, sizeof(outputSizes));
+                break;
+
+            case SuperResolutionModel::OpType::ConvolutionAdd:
+                // DirectML has no convolution that adds a tensor, so the graph keeps its separate adds here (see
+                // Graph::FuseConvolutionAdds)
+                throw std::exception("ConvolutionAdd");
+            }
+
+#if _DEBUG
+            uint32_t expectedOutputSizes[4];
+            GetModelTensorSizes(opDesc.output, expectedOutputSizes);
+            assert(memcmp(outputSizes, expectedOutputSizes, sizeof(outputSizes)) == 0);
+#endif
+        }
 
         weightUploadBatch.End(m_deviceResources->GetCommandQueue());
     }
 
-    // Buffers for DML inputs and outputs
+    // Buffers for DML inputs, outputs and intermediate results
     {
+        // An add may write over one of its inputs, so a buffer must be large enough for each tensor stored in it.
+        std::vector<uint64_t> bufferSizes(m_modelGraph.GetBufferCount(), 0);
+        const auto& tensors = m_modelGraph.GetTensors();
+        for (uint32_t i = 0; i < tensors.size(); i++)
+        {
+            uint32_t sizes[4], strides[4];
+            GetModelTensorSizes(i, sizes);
+            GetStrides(sizes, m_tensorLayout, strides);
+
+            uint64_t tensorBufferSize = DMLCalcBufferTensorSize(DML_TENSOR_DATA_TYPE_FLOAT16, 4, sizes, strides);
+            bufferSizes[tensors[i].buffer] = std::max(bufferSizes[tensors[i].buffer], tensorBufferSize);
+        }
+
+        const uint64_t modelInputBufferSize = bufferSizes[SuperResolutionModel::c_inputBuffer];
+        const uint64_t modelOutputBufferSize = bufferSizes[SuperResolutionModel::c_outputBuffer];
+
         // Resource for input tensor
         D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(modelInputBufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 
@@ -1436,7 +1652,7 @@ void Sample::CreateDirectMLResources()
         uavDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
         device->CreateUnorderedAccessView(m_modelInput.Get(), nullptr, &uavDesc, m_SRVDescriptorHeap->GetCpuHandle(e_descModelInput));
 
-        // Model result tensor is 2x larger in both dimensions
+        // Model result tensor is upscaled in both dimensions
         resourceDesc.Width = modelOutputBufferSize;
         DX::ThrowIfFailed(device->CreateCommittedResource(
             &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
@@ -1458,30 +1674,317 @@ void Sample::CreateDirectMLResources()
         srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
         device->CreateShaderResourceView(m_modelOutput.Get(), &srvDesc, m_SRVDescriptorHeap->GetCpuHandle(e_descModelOutput));
 
-        // Create two resources for intermediate layer results. Each layer will ping-pong between these. They're each large
-        // enough to hold the largest intermediate result required.
-        for (int i = 0; i < 2; i++)
+        // Plan where the intermediate layer results and the temporary resources of the operators go in the arena,
+        // reusing memory as soon as its previous contents are no longer needed. The arena itself is created with
+        // the operator initializer, which may need a larger temporary resource.
+        std::vector<uint64_t> temporarySizes(m_modelOps.size());
+        for (size_t i = 0; i < m_modelOps.size(); i++)
         {
-            resourceDesc.Width = intermediateBufferMaxSize[i];
-            DX::ThrowIfFailed(device->CreateCommittedResource(
-                &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-                D3D12_HEAP_FLAG_NONE,
-                &resourceDesc,
-                D3D12_RESOURCE_STATE_COMMON,
-                nullptr,
-                IID_PPV_ARGS(&m_modelIntermediateResult[i])
-            ));
+            temporarySizes[i] = m_modelOps[i].compiledOp->GetBindingProperties().TemporaryResourceSize;
         }
+
+        m_modelArenaLayout = MemoryPlanner::PlanGraph(m_modelGraph, bufferSizes, temporarySizes, DML_TEMPORARY_BUFFER_ALIGNMENT);
+
+        char buff[128] = {};
+        sprintf_s(buff, "DirectML arena: %.2f MiB, peak live %.2f MiB, %.2f MiB without sharing\n",
+            m_modelArenaLayout.arenaSize / (1024.0 * 1024.0),
+            m_modelArenaLayout.peakLiveSize / (1024.0 * 1024.0),
+            m_modelArenaLayout.GetUnpackedSize() / (1024.0 * 1024.0));
+        OutputDebugStringA(buff);
     }
     
     // Wait until assets have been uploaded to the GPU.
     m_deviceResources->WaitForGpu();
 }
 
+TensorLayout Sample::SelectTensorLayout()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    // Identify the adapter and its driver, which decides how DirectML runs the operators
+    ComPtr<IDXGIAdapter1> adapter;
+    DX::ThrowIfFailed(m_deviceResources->GetDXGIFactory()->EnumAdapterByLuid(device->GetAdapterLuid(), IID_PPV_ARGS(&adapter)));
+
+    DXGI_ADAPTER_DESC1 adapterDesc;
+    DX::ThrowIfFailed(adapter->GetDesc1(&adapterDesc));
+
+    LARGE_INTEGER driverVersion = {};
+    (void)adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion);
+
+    char deviceName[128] = {};
+    sprintf_s(deviceName, "dml:%04X:%04X:%08X:%02X:%u.%u.%u.%u",
+        adapterDesc.VendorId, adapterDesc.DeviceId, adapterDesc.SubSysId, adapterDesc.Revision,
+        HIWORD(driverVersion.HighPart), LOWORD(driverVersion.HighPart), HIWORD(driverVersion.LowPart), LOWORD(driverVersion.LowPart));
+
+    const TensorLayout layouts[] = { TensorLayout::Default, TensorLayout::NHWC };
+    const char* const layoutNames[] = { "nchw", "nhwc" };
+
+    // A cache that can't be read is measured again
+    LayoutTuning::MeasuredTimes times;
+    if (!LayoutTuning::LoadMeasuredTimes(c_layoutCachePath, times))
+    {
+        times.clear();
+    }
+
+    // Every tensor has the same layout, since operators would otherwise have to convert between them, so pick the
+    // one with the smallest total time for the convolutions, which take nearly all of the time.
+    double totalTimes[_countof(layouts)] = {};
+    bool measured = false;
+
+    for (const SuperResolutionModel::OpDesc& opDesc : m_modelGraph.GetOps())
+    {
+        if (opDesc.type != SuperResolutionModel::OpType::Convolution)
+        {
+            continue;
+        }
+
+        const SuperResolutionModel::ConvLayerDesc& layer = m_modelGraph.GetConvLayers()[opDesc.convLayer];
+        const bool useBiasAndActivation = SuperResolutionModel::UsesBiasAndActivation(layer);
+
+        uint32_t inputSizes[4];
+        GetModelTensorSizes(opDesc.inputs[0], inputSizes);
+        const std::string shape = LayoutTuning::GetConvShape(inputSizes, layer.filterSizes, useBiasAndActivation);
+
+        for (size_t i = 0; i < _countof(layouts); i++)
+        {
+            const std::string key = LayoutTuning::GetKey(deviceName, shape, layoutNames[i]);
+            auto time = times.find(key);
+            if (time == times.end())
+            {
+                time = times.emplace(key, MeasureConvolutionLayer(layouts[i], inputSizes, layer.filterSizes, useBiasAndActivation)).first;
+                measured = true;
+            }
+            totalTimes[i] += time->second;
+        }
+    }
+
+    // Failing to write the cache only means measuring again next time
+    if (measured)
+    {
+        LayoutTuning::SaveMeasuredTimes(c_layoutCachePath, times);
+    }
+
+    const size_t fastest = (totalTimes[1] < totalTimes[0]) ? 1 : 0;
+
+    char buff[256] = {};
+    sprintf_s(buff, "Tensor layout %s: convolutions take %.3f ms in NCHW and %.3f ms in NHWC (%s)\n",
+        layoutNames[fastest], totalTimes[0], totalTimes[1], measured ? "measured" : "cached");
+    OutputDebugStringA(buff);
+
+    return layouts[fastest];
+}
+
+double Sample::MeasureConvolutionLayer(
+    TensorLayout layout,
+    _In_reads_(4) const uint32_t* inputSizes,
+    _In_reads_(4) const uint32_t* filterSizes,
+    bool useBiasAndActivation)
+{
+    auto device = m_deviceResources->GetD3DDevice();
+    auto commandList = m_deviceResources->GetCommandList();
+
+    // The weights are left zeroed, since their values don't change the time.
+    const TensorLayout previousLayout = m_tensorLayout;
+    m_tensorLayout = layout;
+
+    uint32_t outputSizes[4];
+    ComPtr<IDMLCompiledOperator> compiledOp;
+    CreateConvolutionLayer(inputSizes, filterSizes, useBiasAndActivation, outputSizes, &compiledOp);
+
+    ComPtr<ID3D12Resource> filterWeights, biasWeights;
+    CreateWeightResource(filterSizes, &filterWeights);
+    if (useBiasAndActivation)
+    {
+        const uint32_t biasSizes[] = { 1, filterSizes[0], 1, 1 };
+        CreateWeightResource(biasSizes, &biasWeights);
+    }
+
+    m_tensorLayout = previousLayout;
+
+    auto createBuffer = [&](uint64_t size, D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES state, ComPtr<ID3D12Resource>& resourceOut)
+    {
+        const D3D12_RESOURCE_FLAGS flags = (heapType == D3D12_HEAP_TYPE_DEFAULT) ? D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS : D3D12_RESOURCE_FLAG_NONE;
+        DX::ThrowIfFailed(device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(heapType),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(std::max<UINT64>(size, 1), flags),
+            state,
+            nullptr,
+            IID_PPV_ARGS(resourceOut.ReleaseAndGetAddressOf())));
+    };
+
+    uint32_t inputStrides[4], outputStrides[4];
+    GetStrides(inputSizes, layout, inputStrides);
+    GetStrides(outputSizes, layout, outputStrides);
+
+    ComPtr<ID3D12Resource> input, output;
+    createBuffer(DMLCalcBufferTensorSize(DML_TENSOR_DATA_TYPE_FLOAT16, 4, inputSizes, inputStrides), D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_COMMON, input);
+    createBuffer(DMLCalcBufferTensorSize(DML_TENSOR_DATA_TYPE_FLOAT16, 4, outputSizes, outputStrides), D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_COMMON, output);
+
+    IDMLCompiledOperator* compiledOps[] = { compiledOp.Get() };
+    ComPtr<IDMLOperatorInitializer> initializer;
+    DX::ThrowIfFailed(m_dmlDevice->CreateOperatorInitializer(1, compiledOps, IID_PPV_ARGS(&initializer)));
+
+    const DML_BINDING_PROPERTIES initProps = initializer->GetBindingProperties();
+    const DML_BINDING_PROPERTIES execProps = compiledOp->GetBindingProperties();
+
+    // Initialization and execution are recorded in the same command list, so they get separate descriptors
+    DescriptorHeap descriptorHeap(device,
+        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+        D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
+        std::max<size_t>(initProps.RequiredDescriptorCount + execProps.RequiredDescriptorCount, 1));
+
+    ComPtr<ID3D12Resource> temporary, persistent;
+    const UINT64 temporarySize = std::max(initProps.TemporaryResourceSize, execProps.TemporaryResourceSize);
+    if (temporarySize > 0)
+    {
+        createBuffer(temporarySize, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_COMMON, temporary);
+    }
+    if (execProps.PersistentResourceSize > 0)
+    {
+        createBuffer(execProps.PersistentResourceSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_COMMON, persistent);
+    }
+
+    const DML_BUFFER_BINDING emptyBufferBinding = { nullptr, 0, 0 };
+    const DML_BINDING_DESC emptyBindingDesc = { DML_BINDING_TYPE_NONE, nullptr };
+
+    DML_BUFFER_BINDING temporaryBuffer = emptyBufferBinding;
+    DML_BINDING_DESC temporaryBinding = emptyBindingDesc;
+    if (temporary)
+    {
+        temporaryBuffer = { temporary.Get(), 0, temporarySize };
+        temporaryBinding = { DML_BINDING_TYPE_BUFFER, &temporaryBuffer };
+    }
+
+    DML_BUFFER_BINDING persistentBuffer = emptyBufferBinding;
+    DML_BINDING_DESC persistentBinding = emptyBindingDesc;
+    if (persistent)
+    {
+        persistentBuffer = { persistent.Get(), 0, execProps.PersistentResourceSize };
+        persistentBinding = { DML_BINDING_TYPE_BUFFER, &persistentBuffer };
+    }
+
+    DML_BUFFER_BINDING weightBuffers[3] = { emptyBufferBinding, emptyBufferBinding, emptyBufferBinding };
+    weightBuffers[1] = { filterWeights.Get(), 0, filterWeights->GetDesc().Width };
+    if (biasWeights)
+    {
+        weightBuffers[2] = { biasWeights.Get(), 0, biasWeights->GetDesc().Width };
+    }
+
+    commandList->Reset(m_deviceResources->GetCommandAllocator(), nullptr);
+
+    ID3D12DescriptorHeap* pHeaps[] = { descriptorHeap.Heap() };
+    commandList->SetDescriptorHeaps(_countof(pHeaps), pHeaps);
+
+    // Initialize the operator, binding the weights the same way as InitializeDirectMLResources()
+    {
+        DML_BINDING_TABLE_DESC tableDesc = {
+            initializer.Get(),
+            descriptorHeap.GetCpuHandle(0),
+            descriptorHeap.GetGpuHandle(0),
+            initProps.RequiredDescriptorCount
+        };
+
+        ComPtr<IDMLBindingTable> initBindingTable;
+        DX::ThrowIfFailed(m_dmlDevice->CreateBindingTable(&tableDesc, IID_PPV_ARGS(&initBindingTable)));
+
+#if DML_MANAGED_WEIGHTS
+        DML_BUFFER_ARRAY_BINDING initBufferArray = { 3, weightBuffers };
+        DML_BINDING_DESC initBinding = { DML_BINDING_TYPE_BUFFER_ARRAY, &initBufferArray };
+        initBindingTable->BindInputs(1, &initBinding);
+#else
+        initBindingTable->BindInputs(0, nullptr);
+#endif
+        initBindingTable->BindOutputs(1, &persistentBinding);
+        if (initProps.TemporaryResourceSize > 0)
+        {
+            initBindingTable->BindTemporaryResource(&temporaryBinding);
+        }
+
+        m_dmlCommandRecorder->RecordDispatch(commandList, initializer.Get(), initBindingTable.Get());
+        commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+    }
+
+    // Bind for execution
+    DML_BINDING_TABLE_DESC tableDesc = {
+        compiledOp.Get(),
+        descriptorHeap.GetCpuHandle(initProps.RequiredDescriptorCount),
+        descriptorHeap.GetGpuHandle(initProps.RequiredDescriptorCount),
+        execProps.RequiredDescriptorCount
+    };
+
+    ComPtr<IDMLBindingTable> bindingTable;
+    DX::ThrowIfFailed(m_dmlDevice->CreateBindingTable(&tableDesc, IID_PPV_ARGS(&bindingTable)));
+
+    DML_BUFFER_BINDING inputBuffers[3] = { { input.Get(), 0, input->GetDesc().Width }, emptyBufferBinding, emptyBufferBinding };
+    DML_BINDING_DESC inputBindings[3] = { { DML_BINDING_TYPE_BUFFER, &inputBuffers[0] }, emptyBindingDesc, emptyBindingDesc };
+#if !DML_MANAGED_WEIGHTS
+    for (UINT k = 1; k < 3; k++)
+    {
+        if (weightBuffers[k].Buffer != nullptr)
+        {
+            inputBuffers[k] = weightBuffers[k];
+            inputBindings[k] = { DML_BINDING_TYPE_BUFFER, &inputBuffers[k] };
+        }
+    }
+#endif
+
+    DML_BUFFER_BINDING outputBuffer = { output.Get(), 0, output->GetDesc().Width };
+    DML_BINDING_DESC outputBinding = { DML_BINDING_TYPE_BUFFER, &outputBuffer };
+
+    bindingTable->BindInputs(_countof(inputBindings), inputBindings);
+    bindingTable->BindOutputs(1, &outputBinding);
+    if (execProps.TemporaryResourceSize > 0)
+    {
+        bindingTable->BindTemporaryResource(&temporaryBinding);
+    }
+    if (persistent)
+    {
+        bindingTable->BindPersistentResource(&persistentBinding);
+    }
+
+    // Time a run of dispatches after one to warm up, with a barrier between them like in the model
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = { D3D12_QUERY_HEAP_TYPE_TIMESTAMP, 2, 0 };
+    ComPtr<ID3D12QueryHeap> queryHeap;
+    DX::ThrowIfFailed(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&queryHeap)));
+
+    ComPtr<ID3D12Resource> timestampReadback;
+    createBuffer(2 * sizeof(uint64_t), D3D12_HEAP_TYPE_READBACK, D3D12_RESOURCE_STATE_COPY_DEST, timestampReadback);
+
+    const UINT c_timedDispatches = 8;
+
+    m_dmlCommandRecorder->RecordDispatch(commandList, compiledOp.Get(), bindingTable.Get());
+    commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+
+    commandList->EndQuery(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0);
+    for (UINT i = 0; i < c_timedDispatches; i++)
+    {
+        m_dmlCommandRecorder->RecordDispatch(commandList, compiledOp.Get(), bindingTable.Get());
+        commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+    }
+    commandList->EndQuery(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 1);
+    commandList->ResolveQueryData(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, timestampReadback.Get(), 0);
+
+    DX::ThrowIfFailed(commandList->Close());
+    m_deviceResources->GetCommandQueue()->ExecuteCommandLists(1, CommandListCast(&commandList));
+    m_deviceResources->WaitForGpu();
+
+    uint64_t* timestamps = nullptr;
+    const D3D12_RANGE readRange = { 0, 2 * sizeof(uint64_t) };
+    DX::ThrowIfFailed(timestampReadback->Map(0, &readRange, reinterpret_cast<void**>(&timestamps)));
+    const uint64_t ticks = timestamps[1] - timestamps[0];
+    const D3D12_RANGE writtenRange = { 0, 0 };
+    timestampReadback->Unmap(0, &writtenRange);
+
+    UINT64 frequency = 0;
+    DX::ThrowIfFailed(m_deviceResources->GetCommandQueue()->GetTimestampFrequency(&frequency));
+
+    return 1000.0 * double(ticks) / double(frequency) / c_timedDispatches;
+}
+
 void Sample::CreateUpsampleLayer(
     _In_reads_(4) const uint32_t* inputSizes,
-    _Inout_updates_(1) uint64_t* inputBufferRequiredSize,
-    _Inout_updates_(1) uint64_t* outputBufferRequiredSize,
+    uint32_t scaleFactor,
     _Out_writes_(4) uint32_t* outputSizesOut,
     _Out_writes_(1) IDMLCompiledOperator** compiledOpOut)
 {
@@ -1490,30 +1993,26 @@ void Sample::CreateUpsampleLayer(
     GetStrides(inputSizes, m_tensorLayout, inputStrides);
     
     uint64_t inputBufferSize = DMLCalcBufferTensorSize(DML_TENSOR_DATA_TYPE_FLOAT16, 4, inputSizes, inputStrides);
-    // Because we can resuse resources for tensor storage, this tracks the resource size needed to hold the
-    // largest possible tensor requested.
-    *inputBufferRequiredSize = std::max(inputBufferSize, *inputBufferRequiredSize);
 
     DML_BUFFER_TENSOR_DESC inputBufferDesc = { DML_TENSOR_DATA_TYPE_FLOAT16, DML_TENSOR_FLAG_NONE, 4, inputSizes, inputStrides, inputBufferSize, 0 };
     DML_TENSOR_DESC inputDesc = { DML_TENSOR_TYPE_BUFFER, &inputBufferDesc };
 
-    // Output size is double in height and width
+    // Output size is multiplied by the scale factor in height and width
     outputSizesOut[0] = inputSizes[0];
     outputSizesOut[1] = inputSizes[1];
-    outputSizesOut[2] = inputSizes[2] * 2;
-    outputSizesOut[3] = inputSizes[3] * 2;
+    outputSizesOut[2] = inputSizes[2] * scaleFactor;
+    outputSizesOut[3] = inputSizes[3] * scaleFactor;
 
     uint32_t outputStrides[4];
     GetStrides(outputSizesOut, m_tensorLayout, outputStrides);
 
     uint64_t outputBufferSize = DMLCalcBufferTensorSize(DML_TENSOR_DATA_TYPE_FLOAT16, 4, outputSizesOut, outputStrides);
-    *outputBufferRequiredSize = std::max(outputBufferSize, *outputBufferRequiredSize);
 
     DML_BUFFER_TENSOR_DESC outputBufferDesc = { DML_TENSOR_DATA_TYPE_FLOAT16, DML_TENSOR_FLAG_NONE, 4, outputSizesOut, outputStrides, outputBufferSize, 0 };
     DML_TENSOR_DESC outputDesc = { DML_TENSOR_TYPE_BUFFER, &outputBufferDesc };
 
     // Describe, create, and compile upsample operator
-    DML_UPSAMPLE_2D_OPERATOR_DESC upsampleDesc = { &inputDesc, &outputDesc, {2, 2}, DML_INTERPOLATION_MODE_NEAREST_NEIGHBOR };
+    DML_UPSAMPLE_2D_OPERATOR_DESC upsampleDesc = { &inputDesc, &outputDesc, { scaleFactor, scaleFactor }, DML_INTERPOLATION_MODE_NEAREST_NEIGHBOR };
     DML_OPERATOR_DESC opDesc = { DML_OPERATOR_UPSAMPLE_2D, &upsampleDesc };
 
     ComPtr<IDMLOperator> op;
@@ -1525,8 +2024,6 @@ void Sample::CreateConvolutionLayer(
     _In_reads_(4) const uint32_t* inputSizes,
     _In_reads_(4) const uint32_t* filterSizes,
     bool useBiasAndActivation,
-    _Inout_updates_(1) uint64_t* inputBufferRequiredSize,
-    _Inout_updates_(1) uint64_t* outputBufferRequiredSize,
     _Out_writes_(4) uint32_t* outputSizesOut,
     _Out_writes_(1) IDMLCompiledOperator** compiledOpOut)
 {
@@ -1535,7 +2032,6 @@ void Sample::CreateConvolutionLayer(
     GetStrides(inputSizes, m_tensorLayout, inputStrides);
 
     uint64_t inputBufferSize = DMLCalcBufferTensorSize(DML_TENSOR_DATA_TYPE_FLOAT16, 4, inputSizes, inputStrides);
-    *inputBufferRequiredSize = std::max(inputBufferSize, *inputBufferRequiredSize);
 
     DML_BUFFER_TENSOR_DESC inputBufferDesc = { DML_TENSOR_DATA_TYPE_FLOAT16, DML_TENSOR_FLAG_NONE, 4, inputSizes, inputStrides, inputBufferSize, 0 };
     DML_TENSOR_DESC inputDesc = { DML_TENSOR_TYPE_BUFFER, &inputBufferDesc };
@@ -1550,7 +2046,6 @@ void Sample::CreateConvolutionLayer(
     GetStrides(outputSizesOut, m_tensorLayout, outputStrides);
 
     uint64_t outputBufferSize = DMLCalcBufferTensorSize(DML_TENSOR_DATA_TYPE_FLOAT16, 4, outputSizesOut, outputStrides);
-    *outputBufferRequiredSize = std::max(outputBufferSize, *outputBufferRequiredSize);    
 
     DML_BUFFER_TENSOR_DESC outputBufferDesc = { DML_TENSOR_DATA_TYPE_FLOAT16, DML_TENSOR_FLAG_NONE, 4, outputSizesOut, outputStrides, outputBufferSize, 0 };
     DML_TENSOR_DESC outputDesc = { DML_TENSOR_TYPE_BUFFER, &outputBufferDesc };
@@ -1581,23 +2076,12 @@ void Sample::CreateConvolutionLayer(
 
     // Describe, create, and compile convolution operator
 
-    // The output size of a convolution operation is given by:
-    //  height = (inputHeight - filterHeight + 2*paddingHeight) / filterStride + 1
-    //  width  = (inputWidth  - filterWidth  + 2*paddingWidth ) / filterStride + 1
-    //
-    // We want to preserve the height and width, so assuming stride is 1, we get:
-    //  paddingHeight = (filterHeight - 1) / 2
-    //  paddingWidth  = (filterWidth  - 1) / 2
-    // If padding is fractional, we pad unevenly with ceil/floor.
-    UINT paddingHeightTop = static_cast<UINT>(ceil((filterSizes[2] - 1) / 2.0f));
-    UINT paddingHeightBottom = static_cast<UINT>(floor((filterSizes[2] - 1) / 2.0f));
-    UINT paddingWidthLeft = static_cast<UINT>(ceil((filterSizes[3] - 1) / 2.0f));
-    UINT paddingWidthRight = static_cast<UINT>(floor((filterSizes[3] - 1) / 2.0f));
-    
+    // Pad to preserve the height and width of the input.
+    uint32_t startPadding[2], endPadding[2];
+    SuperResolutionModel::GetConvPadding(filterSizes, startPadding, endPadding);
+
     UINT strides[] = { 1, 1 };
     UINT dilations[] = { 1, 1 };
-    UINT startPadding[] = { paddingHeightTop, paddingWidthLeft };
-    UINT endPadding[] = { paddingHeightBottom, paddingWidthRight };
     UINT outputPadding[] = { 0, 0 };
 
     DML_ACTIVATION_RELU_OPERATOR_DESC fusedReluDesc = { 0 };
@@ -1628,6 +2112,7 @@ void Sample::CreateConvolutionLayer(
 
 void Sample::CreateAdditionLayer(
     _In_reads_(4) const uint32_t* inputSizes,
+    uint32_t addendUpsampleFactor,
     _Out_writes_(1) IDMLCompiledOperator** compiledOpOut)
 {
     // Describe input and output tensors
@@ -1639,8 +2124,27 @@ void Sample::CreateAdditionLayer(
     DML_TENSOR_DESC tensorDesc = { DML_TENSOR_TYPE_BUFFER, &bufferDesc };
 
     // Describe, create, and compile elementwise addition operator
-    // Inputs and output are all the same size and use the same tensor desc.
+    // Inputs and output are all the same size and use the same tensor desc, unless the second input is read upsampled.
+    // Then all three are described as 5D views in which the second input repeats its values.
     DML_ELEMENT_WISE_ADD_OPERATOR_DESC addDesc = { &tensorDesc, &tensorDesc, &tensorDesc };
+
+    uint32_t viewSizes[5], viewStrides[5], upsampledStrides[5];
+    DML_BUFFER_TENSOR_DESC viewBufferDesc = {}, upsampledBufferDesc = {};
+    DML_TENSOR_DESC viewDesc = {}, upsampledDesc = {};
+    if (addendUpsampleFactor > 1)
+    {
+        GetUpsampledInputViews(inputSizes, m_tensorLayout, addendUpsampleFactor, viewSizes, viewStrides, upsampledStrides);
+
+        viewBufferDesc = { DML_TENSOR_DATA_TYPE_FLOAT16, DML_TENSOR_FLAG_NONE, 5, viewSizes, viewStrides, bufferSize, 0 };
+        viewDesc = { DML_TENSOR_TYPE_BUFFER, &viewBufferDesc };
+
+        upsampledBufferDesc = { DML_TENSOR_DATA_TYPE_FLOAT16, DML_TENSOR_FLAG_NONE, 5, viewSizes, upsampledStrides,
+            DMLCalcBufferTensorSize(DML_TENSOR_DATA_TYPE_FLOAT16, 5, viewSizes, upsampledStrides), 0 };
+        upsampledDesc = { DML_TENSOR_TYPE_BUFFER, &upsampledBufferDesc };
+
+        addDesc = { &viewDesc, &upsampledDesc, &viewDesc };
+    }
+
     DML_OPERATOR_DESC opDesc = { DML_OPERATOR_ELEMENT_WISE_ADD, &addDesc };
 
     ComPtr<IDMLOperator> op;
@@ -1649,105 +2153,44 @@ void Sample::CreateAdditionLayer(
 }
 
 void Sample::CreateWeightTensors(
-    WeightMapType& weights,
-    const char* convLayerName,
-    const char* scaleLayerName,
-    const char* shiftLayerName,
-    _In_reads_(4) const uint32_t* filterSizes,
+    const ModelContainer::Reader& container,
+    const SuperResolutionModel::ConvLayerDesc& layer,
     DirectX::ResourceUploadBatch& uploadBatch,
     _Out_writes_(1) ID3D12Resource** filterWeightResourceOut,
     _Out_writes_opt_(1) ID3D12Resource** biasWeightResourceOut)
 {
-    // There are two types of weights for the convolutions: The convolution filters themselves, and scale/shift
-    // weights used to normalize and bias the results. The final layer doesn't use scale and shift weights, so
-    // these are optional.
+    // There are two types of weights for the convolutions: The convolution filters themselves, and bias weights.
+    // The container already has the batch normalization scale premultiplied into the filters and the shift stored
+    // as the bias, in FP16 and in the layout we need, so the data is uploaded as it is. The final layer doesn't
+    // use a bias, so it is optional.
 
-    bool useScaleShift = true;
-    if (scaleLayerName == nullptr)
-    {
-        assert(shiftLayerName == nullptr);
-        useScaleShift = false;
-    }
-    
-    CreateWeightResource(filterSizes, filterWeightResourceOut);
-    if (useScaleShift)
-    {
-        uint32_t biasSizes[] = { 1, filterSizes[0], 1, 1 };	// One bias per output channel
-        CreateWeightResource(biasSizes, biasWeightResourceOut);
-
-        // The scale weights will be premultiplied into the filter weights, so they don't need
-        // a separate resource.
-    }
-    else
-    {
-        if (biasWeightResourceOut)
-            biasWeightResourceOut = nullptr;
-    }
+    const ModelContainer::Layout layout = (m_tensorLayout == TensorLayout::NHWC) ?
+        ModelContainer::Layout::NHWC :
+        ModelContainer::Layout::NCHW;
 
-    // Convert weight values to FP16
-    WeightsType filterWeights = weights[convLayerName];
-    WeightsType scaleWeights, shiftWeights;
-    if (useScaleShift)
+    const ModelContainer::TensorEntry* filter = container.Find(ModelContainer::GetFilterName(layer).c_str(), layout);
+    if (!filter || memcmp(filter->sizes, layer.filterSizes, sizeof(filter->sizes)) != 0)
     {
-        scaleWeights = weights[scaleLayerName];
-        shiftWeights = weights[shiftLayerName];
+        throw std::exception("CreateWeightTensors");
     }
 
-    std::vector<uint16_t> filterWeightsFP16;
-    std::vector<uint16_t> biasWeightsFP16;
+    CreateWeightResource(layer.filterSizes, filterWeightResourceOut);
 
-    const uint32_t N = filterSizes[0];
-    const uint32_t C = filterSizes[1];
-    const uint32_t H = filterSizes[2];
-    const uint32_t W = filterSizes[3];
+    D3D12_SUBRESOURCE_DATA weightsData = {};
+    weightsData.pData = container.GetData(*filter);
+    uploadBatch.Upload(*filterWeightResourceOut, 0, &weightsData, 1);
 
-    for (uint32_t n = 0; n < N; n++)
+    if (biasWeightResourceOut)
     {
-        switch (m_tensorLayout)
+        const ModelContainer::TensorEntry* bias = container.Find(ModelContainer::GetBiasName(layer).c_str(), layout);
+        if (!bias)
         {
-        case TensorLayout::NHWC:
-            // We need to convert the weights from NCHW to NHWC.
-            for (uint32_t h = 0; h < H; h++)
-                for (uint32_t w = 0; w < W; w++)
-                    for (uint32_t c = 0; c < C; c++)
-                    {
-                        // Apply the scale weight now so we don't need a normalization layer
-                        uint32_t idx = w + h * W + c * H*W + n * C*H*W;
-                        float scaledWeight = useScaleShift ?
-                            filterWeights[idx] * scaleWeights[n] :
-                            filterWeights[idx];
-                        filterWeightsFP16.push_back(Float16Compressor::compress(scaledWeight));
-                    }
-            break;
-
-        default:
-            // Weights are already in the right order
-            for (uint32_t i = 0; i < C*H*W; i++)
-            {
-                // Apply the scale weight now so we don't need a normalization layer
-                uint32_t idx = n * C*H*W + i;
-                float scaledWeight = useScaleShift ?
-                    filterWeights[idx] * scaleWeights[n] :
-                    filterWeights[idx];
-                filterWeightsFP16.push_back(Float16Compressor::compress(scaledWeight));
-            }
+            throw std::exception("CreateWeightTensors");
         }
 
-        if (useScaleShift)
-        {
-            // Technically this is initialBias*scale+shift, but the initial bias is 0
-            biasWeightsFP16.push_back(Float16Compressor::compress(shiftWeights[n]));
-        }
-    }
+        CreateWeightResource(bias->sizes, biasWeightResourceOut);
 
-    // Upload to the GPU
-    D3D12_SUBRESOURCE_DATA weightsData = {};
-    weightsData.pData = filterWeightsFP16.data();
-    uploadBatch.Upload(*filterWeightResourceOut, 0, &weightsData, 1);
-
-    if (useScaleShift)
-    {
-        weightsData.pData = biasWeightsFP16.data();
+        weightsData.pData = container.GetData(*bias);
         uploadBatch.Upload(*biasWeightResourceOut, 0, &weightsData, 1);
     }
 }
@@ -1772,355 +2215,223 @@ void Sample::CreateWeightResource(
     ));
 }
 
+void Sample::GetModelTensorSizes(uint32_t tensorIndex, _Out_writes_(4) uint32_t* sizesOut) const
+{
+    const SuperResolutionModel::TensorDesc& tensor = m_modelGraph.GetTensors()[tensorIndex];
+
+    sizesOut[0] = c_modelBatchSize;
+    sizesOut[1] = tensor.channels;
+    sizesOut[2] = m_origTextureHeight * tensor.scale;
+    sizesOut[3] = m_origTextureWidth * tensor.scale;
+}
+
+DML_BUFFER_BINDING Sample::GetModelTensorBinding(uint32_t tensorIndex) const
+{
+    const uint32_t buffer = m_modelGraph.GetTensors()[tensorIndex].buffer;
+
+    switch (buffer)
+    {
+    case SuperResolutionModel::c_inputBuffer:   return { m_modelInput.Get(), 0, m_modelInput->GetDesc().Width };
+    case SuperResolutionModel::c_outputBuffer:  return { m_modelOutput.Get(), 0, m_modelOutput->GetDesc().Width };
+    default:                                    return { m_modelArena.Get(), m_modelArenaLayout.bufferOffsets[buffer], m_modelArenaLayout.bufferSizes[buffer] };
+    }
+}
+
 void Sample::InitializeDirectMLResources()
 {
     auto commandList = m_deviceResources->GetCommandList();
     commandList->Reset(m_deviceResources->GetCommandAllocator(), nullptr);
 
-    // Create operator initializers and descriptor heap for binding
-    size_t upsampleOpDescriptorCount, convOpDescriptorCount, additionOpDescriptorCount;
-    size_t upsampleDescriptorsIdx, convDescriptorsIdx, additionDescriptorsIdx;
+    const auto& ops = m_modelGraph.GetOps();
+    const UINT opCount = static_cast<UINT>(m_modelOps.size());
+
+    // Create the operator initializer and descriptor heap for binding
+    size_t opDescriptorCount;
 
     {
+        std::vector<IDMLCompiledOperator*> compiledOps(opCount);
+        for (UINT i = 0; i < opCount; i++)
+        {
+            compiledOps[i] = m_modelOps[i].compiledOp.Get();
+        }
+
         // The same descriptor heap will be used for both initializing and executing operators. These each happen
         // at different times, so we reuse the same descriptor slots. GetDescriptorCount() ensures there are enough
         // slots for both cases.
-        DX::ThrowIfFailed(m_dmlDevice->CreateOperatorInitializer(c_numUpsampleLayers, m_dmlUpsampleOps[0].GetAddressOf(), IID_PPV_ARGS(m_dmlOpInitializers[e_opUpsample].GetAddressOf())));
-        upsampleOpDescriptorCount = GetDescriptorCount(c_numUpsampleLayers, m_dmlUpsampleOps[0].GetAddressOf(), m_dmlOpInitializers[e_opUpsample].Get());
-
-        DX::ThrowIfFailed(m_dmlDevice->CreateOperatorInitializer(c_numConvLayers, m_dmlConvOps[0].GetAddressOf(), IID_PPV_ARGS(m_dmlOpInitializers[e_opConv].GetAddressOf())));
-        convOpDescriptorCount = GetDescriptorCount(c_numConvLayers, m_dmlConvOps[0].GetAddressOf(), m_dmlOpInitializers[e_opConv].Get());
-
-        DX::ThrowIfFailed(m_dmlDevice->CreateOperatorInitializer(1, m_dmlAddResidualOp.GetAddressOf(), IID_PPV_ARGS(m_dmlOpInitializers[e_opAdd].GetAddressOf())));
-        additionOpDescriptorCount = GetDescriptorCount(1, m_dmlAddResidualOp.GetAddressOf(), m_dmlOpInitializers[e_opAdd].Get());
-        
-        upsampleDescriptorsIdx = 0;
-        convDescriptorsIdx = upsampleDescriptorsIdx + upsampleOpDescriptorCount * c_numUpsampleLayers;
-        additionDescriptorsIdx = convDescriptorsIdx + convOpDescriptorCount * c_numConvLayers;
-        size_t descriptorCount = additionDescriptorsIdx + additionOpDescriptorCount;
+        DX::ThrowIfFailed(m_dmlDevice->CreateOperatorInitializer(opCount, compiledOps.data(), IID_PPV_ARGS(m_dmlOpInitializer.ReleaseAndGetAddressOf())));
+        opDescriptorCount = GetDescriptorCount(opCount, compiledOps.data(), m_dmlOpInitializer.Get());
 
         m_dmlDescriptorHeap = std::make_unique<DescriptorHeap>(m_deviceResources->GetD3DDevice(),
             D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
             D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
-            descriptorCount);
+            opDescriptorCount * opCount);
 
         // Operator initialization dispatches will use this heap right away
         ID3D12DescriptorHeap* pHeaps[] = { m_dmlDescriptorHeap->Heap() };
         commandList->SetDescriptorHeaps(_countof(pHeaps), pHeaps);
     }
 
-    // Create any persistent resources required for the operators.
+    // Create the arena for intermediate results and temporary resources, as planned in CreateDirectMLResources()
     {
-        for (int i = 0; i < c_numUpsampleLayers + c_numConvLayers + 1; i++)
-        {
-            IDMLCompiledOperator* currentOp;
-            ID3D12Resource** persistentResource;
-            if (i < c_numUpsampleLayers)
-            {
-                currentOp = m_dmlUpsampleOps[i].Get();
-                persistentResource = m_modelUpsamplePersistentResources[i].ReleaseAndGetAddressOf();
-            }
-            else if (i < c_numUpsampleLayers + c_numConvLayers)
-            {
-                currentOp = m_dmlConvOps[i - c_numUpsampleLayers].Get();
-                persistentResource = m_modelConvPersistentResources[i - c_numUpsampleLayers].ReleaseAndGetAddressOf();
-            }
-            else
-            {
-                currentOp = m_dmlAddResidualOp.Get();
-                persistentResource = m_modelAddPersistentResource.ReleaseAndGetAddressOf();
-            }
+        const UINT64 arenaSize = std::max(m_modelArenaLayout.arenaSize, m_dmlOpInitializer->GetBindingProperties().TemporaryResourceSize);
+
+        D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(std::max<UINT64>(arenaSize, 1), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+        DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+            D3D12_HEAP_FLAG_NONE,
+            &resourceDesc,
+            D3D12_RESOURCE_STATE_COMMON,
+            nullptr,
+            IID_PPV_ARGS(m_modelArena.ReleaseAndGetAddressOf())));
+    }
 
-            auto bindingProps = currentOp->GetBindingProperties();
+    // Create any persistent resources required for the operators.
+    for (ModelOperation& op : m_modelOps)
+    {
+        auto bindingProps = op.compiledOp->GetBindingProperties();
 
-            if (bindingProps.PersistentResourceSize > 0)
-            {
-                D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(bindingProps.PersistentResourceSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-                DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateCommittedResource(
-                    &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-                    D3D12_HEAP_FLAG_NONE,
-                    &resourceDesc,
-                    D3D12_RESOURCE_STATE_COMMON,
-                    nullptr,
-                    IID_PPV_ARGS(persistentResource)));
-            }
+        if (bindingProps.PersistentResourceSize > 0)
+        {
+            D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(bindingProps.PersistentResourceSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+            DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateCommittedResource(
+                &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+                D3D12_HEAP_FLAG_NONE,
+                &resourceDesc,
+                D3D12_RESOURCE_STATE_COMMON,
+                nullptr,
+                IID_PPV_ARGS(op.persistentResource.ReleaseAndGetAddressOf())));
         }
     }
 
-    // When binding input and output resources, take note of which temp resource is used at the time:
-    // Layer		| Input							| Output
-    // Upsample[0]	| m_modelInput					| m_modelOutput
-    // Conv[0]		| m_modelInput					| m_modelIntermediateResult[0]
-    // Conv[1]		| m_modelIntermediateResult[0]	| m_modelIntermediateResult[1]
-    // Conv[2]		| m_modelIntermediateResult[1]	| m_modelIntermediateResult[0]
-    // Upsample[1]	| m_modelIntermediateResult[0]	| m_modelIntermediateResult[1]
-    // Conv[3]		| m_modelIntermediateResult[1]	| m_modelIntermediateResult[0]
-    // Conv[4]		| m_modelIntermediateResult[0]	| m_modelIntermediateResult[1]
-    // Conv[5]		| m_modelIntermediateResult[1]	| m_modelIntermediateResult[0]
-    // Conv[6]		| m_modelIntermediateResult[0]	| m_modelIntermediateResult[1]
-    // Addition		| m_modelIntermediateResult[1], m_modelOutput | m_modelOutput
-    
     const DML_BUFFER_BINDING emptyBufferBinding = { nullptr, 0, 0 };
     const DML_BINDING_DESC emptyBindingDesc = { DML_BINDING_TYPE_NONE, nullptr };
 
-    // Bind D3D resources
-
-    Microsoft::WRL::ComPtr<IDMLBindingTable> initBindingTable;
+    // If an operator requires a persistent resource, it must be bound as output for the initializer, and
+    // for every execution.
+    std::vector<DML_BUFFER_BINDING> persistentBuffers(opCount);
+    std::vector<DML_BINDING_DESC> persistentBindings(opCount);
+    for (UINT i = 0; i < opCount; i++)
+    {
+        if (m_modelOps[i].persistentResource.Get() != nullptr)
+        {
+            persistentBuffers[i] = { m_modelOps[i].persistentResource.Get(), 0, m_modelOps[i].persistentResource->GetDesc().Width };
+            persistentBindings[i] = { DML_BINDING_TYPE_BUFFER, &persistentBuffers[i] };
+        }
+        else
+            persistentBindings[i] = emptyBindingDesc;
+    }
 
-    // Upsample layers
+    // Bind resources for initialization
     {
-        // Bind resources for initialization.
-        auto bindingProps = m_dmlOpInitializers[e_opUpsample]->GetBindingProperties();
+        auto bindingProps = m_dmlOpInitializer->GetBindingProperties();
         // The DML API guarantees that initialization never uses a persistent resource.
         assert(bindingProps.PersistentResourceSize == 0);
-        
+
         DML_BINDING_TABLE_DESC tableDesc = {
-            m_dmlOpInitializers[e_opUpsample].Get(),
-            m_dmlDescriptorHeap->GetCpuHandle(upsampleDescriptorsIdx),
-            m_dmlDescriptorHeap->GetGpuHandle(upsampleDescriptorsIdx),
+            m_dmlOpInitializer.Get(),
+            m_dmlDescriptorHeap->GetCpuHandle(0),
+            m_dmlDescriptorHeap->GetGpuHandle(0),
             bindingProps.RequiredDescriptorCount
         };
+
+        Microsoft::WRL::ComPtr<IDMLBindingTable> initBindingTable;
         DX::ThrowIfFailed(m_dmlDevice->CreateBindingTable(&tableDesc, IID_PPV_ARGS(&initBindingTable)));
-        
-        // If the operator requires a persistent resource, it must be bound as output for the initializer.
-        DML_BUFFER_BINDING upsamplePersistentBuffers[c_numUpsampleLayers];
-        DML_BINDING_DESC upsamplePersistentBindings[c_numUpsampleLayers];
-        for (int i = 0; i < c_numUpsampleLayers; i++)
+
+#if DML_MANAGED_WEIGHTS
+        // Bind the weight tensors at initialization instead of at execution. This lets DirectML reformat them
+        // and improve performance on some hardware. Each operator gets one binding per input, and only the
+        // convolution weights are bound.
+        std::vector<DML_BUFFER_BINDING> initBuffers(opCount * 3, emptyBufferBinding);
+        std::vector<DML_BUFFER_ARRAY_BINDING> initBufferArrays(opCount);
+        std::vector<DML_BINDING_DESC> initBindings(opCount);
+        for (UINT i = 0; i < opCount; i++)
         {
-            if (m_modelUpsamplePersistentResources[i].Get() != nullptr)
+            const ModelOperation& op = m_modelOps[i];
+            DML_BUFFER_BINDING* opBuffers = &initBuffers[i * 3];
+
+            UINT inputCount = SuperResolutionModel::GetInputCount(ops[i]);
+            if (ops[i].type == SuperResolutionModel::OpType::Convolution)
             {
-                upsamplePersistentBuffers[i] = { m_modelUpsamplePersistentResources[i].Get(), 0, m_modelUpsamplePersistentResources[i]->GetDesc().Width };
-                upsamplePersistentBindings[i] = { DML_BINDING_TYPE_BUFFER, &upsamplePersistentBuffers[i] };
+                inputCount = 3;
+                opBuffers[1] = { op.filterWeights.Get(), 0, op.filterWeights->GetDesc().Width };
+                if (op.biasWeights.Get() != nullptr)
+                {
+                    opBuffers[2] = { op.biasWeights.Get(), 0, op.biasWeights->GetDesc().Width };
+                }
             }
-            else
-                upsamplePersistentBindings[i] = emptyBindingDesc;
+
+            initBufferArrays[i] = { inputCount, opBuffers };
+            initBindings[i] = { DML_BINDING_TYPE_BUFFER_ARRAY, &initBufferArrays[i] };
         }
 
+        initBindingTable->BindInputs(opCount, initBindings.data());
+#else
         // The inputs will vary each frame, so don't bind inputs at initialization.
         initBindingTable->BindInputs(0, nullptr);
-        initBindingTable->BindOutputs(c_numUpsampleLayers, upsamplePersistentBindings);
-        BindTempResourceIfNeeded(bindingProps, initBindingTable.Get(), m_modelInitTemporaryResources[e_opUpsample].ReleaseAndGetAddressOf());
+#endif
+        initBindingTable->BindOutputs(opCount, persistentBindings.data());
+        BindArenaTemporary(initBindingTable.Get(), 0, bindingProps.TemporaryResourceSize);
 
         // Run initialization
-        m_dmlCommandRecorder->RecordDispatch(commandList, m_dmlOpInitializers[e_opUpsample].Get(), initBindingTable.Get());
-
-        // Bind resources for execution
-        for (int i = 0; i < c_numUpsampleLayers; i++)
-        {
-            bindingProps = m_dmlUpsampleOps[i]->GetBindingProperties();
-
-            tableDesc = {
-                m_dmlUpsampleOps[i].Get(),
-                m_dmlDescriptorHeap->GetCpuHandle(upsampleDescriptorsIdx + i * upsampleOpDescriptorCount),
-                m_dmlDescriptorHeap->GetGpuHandle(upsampleDescriptorsIdx + i * upsampleOpDescriptorCount),
-                bindingProps.RequiredDescriptorCount
-            };
-            DX::ThrowIfFailed(m_dmlDevice->CreateBindingTable(&tableDesc, IID_PPV_ARGS(m_dmlUpsampleBindings[i].ReleaseAndGetAddressOf())));
-
-            auto inputResource = (i == 0) ? m_modelInput : m_modelIntermediateResult[0];
-            auto outputResource = (i == 0) ? m_modelOutput : m_modelIntermediateResult[1];
-
-            DML_BUFFER_BINDING inputBufferBinding = { inputResource.Get(), 0, inputResource->GetDesc().Width };
-            DML_BINDING_DESC inputBinding = { DML_BINDING_TYPE_BUFFER, &inputBufferBinding };
-            DML_BUFFER_BINDING outputBufferBinding = { outputResource.Get(), 0, outputResource->GetDesc().Width };
-            DML_BINDING_DESC outputBinding = { DML_BINDING_TYPE_BUFFER, &outputBufferBinding };
-
-            m_dmlUpsampleBindings[i]->BindInputs(1, &inputBinding);
-            m_dmlUpsampleBindings[i]->BindOutputs(1, &outputBinding);
-            BindTempResourceIfNeeded(bindingProps, m_dmlUpsampleBindings[i].Get(), m_modelUpsampleTemporaryResources[i].ReleaseAndGetAddressOf());
-
-            if (m_modelUpsamplePersistentResources[i].Get() != nullptr)
-                m_dmlUpsampleBindings[i]->BindPersistentResource(&upsamplePersistentBindings[i]);
-        }
+        m_dmlCommandRecorder->RecordDispatch(commandList, m_dmlOpInitializer.Get(), initBindingTable.Get());
     }
 
-    // Convolution layers
+    // Bind resources for execution. The graph assigns the buffer each tensor is read from and written to; the
+    // model input and output have their own, and intermediate results are placed in the arena.
+    for (UINT i = 0; i < opCount; i++)
     {
-        // Bind resources for initialization
-        auto bindingProps = m_dmlOpInitializers[e_opConv]->GetBindingProperties();
-        assert(bindingProps.PersistentResourceSize == 0);
+        const SuperResolutionModel::OpDesc& opDesc = ops[i];
+        ModelOperation& op = m_modelOps[i];
+
+        auto bindingProps = op.compiledOp->GetBindingProperties();
 
         DML_BINDING_TABLE_DESC tableDesc = {
-            m_dmlOpInitializers[e_opConv].Get(),
-            m_dmlDescriptorHeap->GetCpuHandle(convDescriptorsIdx),
-            m_dmlDescriptorHeap->GetGpuHandle(convDescriptorsIdx),
+            op.compiledOp.Get(),
+            m_dmlDescriptorHeap->GetCpuHandle(i * opDescriptorCount),
+            m_dmlDescriptorHeap->GetGpuHandle(i * opDescriptorCount),
             bindingProps.RequiredDescriptorCount
         };
-        DX::ThrowIfFailed(initBindingTable->Reset(&tableDesc));
+        DX::ThrowIfFailed(m_dmlDevice->CreateBindingTable(&tableDesc, IID_PPV_ARGS(op.binding.ReleaseAndGetAddressOf())));
 
-#if DML_MANAGED_WEIGHTS
-        // Bind the weight tensors at initialization instead of at execution. This lets DirectML reformat them
-        // and improve performance on some hardware.
-        DML_BUFFER_BINDING convBufferBindings[][3] = {
-            { emptyBufferBinding, { m_modelConvFilterWeights[0].Get(), 0, m_modelConvFilterWeights[0]->GetDesc().Width }, { m_modelConvBiasWeights[0].Get(), 0, m_modelConvBiasWeights[0]->GetDesc().Width } },
-            { emptyBufferBinding, { m_modelConvFilterWeights[1].Get(), 0, m_modelConvFilterWeights[1]->GetDesc().Width }, { m_modelConvBiasWeights[1].Get(), 0, m_modelConvBiasWeights[1]->GetDesc().Width } },
-            { emptyBufferBinding, { m_modelConvFilterWeights[2].Get(), 0, m_modelConvFilterWeights[2]->GetDesc().Width }, { m_modelConvBiasWeights[2].Get(), 0, m_modelConvBiasWeights[2]->GetDesc().Width } },
-            { emptyBufferBinding, { m_modelConvFilterWeights[3].Get(), 0, m_modelConvFilterWeights[3]->GetDesc().Width }, { m_modelConvBiasWeights[3].Get(), 0, m_modelConvBiasWeights[3]->GetDesc().Width } },
-            { emptyBufferBinding, { m_modelConvFilterWeights[4].Get(), 0, m_modelConvFilterWeights[4]->GetDesc().Width }, { m_modelConvBiasWeights[4].Get(), 0, m_modelConvBiasWeights[4]->GetDesc().Width } },
-            { emptyBufferBinding, { m_modelConvFilterWeights[5].Get(), 0, m_modelConvFilterWeights[5]->GetDesc().Width }, { m_modelConvBiasWeights[5].Get(), 0, m_modelConvBiasWeights[5]->GetDesc().Width } },
-            { emptyBufferBinding, { m_modelConvFilterWeights[6].Get(), 0, m_modelConvFilterWeights[6]->GetDesc().Width }, emptyBufferBinding }	// last layer has no bias
-        };
-
-        DML_BUFFER_ARRAY_BINDING convBufferArrayBindings[] = {
-            { 3, convBufferBindings[0] },
-            { 3, convBufferBindings[1] },
-            { 3, convBufferBindings[2] },
-            { 3, convBufferBindings[3] },
-            { 3, convBufferBindings[4] },
-            { 3, convBufferBindings[5] },
-            { 3, convBufferBindings[6] },
-        };
-
-        DML_BINDING_DESC convInBindings[] = {
-            { DML_BINDING_TYPE_BUFFER_ARRAY, &convBufferArrayBindings[0] },
-            { DML_BINDING_TYPE_BUFFER_ARRAY, &convBufferArrayBindings[1] },
-            { DML_BINDING_TYPE_BUFFER_ARRAY, &convBufferArrayBindings[2] },
-            { DML_BINDING_TYPE_BUFFER_ARRAY, &convBufferArrayBindings[3] },
-            { DML_BINDING_TYPE_BUFFER_ARRAY, &convBufferArrayBindings[4] },
-            { DML_BINDING_TYPE_BUFFER_ARRAY, &convBufferArrayBindings[5] },
-            { DML_BINDING_TYPE_BUFFER_ARRAY, &convBufferArrayBindings[6] }
-        };
+        // Up to three inputs: a convolution takes its input, filter and bias.
+        DML_BUFFER_BINDING inputBuffers[3] = { emptyBufferBinding, emptyBufferBinding, emptyBufferBinding };
+        DML_BINDING_DESC inputBindings[3] = { emptyBindingDesc, emptyBindingDesc, emptyBindingDesc };
+        UINT inputCount = SuperResolutionModel::GetInputCount(opDesc);
 
-        initBindingTable->BindInputs(c_numConvLayers, convInBindings);
-#else
-        initBindingTable->BindInputs(0, nullptr);
-#endif
-
-        // If the operator requires a persistent resource, it must be bound as output for the initializer.
-        DML_BUFFER_BINDING convPersistentBuffers[c_numConvLayers];
-        DML_BINDING_DESC convPersistentBindings[c_numConvLayers];
-        for (int i = 0; i < c_numConvLayers; i++)
+        for (UINT k = 0; k < inputCount; k++)
         {
-            if (m_modelConvPersistentResources[i].Get() != nullptr)
-            {
-                convPersistentBuffers[i] = { m_modelConvPersistentResources[i].Get(), 0, m_modelConvPersistentResources[i]->GetDesc().Width };
-                convPersistentBindings[i] = { DML_BINDING_TYPE_BUFFER, &convPersistentBuffers[i] };
-            }
-            else
-                convPersistentBindings[i] = emptyBindingDesc;
+            inputBuffers[k] = GetModelTensorBinding(opDesc.inputs[k]);
+            inputBindings[k] = { DML_BINDING_TYPE_BUFFER, &inputBuffers[k] };
         }
 
-        initBindingTable->BindOutputs(c_numConvLayers, convPersistentBindings);
-        BindTempResourceIfNeeded(bindingProps, initBindingTable.Get(), m_modelInitTemporaryResources[e_opConv].ReleaseAndGetAddressOf());
-
-        // Run initialization
-        m_dmlCommandRecorder->RecordDispatch(commandList, m_dmlOpInitializers[e_opConv].Get(), initBindingTable.Get());
-
-        // Bind resources for execution
-        for (int i = 0; i < c_numConvLayers; i++)
+        if (opDesc.type == SuperResolutionModel::OpType::Convolution)
         {
-            bindingProps = m_dmlConvOps[i]->GetBindingProperties();
-
-            tableDesc = {
-                m_dmlConvOps[i].Get(),
-                m_dmlDescriptorHeap->GetCpuHandle(convDescriptorsIdx + i * convOpDescriptorCount),
-                m_dmlDescriptorHeap->GetGpuHandle(convDescriptorsIdx + i * convOpDescriptorCount),
-                bindingProps.RequiredDescriptorCount
-            };
-            DX::ThrowIfFailed(m_dmlDevice->CreateBindingTable(&tableDesc, IID_PPV_ARGS(m_dmlConvBindings[i].ReleaseAndGetAddressOf())));
-
-            // See table at the beginning of the function for the mapping of ops to resources.
-            auto inputResource = (i == 0) ? m_modelInput : ((i == 1 || i == 4 || i == 6) ? m_modelIntermediateResult[0] : m_modelIntermediateResult[1]);
-            auto outputResource = (i == 1 || i == 4 || i == 6) ? m_modelIntermediateResult[1] : m_modelIntermediateResult[0];
-
-            DML_BUFFER_BINDING inputBufferBinding = { inputResource.Get(), 0, inputResource->GetDesc().Width };
-            DML_BINDING_DESC inputBinding = { DML_BINDING_TYPE_BUFFER, &inputBufferBinding };
-
-            DML_BUFFER_BINDING outputBufferBinding = { outputResource.Get(), 0, outputResource->GetDesc().Width };
-            DML_BINDING_DESC outputBinding = { DML_BINDING_TYPE_BUFFER, &outputBufferBinding };
-
-#if DML_MANAGED_WEIGHTS
-            // The weights are stored in the persistent resource and shouldn't be bound separately.
-            DML_BINDING_DESC inputBindings[] = { inputBinding, emptyBindingDesc, emptyBindingDesc };
-#else
-            // Bind the weight resources
-            DML_BUFFER_BINDING filterBufferBinding = { m_modelConvFilterWeights[i].Get(), 0, m_modelConvFilterWeights[i]->GetDesc().Width };
-            DML_BINDING_DESC filterBinding = { DML_BINDING_TYPE_BUFFER, &filterBufferBinding };
-
-            DML_BUFFER_BINDING biasBufferBinding;
-            DML_BINDING_DESC biasBinding;
-            if (i == 6)
+            inputCount = 3;
+#if !DML_MANAGED_WEIGHTS
+            // Bind the weight resources. With DML_MANAGED_WEIGHTS, they are stored in the persistent resource
+            // instead and shouldn't be bound separately. Layers without batch normalization have no bias.
+            inputBuffers[1] = { op.filterWeights.Get(), 0, op.filterWeights->GetDesc().Width };
+            inputBindings[1] = { DML_BINDING_TYPE_BUFFER, &inputBuffers[1] };
+
+            if (op.biasWeights.Get() != nullptr)
             {
-                biasBinding = emptyBindingDesc;	// last layer has no bias
+                inputBuffers[2] = { op.biasWeights.Get(), 0, op.biasWeights->GetDesc().Width };
+                inputBindings[2] = { DML_BINDING_TYPE_BUFFER, &inputBuffers[2] };
             }
-            else
-            {
-                biasBufferBinding = { m_modelConvBiasWeights[i].Get(), 0, m_modelConvBiasWeights[i]->GetDesc().Width };
-                biasBinding = { DML_BINDING_TYPE_BUFFER, &biasBufferBinding };
-            }
-
-            DML_BINDING_DESC inputBindings[] = { inputBinding, filterBinding, biasBinding };
 #endif
-            m_dmlConvBindings[i]->BindInputs(3, inputBindings);
-            m_dmlConvBindings[i]->BindOutputs(1, &outputBinding);
-            BindTempResourceIfNeeded(bindingProps, m_dmlConvBindings[i].Get(), m_modelConvTemporaryResources[i].ReleaseAndGetAddressOf());
-
-            if (m_modelConvPersistentResources[i].Get() != nullptr)
-                m_dmlConvBindings[i]->BindPersistentResource(&convPersistentBindings[i]);
         }
-    }
 
-    // Addition layer
-    {
-        // Bind resources for initialization.
-        auto bindingProps = m_dmlOpInitializers[e_opAdd]->GetBindingProperties();
-        assert(bindingProps.PersistentResourceSize == 0);
+        // An add may write its result over one of its inputs, e.g. adding the nearest-neighbor upscale of the
+        // input and the residual image, one of which is already in m_modelOutput.
+        DML_BUFFER_BINDING outputBufferBinding = GetModelTensorBinding(opDesc.output);
+        DML_BINDING_DESC outputBinding = { DML_BINDING_TYPE_BUFFER, &outputBufferBinding };
 
-        DML_BINDING_TABLE_DESC tableDesc = {
-            m_dmlOpInitializers[e_opAdd].Get(),
-            m_dmlDescriptorHeap->GetCpuHandle(additionDescriptorsIdx),
-            m_dmlDescriptorHeap->GetGpuHandle(additionDescriptorsIdx),
-            bindingProps.RequiredDescriptorCount
-        };
-        DX::ThrowIfFailed(initBindingTable->Reset(&tableDesc));
-                
-        // If the operator requires a persistent resource, it must be bound as output for the initializer.
-        DML_BUFFER_BINDING addPersistentBuffer;
-        DML_BINDING_DESC addPersistentBinding;
-        if (m_modelAddPersistentResource.Get() != nullptr)
-        {
-            addPersistentBuffer = { m_modelAddPersistentResource.Get(), 0, m_modelAddPersistentResource->GetDesc().Width };
-            addPersistentBinding = { DML_BINDING_TYPE_BUFFER, &addPersistentBuffer };
-        }
-        else
-            addPersistentBinding = emptyBindingDesc;
+        op.binding->BindInputs(inputCount, inputBindings);
+        op.binding->BindOutputs(1, &outputBinding);
+        BindArenaTemporary(op.binding.Get(), m_modelArenaLayout.temporaryOffsets[i], bindingProps.TemporaryResourceSize);
 
-        initBindingTable->BindInputs(0, nullptr);
-        initBindingTable->BindOutputs(1, &addPersistentBinding);
-        BindTempResourceIfNeeded(bindingProps, initBindingTable.Get(), m_modelInitTemporaryResources[e_opAdd].ReleaseAndGetAddressOf());
-
-        // Run initialization
-        m_dmlCommandRecorder->RecordDispatch(commandList, m_dmlOpInitializers[e_opAdd].Get(), initBindingTable.Get());
-
-        // Bind resources for execution
-        {
-            bindingProps = m_dmlAddResidualOp->GetBindingProperties();
-
-            tableDesc = {
-                m_dmlAddResidualOp.Get(),
-                m_dmlDescriptorHeap->GetCpuHandle(additionDescriptorsIdx),
-                m_dmlDescriptorHeap->GetGpuHandle(additionDescriptorsIdx),
-                bindingProps.RequiredDescriptorCount
-            };
-            DX::ThrowIfFailed(m_dmlDevice->CreateBindingTable(&tableDesc, IID_PPV_ARGS(m_dmlAddResidualBinding.ReleaseAndGetAddressOf())));
-
-            // m_modelOutput will already hold the result of the first upsample operation. We add the result of
-            // the last convolution (the residual) to it in-place to get the final result.
-            DML_BUFFER_BINDING input0BufferBinding = { m_modelIntermediateResult[1].Get(), 0, m_modelIntermediateResult[1]->GetDesc().Width };
-            DML_BINDING_DESC input0Binding = { DML_BINDING_TYPE_BUFFER, &input0BufferBinding };
-            DML_BUFFER_BINDING input1BufferBinding = { m_modelOutput.Get(), 0, m_modelOutput->GetDesc().Width };
-            DML_BINDING_DESC input1Binding = { DML_BINDING_TYPE_BUFFER, &input1BufferBinding };
-            DML_BUFFER_BINDING outputBufferBinding = { m_modelOutput.Get(), 0, m_modelOutput->GetDesc().Width };
-            DML_BINDING_DESC outputBinding = { DML_BINDING_TYPE_BUFFER, &outputBufferBinding };
-
-            DML_BINDING_DESC inputBindings[] = { input0Binding, input1Binding };
-            m_dmlAddResidualBinding->BindInputs(2, inputBindings);
-            m_dmlAddResidualBinding->BindOutputs(1, &outputBinding);
-            BindTempResourceIfNeeded(bindingProps, m_dmlAddResidualBinding.Get(), m_modelAddTemporaryResource.ReleaseAndGetAddressOf());
-
-            if (m_modelAddPersistentResource.Get() != nullptr)
-                m_dmlAddResidualBinding->BindPersistentResource(&addPersistentBinding);
-        }
+        if (op.persistentResource.Get() != nullptr)
+            op.binding->BindPersistentResource(&persistentBindings[i]);
     }
 
     DX::ThrowIfFailed(commandList->Close());
@@ -2131,33 +2442,21 @@ void Sample::InitializeDirectMLResources()
 
 #if DML_MANAGED_WEIGHTS
     // These have been copied to DML-managed resources and are no longer needed.
-    for (int i = 0; i < c_numConvLayers; i++)
+    for (ModelOperation& op : m_modelOps)
     {
-        m_modelConvFilterWeights[i].Reset();
-        if (i < c_numConvLayers - 1)    // Last layer has no bias
-        {
-            m_modelConvBiasWeights[i].Reset();
-        }
+        op.filterWeights.Reset();
+        op.biasWeights.Reset();
     }
 #endif
 }
 
-void Sample::BindTempResourceIfNeeded(DML_BINDING_PROPERTIES& bindingProps, IDMLBindingTable* initBindingTable, ID3D12Resource** tempResource)
+void Sample::BindArenaTemporary(IDMLBindingTable* bindingTable, uint64_t offset, uint64_t size)
 {
-    if (bindingProps.TemporaryResourceSize > 0)
+    if (size > 0)
     {
-        D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(bindingProps.TemporaryResourceSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-        DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-            D3D12_HEAP_FLAG_NONE,
-            &resourceDesc,
-            D3D12_RESOURCE_STATE_COMMON,
-            nullptr,
-            IID_PPV_ARGS(tempResource)));
-
-        DML_BUFFER_BINDING tempBuffer = { *tempResource, 0, (*tempResource)->GetDesc().Width };
+        DML_BUFFER_BINDING tempBuffer = { m_modelArena.Get(), offset, size };
         DML_BINDING_DESC tempBinding = { DML_BINDING_TYPE_BUFFER, &tempBuffer };
-        initBindingTable->BindTemporaryResource(&tempBinding);
+        bindingTable->BindTemporaryResource(&tempBinding);
     }
 }
 
@@ -2251,41 +2550,18 @@ void Sample::OnDeviceLost()
     m_computePSO.Reset();
     m_computeRootSignature.Reset();
 
+    m_frameTimestampHeap.Reset();
+    m_frameTimestampReadback.Reset();
+
     m_dmlDevice.Reset();
     m_dmlCommandRecorder.Reset();
 
     m_modelInput.Reset();
     m_modelOutput.Reset();
-    for (int i = 0; i < c_numIntermediateBuffers; i++)
-    {
-        m_modelIntermediateResult[i].Reset();
-    }
-    
-    for (int i = 0; i < e_opCount; i++)
-    {
-        m_dmlOpInitializers[i].Reset();
-        m_modelInitTemporaryResources[i].Reset();
-    }
-    for (int i = 0; i < c_numUpsampleLayers; i++)
-    {
-        m_dmlUpsampleOps[i].Reset();
-        m_modelUpsamplePersistentResources[i].Reset();
-        m_modelUpsampleTemporaryResources[i].Reset();
-        m_dmlUpsampleBindings[i].Reset();
-    }
-    for (int i = 0; i < c_numConvLayers; i++)
-    {
-        m_modelConvFilterWeights[i].Reset();
-        m_modelConvBiasWeights[i].Reset();
-        m_modelConvPersistentResources[i].Reset();
-        m_modelConvTemporaryResources[i].Reset();
-        m_dmlConvOps[i].Reset();
-        m_dmlConvBindings[i].Reset();
-    }
-    m_dmlAddResidualOp.Reset();
-    m_modelAddPersistentResource.Reset();
-    m_modelAddTemporaryResource.Reset();
-    m_dmlAddResidualBinding.Reset();
+    m_modelArena.Reset();
+
+    m_dmlOpInitializer.Reset();
+    m_modelOps.clear();
 
     m_dmlDescriptorHeap.reset();
 
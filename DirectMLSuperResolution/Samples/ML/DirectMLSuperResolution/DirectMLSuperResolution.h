@@ -10,8 +10,11 @@
 
 #include "DeviceResources.h"
 #include "StepTimer.h"
-#include "LoadWeights.h"
+#include "FrameStatistics.h"
+#include "ModelContainer.h"
 #include "MediaEnginePlayer.h"
+#include "MemoryPlanner.h"
+#include "SuperResolutionModel.h"
 
 class SmoothedFPS
 {
@@ -95,47 +98,56 @@ private:
 
     void Clear();
 
+    void RecordFrameTimestamp(uint32_t timestamp);
+    void ReadFrameTimestamps();
+
     void CreateDeviceDependentResources();
     void CreateTextureResources();
     void CreateDirectMLResources();
     void InitializeDirectMLResources();
     void CreateUIResources();
 
+    // Picks the faster tensor layout for the convolutions of the model on this device, from the layout cache or by
+    // measuring them with MeasureConvolutionLayer(), which returns milliseconds per dispatch.
+    TensorLayout SelectTensorLayout();
+    double MeasureConvolutionLayer(
+        TensorLayout layout,
+        _In_reads_(4) const uint32_t* inputSizes,
+        _In_reads_(4) const uint32_t* filterSizes,
+        bool useBiasAndActivation);
+
     void CreateUpsampleLayer(
         _In_reads_(4) const uint32_t* inputSizes,
-        _Inout_updates_(1) uint64_t* inputBufferRequiredSize,
-        _Inout_updates_(1) uint64_t* outputBufferRequiredSize,
+        uint32_t scaleFactor,
         _Out_writes_(4) uint32_t* outputSizesOut,
         _Out_writes_(1) IDMLCompiledOperator** compiledOpOut);
     void CreateConvolutionLayer(
         _In_reads_(4) const uint32_t* inputSizes,
         _In_reads_(4) const uint32_t* filterSizes,
         bool useBiasAndActivation,
-        _Inout_updates_(1) uint64_t* inputBufferRequiredSize,
-        _Inout_updates_(1) uint64_t* outputBufferRequiredSize,
         _Out_writes_(4) uint32_t* outputSizesOut,
         _Out_writes_(1) IDMLCompiledOperator** compiledOpOut);
     void CreateAdditionLayer(
         _In_reads_(4) const uint32_t* inputSizes,
+        uint32_t addendUpsampleFactor,
         _Out_writes_(1) IDMLCompiledOperator** compiledOpOut);
 
     void CreateWeightTensors(
-        WeightMapType& weights,
-        const char* convLayerName,
-        const char* scaleLayerName,
-        const char* shiftLayerName,
-        _In_reads_(4) const uint32_t* filterSizes,
+        const ModelContainer::Reader& container,
+        const SuperResolutionModel::ConvLayerDesc& layer,
         DirectX::ResourceUploadBatch& uploadBatch,
         _Out_writes_(1) ID3D12Resource** filterWeightResourceOut,
         _Out_writes_opt_(1) ID3D12Resource** biasWeightResourceOut);
     void CreateWeightResource(
         _In_reads_(4) const uint32_t* tensorSizes,
         _Out_writes_(1) ID3D12Resource** d3dResourceOut);
+    void GetModelTensorSizes(uint32_t tensorIndex, _Out_writes_(4) uint32_t* sizesOut) const;
+    DML_BUFFER_BINDING GetModelTensorBinding(uint32_t tensorIndex) const;
     
-    void BindTempResourceIfNeeded(
-        DML_BINDING_PROPERTIES& bindingProps,
-        _In_reads_(1) IDMLBindingTable* initBindingTable,
-        _Out_writes_opt_(1) ID3D12Resource** tempResource);
+    void BindArenaTemporary(
+        _In_reads_(1) IDMLBindingTable* bindingTable,
+        uint64_t offset,
+        uint64_t size);
     
     void CreateWindowSizeDependentResources();
 
@@ -159,6 +171,31 @@ private:
     
     // UI
     SmoothedFPS                                     m_fps;
+
+    // Distributions of the frame time and of the GPU time of each stage (see FrameStatistics.h). GPU timestamps are
+    // read back when the command list of their back buffer is reused, so the stages are recorded a few frames late.
+    enum FrameStatistic : uint32_t
+    {
+        e_statFrame,
+        e_statConvert,
+        e_statInference,
+        e_statPresent,          // Rendering the result to the back buffer
+    };
+
+    enum FrameTimestamp : uint32_t
+    {
+        e_timestampStart,
+        e_timestampConverted,
+        e_timestampInferred,
+        e_timestampRendered,
+        e_timestampCount
+    };
+
+    FrameStatistics                                 m_frameStatistics;
+    Microsoft::WRL::ComPtr<ID3D12QueryHeap>         m_frameTimestampHeap;           // e_timestampCount per back buffer
+    Microsoft::WRL::ComPtr<ID3D12Resource>          m_frameTimestampReadback;
+    std::vector<uint32_t>                           m_frameTimestampMasks;          // Per back buffer, bits of the timestamps recorded
+    double                                          m_gpuTimestampPeriod;           // Seconds per tick
     std::unique_ptr<DirectX::BasicEffect>           m_lineEffect;
     std::unique_ptr<DirectX::PrimitiveBatch<DirectX::VertexPositionColor>> m_lineBatch;
     std::unique_ptr<DirectX::DescriptorHeap>        m_fontDescriptorHeap;
@@ -203,49 +240,42 @@ private:
 
     TensorLayout                                    m_tensorLayout;
 
-    // Model layer sizes and indices
-    static const size_t                             c_numUpsampleLayers = 2;
-    static const size_t                             c_numConvLayers = 7;
-    static const size_t                             c_numIntermediateBuffers = 2;
-    
-    enum OpTypes : uint32_t
-    {
-        e_opUpsample,
-        e_opConv,
-        e_opAdd,
-        e_opCount
-    };
+    // Model layers, and the buffers they use, from Assets\model.txt
+    SuperResolutionModel::Graph                     m_modelGraph;
+
+    // Number of frames in each dispatch of the model. With more than one, consecutive frames are gathered
+    // into a batch, and each is displayed once its batch has been upscaled.
+    static const uint32_t                           c_modelBatchSize = 1;
+    uint32_t                                        m_batchFrameIndex;
 
     // Resources for DirectML
     std::unique_ptr<DirectX::DescriptorHeap>        m_dmlDescriptorHeap;
     
     Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelInput;
     Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelOutput;
-    Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelIntermediateResult[c_numIntermediateBuffers];
 
-    Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelConvFilterWeights[c_numConvLayers];
-    Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelConvBiasWeights[c_numConvLayers];
-    
-    Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelUpsamplePersistentResources[c_numUpsampleLayers];
-    Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelConvPersistentResources[c_numConvLayers];
-    Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelAddPersistentResource;
-
-    Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelInitTemporaryResources[e_opCount];
-    Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelUpsampleTemporaryResources[c_numUpsampleLayers];
-    Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelConvTemporaryResources[c_numConvLayers];
-    Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelAddTemporaryResource;
-
-    // DirectML operations
-    Microsoft::WRL::ComPtr<IDMLCompiledOperator>    m_dmlUpsampleOps[c_numUpsampleLayers];
-    Microsoft::WRL::ComPtr<IDMLBindingTable>        m_dmlUpsampleBindings[c_numUpsampleLayers];
-    Microsoft::WRL::ComPtr<IDMLCompiledOperator>    m_dmlConvOps[c_numConvLayers];
-    Microsoft::WRL::ComPtr<IDMLBindingTable>        m_dmlConvBindings[c_numConvLayers];
-    Microsoft::WRL::ComPtr<IDMLCompiledOperator>    m_dmlAddResidualOp;
-    Microsoft::WRL::ComPtr<IDMLBindingTable>        m_dmlAddResidualBinding;
-    Microsoft::WRL::ComPtr<IDMLOperatorInitializer> m_dmlOpInitializers[e_opCount];
+    // Intermediate buffers of the graph and the temporary resources of the operators, packed into one resource.
+    // Initialization runs before any of them are live, so its temporary resource is at the start of the arena.
+    Microsoft::WRL::ComPtr<ID3D12Resource>          m_modelArena;
+    MemoryPlanner::ArenaLayout                      m_modelArenaLayout;
+
+    // DirectML operations, one per op of the graph, in dispatch order
+    struct ModelOperation
+    {
+        Microsoft::WRL::ComPtr<IDMLCompiledOperator>    compiledOp;
+        Microsoft::WRL::ComPtr<IDMLBindingTable>        binding;
+        Microsoft::WRL::ComPtr<ID3D12Resource>          persistentResource;
+        Microsoft::WRL::ComPtr<ID3D12Resource>          filterWeights;          // Convolutions only
+        Microsoft::WRL::ComPtr<ID3D12Resource>          biasWeights;            // Convolutions with batch normalization only
+        const char*                                     traceName;              // Output tensor's, interned
+    };
+
+    std::vector<ModelOperation>                     m_modelOps;
+    Microsoft::WRL::ComPtr<IDMLOperatorInitializer> m_dmlOpInitializer;
 
     // Application state
     bool                                            m_useDml;
+    bool                                            m_modelInputChanged;    // Since the model last ran, see REUSE_UNCHANGED_FRAMES
     bool                                            m_showPip;
     float                                           m_zoomX;
     float                                           m_zoomY;
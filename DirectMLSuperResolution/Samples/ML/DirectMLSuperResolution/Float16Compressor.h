@@ -3,6 +3,28 @@
 // Float32 to float16 compressor
 // Code from here: https://stackoverflow.com/a/3542975
 // Used under the Unlicense: http://choosealicense.com/licenses/unlicense/
+//
+// The bulk compress/decompress overloads convert whole arrays with the widest conversion instructions
+// enabled at compile time (AVX-512, F16C or NEON). They round to nearest even, like the hardware, and
+// their scalar fallback produces bit-identical results.
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define FLOAT16_AVX512 1
+#endif
+// MSVC has no __F16C__, and every AVX2 processor has F16C. GCC and Clang only enable it with -mf16c, which
+// -march does where the processor has it, but -mavx2 doesn't.
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#include <immintrin.h>
+#define FLOAT16_F16C 1
+#endif
+#if (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define FLOAT16_NEON 1
+#endif
 
 class Float16Compressor
 {
@@ -74,4 +96,162 @@ public:
         v.si |= sign;
         return v.f;
     }
-};
\ No newline at end of file
+
+    // Same as compress, but rounds to nearest even and quiets NaNs like the hardware conversion instructions.
+    static uint16_t compressRoundToNearest(float value)
+    {
+        Bits v;
+        v.f = value;
+        uint32_t sign = (v.ui >> shiftSign) & signC;
+        v.ui &= ~static_cast<uint32_t>(signN);
+
+        if (v.si >= infN)
+        {
+            // Inf stays inf, NaN keeps the top of its payload and becomes quiet
+            return static_cast<uint16_t>(sign | 0x7C00 | ((v.si > infN) ? (0x200 | ((v.ui >> shift) & 0x3FF)) : 0));
+        }
+
+        if (v.si < minN)
+        {
+            // The result is subnormal. Adding 0.5 lines the float16 subnormal bits up with the bottom of the float32
+            // mantissa, and the FPU does the rounding.
+            Bits half;
+            half.ui = 0x3F000000;
+            v.f += half.f;
+            return static_cast<uint16_t>(sign | (v.ui - half.ui));
+        }
+
+        // Rebias the exponent and round the mantissa. A carry out of the mantissa correctly bumps the exponent,
+        // which also takes values of 65520 and up to infinity.
+        uint32_t mantissaOdd = (v.ui >> shift) & 1;
+        v.ui += (static_cast<uint32_t>(15 - 127) << 23) + 0xFFF + mantissaOdd;
+        if (v.ui >= (0x1Fu << 23))
+        {
+            v.ui = 0x1Fu << 23;
+        }
+        return static_cast<uint16_t>(sign | (v.ui >> shift));
+    }
+
+    // Portable bulk conversions
+    static void compressScalar(const float* src, uint16_t* dst, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            dst[i] = compressRoundToNearest(src[i]);
+        }
+    }
+
+    static void decompressScalar(const uint16_t* src, float* dst, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            // Signaling NaNs come out quiet, like the hardware conversion instructions
+            uint16_t value = src[i];
+            if ((value & 0x7C00) == 0x7C00 && (value & 0x3FF))
+            {
+                value |= 0x200;
+            }
+            dst[i] = decompress(value);
+        }
+    }
+
+#if FLOAT16_AVX512
+    static void compressAvx512(const float* src, uint16_t* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m256i h = _mm512_cvtps_ph(_mm512_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), h);
+        }
+        compressScalar(src + i, dst + i, count - i);
+    }
+
+    static void decompressAvx512(const uint16_t* src, float* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            _mm512_storeu_ps(dst + i, _mm512_cvtph_ps(h));
+        }
+        decompressScalar(src + i, dst + i, count - i);
+    }
+#endif
+
+#if FLOAT16_F16C
+    static void compressF16C(const float* src, uint16_t* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+        }
+        compressScalar(src + i, dst + i, count - i);
+    }
+
+    static void decompressF16C(const uint16_t* src, float* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+        }
+        decompressScalar(src + i, dst + i, count - i);
+    }
+#endif
+
+#if FLOAT16_NEON
+    static void compressNeon(const float* src, uint16_t* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            float16x8_t h = vcvt_high_f16_f32(vcvt_f16_f32(vld1q_f32(src + i)), vld1q_f32(src + i + 4));
+            vst1q_u16(dst + i, vreinterpretq_u16_f16(h));
+        }
+        compressScalar(src + i, dst + i, count - i);
+    }
+
+    static void decompressNeon(const uint16_t* src, float* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            float16x8_t h = vreinterpretq_f16_u16(vld1q_u16(src + i));
+            vst1q_f32(dst + i, vcvt_f32_f16(vget_low_f16(h)));
+            vst1q_f32(dst + i + 4, vcvt_high_f32_f16(h));
+        }
+        decompressScalar(src + i, dst + i, count - i);
+    }
+#endif
+
+    // Bulk conversions using the widest path available
+    static void compress(const float* src, uint16_t* dst, size_t count)
+    {
+#if FLOAT16_AVX512
+        compressAvx512(src, dst, count);
+#elif FLOAT16_F16C
+        compressF16C(src, dst, count);
+#elif FLOAT16_NEON
+        compressNeon(src, dst, count);
+#else
+        compressScalar(src, dst, count);
+#endif
+    }
+
+    static void decompress(const uint16_t* src, float* dst, size_t count)
+    {
+#if FLOAT16_AVX512
+        decompressAvx512(src, dst, count);
+#elif FLOAT16_F16C
+        decompressF16C(src, dst, count);
+#elif FLOAT16_NEON
+        decompressNeon(src, dst, count);
+#else
+        decompressScalar(src, dst, count);
+#endif
+    }
+};
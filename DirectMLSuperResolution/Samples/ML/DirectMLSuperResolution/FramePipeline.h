@@ -0,0 +1,343 @@
+//--------------------------------------------------------------------------------------
+// FramePipeline.h
+//
+// Runs the stages of frame processing (decode, inference, encode) on separate threads.
+// Stages hand frames to each other through BoundedQueue, whose capacity bounds how far a
+// stage can run ahead of the next one, and so the number of frames in flight. StageTimes
+// accounts where each stage spends its time, so the summary can show which stage limits
+// the throughput, and FrameStatistics the distribution of each stage's time per frame.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "FrameStatistics.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace FramePipeline
+{
+    // Seconds a stage spent working, waiting for a frame from the previous stage, and waiting for room in the queue
+    // to the next stage. Their sum is the time the stage ran.
+    struct StageTimes
+    {
+        double busySeconds = 0.0;
+        double inputWaitSeconds = 0.0;
+        double outputWaitSeconds = 0.0;
+    };
+
+    // Measures the time from construction to destruction into one of the StageTimes
+    class ScopedStageTimer
+    {
+    public:
+        explicit ScopedStageTimer(double& seconds) :
+            m_seconds(seconds),
+            m_start(std::chrono::steady_clock::now())
+        {
+        }
+
+        ~ScopedStageTimer()
+        {
+            m_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+        }
+
+        ScopedStageTimer(const ScopedStageTimer&) = delete;
+        ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+    private:
+        double&                                 m_seconds;
+        std::chrono::steady_clock::time_point   m_start;
+    };
+
+    // Blocking first-in first-out queue of at most a fixed number of items. Closing the queue wakes every waiting
+    // thread: Push() then fails, and Pop() fails once the queued items are taken. A stage closes its output queue when
+    // it is done or fails, and its input queue when it fails, so the stages before it stop too.
+    template <typename T>
+    class BoundedQueue
+    {
+    public:
+        explicit BoundedQueue(size_t capacity) :
+            m_capacity(std::max<size_t>(capacity, 1))
+        {
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        // Waits while the queue is full, adding the time waited to waitSeconds
+        bool Push(T&& item, double& waitSeconds)
+        {
+            ScopedStageTimer timer(waitSeconds);
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+            if (m_closed)
+            {
+                return false;
+            }
+
+            m_items.push_back(std::move(item));
+            m_notEmpty.notify_one();
+            return true;
+        }
+
+        // Waits while the queue is empty, adding the time waited to waitSeconds
+        bool Pop(T& itemOut, double& waitSeconds)
+        {
+            ScopedStageTimer timer(waitSeconds);
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+            if (m_items.empty())
+            {
+                return false;
+            }
+
+            itemOut = std::move(m_items.front());
+            m_items.pop_front();
+            m_notFull.notify_one();
+            return true;
+        }
+
+        void Close()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+            m_notFull.notify_all();
+            m_notEmpty.notify_all();
+        }
+
+        size_t GetCapacity() const { return m_capacity; }
+
+    private:
+        const size_t                m_capacity;
+        std::deque<T>               m_items;
+        bool                        m_closed = false;
+        std::mutex                  m_mutex;
+        std::condition_variable     m_notFull;
+        std::condition_variable     m_notEmpty;
+    };
+
+    enum class DecodeResult
+    {
+        Frame,
+        End,
+        Failed,
+    };
+
+    // What Run() records into FrameStatistics for each frame: the time since the previous frame finished, the
+    // latency, and the time each stage spent working on it
+    enum class Statistic
+    {
+        Frame,
+        Latency,
+        Decode,
+        Inference,
+        Encode,
+    };
+
+    inline std::vector<std::string> GetStatisticNames()
+    {
+        return { "frame", "latency", "decode", "inference", "encode" };
+    }
+
+    // How often the tools export the statistics of a run
+    const double c_statisticsIntervalSeconds = 1.0;
+
+    struct Summary
+    {
+        size_t      frameCount = 0;
+        double      wallSeconds = 0.0;
+        double      totalLatencySeconds = 0.0;  // From the start of decoding each frame to the end of encoding it
+        double      maxLatencySeconds = 0.0;
+        StageTimes  decode;
+        StageTimes  inference;
+        StageTimes  encode;
+    };
+
+    // Runs decode(Frame&) -> DecodeResult on one thread until it returns End, infer(Frame&, Frame&) -> bool on the
+    // calling thread, which can then be thread 0 of a ThreadPool, and encode(const Frame&) -> bool on another thread,
+    // in the order the frames were decoded. infer may move buffers from the decoded frame to the result. At most
+    // decodeQueueDepth decoded frames wait for inference, and encodeQueueDepth results for encoding. Returns false
+    // as soon as a stage fails. If statistics are given, they get the Statistic of every frame, with
+    // GetStatisticNames() for stages, and are exported as they become due and at the end, at times in seconds since
+    // the start of Run().
+    template<typename Frame, typename Decode, typename Infer, typename Encode>
+    bool Run(size_t decodeQueueDepth, size_t encodeQueueDepth, const Decode& decode, const Infer& infer, const Encode& encode, Summary& summaryOut,
+        FrameStatistics* statistics = nullptr)
+    {
+        typedef std::chrono::steady_clock Clock;
+        struct Item
+        {
+            Frame               frame;
+            Clock::time_point   decodeStart;
+            double              decodeSeconds = 0.0;
+            double              inferenceSeconds = 0.0;
+        };
+
+        BoundedQueue<Item> decodedItems(decodeQueueDepth);
+        BoundedQueue<Item> inferredItems(encodeQueueDepth);
+        std::atomic<bool> failed(false);
+        summaryOut = Summary();
+
+        const Clock::time_point start = Clock::now();
+
+        Trace::SetThreadName("Inference");
+        std::thread decodeThread([&]
+        {
+            Trace::SetThreadName("Decode");
+            for (;;)
+            {
+                Item item;
+                DecodeResult result;
+                {
+                    ScopedStageTimer timer(item.decodeSeconds);
+                    Trace::Scope scope("Decode");
+                    item.decodeStart = Clock::now();
+                    result = decode(item.frame);
+                }
+                summaryOut.decode.busySeconds += item.decodeSeconds;
+
+                if (result == DecodeResult::Failed)
+                {
+                    failed = true;
+                }
+                if (result != DecodeResult::Frame || !decodedItems.Push(std::move(item), summaryOut.decode.outputWaitSeconds))
+                {
+                    break;
+                }
+            }
+            decodedItems.Close();
+        });
+
+        std::thread encodeThread([&]
+        {
+            Trace::SetThreadName("Encode");
+            Item item;
+            Clock::time_point previousEnd = start;
+            while (inferredItems.Pop(item, summaryOut.encode.inputWaitSeconds))
+            {
+                double encodeSeconds = 0.0;
+                {
+                    ScopedStageTimer timer(encodeSeconds);
+                    Trace::Scope scope("Encode");
+                    if (!encode(static_cast<const Frame&>(item.frame)))
+                    {
+                        failed = true;
+                        inferredItems.Close();
+                        decodedItems.Close();
+                        break;
+                    }
+                }
+
+                summaryOut.encode.busySeconds += encodeSeconds;
+
+                const Clock::time_point end = Clock::now();
+                const double latency = std::chrono::duration<double>(end - item.decodeStart).count();
+                summaryOut.totalLatencySeconds += latency;
+                summaryOut.maxLatencySeconds = std::max(summaryOut.maxLatencySeconds, latency);
+                summaryOut.frameCount++;
+
+                if (statistics)
+                {
+                    statistics->Record(size_t(Statistic::Frame), std::chrono::duration<double>(end - previousEnd).count());
+                    statistics->Record(size_t(Statistic::Latency), latency);
+                    statistics->Record(size_t(Statistic::Decode), item.decodeSeconds);
+                    statistics->Record(size_t(Statistic::Inference), item.inferenceSeconds);
+                    statistics->Record(size_t(Statistic::Encode), encodeSeconds);
+                    if (!statistics->ExportIfDue(std::chrono::duration<double>(end - start).count()))
+                    {
+                        failed = true;
+                    }
+                }
+                previousEnd = end;
+            }
+        });
+
+        Item input;
+        while (decodedItems.Pop(input, summaryOut.inference.inputWaitSeconds))
+        {
+            Item output;
+            output.decodeStart = input.decodeStart;
+            output.decodeSeconds = input.decodeSeconds;
+            {
+                ScopedStageTimer timer(output.inferenceSeconds);
+                Trace::Scope scope("Inference");
+                if (!infer(input.frame, output.frame))
+                {
+                    failed = true;
+                    break;
+                }
+            }
+            summaryOut.inference.busySeconds += output.inferenceSeconds;
+
+            if (!inferredItems.Push(std::move(output), summaryOut.inference.outputWaitSeconds))
+            {
+                break;
+            }
+        }
+
+        // Closing the input as well stops decoding if a later stage failed
+        inferredItems.Close();
+        decodedItems.Close();
+        decodeThread.join();
+        encodeThread.join();
+
+        summaryOut.wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (statistics && !statistics->Export(summaryOut.wallSeconds))
+        {
+            return false;
+        }
+        return !failed;
+    }
+
+    // Busy is the share of the wall time a stage spent working. The stage with the highest share limits the
+    // throughput, and the others spend the rest waiting for it.
+    inline void PrintSummary(std::ostream& out, const Summary& summary)
+    {
+        const double wallSeconds = summary.wallSeconds;
+        const double frameCount = double(summary.frameCount);
+        out << summary.frameCount << " frame(s) in " << wallSeconds << " s: " << frameCount / wallSeconds << " frames/s end to end, "
+            << "latency " << 1000.0 * summary.totalLatencySeconds / frameCount << " ms on average, "
+            << 1000.0 * summary.maxLatencySeconds << " ms at most" << std::endl;
+
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision(2);
+        out << std::fixed << "  stage         busy  waiting for input  waiting for output   busy time" << std::endl;
+
+        const struct { const char* name; const StageTimes& times; } stages[] =
+        {
+            { "decode", summary.decode },
+            { "inference", summary.inference },
+            { "encode", summary.encode },
+        };
+        for (const auto& stage : stages)
+        {
+            out << "  " << std::left << std::setw(10) << stage.name << std::right << std::setw(7)
+                << 100.0 * stage.times.busySeconds / wallSeconds << "%" << std::setw(18)
+                << 100.0 * stage.times.inputWaitSeconds / wallSeconds << "%" << std::setw(19)
+                << 100.0 * stage.times.outputWaitSeconds / wallSeconds << "%" << std::setw(10) << stage.times.busySeconds
+                << " s" << std::endl;
+        }
+
+        const double serialSeconds = summary.decode.busySeconds + summary.inference.busySeconds + summary.encode.busySeconds;
+        out << "Run one after the other, the stages would take " << serialSeconds << " s (" << frameCount / serialSeconds
+            << " frames/s)" << std::endl;
+
+        out.flags(flags);
+        out.precision(precision);
+    }
+}
@@ -0,0 +1,264 @@
+//--------------------------------------------------------------------------------------
+// FrameStatistics.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "FrameStatistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#include <intrin.h>
+#endif
+
+namespace
+{
+    // Index of the highest set bit of a nonzero value
+    uint32_t GetHighestBit(uint64_t value)
+    {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<uint32_t>(index);
+#elif defined(__GNUC__)
+        return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#else
+        uint32_t index = 0;
+        while (value >>= 1)
+        {
+            index++;
+        }
+        return index;
+#endif
+    }
+
+    const double c_millisecondsPerSecond = 1000.0;
+
+    void WriteJson(std::ostream& out, const TimeStatistics& statistics)
+    {
+        out << "{\"frames\": " << statistics.count
+            << ", \"mean\": " << c_millisecondsPerSecond * statistics.meanSeconds
+            << ", \"p50\": " << c_millisecondsPerSecond * statistics.p50Seconds
+            << ", \"p90\": " << c_millisecondsPerSecond * statistics.p90Seconds
+            << ", \"p99\": " << c_millisecondsPerSecond * statistics.p99Seconds
+            << ", \"p99.9\": " << c_millisecondsPerSecond * statistics.p999Seconds
+            << ", \"max\": " << c_millisecondsPerSecond * statistics.maxSeconds << "}";
+    }
+}
+
+const size_t TimeHistogram::c_bucketCount;
+
+TimeStatistics TimeHistogram::Counts::GetStatistics() const
+{
+    TimeStatistics statistics;
+    for (uint64_t count : buckets)
+    {
+        statistics.count += count;
+    }
+    if (statistics.count == 0)
+    {
+        return statistics;
+    }
+
+    statistics.meanSeconds = 1e-9 * double(totalNanoseconds) / double(statistics.count);
+    statistics.maxSeconds = 1e-9 * double(maxNanoseconds);
+
+    // The smallest time that at least the given share of the frames don't exceed
+    struct { double percentile; double* secondsOut; } percentiles[] =
+    {
+        { 50.0, &statistics.p50Seconds },
+        { 90.0, &statistics.p90Seconds },
+        { 99.0, &statistics.p99Seconds },
+        { 99.9, &statistics.p999Seconds },
+    };
+
+    size_t bucket = 0;
+    uint64_t countBelow = buckets[0];
+    for (const auto& percentile : percentiles)
+    {
+        const uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(percentile.percentile / 100.0 * double(statistics.count))), 1);
+        while (countBelow < rank)
+        {
+            countBelow += buckets[++bucket];
+        }
+
+        uint64_t lower, width;
+        GetBucketRange(bucket, lower, width);
+        *percentile.secondsOut = std::min(1e-9 * (double(lower) + 0.5 * double(width - 1)), statistics.maxSeconds);
+    }
+    return statistics;
+}
+
+TimeHistogram::TimeHistogram() :
+    m_buckets(new std::atomic<uint64_t>[c_bucketCount]()),
+    m_totalNanoseconds(0),
+    m_maxNanoseconds(0),
+    m_periodMaxNanoseconds(0)
+{
+}
+
+void TimeHistogram::GetCounts(Counts& countsOut) const
+{
+    countsOut.buckets.resize(c_bucketCount);
+    for (size_t i = 0; i < c_bucketCount; i++)
+    {
+        countsOut.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+    }
+    countsOut.totalNanoseconds = m_totalNanoseconds.load(std::memory_order_relaxed);
+    countsOut.maxNanoseconds = m_maxNanoseconds.load(std::memory_order_relaxed);
+}
+
+// Times below 2^(c_subBucketBits + 1) have a bucket each. Above, each power of two is split into 2^c_subBucketBits
+// buckets, so the width of a bucket is at most 1/2^c_subBucketBits of the times it holds.
+size_t TimeHistogram::GetBucket(uint64_t nanoseconds)
+{
+    const uint64_t c_subBucketCount = uint64_t(1) << c_subBucketBits;
+    if (nanoseconds < 2 * c_subBucketCount)
+    {
+        return static_cast<size_t>(nanoseconds);
+    }
+
+    const uint32_t shift = GetHighestBit(nanoseconds) - c_subBucketBits;
+    return static_cast<size_t>(shift * c_subBucketCount + (nanoseconds >> shift));
+}
+
+void TimeHistogram::GetBucketRange(size_t bucket, uint64_t& lowerOut, uint64_t& widthOut)
+{
+    const size_t c_subBucketCount = size_t(1) << c_subBucketBits;
+    if (bucket < 2 * c_subBucketCount)
+    {
+        lowerOut = bucket;
+        widthOut = 1;
+        return;
+    }
+
+    const uint32_t shift = static_cast<uint32_t>(bucket / c_subBucketCount - 1);
+    lowerOut = uint64_t(bucket - shift * c_subBucketCount) << shift;
+    widthOut = uint64_t(1) << shift;
+}
+
+uint64_t TimeHistogram::ToNanoseconds(double seconds)
+{
+    const uint64_t c_maxNanoseconds = (uint64_t(1) << c_rangeBits) - 1;
+    if (!(seconds > 0.0))
+    {
+        return 0;
+    }
+    const double nanoseconds = seconds * 1e9 + 0.5;
+    return (nanoseconds >= double(c_maxNanoseconds)) ? c_maxNanoseconds : static_cast<uint64_t>(nanoseconds);
+}
+
+FrameStatistics::FrameStatistics(const std::vector<std::string>& stageNames) :
+    m_stages(stageNames.size())
+{
+    for (size_t i = 0; i < stageNames.size(); i++)
+    {
+        m_stages[i].name = stageNames[i];
+    }
+}
+
+bool FrameStatistics::OpenExport(const std::string& path, double intervalSeconds, double timeSeconds)
+{
+    m_exportFile.open(path);
+    if (!m_exportFile)
+    {
+        std::cerr << "Unable to create statistics file: " << path << std::endl;
+        return false;
+    }
+
+    m_exportPath = path;
+    m_exportInterval = intervalSeconds;
+    m_lastExportTime = timeSeconds;
+    return true;
+}
+
+bool FrameStatistics::ExportIfDue(double timeSeconds)
+{
+    if (!m_exportFile.is_open() || timeSeconds - m_lastExportTime < m_exportInterval)
+    {
+        return true;
+    }
+    return Export(timeSeconds);
+}
+
+bool FrameStatistics::Export(double timeSeconds)
+{
+    if (!m_exportFile.is_open())
+    {
+        return true;
+    }
+    m_lastExportTime = timeSeconds;
+
+    // The period's counts are the difference of the counts since the start; only its max is kept apart
+    m_exportFile << "{\"time\": " << timeSeconds << ", \"stages\": {";
+    for (size_t i = 0; i < m_stages.size(); i++)
+    {
+        Stage& stage = m_stages[i];
+        stage.histogram.GetCounts(stage.newCounts);
+        stage.counts.buckets.resize(TimeHistogram::c_bucketCount);
+        stage.periodCounts.buckets.resize(TimeHistogram::c_bucketCount);
+        for (size_t j = 0; j < TimeHistogram::c_bucketCount; j++)
+        {
+            stage.periodCounts.buckets[j] = stage.newCounts.buckets[j] - stage.counts.buckets[j];
+        }
+        stage.periodCounts.totalNanoseconds = stage.newCounts.totalNanoseconds - stage.counts.totalNanoseconds;
+        stage.periodCounts.maxNanoseconds = stage.histogram.TakePeriodMaxNanoseconds();
+        std::swap(stage.counts, stage.newCounts);
+
+        m_exportFile << (i ? ", \"" : "\"") << stage.name << "\": {\"period\": ";
+        WriteJson(m_exportFile, stage.periodCounts.GetStatistics());
+        m_exportFile << ", \"total\": ";
+        WriteJson(m_exportFile, stage.counts.GetStatistics());
+        m_exportFile << "}";
+    }
+    m_exportFile << "}}" << std::endl;
+
+    if (!m_exportFile)
+    {
+        std::cerr << "Unable to write statistics file: " << m_exportPath << std::endl;
+        m_exportFile.close();
+        return false;
+    }
+    return true;
+}
+
+TimeStatistics FrameStatistics::GetStatistics(size_t stage) const
+{
+    TimeHistogram::Counts counts;
+    m_stages[stage].histogram.GetCounts(counts);
+    return counts.GetStatistics();
+}
+
+void FrameStatistics::PrintSummary(std::ostream& out) const
+{
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision(2);
+    out << std::fixed << "  " << std::left << std::setw(12) << "ms" << std::right << std::setw(8) << "frames";
+    const char* columns[] = { "mean", "p50", "p90", "p99", "p99.9", "max" };
+    for (const char* column : columns)
+    {
+        out << std::setw(9) << column;
+    }
+    out << std::endl;
+
+    for (size_t i = 0; i < m_stages.size(); i++)
+    {
+        const TimeStatistics statistics = GetStatistics(i);
+        out << "  " << std::left << std::setw(12) << m_stages[i].name << std::right << std::setw(8) << statistics.count;
+        const double values[] = { statistics.meanSeconds, statistics.p50Seconds, statistics.p90Seconds, statistics.p99Seconds, statistics.p999Seconds, statistics.maxSeconds };
+        for (double value : values)
+        {
+            out << std::setw(9) << c_millisecondsPerSecond * value;
+        }
+        out << std::endl;
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
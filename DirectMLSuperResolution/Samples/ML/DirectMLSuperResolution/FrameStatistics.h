@@ -0,0 +1,147 @@
+//--------------------------------------------------------------------------------------
+// FrameStatistics.h
+//
+// Distributions of frame time and of the time of each stage of a frame, so that stutter
+// shows, where an average frame rate hides it. TimeHistogram counts times in log-linear
+// buckets, as HDR histograms do: 128 linear buckets per power of two nanoseconds, so any
+// time from a nanosecond to 18 minutes is kept within 0.4%, in a fixed 34 KB. Recording
+// is a few relaxed atomic adds, without locks or allocations, and may be done from any
+// thread, such as the render loop or the stages of a pipeline.
+//
+// FrameStatistics holds one histogram per stage, and writes their percentiles to a file
+// as JSON, a line per export, for the frames of the period since the previous export and
+// for all of them.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Percentiles and max are in seconds. A percentile is the middle of the bucket it falls in, or the max if smaller.
+struct TimeStatistics
+{
+    uint64_t    count = 0;
+    double      meanSeconds = 0.0;
+    double      p50Seconds = 0.0;
+    double      p90Seconds = 0.0;
+    double      p99Seconds = 0.0;
+    double      p999Seconds = 0.0;
+    double      maxSeconds = 0.0;
+};
+
+class TimeHistogram
+{
+public:
+    // The counts of a histogram at one time, which can be subtracted to get those of a period
+    struct Counts
+    {
+        std::vector<uint64_t>   buckets;
+        uint64_t                totalNanoseconds = 0;
+        uint64_t                maxNanoseconds = 0;
+
+        TimeStatistics GetStatistics() const;
+    };
+
+    TimeHistogram();
+
+    TimeHistogram(const TimeHistogram&) = delete;
+    TimeHistogram& operator=(const TimeHistogram&) = delete;
+
+    // Negative times count as zero, and times past the range as its end
+    void Record(double seconds)
+    {
+        const uint64_t nanoseconds = ToNanoseconds(seconds);
+        m_buckets[GetBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        m_totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+        UpdateMax(m_maxNanoseconds, nanoseconds);
+        UpdateMax(m_periodMaxNanoseconds, nanoseconds);
+    }
+
+    // Copies the counts since construction into countsOut, whose buckets are only allocated the first time. While
+    // other threads record, the copy may have some of their latest times and not others.
+    void GetCounts(Counts& countsOut) const;
+
+    // The largest time recorded since the previous call, which the counts can't give
+    uint64_t TakePeriodMaxNanoseconds() { return m_periodMaxNanoseconds.exchange(0, std::memory_order_relaxed); }
+
+    static const uint32_t c_subBucketBits = 7;
+    static const uint32_t c_rangeBits = 40;
+    static const size_t c_bucketCount = (size_t(c_rangeBits - c_subBucketBits) + 1) << c_subBucketBits;
+
+    // Bucket of a time, and the range of times [lower, lower + width) it holds
+    static size_t GetBucket(uint64_t nanoseconds);
+    static void GetBucketRange(size_t bucket, uint64_t& lowerOut, uint64_t& widthOut);
+
+private:
+    static uint64_t ToNanoseconds(double seconds);
+
+    static void UpdateMax(std::atomic<uint64_t>& max, uint64_t value)
+    {
+        uint64_t current = max.load(std::memory_order_relaxed);
+        while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    std::unique_ptr<std::atomic<uint64_t>[]>    m_buckets;
+    std::atomic<uint64_t>                       m_totalNanoseconds;
+    std::atomic<uint64_t>                       m_maxNanoseconds;
+    std::atomic<uint64_t>                       m_periodMaxNanoseconds;
+};
+
+class FrameStatistics
+{
+public:
+    explicit FrameStatistics(const std::vector<std::string>& stageNames);
+
+    FrameStatistics(const FrameStatistics&) = delete;
+    FrameStatistics& operator=(const FrameStatistics&) = delete;
+
+    size_t GetStageCount() const { return m_stages.size(); }
+    const std::string& GetStageName(size_t stage) const { return m_stages[stage].name; }
+
+    // Thread safe, and doesn't allocate or lock
+    void Record(size_t stage, double seconds) { m_stages[stage].histogram.Record(seconds); }
+
+    // Starts writing the statistics to a file, which is replaced, every intervalSeconds from the time given.
+    // Reports errors to stderr.
+    bool OpenExport(const std::string& path, double intervalSeconds, double timeSeconds);
+
+    // Exports from one thread at a time, when the interval has passed since the previous export, or always with
+    // Export(). Each line is a JSON object with the time, and for each stage, the statistics of the period since
+    // the previous export and those of all the frames, in milliseconds. Returns false if the file can't be written.
+    bool ExportIfDue(double timeSeconds);
+    bool Export(double timeSeconds);
+
+    TimeStatistics GetStatistics(size_t stage) const;
+
+    // A table of the statistics of every frame, in milliseconds
+    void PrintSummary(std::ostream& out) const;
+
+private:
+    struct Stage
+    {
+        std::string             name;
+        TimeHistogram           histogram;
+        TimeHistogram::Counts   counts;         // At the previous export
+        TimeHistogram::Counts   newCounts;
+        TimeHistogram::Counts   periodCounts;
+    };
+
+    std::vector<Stage>  m_stages;
+    std::string         m_exportPath;
+    std::ofstream       m_exportFile;
+    double              m_exportInterval = 0.0;
+    double              m_lastExportTime = 0.0;
+};
@@ -0,0 +1,735 @@
+//--------------------------------------------------------------------------------------
+// ImageFile.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "ImageFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace
+{
+    const uint8_t c_pngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    // Stored deflate blocks hold at most this many bytes
+    const size_t c_maxStoredBlockSize = 65535;
+
+    // Reads the next whitespace-delimited header value, skipping comments.
+    bool ReadHeaderValue(std::istream& input, uint32_t& value)
+    {
+        for (;;)
+        {
+            int c = input.peek();
+            if (c == '#')
+            {
+                std::string comment;
+                std::getline(input, comment);
+            }
+            else if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            {
+                input.get();
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        input >> value;
+        return !input.fail();
+    }
+
+    // Standard CRC-32 (IEEE 802.3, reflected), as used by PNG chunks
+    struct Crc32Table
+    {
+        uint32_t values[256];
+
+        Crc32Table()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                {
+                    c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                }
+                values[i] = c;
+            }
+        }
+    };
+
+    uint32_t UpdateCrc32(uint32_t crc, const uint8_t* data, size_t size)
+    {
+        static const Crc32Table table;
+
+        crc ^= 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    uint32_t UpdateAdler32(uint32_t adler, const uint8_t* data, size_t size)
+    {
+        uint32_t a = adler & 0xFFFF;
+        uint32_t b = adler >> 16;
+        while (size > 0)
+        {
+            // The sums can't overflow 32 bits in this many steps
+            const size_t count = std::min<size_t>(size, 5552);
+            for (size_t i = 0; i < count; i++)
+            {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+            data += count;
+            size -= count;
+        }
+        return (b << 16) | a;
+    }
+
+    uint32_t ReadBigEndian32(const uint8_t* bytes)
+    {
+        return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | bytes[3];
+    }
+
+    void AppendBigEndian32(std::vector<uint8_t>& bytes, uint32_t value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            bytes.push_back(static_cast<uint8_t>(value >> shift));
+        }
+    }
+
+    // Canonical Huffman code, decoded one bit at a time: the codes of each length are consecutive, so a code is
+    // found by counting how many codes come before it.
+    struct HuffmanCode
+    {
+        uint16_t    counts[16];         // Number of codes of each length
+        uint16_t    symbols[320];       // Symbols ordered by code
+
+        bool Build(const uint8_t* lengths, uint32_t symbolCount)
+        {
+            memset(counts, 0, sizeof(counts));
+            for (uint32_t symbol = 0; symbol < symbolCount; symbol++)
+            {
+                counts[lengths[symbol]]++;
+            }
+            counts[0] = 0;
+
+            uint16_t offsets[16] = {};
+            for (uint32_t length = 1; length < 15; length++)
+            {
+                offsets[length + 1] = offsets[length] + counts[length];
+            }
+            for (uint32_t symbol = 0; symbol < symbolCount; symbol++)
+            {
+                if (lengths[symbol] != 0)
+                {
+                    symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+                }
+            }
+
+            // Reject codes with more codes of a length than fit
+            int left = 1;
+            for (uint32_t length = 1; length < 16; length++)
+            {
+                left = left * 2 - counts[length];
+                if (left < 0)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    // Decompresses a zlib stream (RFC 1950 and 1951)
+    class Inflater
+    {
+    public:
+        Inflater(const uint8_t* data, size_t size) :
+            m_data(data),
+            m_size(size)
+        {
+        }
+
+        bool Inflate(std::vector<uint8_t>& output)
+        {
+            if (m_size < 6 || (m_data[0] & 0x0F) != 8 || ((m_data[0] << 8) | m_data[1]) % 31 != 0 || (m_data[1] & 0x20) != 0)
+            {
+                return false;
+            }
+            m_position = 2;
+
+            bool lastBlock = false;
+            while (!lastBlock)
+            {
+                lastBlock = GetBits(1) != 0;
+                const uint32_t type = GetBits(2);
+
+                bool valid = false;
+                if (type == 0)
+                {
+                    valid = CopyStoredBlock(output);
+                }
+                else if (type == 1)
+                {
+                    BuildFixedCodes();
+                    valid = DecodeBlock(output);
+                }
+                else if (type == 2)
+                {
+                    valid = ReadDynamicCodes() && DecodeBlock(output);
+                }
+                if (!valid || m_overrun)
+                {
+                    return false;
+                }
+            }
+
+            // The Adler-32 of the data follows, byte aligned
+            m_bitCount = 0;
+            if (m_position + 4 > m_size)
+            {
+                return false;
+            }
+            return ReadBigEndian32(m_data + m_position) == UpdateAdler32(1, output.data(), output.size());
+        }
+
+    private:
+        uint32_t GetBits(uint32_t count)
+        {
+            while (m_bitCount < count)
+            {
+                if (m_position >= m_size)
+                {
+                    m_overrun = true;
+                    return 0;
+                }
+                m_bitBuffer |= uint32_t(m_data[m_position++]) << m_bitCount;
+                m_bitCount += 8;
+            }
+
+            const uint32_t bits = m_bitBuffer & ((1u << count) - 1);
+            m_bitBuffer >>= count;
+            m_bitCount -= count;
+            return bits;
+        }
+
+        int Decode(const HuffmanCode& code)
+        {
+            int first = 0, index = 0, value = 0;
+            for (uint32_t length = 1; length < 16; length++)
+            {
+                value |= static_cast<int>(GetBits(1));
+                const int count = code.counts[length];
+                if (value - first < count)
+                {
+                    return code.symbols[index + value - first];
+                }
+                index += count;
+                first = (first + count) << 1;
+                value <<= 1;
+            }
+            return -1;
+        }
+
+        bool CopyStoredBlock(std::vector<uint8_t>& output)
+        {
+            m_bitBuffer = 0;
+            m_bitCount = 0;
+            if (m_position + 4 > m_size)
+            {
+                return false;
+            }
+
+            const uint32_t length = m_data[m_position] | (m_data[m_position + 1] << 8);
+            const uint32_t complement = m_data[m_position + 2] | (m_data[m_position + 3] << 8);
+            m_position += 4;
+            if (length != (~complement & 0xFFFF) || m_position + length > m_size)
+            {
+                return false;
+            }
+
+            output.insert(output.end(), m_data + m_position, m_data + m_position + length);
+            m_position += length;
+            return true;
+        }
+
+        void BuildFixedCodes()
+        {
+            uint8_t lengths[288 + 30];
+            memset(lengths, 8, 144);
+            memset(lengths + 144, 9, 112);
+            memset(lengths + 256, 7, 24);
+            memset(lengths + 280, 8, 8);
+            memset(lengths + 288, 5, 30);
+            m_lengthCode.Build(lengths, 288);
+            m_distanceCode.Build(lengths + 288, 30);
+        }
+
+        bool ReadDynamicCodes()
+        {
+            static const uint8_t c_codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+            const uint32_t lengthCount = GetBits(5) + 257;
+            const uint32_t distanceCount = GetBits(5) + 1;
+            const uint32_t codeLengthCount = GetBits(4) + 4;
+            if (lengthCount > 286 || distanceCount > 30)
+            {
+                return false;
+            }
+
+            uint8_t lengths[286 + 30] = {};
+            for (uint32_t i = 0; i < codeLengthCount; i++)
+            {
+                lengths[c_codeLengthOrder[i]] = static_cast<uint8_t>(GetBits(3));
+            }
+
+            HuffmanCode codeLengthCode;
+            if (!codeLengthCode.Build(lengths, 19))
+            {
+                return false;
+            }
+
+            // The code lengths of both codes form one sequence, with runs that may cross from one to the other
+            memset(lengths, 0, sizeof(lengths));
+            for (uint32_t i = 0; i < lengthCount + distanceCount; )
+            {
+                const int symbol = Decode(codeLengthCode);
+                if (symbol < 0 || m_overrun)
+                {
+                    return false;
+                }
+                if (symbol < 16)
+                {
+                    lengths[i++] = static_cast<uint8_t>(symbol);
+                    continue;
+                }
+
+                uint8_t value = 0;
+                uint32_t repeat;
+                if (symbol == 16)
+                {
+                    if (i == 0)
+                    {
+                        return false;
+                    }
+                    value = lengths[i - 1];
+                    repeat = 3 + GetBits(2);
+                }
+                else if (symbol == 17)
+                {
+                    repeat = 3 + GetBits(3);
+                }
+                else
+                {
+                    repeat = 11 + GetBits(7);
+                }
+                if (i + repeat > lengthCount + distanceCount)
+                {
+                    return false;
+                }
+                while (repeat-- > 0)
+                {
+                    lengths[i++] = value;
+                }
+            }
+
+            return lengths[256] != 0 &&
+                m_lengthCode.Build(lengths, lengthCount) &&
+                m_distanceCode.Build(lengths + lengthCount, distanceCount);
+        }
+
+        bool DecodeBlock(std::vector<uint8_t>& output)
+        {
+            static const uint16_t c_lengthBase[29] = {
+                3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+            static const uint8_t c_lengthExtraBits[29] = {
+                0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+            static const uint16_t c_distanceBase[30] = {
+                1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+                4097, 6145, 8193, 12289, 16385, 24577 };
+            static const uint8_t c_distanceExtraBits[30] = {
+                0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+            for (;;)
+            {
+                const int symbol = Decode(m_lengthCode);
+                if (symbol < 0 || m_overrun)
+                {
+                    return false;
+                }
+                if (symbol < 256)
+                {
+                    output.push_back(static_cast<uint8_t>(symbol));
+                    continue;
+                }
+                if (symbol == 256)
+                {
+                    return true;
+                }
+
+                const uint32_t lengthSymbol = static_cast<uint32_t>(symbol) - 257;
+                if (lengthSymbol >= 29)
+                {
+                    return false;
+                }
+                const uint32_t length = c_lengthBase[lengthSymbol] + GetBits(c_lengthExtraBits[lengthSymbol]);
+
+                const int distanceSymbol = Decode(m_distanceCode);
+                if (distanceSymbol < 0 || distanceSymbol >= 30)
+                {
+                    return false;
+                }
+                const uint32_t distance = c_distanceBase[distanceSymbol] + GetBits(c_distanceExtraBits[distanceSymbol]);
+                if (distance > output.size())
+                {
+                    return false;
+                }
+
+                // The copy may overlap the bytes it writes
+                size_t from = output.size() - distance;
+                for (uint32_t i = 0; i < length; i++)
+                {
+                    output.push_back(output[from++]);
+                }
+            }
+        }
+
+        const uint8_t*  m_data;
+        size_t          m_size;
+        size_t          m_position = 0;
+        uint32_t        m_bitBuffer = 0;
+        uint32_t        m_bitCount = 0;
+        bool            m_overrun = false;
+        HuffmanCode     m_lengthCode;
+        HuffmanCode     m_distanceCode;
+    };
+
+    uint8_t PaethPredictor(int left, int up, int upLeft)
+    {
+        const int estimate = left + up - upLeft;
+        const int distanceLeft = std::abs(estimate - left);
+        const int distanceUp = std::abs(estimate - up);
+        const int distanceUpLeft = std::abs(estimate - upLeft);
+        if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft)
+        {
+            return static_cast<uint8_t>(left);
+        }
+        return static_cast<uint8_t>((distanceUp <= distanceUpLeft) ? up : upLeft);
+    }
+
+    // Reverses the filter of each row in place. Each row starts with its filter type byte.
+    bool UnfilterRows(std::vector<uint8_t>& data, uint32_t height, size_t rowSize, uint32_t pixelSize)
+    {
+        for (uint32_t y = 0; y < height; y++)
+        {
+            uint8_t* row = &data[y * (rowSize + 1) + 1];
+            const uint8_t* previous = (y > 0) ? row - (rowSize + 1) : nullptr;
+            const uint8_t filter = row[-1];
+
+            for (size_t i = 0; i < rowSize; i++)
+            {
+                const int left = (i >= pixelSize) ? row[i - pixelSize] : 0;
+                const int up = previous ? previous[i] : 0;
+                const int upLeft = (previous && i >= pixelSize) ? previous[i - pixelSize] : 0;
+
+                switch (filter)
+                {
+                case 0: break;
+                case 1: row[i] = static_cast<uint8_t>(row[i] + left); break;
+                case 2: row[i] = static_cast<uint8_t>(row[i] + up); break;
+                case 3: row[i] = static_cast<uint8_t>(row[i] + (left + up) / 2); break;
+                case 4: row[i] = static_cast<uint8_t>(row[i] + PaethPredictor(left, up, upLeft)); break;
+                default: return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Loads an 8-bit, non-interlaced PNG file. Alpha is dropped.
+    bool LoadPngFile(const std::string& fpath, std::istream& input, ImageRGB8& image)
+    {
+        const std::vector<uint8_t> file((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+        uint32_t colorType = 0, bitDepth = 0, interlace = 0;
+        std::vector<uint8_t> palette;
+        std::vector<uint8_t> compressed;
+        bool headerFound = false, endFound = false;
+
+        // The signature has already been read
+        for (size_t position = 0; !endFound; )
+        {
+            if (position + 12 > file.size())
+            {
+                std::cerr << "Truncated image file: " << fpath << std::endl;
+                return false;
+            }
+
+            const uint32_t length = ReadBigEndian32(&file[position]);
+            const uint8_t* type = &file[position + 4];
+            const uint8_t* data = type + 4;
+            if (length > file.size() - position - 12)
+            {
+                std::cerr << "Truncated image file: " << fpath << std::endl;
+                return false;
+            }
+            if (ReadBigEndian32(data + length) != UpdateCrc32(0, type, length + 4))
+            {
+                std::cerr << "Corrupt image file (chunk checksum mismatch): " << fpath << std::endl;
+                return false;
+            }
+            position += size_t(length) + 12;
+
+            if (!memcmp(type, "IHDR", 4) && length >= 13)
+            {
+                image.width = ReadBigEndian32(data);
+                image.height = ReadBigEndian32(data + 4);
+                bitDepth = data[8];
+                colorType = data[9];
+                interlace = data[12];
+                headerFound = true;
+            }
+            else if (!memcmp(type, "PLTE", 4))
+            {
+                palette.assign(data, data + length);
+            }
+            else if (!memcmp(type, "IDAT", 4))
+            {
+                compressed.insert(compressed.end(), data, data + length);
+            }
+            else if (!memcmp(type, "IEND", 4))
+            {
+                endFound = true;
+            }
+        }
+
+        // Gray, RGB, palette, gray with alpha and RGBA
+        static const uint32_t c_channelCounts[7] = { 1, 0, 3, 1, 2, 0, 4 };
+        const uint32_t channels = (colorType < 7) ? c_channelCounts[colorType] : 0;
+        if (!headerFound || bitDepth != 8 || channels == 0 || interlace != 0 || image.width == 0 || image.height == 0 ||
+            (colorType == 3 && palette.empty()))
+        {
+            std::cerr << "Unsupported image file (only 8-bit, non-interlaced PNG files are supported): " << fpath << std::endl;
+            return false;
+        }
+
+        const size_t rowSize = size_t(image.width) * channels;
+        std::vector<uint8_t> data;
+        data.reserve((rowSize + 1) * image.height);
+        if (!Inflater(compressed.data(), compressed.size()).Inflate(data) || data.size() != (rowSize + 1) * image.height ||
+            !UnfilterRows(data, image.height, rowSize, channels))
+        {
+            std::cerr << "Corrupt image file: " << fpath << std::endl;
+            return false;
+        }
+
+        const size_t paletteCount = palette.size() / 3;
+        image.pixels.resize(size_t(image.width) * image.height * 3);
+        for (uint32_t y = 0; y < image.height; y++)
+        {
+            const uint8_t* row = &data[y * (rowSize + 1) + 1];
+            uint8_t* pixels = &image.pixels[size_t(y) * image.width * 3];
+            for (uint32_t x = 0; x < image.width; x++, row += channels, pixels += 3)
+            {
+                if (colorType == 3)
+                {
+                    const size_t index = std::min<size_t>(row[0], paletteCount - 1);
+                    memcpy(pixels, &palette[index * 3], 3);
+                }
+                else if (channels >= 3)
+                {
+                    memcpy(pixels, row, 3);
+                }
+                else
+                {
+                    pixels[0] = pixels[1] = pixels[2] = row[0];
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void AppendPngChunk(std::vector<uint8_t>& bytes, const char* type, const uint8_t* data, size_t size)
+    {
+        AppendBigEndian32(bytes, static_cast<uint32_t>(size));
+        const size_t typeStart = bytes.size();
+        bytes.insert(bytes.end(), type, type + 4);
+        bytes.insert(bytes.end(), data, data + size);
+        AppendBigEndian32(bytes, UpdateCrc32(0, &bytes[typeStart], size + 4));
+    }
+
+    // Saves an RGB PNG file. The rows are stored without filtering or compression, which keeps writing cheap at the
+    // cost of larger files.
+    bool SavePngFile(const std::string& fpath, std::ostream& output, const ImageRGB8& image)
+    {
+        const size_t rowSize = size_t(image.width) * 3;
+
+        std::vector<uint8_t> rows((rowSize + 1) * image.height);
+        for (uint32_t y = 0; y < image.height; y++)
+        {
+            rows[y * (rowSize + 1)] = 0;
+            memcpy(&rows[y * (rowSize + 1) + 1], &image.pixels[y * rowSize], rowSize);
+        }
+
+        std::vector<uint8_t> compressed = { 0x78, 0x01 };
+        compressed.reserve(rows.size() + rows.size() / c_maxStoredBlockSize * 5 + 16);
+        for (size_t start = 0; start < rows.size() || start == 0; start += c_maxStoredBlockSize)
+        {
+            const size_t size = std::min(rows.size() - start, c_maxStoredBlockSize);
+            const bool lastBlock = (start + size == rows.size());
+            compressed.push_back(lastBlock ? 1 : 0);
+            compressed.push_back(static_cast<uint8_t>(size));
+            compressed.push_back(static_cast<uint8_t>(size >> 8));
+            compressed.push_back(static_cast<uint8_t>(~size));
+            compressed.push_back(static_cast<uint8_t>(~size >> 8));
+            compressed.insert(compressed.end(), rows.begin() + start, rows.begin() + start + size);
+            if (lastBlock)
+            {
+                break;
+            }
+        }
+        AppendBigEndian32(compressed, UpdateAdler32(1, rows.data(), rows.size()));
+
+        std::vector<uint8_t> header;
+        AppendBigEndian32(header, image.width);
+        AppendBigEndian32(header, image.height);
+        header.insert(header.end(), { 8, 2, 0, 0, 0 });
+
+        std::vector<uint8_t> bytes(c_pngSignature, c_pngSignature + sizeof(c_pngSignature));
+        AppendPngChunk(bytes, "IHDR", header.data(), header.size());
+        AppendPngChunk(bytes, "IDAT", compressed.data(), compressed.size());
+        AppendPngChunk(bytes, "IEND", nullptr, 0);
+
+        output.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        if (!output.good())
+        {
+            std::cerr << "Unable to write image file: " << fpath << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+bool IsPngFileName(const std::string& fpath)
+{
+    if (fpath.size() < 4)
+    {
+        return false;
+    }
+
+    std::string extension = fpath.substr(fpath.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+    return extension == ".png";
+}
+
+// Loads a binary PPM or PGM file, or a PNG file.
+bool LoadImageFile(const std::string& fpath, ImageRGB8& image)
+{
+    std::ifstream input(fpath, std::ifstream::binary);
+    if (!input.is_open())
+    {
+        std::cerr << "Unable to open image file: " << fpath << std::endl;
+        return false;
+    }
+
+    char magic[8] = {};
+    input.read(magic, 2);
+
+    uint32_t channels = 0;
+    if (magic[0] == 'P' && magic[1] == '6')
+    {
+        channels = 3;
+    }
+    else if (magic[0] == 'P' && magic[1] == '5')
+    {
+        channels = 1;
+    }
+    else if (input.read(magic + 2, 6) && !memcmp(magic, c_pngSignature, sizeof(c_pngSignature)))
+    {
+        return LoadPngFile(fpath, input, image);
+    }
+    else
+    {
+        std::cerr << "Unsupported image file (expected binary PPM, PGM or PNG): " << fpath << std::endl;
+        return false;
+    }
+
+    uint32_t maxValue = 0;
+    if (!ReadHeaderValue(input, image.width) || !ReadHeaderValue(input, image.height) || !ReadHeaderValue(input, maxValue)
+        || maxValue != 255 || image.width == 0 || image.height == 0)
+    {
+        std::cerr << "Invalid image header (only 8-bit images are supported): " << fpath << std::endl;
+        return false;
+    }
+
+    // Exactly one whitespace character separates the header from the pixel data.
+    input.get();
+
+    const size_t pixelCount = size_t(image.width) * image.height;
+    std::vector<uint8_t> data(pixelCount * channels);
+    input.read(reinterpret_cast<char*>(data.data()), data.size());
+    if (size_t(input.gcount()) != data.size())
+    {
+        std::cerr << "Truncated image file: " << fpath << std::endl;
+        return false;
+    }
+
+    if (channels == 3)
+    {
+        image.pixels = std::move(data);
+    }
+    else
+    {
+        image.pixels.resize(pixelCount * 3);
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            image.pixels[i * 3] = image.pixels[i * 3 + 1] = image.pixels[i * 3 + 2] = data[i];
+        }
+    }
+
+    return true;
+}
+
+// Saves a binary PPM file, or a PNG file if the name ends in .png.
+bool SaveImageFile(const std::string& fpath, const ImageRGB8& image)
+{
+    std::ofstream output(fpath, std::ofstream::binary);
+    if (!output.is_open())
+    {
+        std::cerr << "Unable to create image file: " << fpath << std::endl;
+        return false;
+    }
+
+    if (IsPngFileName(fpath))
+    {
+        return SavePngFile(fpath, output, image);
+    }
+
+    output << "P6\n" << image.width << " " << image.height << "\n255\n";
+    output.write(reinterpret_cast<const char*>(image.pixels.data()), image.pixels.size());
+
+    if (!output.good())
+    {
+        std::cerr << "Unable to write image file: " << fpath << std::endl;
+        return false;
+    }
+
+    return true;
+}
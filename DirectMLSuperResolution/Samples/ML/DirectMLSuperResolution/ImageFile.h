@@ -0,0 +1,32 @@
+//--------------------------------------------------------------------------------------
+// ImageFile.h
+//
+// Minimal, dependency-free image file reading and writing for the headless tools.
+// Supports binary PPM (P6) and PGM (P5) files with 8 bits per channel, and 8-bit PNG
+// files. PNG files are written uncompressed.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 8-bit interleaved RGB image.
+struct ImageRGB8
+{
+    uint32_t                width = 0;
+    uint32_t                height = 0;
+    std::vector<uint8_t>    pixels;
+};
+
+// The format is detected from the file contents. Grayscale files are expanded to RGB, and alpha is dropped.
+bool LoadImageFile(const std::string& fpath, ImageRGB8& image);
+
+// Writes a PNG file if the name ends in .png (in any case), and a PPM file otherwise.
+bool SaveImageFile(const std::string& fpath, const ImageRGB8& image);
+bool IsPngFileName(const std::string& fpath);
@@ -9,6 +9,7 @@ cbuffer ConstantBufferCS
     uint Height;
     uint Width;
     bool Nhwc;
+    uint BatchIndex;    // Image within the batch to write
 };
 
 
@@ -20,7 +21,7 @@ void imageToTensor(uint3 blockID : SV_GroupID, uint3 threadID : SV_GroupThreadID
 
     if (x < Width && y < Height)
     {
-        uint index = Width * y + x;
+        uint index = Width * (Height * BatchIndex + y) + x;
 
         float3 val = inputImage[uint2(x, y)].xyz;
 
@@ -33,6 +34,7 @@ void imageToTensor(uint3 blockID : SV_GroupID, uint3 threadID : SV_GroupThreadID
         else
         {
             uint planeSize = Height * Width;
+            index = planeSize * BatchIndex * 3 + Width * y + x;
 
             // RGB plane order since model was trained on this
             opTensor[index] = val.x;
@@ -0,0 +1,182 @@
+//--------------------------------------------------------------------------------------
+// LayoutTuning.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "LayoutTuning.h"
+#include "CpuSimd.h"
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+using namespace LayoutTuning;
+
+namespace
+{
+    std::string GetProcessorBrand()
+    {
+        unsigned int registers[12] = {};
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        for (int i = 0; i < 3; i++)
+        {
+            __cpuid(reinterpret_cast<int*>(registers + i * 4), static_cast<int>(0x80000002 + i));
+        }
+#elif defined(__x86_64__) || defined(__i386__)
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            if (!__get_cpuid(0x80000002 + i, &registers[i * 4], &registers[i * 4 + 1], &registers[i * 4 + 2], &registers[i * 4 + 3]))
+            {
+                return "unknown";
+            }
+        }
+#endif
+        char brand[sizeof(registers) + 1] = {};
+        memcpy(brand, registers, sizeof(registers));
+        return brand[0] ? brand : "unknown";
+    }
+}
+
+std::string LayoutTuning::GetKey(const std::string& device, const std::string& shape, const std::string& layout)
+{
+    return device + " " + shape + " " + layout;
+}
+
+std::string LayoutTuning::GetConvShape(const uint32_t* inputSizes, const uint32_t* filterSizes, bool relu)
+{
+    std::ostringstream shape;
+    shape << "conv:" << inputSizes[0] << "x" << inputSizes[1] << "x" << inputSizes[2] << "x" << inputSizes[3] << ":"
+          << filterSizes[0] << "x" << filterSizes[1] << "x" << filterSizes[2] << "x" << filterSizes[3]
+          << (relu ? ":relu" : ":linear");
+    return shape.str();
+}
+
+std::string LayoutTuning::GetCpuDevice(uint32_t threadCount)
+{
+    std::ostringstream device;
+    device << "cpu:" << GetProcessorBrand() << ":" << CpuSimd::c_name << ":" << threadCount << "threads";
+    return MakeName(device.str());
+}
+
+std::string LayoutTuning::MakeName(const std::string& text)
+{
+    // Trim, and collapse runs of white space
+    std::string name;
+    bool space = false;
+    for (char c : text)
+    {
+        if (isspace(static_cast<unsigned char>(c)))
+        {
+            space = !name.empty();
+            continue;
+        }
+        if (space)
+        {
+            name += '_';
+            space = false;
+        }
+        name += c;
+    }
+    return name;
+}
+
+bool LayoutTuning::FindFastestLayout(
+    const MeasuredTimes& times,
+    const std::string& device,
+    const std::string& shape,
+    const std::vector<std::string>& layouts,
+    std::string& fastestOut)
+{
+    double fastestTime = std::numeric_limits<double>::max();
+    for (const std::string& layout : layouts)
+    {
+        const auto time = times.find(GetKey(device, shape, layout));
+        if (time == times.end())
+        {
+            return false;
+        }
+        if (time->second < fastestTime)
+        {
+            fastestTime = time->second;
+            fastestOut = layout;
+        }
+    }
+    return !layouts.empty();
+}
+
+bool LayoutTuning::LoadMeasuredTimes(const std::string& path, MeasuredTimes& timesOut)
+{
+    timesOut.clear();
+
+    std::ifstream input(path);
+    if (!input.is_open())
+    {
+        return true;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(input, line))
+    {
+        lineNumber++;
+
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+
+        std::istringstream tokenStream(line);
+        std::string device;
+        if (!(tokenStream >> device))
+        {
+            continue;
+        }
+
+        std::string shape, layout, extra;
+        double milliseconds;
+        if (!(tokenStream >> shape >> layout >> milliseconds) || (tokenStream >> extra) || !(milliseconds >= 0.0))
+        {
+            std::cerr << path << "(" << lineNumber << "): Expected <device> <shape> <layout> <milliseconds>" << std::endl;
+            return false;
+        }
+        timesOut[GetKey(device, shape, layout)] = milliseconds;
+    }
+
+    return true;
+}
+
+bool LayoutTuning::SaveMeasuredTimes(const std::string& path, const MeasuredTimes& times)
+{
+    std::ofstream output(path);
+    if (!output.is_open())
+    {
+        std::cerr << "Unable to create layout tuning cache: " << path << std::endl;
+        return false;
+    }
+
+    output << "# Measured operator times by device, shape and tensor layout (see LayoutTuning.h)" << std::endl;
+    for (const auto& entry : times)
+    {
+        output << entry.first << " " << entry.second << std::endl;
+    }
+
+    if (!output.good())
+    {
+        std::cerr << "Unable to write layout tuning cache: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
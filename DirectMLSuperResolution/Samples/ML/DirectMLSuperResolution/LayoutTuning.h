@@ -0,0 +1,54 @@
+//--------------------------------------------------------------------------------------
+// LayoutTuning.h
+//
+// Cache of measured operator times for choosing tensor layouts. The sample measures each
+// convolution of the graph in NCHW and NHWC on the DirectML device, and the CPU engine
+// measures its direct convolutions in each CpuKernels::ConvLayout. The fastest layout is
+// used, and the times are kept in a text file with one line per measurement:
+//
+//   <device> <shape> <layout> <milliseconds>
+//
+// so that later runs on the same device only measure shapes they have not seen.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace LayoutTuning
+{
+    // Milliseconds per run, indexed by GetKey()
+    using MeasuredTimes = std::map<std::string, double>;
+
+    // Device, shape and layout names must not contain white space.
+    std::string GetKey(const std::string& device, const std::string& shape, const std::string& layout);
+
+    // e.g. "conv:1x64x136x240:64x64x3x3:relu"
+    std::string GetConvShape(const uint32_t* inputSizes, const uint32_t* filterSizes, bool relu);
+
+    // The processor brand, the vector instruction set the CPU kernels were built for, and the thread count
+    std::string GetCpuDevice(uint32_t threadCount);
+
+    // Replaces white space with underscores
+    std::string MakeName(const std::string& text);
+
+    // The layout with the smallest time for the shape. Returns false if any of them has not been measured.
+    bool FindFastestLayout(
+        const MeasuredTimes& times,
+        const std::string& device,
+        const std::string& shape,
+        const std::vector<std::string>& layouts,
+        std::string& fastestOut);
+
+    // Both report errors to stderr. A file that can't be opened is taken to be missing, which is not an error and
+    // leaves no times. '#' starts a comment.
+    bool LoadMeasuredTimes(const std::string& path, MeasuredTimes& timesOut);
+    bool SaveMeasuredTimes(const std::string& path, const MeasuredTimes& times);
+}
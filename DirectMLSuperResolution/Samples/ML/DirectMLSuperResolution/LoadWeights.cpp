@@ -6,81 +6,146 @@
 // Licensed under the MIT License.
 //--------------------------------------------------------------------------------------
 
-#include "pch.h"
 #include "LoadWeights.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <string>
-#include <fstream>
 
 namespace
 {
-    const int c_bufferLength = 256;
+    bool NameLess(const char* a, uint32_t aLength, const char* b, uint32_t bLength)
+    {
+        int order = memcmp(a, b, std::min(aLength, bLength));
+        return (order != 0) ? (order < 0) : (aLength < bLength);
+    }
+
+    // Reads a uint32 that may not be aligned, advancing the offset. Returns false past the end of the file.
+    bool ReadUint32(const uint8_t* data, size_t size, size_t& offset, uint32_t& value)
+    {
+        if (size - offset < sizeof(uint32_t))
+        {
+            return false;
+        }
+        memcpy(&value, data + offset, sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+        return true;
+    }
 }
 
-// Loads weight values from a file.
-bool LoadWeights(const std::string& fpath, WeightMapType& weightMap)
+const WeightsType* WeightMapType::find(const char* name) const
 {
-    std::ifstream input(fpath, std::ifstream::binary);
-    if( !(input) || !(input.good()) || !(input.is_open()))
+    const uint32_t nameLength = static_cast<uint32_t>(strlen(name));
+    auto it = std::lower_bound(m_index.begin(), m_index.end(), name, [nameLength](const Entry& entry, const char* key)
     {
-        std::cerr << "Unable to open weight file: " << fpath << std::endl;
-        return false;
-    }
+        return NameLess(entry.name, entry.nameLength, key, nameLength);
+    });
 
-    int32_t count;
-    try
+    if (it == m_index.end() || it->nameLength != nameLength || memcmp(it->name, name, nameLength) != 0)
     {
-        input.read(reinterpret_cast<char*>(&count), 4);
+        return nullptr;
     }
-    catch(const std::ifstream::failure&)
+    return &it->weights;
+}
+
+// Maps a weights file and indexes its tensors. The file holds an int32 tensor count, then for each tensor
+// a uint32 name length, the name, a uint32 value count and the FP32 values.
+bool LoadWeights(const std::string& fpath, WeightMapType& weightMap)
+{
+    weightMap.m_index.clear();
+    weightMap.m_relocatedWeights.reset();
+
+    if (!weightMap.m_file.Open(fpath))
     {
-        std::cerr << "Invalid weight map file: " << fpath << std::endl;
         return false;
     }
-    if (count < 0)
+
+    const uint8_t* data = weightMap.m_file.Data();
+    const size_t size = weightMap.m_file.Size();
+    size_t offset = 0;
+
+    // Every tensor has at least its two lengths, so a larger count is corrupt, and mustn't size the reserves below
+    uint32_t count;
+    if (!ReadUint32(data, size, offset, count) || static_cast<int32_t>(count) < 0 || count > (size - offset) / (2 * sizeof(uint32_t)))
     {
         std::cerr << "Invalid weight map file: " << fpath << std::endl;
         return false;
     }
-    std::cout << "Number of weight tensors: " + std::to_string(count) << std::endl;
 
-    uint32_t name_len;
-    uint32_t w_len;
-    char name_buf[c_bufferLength];
+    weightMap.m_index.reserve(count);
+    std::vector<size_t> payloadOffsets;
+    payloadOffsets.reserve(count);
+    size_t relocatedCount = 0;
 
-    try
+    while (count--)
     {
-        while(count--)
+        uint32_t name_len;
+        if (!ReadUint32(data, size, offset, name_len) || name_len > size - offset)
         {
-            input.read(reinterpret_cast<char*>(&name_len), sizeof(uint32_t));
-            if (name_len > c_bufferLength - 1)
-            {
-                std::cerr << "name_len exceeds c_bufferLength: " << name_len
-                          << " vs " << c_bufferLength - 1 << std::endl;
-                return false;
-            }
-            input.read(name_buf, name_len);
-            name_buf[name_len] = '\0';
-            std::string name(name_buf);
-
-            input.read(reinterpret_cast<char*>(&w_len), sizeof(uint32_t));
-            weightMap[name] = WeightsType(w_len);
-            input.read(reinterpret_cast<char*>(weightMap[name].data()), sizeof(float) * w_len);
-
-            std::cout << "Loaded tensor: " + name + " -> " + std::to_string(w_len) << std::endl;
+            std::cerr << "Invalid tensor format" << std::endl;
+            return false;
         }
 
-        input.close();
+        WeightMapType::Entry entry;
+        entry.name = reinterpret_cast<const char*>(data + offset);
+        entry.nameLength = name_len;
+        offset += name_len;
+
+        uint32_t w_len;
+        if (!ReadUint32(data, size, offset, w_len) || w_len > (size - offset) / sizeof(float))
+        {
+            std::cerr << "Invalid tensor data" << std::endl;
+            return false;
+        }
+
+        entry.weights = WeightsType(nullptr, w_len);
+        if ((reinterpret_cast<uintptr_t>(data) + offset) % alignof(float) != 0)
+        {
+            relocatedCount += w_len;
+        }
+
+        weightMap.m_index.push_back(entry);
+        payloadOffsets.push_back(offset);
+        offset += sizeof(float) * w_len;
     }
-    catch(const std::ifstream::failure&)
+
+    // The format doesn't pad the payloads, so some of them can't be used in place. Copy those into a single
+    // aligned block.
+    weightMap.m_relocatedWeights.reset(relocatedCount > 0 ? new float[relocatedCount] : nullptr);
+    float* relocated = weightMap.m_relocatedWeights.get();
+
+    for (size_t i = 0; i < weightMap.m_index.size(); i++)
     {
-        std::cerr << "Invalid tensor data" << std::endl;
-        return false;
+        WeightsType& weights = weightMap.m_index[i].weights;
+        const uint8_t* payload = data + payloadOffsets[i];
+
+        if (reinterpret_cast<uintptr_t>(payload) % alignof(float) == 0)
+        {
+            weights = WeightsType(reinterpret_cast<const float*>(payload), weights.size());
+        }
+        else
+        {
+            memcpy(relocated, payload, sizeof(float) * weights.size());
+            weights = WeightsType(relocated, weights.size());
+            relocated += weights.size();
+        }
     }
-    catch(const std::out_of_range&)
+
+    std::sort(weightMap.m_index.begin(), weightMap.m_index.end(), [](const WeightMapType::Entry& a, const WeightMapType::Entry& b)
     {
-        std::cerr << "Invalid tensor format" << std::endl;
-        return false;
+        return NameLess(a.name, a.nameLength, b.name, b.nameLength);
+    });
+
+    for (size_t i = 1; i < weightMap.m_index.size(); i++)
+    {
+        const auto& previous = weightMap.m_index[i - 1];
+        const auto& current = weightMap.m_index[i];
+        if (!NameLess(previous.name, previous.nameLength, current.name, current.nameLength))
+        {
+            std::cerr << "Duplicate weight tensor: " << std::string(current.name, current.nameLength) << std::endl;
+            return false;
+        }
     }
 
     return true;
@@ -8,9 +8,60 @@
 
 #pragma once
 
-#include <map>
+#include "MappedFile.h"
 
-typedef std::vector<float> WeightsType;
-typedef std::map<std::string, WeightsType> WeightMapType;
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
 
-bool LoadWeights(const std::string& fpath, WeightMapType& weightMap);
\ No newline at end of file
+// Read-only view of one tensor's values, in the spirit of std::span<const float>.
+class WeightsType
+{
+public:
+    WeightsType() : m_data(nullptr), m_size(0) {}
+    WeightsType(const float* data, size_t size) : m_data(data), m_size(size) {}
+
+    const float* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const float& operator[](size_t i) const { return m_data[i]; }
+    const float* begin() const { return m_data; }
+    const float* end() const { return m_data + m_size; }
+
+private:
+    const float*    m_data;
+    size_t          m_size;
+};
+
+// The tensors of a memory-mapped weights file, in a flat index sorted by name. The views point into the
+// mapping, so they are only valid while the map is alive. Tensors that the file doesn't store 4-byte aligned
+// are relocated into one aligned block instead.
+class WeightMapType
+{
+public:
+    WeightMapType() = default;
+    WeightMapType(const WeightMapType&) = delete;
+    WeightMapType& operator=(const WeightMapType&) = delete;
+
+    // Returns nullptr if there is no tensor with this name.
+    const WeightsType* find(const char* name) const;
+
+    size_t size() const { return m_index.size(); }
+
+private:
+    friend bool LoadWeights(const std::string& fpath, WeightMapType& weightMap);
+
+    struct Entry
+    {
+        const char*     name;           // Not null terminated
+        uint32_t        nameLength;
+        WeightsType     weights;
+    };
+
+    MappedFile                  m_file;
+    std::vector<Entry>          m_index;
+    std::unique_ptr<float[]>    m_relocatedWeights;
+};
+
+bool LoadWeights(const std::string& fpath, WeightMapType& weightMap);
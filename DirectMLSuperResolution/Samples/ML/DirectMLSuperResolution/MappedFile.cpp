@@ -0,0 +1,158 @@
+//--------------------------------------------------------------------------------------
+// MappedFile.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "MappedFile.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() :
+    m_data(nullptr),
+    m_size(0)
+#ifdef _WIN32
+    , m_file(INVALID_HANDLE_VALUE),
+    m_mapping(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        std::cerr << "Unable to open file: " << path << std::endl;
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_file, &fileSize))
+    {
+        std::cerr << "Unable to get the size of file: " << path << std::endl;
+        Close();
+        return false;
+    }
+
+    if (fileSize.QuadPart == 0)
+    {
+        // Empty files can't be mapped, but they are valid
+        return true;
+    }
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view)
+    {
+        std::cerr << "Unable to map file: " << path << std::endl;
+        Close();
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping)
+    {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+    }
+
+    m_data = nullptr;
+    m_size = 0;
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Unable to open file: " << path << std::endl;
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0)
+    {
+        std::cerr << "Unable to get the size of file: " << path << std::endl;
+        close(fd);
+        return false;
+    }
+
+    if (fileStat.st_size == 0)
+    {
+        // Empty files can't be mapped, but they are valid
+        close(fd);
+        return true;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        std::cerr << "Unable to map file: " << path << std::endl;
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(fileStat.st_size);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data)
+    {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
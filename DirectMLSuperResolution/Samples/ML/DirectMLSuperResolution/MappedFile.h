@@ -0,0 +1,41 @@
+//--------------------------------------------------------------------------------------
+// MappedFile.h
+//
+// Read-only memory mapping of a whole file (Win32 file mapping or POSIX mmap).
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps the file, replacing any previous mapping. Reports errors to stderr.
+    bool Open(const std::string& path);
+    void Close();
+
+    const uint8_t* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const uint8_t*  m_data;
+    size_t          m_size;
+
+#ifdef _WIN32
+    void*           m_file;
+    void*           m_mapping;
+#endif
+};
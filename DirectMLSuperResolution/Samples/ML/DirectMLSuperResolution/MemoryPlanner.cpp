@@ -0,0 +1,145 @@
+//--------------------------------------------------------------------------------------
+// MemoryPlanner.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "MemoryPlanner.h"
+
+#include <algorithm>
+
+using namespace MemoryPlanner;
+using namespace SuperResolutionModel;
+
+namespace
+{
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    bool LifetimesOverlap(const Block& a, const Block& b)
+    {
+        return a.firstOp <= b.lastOp && b.firstOp <= a.lastOp;
+    }
+}
+
+Plan MemoryPlanner::PlanArena(const std::vector<Block>& blocks, uint64_t alignment)
+{
+    Plan plan = {};
+    plan.offsets.assign(blocks.size(), 0);
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < blocks.size(); i++)
+    {
+        if (blocks[i].size > 0)
+        {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return blocks[a].size > blocks[b].size; });
+
+    // Offset ranges of the blocks placed so far that are live at the same time as the current one
+    std::vector<std::pair<uint64_t, uint64_t>> conflicts;
+    std::vector<size_t> placed;
+
+    for (size_t i : order)
+    {
+        const uint64_t size = AlignUp(blocks[i].size, alignment);
+
+        conflicts.clear();
+        for (size_t other : placed)
+        {
+            if (LifetimesOverlap(blocks[i], blocks[other]))
+            {
+                conflicts.emplace_back(plan.offsets[other], plan.offsets[other] + AlignUp(blocks[other].size, alignment));
+            }
+        }
+        std::sort(conflicts.begin(), conflicts.end());
+
+        // Take the first gap that is large enough
+        uint64_t offset = 0;
+        for (const auto& range : conflicts)
+        {
+            if (range.first >= offset + size)
+            {
+                break;
+            }
+            offset = std::max(offset, range.second);
+        }
+
+        plan.offsets[i] = offset;
+        plan.arenaSize = std::max(plan.arenaSize, offset + size);
+        placed.push_back(i);
+    }
+
+    // The live size only changes where a block starts, so checking each start finds the peak
+    for (const Block& block : blocks)
+    {
+        uint64_t liveSize = 0;
+        for (const Block& other : blocks)
+        {
+            if (other.firstOp <= block.firstOp && block.firstOp <= other.lastOp)
+            {
+                liveSize += AlignUp(other.size, alignment);
+            }
+        }
+        plan.peakLiveSize = std::max(plan.peakLiveSize, liveSize);
+    }
+
+    return plan;
+}
+
+uint64_t ArenaLayout::GetUnpackedSize() const
+{
+    uint64_t size = 0;
+    for (size_t i = c_firstIntermediateBuffer; i < bufferSizes.size(); i++)
+    {
+        size += bufferSizes[i];
+    }
+    for (uint64_t temporarySize : temporarySizes)
+    {
+        size += temporarySize;
+    }
+    return size;
+}
+
+ArenaLayout MemoryPlanner::PlanGraph(
+    const Graph& graph,
+    const std::vector<uint64_t>& bufferSizes,
+    const std::vector<uint64_t>& temporarySizes,
+    uint64_t alignment)
+{
+    const uint32_t bufferCount = graph.GetBufferCount();
+    const uint32_t opCount = static_cast<uint32_t>(graph.GetOps().size());
+
+    // Intermediate buffers first, then one temporary block per op
+    std::vector<Block> blocks;
+    for (uint32_t buffer = c_firstIntermediateBuffer; buffer < bufferCount; buffer++)
+    {
+        Block block = { bufferSizes[buffer], 0, 0 };
+        graph.GetBufferLifetime(buffer, block.firstOp, block.lastOp);
+        blocks.push_back(block);
+    }
+    for (uint32_t op = 0; op < opCount; op++)
+    {
+        Block block = { temporarySizes[op], 0, 0 };
+        graph.GetConcurrentOps(op, block.firstOp, block.lastOp);
+        blocks.push_back(block);
+    }
+
+    const Plan plan = PlanArena(blocks, alignment);
+
+    ArenaLayout layout = {};
+    layout.bufferSizes = bufferSizes;
+    layout.bufferOffsets.assign(bufferCount, 0);
+    std::copy(plan.offsets.begin(), plan.offsets.begin() + (bufferCount - c_firstIntermediateBuffer),
+        layout.bufferOffsets.begin() + c_firstIntermediateBuffer);
+    layout.temporarySizes = temporarySizes;
+    layout.temporaryOffsets.assign(plan.offsets.end() - opCount, plan.offsets.end());
+    layout.arenaSize = plan.arenaSize;
+    layout.peakLiveSize = plan.peakLiveSize;
+    return layout;
+}
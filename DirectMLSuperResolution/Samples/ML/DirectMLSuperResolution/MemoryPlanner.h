@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// MemoryPlanner.h
+//
+// Packs the intermediate results and temporary storage of the super-resolution model into
+// a single arena, letting blocks that are never live at the same time share memory. Only
+// sizes and lifetimes go in, so the same plan is used by the DirectML and CPU paths.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "SuperResolutionModel.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace MemoryPlanner
+{
+    // A block is live from the start of op firstOp to the end of op lastOp, inclusive.
+    struct Block
+    {
+        uint64_t    size;
+        uint32_t    firstOp;
+        uint32_t    lastOp;
+    };
+
+    struct Plan
+    {
+        std::vector<uint64_t>   offsets;        // One per block, a multiple of the alignment
+        uint64_t                arenaSize;
+        uint64_t                peakLiveSize;   // Largest total size of the blocks live at once; no plan can be smaller
+    };
+
+    // Places the largest blocks first, each at the lowest offset that doesn't overlap a block whose lifetime
+    // overlaps its own. Sizes are rounded up to the alignment, which must be a power of two.
+    Plan PlanArena(const std::vector<Block>& blocks, uint64_t alignment);
+
+    // Arena layout for one graph at one input size.
+    struct ArenaLayout
+    {
+        std::vector<uint64_t>   bufferSizes;        // Indexed by graph buffer. The model input and output are not in the arena.
+        std::vector<uint64_t>   bufferOffsets;
+        std::vector<uint64_t>   temporarySizes;     // Indexed by op
+        std::vector<uint64_t>   temporaryOffsets;
+        uint64_t                arenaSize;
+        uint64_t                peakLiveSize;
+
+        // Size of the same storage with one allocation per buffer and per temporary
+        uint64_t GetUnpackedSize() const;
+    };
+
+    // Plans the intermediate buffers of the graph, and the temporary storage each op needs while it runs, using
+    // Graph::GetBufferLifetime() and Graph::GetConcurrentOps().
+    ArenaLayout PlanGraph(
+        const SuperResolutionModel::Graph& graph,
+        const std::vector<uint64_t>& bufferSizes,
+        const std::vector<uint64_t>& temporarySizes,
+        uint64_t alignment);
+}
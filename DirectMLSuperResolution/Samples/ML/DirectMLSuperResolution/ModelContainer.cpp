@@ -0,0 +1,364 @@
+//--------------------------------------------------------------------------------------
+// ModelContainer.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "ModelContainer.h"
+#include "Float16Compressor.h"
+
+#include <cstring>
+#include <iostream>
+
+using namespace ModelContainer;
+using SuperResolutionModel::ConvLayerDesc;
+
+namespace
+{
+    const Layout c_layouts[] = { Layout::NCHW, Layout::NHWC };
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Standard CRC-32 (IEEE 802.3, reflected)
+    struct Crc32Table
+    {
+        uint32_t values[256];
+
+        Crc32Table()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                {
+                    c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                }
+                values[i] = c;
+            }
+        }
+    };
+
+    uint32_t Crc32(const uint8_t* data, size_t size)
+    {
+        static const Crc32Table table;
+
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    const WeightsType* FindWeights(const WeightMapType& weights, const char* name, size_t expectedCount)
+    {
+        const WeightsType* tensor = weights.find(name);
+        if (!tensor)
+        {
+            std::cerr << "Missing weight tensor: " << name << std::endl;
+            return nullptr;
+        }
+
+        if (tensor->size() != expectedCount)
+        {
+            std::cerr << "Unexpected size for weight tensor " << name << ": " << tensor->size()
+                      << " vs " << expectedCount << std::endl;
+            return nullptr;
+        }
+
+        return tensor;
+    }
+}
+
+std::string ModelContainer::GetFilterName(const ConvLayerDesc& layer)
+{
+    return layer.name + "/filter";
+}
+
+std::string ModelContainer::GetBiasName(const ConvLayerDesc& layer)
+{
+    return layer.name + "/bias";
+}
+
+bool ModelContainer::FoldConvLayer(
+    const WeightMapType& weights,
+    const ConvLayerDesc& layer,
+    Layout layout,
+    std::vector<float>& filterOut,
+    std::vector<float>& biasOut)
+{
+    const uint32_t N = layer.filterSizes[0];
+    const uint32_t C = layer.filterSizes[1];
+    const uint32_t H = layer.filterSizes[2];
+    const uint32_t W = layer.filterSizes[3];
+    const bool useScaleShift = SuperResolutionModel::UsesBiasAndActivation(layer);
+
+    const WeightsType* filterWeights = FindWeights(weights, layer.weightsName.c_str(), size_t(N) * C * H * W);
+    const WeightsType* scaleWeights = useScaleShift ? FindWeights(weights, layer.scaleName.c_str(), N) : nullptr;
+    const WeightsType* shiftWeights = useScaleShift ? FindWeights(weights, layer.shiftName.c_str(), N) : nullptr;
+    if (!filterWeights || (useScaleShift && (!scaleWeights || !shiftWeights)))
+    {
+        return false;
+    }
+
+    filterOut.resize(filterWeights->size());
+    size_t dst = 0;
+
+    for (uint32_t n = 0; n < N; n++)
+    {
+        // Apply the scale weight now so we don't need a normalization layer
+        const float scale = useScaleShift ? (*scaleWeights)[n] : 1.0f;
+
+        switch (layout)
+        {
+        case Layout::NHWC:
+            for (uint32_t h = 0; h < H; h++)
+                for (uint32_t w = 0; w < W; w++)
+                    for (uint32_t c = 0; c < C; c++)
+                    {
+                        uint32_t idx = w + h * W + c * H*W + n * C*H*W;
+                        filterOut[dst++] = (*filterWeights)[idx] * scale;
+                    }
+            break;
+
+        default:
+            for (uint32_t i = 0; i < C*H*W; i++)
+            {
+                uint32_t idx = n * C*H*W + i;
+                filterOut[dst++] = (*filterWeights)[idx] * scale;
+            }
+        }
+    }
+
+    // Technically this is initialBias*scale+shift, but the initial bias is 0
+    if (useScaleShift)
+    {
+        biasOut.assign(shiftWeights->begin(), shiftWeights->end());
+    }
+    else
+    {
+        biasOut.clear();
+    }
+
+    return true;
+}
+
+bool ModelContainer::Bake(const SuperResolutionModel::Graph& graph, const WeightMapType& weights, std::vector<TensorData>& tensorsOut)
+{
+    tensorsOut.clear();
+
+    std::vector<float> filter, bias;
+    for (const ConvLayerDesc& layer : graph.GetConvLayers())
+    {
+        for (Layout layout : c_layouts)
+        {
+            if (!FoldConvLayer(weights, layer, layout, filter, bias))
+            {
+                return false;
+            }
+
+            TensorData filterTensor;
+            filterTensor.name = GetFilterName(layer);
+            filterTensor.layout = layout;
+            memcpy(filterTensor.sizes, layer.filterSizes, sizeof(filterTensor.sizes));
+            filterTensor.values.resize(filter.size());
+            Float16Compressor::compress(filter.data(), filterTensor.values.data(), filter.size());
+            tensorsOut.push_back(std::move(filterTensor));
+
+            if (!bias.empty())
+            {
+                // With one value per channel the bias is the same in both layouts, but storing it per layout keeps
+                // lookups uniform.
+                TensorData biasTensor;
+                biasTensor.name = GetBiasName(layer);
+                biasTensor.layout = layout;
+                biasTensor.sizes[0] = 1;
+                biasTensor.sizes[1] = layer.filterSizes[0];
+                biasTensor.sizes[2] = 1;
+                biasTensor.sizes[3] = 1;
+                biasTensor.values.resize(bias.size());
+                Float16Compressor::compress(bias.data(), biasTensor.values.data(), bias.size());
+                tensorsOut.push_back(std::move(biasTensor));
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ModelContainer::Serialize(const std::vector<TensorData>& tensors, std::vector<uint8_t>& bytesOut)
+{
+    std::vector<TensorEntry> entries(tensors.size());
+    uint64_t offset = AlignUp(sizeof(Header) + sizeof(TensorEntry) * tensors.size(), c_dataAlignment);
+
+    for (size_t i = 0; i < tensors.size(); i++)
+    {
+        const TensorData& tensor = tensors[i];
+        TensorEntry& entry = entries[i];
+
+        if (tensor.name.size() >= c_maxNameLength)
+        {
+            std::cerr << "Tensor name is too long: " << tensor.name << std::endl;
+            return false;
+        }
+
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.name, tensor.name.c_str(), tensor.name.size());
+        entry.dataType = DataType::Float16;
+        entry.layout = tensor.layout;
+        memcpy(entry.sizes, tensor.sizes, sizeof(entry.sizes));
+        entry.offset = offset;
+        entry.byteSize = tensor.values.size() * sizeof(uint16_t);
+
+        // Padding each tensor to the alignment also lets consumers read whole vectors or 4-byte-rounded buffer
+        // sizes past the end of the data.
+        offset = AlignUp(offset + entry.byteSize, c_dataAlignment);
+    }
+
+    bytesOut.assign(static_cast<size_t>(offset), 0);
+
+    Header header = {};
+    header.magic = c_magic;
+    header.version = c_version;
+    header.tensorCount = static_cast<uint32_t>(tensors.size());
+    header.dataAlignment = c_dataAlignment;
+    header.fileSize = offset;
+
+    if (!entries.empty())
+    {
+        memcpy(bytesOut.data() + sizeof(Header), entries.data(), sizeof(TensorEntry) * entries.size());
+    }
+    for (size_t i = 0; i < tensors.size(); i++)
+    {
+        if (entries[i].byteSize > 0)
+        {
+            memcpy(bytesOut.data() + entries[i].offset, tensors[i].values.data(), static_cast<size_t>(entries[i].byteSize));
+        }
+    }
+
+    header.checksum = Crc32(bytesOut.data() + sizeof(Header), bytesOut.size() - sizeof(Header));
+    memcpy(bytesOut.data(), &header, sizeof(Header));
+    return true;
+}
+
+Reader::Reader() :
+    m_data(nullptr),
+    m_size(0)
+{
+}
+
+bool Reader::Open(const std::string& path)
+{
+    m_bytes.clear();
+    m_data = nullptr;
+    m_size = 0;
+    if (!m_file.Open(path))
+    {
+        return false;
+    }
+
+    m_data = m_file.Data();
+    m_size = m_file.Size();
+    if (!Validate())
+    {
+        std::cerr << "Invalid model container: " << path << std::endl;
+        m_file.Close();
+        m_data = nullptr;
+        m_size = 0;
+        return false;
+    }
+    return true;
+}
+
+bool Reader::Open(std::vector<uint8_t>&& bytes)
+{
+    m_file.Close();
+    m_bytes = std::move(bytes);
+
+    m_data = m_bytes.data();
+    m_size = m_bytes.size();
+    if (!Validate())
+    {
+        std::cerr << "Invalid model container" << std::endl;
+        m_bytes.clear();
+        m_data = nullptr;
+        m_size = 0;
+        return false;
+    }
+    return true;
+}
+
+bool Reader::Validate()
+{
+    Header header;
+    if (m_size < sizeof(Header))
+    {
+        return false;
+    }
+    memcpy(&header, m_data, sizeof(Header));
+
+    if (header.magic != c_magic || header.fileSize != m_size || header.dataAlignment != c_dataAlignment)
+    {
+        return false;
+    }
+
+    if (header.version != c_version)
+    {
+        std::cerr << "Unsupported model container version " << header.version << ", expected " << c_version << std::endl;
+        return false;
+    }
+
+    if (header.tensorCount > (m_size - sizeof(Header)) / sizeof(TensorEntry))
+    {
+        return false;
+    }
+
+    const TensorEntry* entries = reinterpret_cast<const TensorEntry*>(m_data + sizeof(Header));
+    for (uint32_t i = 0; i < header.tensorCount; i++)
+    {
+        const TensorEntry& entry = entries[i];
+        if (entry.name[c_maxNameLength - 1] != '\0' ||
+            entry.dataType != DataType::Float16 ||
+            entry.offset % c_dataAlignment != 0 ||
+            entry.offset > m_size ||
+            entry.byteSize > m_size - entry.offset ||
+            entry.byteSize != uint64_t(entry.sizes[0]) * entry.sizes[1] * entry.sizes[2] * entry.sizes[3] * sizeof(uint16_t))
+        {
+            return false;
+        }
+    }
+
+    if (Crc32(m_data + sizeof(Header), m_size - sizeof(Header)) != header.checksum)
+    {
+        std::cerr << "Model container checksum mismatch" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+const TensorEntry* Reader::Find(const char* name, Layout layout) const
+{
+    if (!m_data)
+    {
+        return nullptr;
+    }
+
+    Header header;
+    memcpy(&header, m_data, sizeof(Header));
+
+    const TensorEntry* entries = reinterpret_cast<const TensorEntry*>(m_data + sizeof(Header));
+    for (uint32_t i = 0; i < header.tensorCount; i++)
+    {
+        if (entries[i].layout == layout && strcmp(entries[i].name, name) == 0)
+        {
+            return &entries[i];
+        }
+    }
+    return nullptr;
+}
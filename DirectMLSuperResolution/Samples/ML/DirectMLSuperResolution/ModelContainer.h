@@ -0,0 +1,124 @@
+//--------------------------------------------------------------------------------------
+// ModelContainer.h
+//
+// Versioned container for the pre-baked super-resolution model. Each convolution's filter
+// has batch normalization folded in and is stored in FP16, in both NCHW and NHWC layouts,
+// together with its bias, so the runtime can upload the bytes as they are.
+//
+// File layout (little endian):
+//   Header
+//   TensorEntry[tensorCount]
+//   Tensor data, each tensor starting at a multiple of c_dataAlignment
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "LoadWeights.h"
+#include "MappedFile.h"
+#include "SuperResolutionModel.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ModelContainer
+{
+    static const uint32_t c_magic = 0x4D525346;     // "FSRM"
+    static const uint32_t c_version = 1;            // Bump when the layout or the meaning of any field changes
+    static const uint32_t c_dataAlignment = 64;
+    static const uint32_t c_maxNameLength = 48;     // Including the null terminator
+
+    enum class DataType : uint32_t
+    {
+        Float16 = 1,
+    };
+
+    enum class Layout : uint32_t
+    {
+        NCHW = 0,
+        NHWC = 1,
+    };
+
+    struct Header
+    {
+        uint32_t    magic;
+        uint32_t    version;
+        uint32_t    tensorCount;
+        uint32_t    dataAlignment;
+        uint64_t    fileSize;
+        uint32_t    checksum;           // CRC-32 of everything after the header
+        uint32_t    reserved;
+    };
+
+    struct TensorEntry
+    {
+        char        name[c_maxNameLength];
+        DataType    dataType;
+        Layout      layout;
+        uint32_t    sizes[4];           // Logical NCHW sizes, whatever the layout of the data
+        uint64_t    offset;             // From the start of the file
+        uint64_t    byteSize;
+    };
+
+    static_assert(sizeof(Header) == 32, "The header is part of the file format");
+    static_assert(sizeof(TensorEntry) == 88, "Tensor entries are part of the file format");
+
+    // A tensor to be written to a container.
+    struct TensorData
+    {
+        std::string             name;
+        Layout                  layout;
+        uint32_t                sizes[4];
+        std::vector<uint16_t>   values;
+    };
+
+    // Names of the baked tensors of a convolution layer.
+    std::string GetFilterName(const SuperResolutionModel::ConvLayerDesc& layer);
+    std::string GetBiasName(const SuperResolutionModel::ConvLayerDesc& layer);
+
+    // Folds the batch normalization of one convolution layer into its filter, in the given layout. The bias is
+    // left empty for layers without batch normalization. Reports errors to stderr.
+    bool FoldConvLayer(
+        const WeightMapType& weights,
+        const SuperResolutionModel::ConvLayerDesc& layer,
+        Layout layout,
+        std::vector<float>& filterOut,
+        std::vector<float>& biasOut);
+
+    // Folds and converts every convolution layer of the model, in both layouts.
+    bool Bake(const SuperResolutionModel::Graph& graph, const WeightMapType& weights, std::vector<TensorData>& tensorsOut);
+
+    // Serializes tensors into the container format.
+    bool Serialize(const std::vector<TensorData>& tensors, std::vector<uint8_t>& bytesOut);
+
+    // Read-only access to a container, either memory-mapped from a file or held in memory.
+    class Reader
+    {
+    public:
+        Reader();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // Validates the header, the tensor table and the checksum. Reports errors to stderr.
+        bool Open(const std::string& path);
+        bool Open(std::vector<uint8_t>&& bytes);
+
+        // Returns nullptr if the container has no such tensor.
+        const TensorEntry* Find(const char* name, Layout layout) const;
+
+        const void* GetData(const TensorEntry& tensor) const { return m_data + tensor.offset; }
+
+    private:
+        bool Validate();
+
+        MappedFile              m_file;
+        std::vector<uint8_t>    m_bytes;
+        const uint8_t*          m_data;
+        size_t                  m_size;
+    };
+}
@@ -0,0 +1,114 @@
+//--------------------------------------------------------------------------------------
+// Quantization.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "Quantization.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+using namespace Quantization;
+
+void Quantization::UpdateActivationRange(ActivationRange& range, const float* values, size_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    float minValue = values[0];
+    float maxValue = values[0];
+    for (size_t i = 1; i < count; i++)
+    {
+        minValue = std::min(minValue, values[i]);
+        maxValue = std::max(maxValue, values[i]);
+    }
+
+    if (range.min > range.max)
+    {
+        range = { minValue, maxValue };
+    }
+    else
+    {
+        range.min = std::min(range.min, minValue);
+        range.max = std::max(range.max, maxValue);
+    }
+}
+
+bool Quantization::LoadActivationRanges(const std::string& path, ActivationRanges& rangesOut)
+{
+    std::ifstream input(path);
+    if (!input.is_open())
+    {
+        std::cerr << "Unable to open activation ranges: " << path << std::endl;
+        return false;
+    }
+
+    rangesOut.clear();
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(input, line))
+    {
+        lineNumber++;
+
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+
+        std::istringstream tokenStream(line);
+        std::string name;
+        if (!(tokenStream >> name))
+        {
+            continue;
+        }
+
+        ActivationRange range;
+        std::string extra;
+        if (!(tokenStream >> range.min >> range.max) || (tokenStream >> extra) || range.min > range.max)
+        {
+            std::cerr << path << "(" << lineNumber << "): Expected <tensor> <min> <max>" << std::endl;
+            return false;
+        }
+        if (!rangesOut.emplace(name, range).second)
+        {
+            std::cerr << path << "(" << lineNumber << "): Duplicate tensor " << name << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Quantization::SaveActivationRanges(const std::string& path, const ActivationRanges& ranges)
+{
+    std::ofstream output(path);
+    if (!output.is_open())
+    {
+        std::cerr << "Unable to create activation ranges: " << path << std::endl;
+        return false;
+    }
+
+    output << "# Activation ranges of the super-resolution model (see Quantization.h)" << std::endl;
+    output.precision(std::numeric_limits<float>::max_digits10);
+    for (const auto& entry : ranges)
+    {
+        output << entry.first << " " << entry.second.min << " " << entry.second.max << std::endl;
+    }
+
+    if (!output.good())
+    {
+        std::cerr << "Unable to write activation ranges: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
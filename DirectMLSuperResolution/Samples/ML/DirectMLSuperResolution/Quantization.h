@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// Quantization.h
+//
+// Activation ranges for running the super-resolution model in INT8. The ranges are
+// calibrated by running the FP32 model on sample frames (see Tools/QuantizeModel.cpp), and
+// stored in a text file with one line per tensor of the graph:
+//
+//   <tensor> <min> <max>
+//
+// Weights need no calibration: each output channel of a convolution is quantized with the
+// largest magnitude of its filter, after the batch normalization has been folded into it.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+namespace Quantization
+{
+    struct ActivationRange
+    {
+        float   min;
+        float   max;
+    };
+
+    // Indexed by tensor name
+    using ActivationRanges = std::map<std::string, ActivationRange>;
+
+    // Widens a range to include the given values. An empty range has min > max.
+    void UpdateActivationRange(ActivationRange& range, const float* values, size_t count);
+
+    inline ActivationRange EmptyActivationRange()
+    {
+        return { 1.0f, -1.0f };
+    }
+
+    // Both report errors to stderr. '#' starts a comment.
+    bool LoadActivationRanges(const std::string& path, ActivationRanges& rangesOut);
+    bool SaveActivationRanges(const std::string& path, const ActivationRanges& ranges);
+
+    // Step between unsigned 8-bit codes for a non-negative range, which starts at zero so that zero padding and
+    // ReLU outputs are exact.
+    inline float GetUnsignedScale(const ActivationRange& range)
+    {
+        return (range.max > 0.0f) ? range.max / 255.0f : 1.0f;
+    }
+}
@@ -1,42 +1,72 @@
 //
 // StepTimer.h - A simple timer that provides elapsed time information
 //
+// The timer reads time from a StepClock: SteadyClock for real time, or VirtualClock, which
+// only moves when told to, for deterministic replay and headless runs at a simulated rate.
+//
 
 #pragma once
 
+#include <chrono>
 #include <cmath>
-#include <exception>
+#include <cstdlib>
 #include <stdint.h>
 
 namespace DX
 {
-    // Helper class for animation and simulation timing.
+    // Source of time for StepTimer, as a counter that runs at a fixed frequency
+    class StepClock
+    {
+    public:
+        virtual ~StepClock() = default;
+
+        virtual uint64_t GetFrequency() const = 0;
+        virtual uint64_t GetCounter() const = 0;
+    };
+
+    // Real time, from std::chrono::steady_clock, which is the performance counter on Windows
+    class SteadyClock : public StepClock
+    {
+    public:
+        uint64_t GetFrequency() const override
+        {
+            typedef std::chrono::steady_clock::period Period;
+            return static_cast<uint64_t>(Period::den / Period::num);
+        }
+
+        uint64_t GetCounter() const override
+        {
+            return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        }
+
+        static SteadyClock& Get()
+        {
+            static SteadyClock clock;
+            return clock;
+        }
+    };
+
+    // Helper class for animation and simulation timing. The clock must outlive the timer.
     class StepTimer
     {
     public:
-        StepTimer() noexcept(false) :
+        explicit StepTimer(const StepClock& clock = SteadyClock::Get()) :
+            m_clock(&clock),
             m_elapsedTicks(0),
             m_totalTicks(0),
             m_leftOverTicks(0),
             m_frameCount(0),
             m_framesPerSecond(0),
             m_framesThisSecond(0),
-            m_qpcSecondCounter(0),
+            m_clockSecondCounter(0),
             m_isFixedTimeStep(false),
             m_targetElapsedTicks(TicksPerSecond / 60)
         {
-            if (!QueryPerformanceFrequency(&m_qpcFrequency))
-            {
-                throw std::exception( "QueryPerformanceFrequency" );
-            }
-
-            if (!QueryPerformanceCounter(&m_qpcLastTime))
-            {
-                throw std::exception( "QueryPerformanceCounter" );
-            }
+            m_clockFrequency = m_clock->GetFrequency();
+            m_clockLastTime = m_clock->GetCounter();
 
             // Initialize max delta to 1/10 of a second.
-            m_qpcMaxDelta = static_cast<uint64_t>(m_qpcFrequency.QuadPart / 10);
+            m_clockMaxDelta = m_clockFrequency / 10;
         }
 
         // Get elapsed time since the previous Update call.
@@ -72,15 +102,12 @@ namespace DX
 
         void ResetElapsedTime()
         {
-            if (!QueryPerformanceCounter(&m_qpcLastTime))
-            {
-                throw std::exception("QueryPerformanceCounter");
-            }
+            m_clockLastTime = m_clock->GetCounter();
 
             m_leftOverTicks = 0;
             m_framesPerSecond = 0;
             m_framesThisSecond = 0;
-            m_qpcSecondCounter = 0;
+            m_clockSecondCounter = 0;
         }
 
         // Update timer state, calling the specified Update function the appropriate number of times.
@@ -88,27 +115,22 @@ namespace DX
         void Tick(const TUpdate& update)
         {
             // Query the current time.
-            LARGE_INTEGER currentTime;
+            const uint64_t currentTime = m_clock->GetCounter();
 
-            if (!QueryPerformanceCounter(&currentTime))
-            {
-                throw std::exception( "QueryPerformanceCounter" );
-            }
+            uint64_t timeDelta = currentTime - m_clockLastTime;
 
-            uint64_t timeDelta = static_cast<uint64_t>(currentTime.QuadPart - m_qpcLastTime.QuadPart);
-
-            m_qpcLastTime = currentTime;
-            m_qpcSecondCounter += timeDelta;
+            m_clockLastTime = currentTime;
+            m_clockSecondCounter += timeDelta;
 
             // Clamp excessively large time deltas (e.g. after paused in the debugger).
-            if (timeDelta > m_qpcMaxDelta)
+            if (timeDelta > m_clockMaxDelta)
             {
-                timeDelta = m_qpcMaxDelta;
+                timeDelta = m_clockMaxDelta;
             }
 
-            // Convert QPC units into a canonical tick format. This cannot overflow due to the previous clamp.
+            // Convert clock units into a canonical tick format. This cannot overflow due to the previous clamp.
             timeDelta *= TicksPerSecond;
-            timeDelta /= static_cast<uint64_t>(m_qpcFrequency.QuadPart);
+            timeDelta /= m_clockFrequency;
 
             uint32_t lastFrameCount = m_frameCount;
 
@@ -157,19 +179,20 @@ namespace DX
                 m_framesThisSecond++;
             }
 
-            if (m_qpcSecondCounter >= static_cast<uint64_t>(m_qpcFrequency.QuadPart))
+            if (m_clockSecondCounter >= m_clockFrequency)
             {
                 m_framesPerSecond = m_framesThisSecond;
                 m_framesThisSecond = 0;
-                m_qpcSecondCounter %= static_cast<uint64_t>(m_qpcFrequency.QuadPart);
+                m_clockSecondCounter %= m_clockFrequency;
             }
         }
 
     private:
-        // Source timing data uses QPC units.
-        LARGE_INTEGER m_qpcFrequency;
-        LARGE_INTEGER m_qpcLastTime;
-        uint64_t m_qpcMaxDelta;
+        // Source timing data uses clock units.
+        const StepClock* m_clock;
+        uint64_t m_clockFrequency;
+        uint64_t m_clockLastTime;
+        uint64_t m_clockMaxDelta;
 
         // Derived timing data uses a canonical tick format.
         uint64_t m_elapsedTicks;
@@ -180,10 +203,32 @@ namespace DX
         uint32_t m_frameCount;
         uint32_t m_framesPerSecond;
         uint32_t m_framesThisSecond;
-        uint64_t m_qpcSecondCounter;
+        uint64_t m_clockSecondCounter;
 
         // Members for configuring fixed timestep mode.
         bool m_isFixedTimeStep;
         uint64_t m_targetElapsedTicks;
     };
+
+    // Time that only passes when Advance() is called, in StepTimer ticks by default. Advancing by the same steps
+    // replays the same sequence of updates, at any speed.
+    class VirtualClock : public StepClock
+    {
+    public:
+        explicit VirtualClock(uint64_t frequency = StepTimer::TicksPerSecond) :
+            m_frequency(frequency),
+            m_counter(0)
+        {
+        }
+
+        uint64_t GetFrequency() const override          { return m_frequency; }
+        uint64_t GetCounter() const override            { return m_counter; }
+
+        void Advance(uint64_t counts)                   { m_counter += counts; }
+        void AdvanceSeconds(double seconds)             { m_counter += static_cast<uint64_t>(seconds * static_cast<double>(m_frequency) + 0.5); }
+
+    private:
+        uint64_t m_frequency;
+        uint64_t m_counter;
+    };
 }
@@ -0,0 +1,775 @@
+//--------------------------------------------------------------------------------------
+// SuperResolutionModel.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "SuperResolutionModel.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace SuperResolutionModel;
+
+namespace
+{
+    const uint32_t c_noTensor = UINT32_MAX;
+
+    // Accepts positive decimal integers only.
+    bool ParseCount(const std::string& token, uint32_t& value)
+    {
+        if (token.empty() || token.size() > 9 || token.find_first_not_of("0123456789") != std::string::npos)
+        {
+            return false;
+        }
+
+        value = static_cast<uint32_t>(strtoul(token.c_str(), nullptr, 10));
+        return value > 0;
+    }
+
+    // Filter sizes are given as HEIGHTxWIDTH.
+    bool ParseKernelSize(const std::string& token, uint32_t& height, uint32_t& width)
+    {
+        const size_t separator = token.find('x');
+        return separator != std::string::npos &&
+            ParseCount(token.substr(0, separator), height) &&
+            ParseCount(token.substr(separator + 1), width);
+    }
+
+    uint32_t FindRoot(std::vector<uint32_t>& parents, uint32_t tensor)
+    {
+        while (parents[tensor] != tensor)
+        {
+            tensor = parents[tensor] = parents[parents[tensor]];
+        }
+        return tensor;
+    }
+}
+
+bool Graph::Load(const std::string& path)
+{
+    std::ifstream input(path, std::ifstream::binary);
+    if (!input.is_open())
+    {
+        std::cerr << "Unable to open model graph: " << path << std::endl;
+        return false;
+    }
+
+    std::stringstream text;
+    text << input.rdbuf();
+    return Parse(text.str(), path);
+}
+
+bool Graph::Parse(const std::string& text, const std::string& sourceName)
+{
+    m_tensors.clear();
+    m_ops.clear();
+    m_convLayers.clear();
+    m_inputTensor = c_noTensor;
+    m_outputTensor = c_noTensor;
+    m_bufferCount = 0;
+
+    std::istringstream lines(text);
+    std::string line;
+    int lineNumber = 0;
+
+    auto reportError = [&](const std::string& message)
+    {
+        std::cerr << sourceName << "(" << lineNumber << "): " << message << std::endl;
+        return false;
+    };
+
+    auto findTensor = [&](const std::string& name)
+    {
+        for (uint32_t i = 0; i < m_tensors.size(); i++)
+        {
+            if (m_tensors[i].name == name)
+            {
+                return i;
+            }
+        }
+        return c_noTensor;
+    };
+
+    while (std::getline(lines, line))
+    {
+        lineNumber++;
+
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+
+        std::istringstream tokenStream(line);
+        std::vector<std::string> tokens;
+        for (std::string token; tokenStream >> token; )
+        {
+            tokens.push_back(token);
+        }
+
+        if (tokens.empty())
+        {
+            continue;
+        }
+
+        const std::string& op = tokens[0];
+
+        if (m_outputTensor != c_noTensor)
+        {
+            return reportError("The output must be the last declaration");
+        }
+
+        if (op == "output")
+        {
+            if (tokens.size() != 2)
+            {
+                return reportError("Expected: output <tensor>");
+            }
+
+            m_outputTensor = findTensor(tokens[1]);
+            if (m_outputTensor == c_noTensor || m_ops.empty() || m_ops.back().output != m_outputTensor)
+            {
+                return reportError("The output must be the result of the last operation: " + tokens[1]);
+            }
+            continue;
+        }
+
+        // Every other declaration defines a new tensor
+        if (tokens.size() < 2 || findTensor(tokens[1]) != c_noTensor)
+        {
+            return reportError("Missing or duplicate tensor name");
+        }
+
+        TensorDesc tensor = { tokens[1], 0, 1, 0 };
+
+        if (op == "input")
+        {
+            if (tokens.size() != 3 || !ParseCount(tokens[2], tensor.channels))
+            {
+                return reportError("Expected: input <tensor> <channels>");
+            }
+            if (m_inputTensor != c_noTensor || !m_tensors.empty())
+            {
+                return reportError("The input must be the first and only input declaration");
+            }
+
+            m_inputTensor = 0;
+            m_tensors.push_back(tensor);
+            continue;
+        }
+
+        if (m_inputTensor == c_noTensor)
+        {
+            return reportError("The input must be declared first");
+        }
+
+        OpDesc opDesc = {};
+        opDesc.output = static_cast<uint32_t>(m_tensors.size());
+        opDesc.addendUpsampleFactor = 1;
+
+        if (op == "upsample")
+        {
+            opDesc.type = OpType::Upsample;
+            if (tokens.size() != 4 || !ParseCount(tokens[3], opDesc.upsampleFactor) || opDesc.upsampleFactor < 2)
+            {
+                return reportError("Expected: upsample <tensor> <input> <factor>");
+            }
+        }
+        else if (op == "conv")
+        {
+            opDesc.type = OpType::Convolution;
+            opDesc.upsampleFactor = 1;
+
+            ConvLayerDesc layer = {};
+            layer.name = tensor.name;
+            if (tokens.size() < 6 || tokens.size() > 7 ||
+                !ParseCount(tokens[3], layer.filterSizes[0]) ||
+                !ParseKernelSize(tokens[4], layer.filterSizes[2], layer.filterSizes[3]) ||
+                (tokens.size() == 7 && tokens[6] != "bn-relu"))
+            {
+                return reportError("Expected: conv <tensor> <input> <filters> <height>x<width> <weights> [bn-relu]");
+            }
+
+            layer.weightsName = tokens[5] + "/weights";
+            if (tokens.size() == 7)
+            {
+                layer.scaleName = tokens[5] + "/BatchNorm/scale";
+                layer.shiftName = tokens[5] + "/BatchNorm/shift";
+            }
+
+            opDesc.convLayer = static_cast<uint32_t>(m_convLayers.size());
+            m_convLayers.push_back(layer);
+        }
+        else if (op == "add")
+        {
+            opDesc.type = OpType::Add;
+            if (tokens.size() != 4)
+            {
+                return reportError("Expected: add <tensor> <input> <input>");
+            }
+        }
+        else
+        {
+            return reportError("Unknown declaration: " + op);
+        }
+
+        for (uint32_t i = 0; i < GetInputCount(opDesc); i++)
+        {
+            opDesc.inputs[i] = findTensor(tokens[2 + i]);
+            if (opDesc.inputs[i] == c_noTensor)
+            {
+                return reportError("Undefined tensor: " + tokens[2 + i]);
+            }
+        }
+
+        const TensorDesc& input = m_tensors[opDesc.inputs[0]];
+
+        switch (opDesc.type)
+        {
+        case OpType::Upsample:
+            tensor.channels = input.channels;
+            tensor.scale = input.scale * opDesc.upsampleFactor;
+            break;
+
+        case OpType::Convolution:
+        case OpType::ConvolutionAdd:
+        {
+            ConvLayerDesc& layer = m_convLayers.back();
+            layer.filterSizes[1] = input.channels;
+            tensor.channels = layer.filterSizes[0];
+            tensor.scale = input.scale;
+            break;
+        }
+
+        case OpType::Add:
+        {
+            const TensorDesc& other = m_tensors[opDesc.inputs[1]];
+            if (input.channels != other.channels || input.scale != other.scale)
+            {
+                return reportError("Both inputs of an add must have the same shape");
+            }
+            tensor.channels = input.channels;
+            tensor.scale = input.scale;
+            break;
+        }
+        }
+
+        m_tensors.push_back(tensor);
+        m_ops.push_back(opDesc);
+    }
+
+    if (m_outputTensor == c_noTensor)
+    {
+        return reportError("Missing output declaration");
+    }
+
+    if (GetOutput().channels != GetInput().channels)
+    {
+        return reportError("The output must have as many channels as the input");
+    }
+
+    AssignBuffers();
+    AssignBarriers();
+    return true;
+}
+
+// Each tensor lives from the op that produces it to the last op that reads it. An add may write its result over
+// an input that is read for the last time, and so may a ConvolutionAdd over the tensor it adds, since each output
+// value only reads the value of that tensor in its place. The tensors of such a chain form one group that shares a
+// buffer. The groups of the model input and output get the input and output buffers, and every other group gets an
+// intermediate buffer with the lifetime of the group. Where the intermediate buffers are stored, and which of them
+// share memory, is left to MemoryPlanner.
+void Graph::AssignBuffers()
+{
+    const uint32_t tensorCount = static_cast<uint32_t>(m_tensors.size());
+    const uint32_t opCount = static_cast<uint32_t>(m_ops.size());
+
+    std::vector<uint32_t> firstDef(tensorCount, 0);
+    std::vector<uint32_t> lastUse(tensorCount, 0);
+    for (uint32_t i = 0; i < opCount; i++)
+    {
+        const OpDesc& op = m_ops[i];
+        firstDef[op.output] = lastUse[op.output] = i;
+        for (uint32_t k = 0; k < GetInputCount(op); k++)
+        {
+            lastUse[op.inputs[k]] = i;
+        }
+    }
+    lastUse[m_outputTensor] = opCount;
+
+    std::vector<uint32_t> parents(tensorCount);
+    for (uint32_t t = 0; t < tensorCount; t++)
+    {
+        parents[t] = t;
+    }
+
+    for (uint32_t i = 0; i < opCount; i++)
+    {
+        const OpDesc& op = m_ops[i];
+        if ((op.type == OpType::Add || op.type == OpType::ConvolutionAdd) && op.inputs[0] != op.inputs[1])
+        {
+            // A convolution reads the neighbors of each pixel of its input, and an upsampled addend is smaller than
+            // the output, so neither is ever written over
+            const uint32_t end = (op.addendUpsampleFactor == 1) ? 2 : 1;
+            for (uint32_t k = (op.type == OpType::Add) ? 0 : 1; k < end; k++)
+            {
+                const uint32_t input = op.inputs[k];
+                if (input != m_inputTensor && lastUse[input] == i)
+                {
+                    parents[FindRoot(parents, op.output)] = FindRoot(parents, input);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Lifetime of each group, stored at its root
+    std::vector<uint32_t> groupStart(tensorCount, UINT32_MAX);
+    std::vector<uint32_t> groupEnd(tensorCount, 0);
+    for (uint32_t t = 0; t < tensorCount; t++)
+    {
+        const uint32_t root = FindRoot(parents, t);
+        groupStart[root] = std::min(groupStart[root], firstDef[t]);
+        groupEnd[root] = std::max(groupEnd[root], lastUse[t]);
+    }
+
+    std::vector<uint32_t> groupBuffer(tensorCount, UINT32_MAX);
+    groupBuffer[FindRoot(parents, m_inputTensor)] = c_inputBuffer;
+    groupBuffer[FindRoot(parents, m_outputTensor)] = c_outputBuffer;
+
+    // The output stays live after the last op
+    m_bufferFirstOp.assign(c_firstIntermediateBuffer, 0);
+    m_bufferLastOp.assign(c_firstIntermediateBuffer, opCount - 1);
+
+    // Ops produce the tensors in order, so visiting roots by first definition numbers groups by start time.
+    for (uint32_t i = 0; i < opCount; i++)
+    {
+        const uint32_t root = FindRoot(parents, m_ops[i].output);
+        if (groupBuffer[root] != UINT32_MAX)
+        {
+            continue;
+        }
+
+        groupBuffer[root] = static_cast<uint32_t>(m_bufferFirstOp.size());
+        m_bufferFirstOp.push_back(groupStart[root]);
+        m_bufferLastOp.push_back(groupEnd[root]);
+    }
+
+    for (uint32_t t = 0; t < tensorCount; t++)
+    {
+        m_tensors[t].buffer = groupBuffer[FindRoot(parents, t)];
+    }
+    m_bufferCount = static_cast<uint32_t>(m_bufferFirstOp.size());
+}
+
+void Graph::AssignBarriers()
+{
+    std::vector<bool> written(m_bufferCount, false);
+    std::vector<bool> read(m_bufferCount, false);
+
+    for (OpDesc& op : m_ops)
+    {
+        const uint32_t outputBuffer = m_tensors[op.output].buffer;
+
+        op.barrierBefore = written[outputBuffer] || read[outputBuffer];
+        for (uint32_t k = 0; k < GetInputCount(op); k++)
+        {
+            op.barrierBefore = op.barrierBefore || written[m_tensors[op.inputs[k]].buffer];
+        }
+
+        if (op.barrierBefore)
+        {
+            std::fill(written.begin(), written.end(), false);
+            std::fill(read.begin(), read.end(), false);
+        }
+
+        for (uint32_t k = 0; k < GetInputCount(op); k++)
+        {
+            read[m_tensors[op.inputs[k]].buffer] = true;
+        }
+        written[outputBuffer] = true;
+    }
+}
+
+void Graph::GetConcurrentOps(uint32_t op, uint32_t& firstOpOut, uint32_t& lastOpOut) const
+{
+    firstOpOut = op;
+    while (!m_ops[firstOpOut].barrierBefore && firstOpOut > 0)
+    {
+        firstOpOut--;
+    }
+
+    lastOpOut = op;
+    while (lastOpOut + 1 < m_ops.size() && !m_ops[lastOpOut + 1].barrierBefore)
+    {
+        lastOpOut++;
+    }
+}
+
+// Ops between two barriers may run in any order, or at the same time, so a buffer is live for the whole of the
+// barrier intervals it is first written and last read in.
+void Graph::GetBufferLifetime(uint32_t buffer, uint32_t& firstOpOut, uint32_t& lastOpOut) const
+{
+    uint32_t unused;
+    GetConcurrentOps(m_bufferFirstOp[buffer], firstOpOut, unused);
+    GetConcurrentOps(m_bufferLastOp[buffer], unused, lastOpOut);
+}
+
+// Walks the graph backwards from the output, tracking how much context each tensor needs in its own pixels.
+uint32_t Graph::GetInputHalo() const
+{
+    std::vector<uint32_t> halo(m_tensors.size(), 0);
+
+    for (auto op = m_ops.rbegin(); op != m_ops.rend(); ++op)
+    {
+        uint32_t inputHalo = halo[op->output];
+
+        // The tensor an add adds is read pixel by pixel, at the resolution of the output or upsampled to it
+        if (op->type == OpType::Add || op->type == OpType::ConvolutionAdd)
+        {
+            const uint32_t addendHalo = (inputHalo + op->addendUpsampleFactor - 1) / op->addendUpsampleFactor;
+            halo[op->inputs[1]] = std::max(halo[op->inputs[1]], addendHalo);
+        }
+
+        switch (op->type)
+        {
+        case OpType::Upsample:
+            inputHalo = (inputHalo + op->upsampleFactor - 1) / op->upsampleFactor;
+            break;
+
+        case OpType::Convolution:
+        case OpType::ConvolutionAdd:
+        {
+            uint32_t startPadding[2], endPadding[2];
+            GetConvPadding(m_convLayers[op->convLayer].filterSizes, startPadding, endPadding);
+            inputHalo += std::max(std::max(startPadding[0], startPadding[1]), std::max(endPadding[0], endPadding[1]));
+            inputHalo = (inputHalo + op->upsampleFactor - 1) / op->upsampleFactor;
+            break;
+        }
+
+        case OpType::Add:
+            break;
+        }
+
+        halo[op->inputs[0]] = std::max(halo[op->inputs[0]], inputHalo);
+    }
+
+    return halo[m_inputTensor];
+}
+
+uint32_t Graph::FuseUpsampleConvolutions()
+{
+    const uint32_t tensorCount = static_cast<uint32_t>(m_tensors.size());
+
+    // An upsample can be fused if every op that reads its result is a convolution of an input at its own resolution
+    std::vector<bool> fusable(tensorCount, false);
+    for (const OpDesc& op : m_ops)
+    {
+        fusable[op.output] = (op.type == OpType::Upsample && op.output != m_outputTensor);
+    }
+    for (const OpDesc& op : m_ops)
+    {
+        for (uint32_t k = 0; k < GetInputCount(op); k++)
+        {
+            if (op.type != OpType::Convolution || op.upsampleFactor != 1)
+            {
+                fusable[op.inputs[k]] = false;
+            }
+        }
+    }
+
+    // Point the convolutions at the upsample input, and drop the upsamples and their results
+    std::vector<uint32_t> producer(tensorCount, c_noTensor);
+    for (uint32_t i = 0; i < m_ops.size(); i++)
+    {
+        producer[m_ops[i].output] = i;
+    }
+
+    for (OpDesc& op : m_ops)
+    {
+        if (op.type == OpType::Convolution && fusable[op.inputs[0]])
+        {
+            const OpDesc& upsample = m_ops[producer[op.inputs[0]]];
+            op.upsampleFactor = upsample.upsampleFactor;
+            op.inputs[0] = upsample.inputs[0];
+        }
+    }
+
+    return RemoveTensors(fusable);
+}
+
+uint32_t Graph::FuseConvolutionAdds()
+{
+    const uint32_t tensorCount = static_cast<uint32_t>(m_tensors.size());
+
+    std::vector<uint32_t> producer(tensorCount, c_noTensor);
+    std::vector<uint32_t> readCount(tensorCount, 0);
+    for (uint32_t i = 0; i < m_ops.size(); i++)
+    {
+        producer[m_ops[i].output] = i;
+        for (uint32_t k = 0; k < GetInputCount(m_ops[i]); k++)
+        {
+            readCount[m_ops[i].inputs[k]]++;
+        }
+    }
+
+    // The convolution takes the add's output and other input, and its own result is dropped along with the add
+    std::vector<bool> removed(tensorCount, false);
+    for (OpDesc& add : m_ops)
+    {
+        if (add.type != OpType::Add || add.inputs[0] == add.inputs[1])
+        {
+            continue;
+        }
+
+        // An upsampled addend is not at the resolution of the output, so only the first input can be the convolution
+        const uint32_t candidates = (add.addendUpsampleFactor == 1) ? 2 : 1;
+        for (uint32_t k = 0; k < candidates; k++)
+        {
+            const uint32_t convResult = add.inputs[k];
+            if (producer[convResult] == c_noTensor || readCount[convResult] != 1 || convResult == m_outputTensor)
+            {
+                continue;
+            }
+
+            OpDesc& conv = m_ops[producer[convResult]];
+            if (conv.type != OpType::Convolution || conv.upsampleFactor != 1)
+            {
+                continue;
+            }
+
+            // The added tensor must already exist when the convolution runs
+            const uint32_t addend = add.inputs[1 - k];
+            if (addend != m_inputTensor && producer[addend] > producer[convResult])
+            {
+                continue;
+            }
+
+            conv.type = OpType::ConvolutionAdd;
+            conv.inputs[1] = addend;
+            conv.addendUpsampleFactor = add.addendUpsampleFactor;
+            conv.output = add.output;
+            producer[conv.output] = producer[convResult];
+            add.output = convResult;
+            removed[convResult] = true;
+            break;
+        }
+    }
+
+    return RemoveTensors(removed);
+}
+
+uint32_t Graph::FuseUpsampleAdds()
+{
+    const uint32_t tensorCount = static_cast<uint32_t>(m_tensors.size());
+
+    // An upsample can be fused if every op that reads its result is an add that reads it once, as the tensor it adds.
+    // A ConvolutionAdd only adds its second input, and an add can read only one of its inputs upsampled.
+    std::vector<bool> fusable(tensorCount, false);
+    for (const OpDesc& op : m_ops)
+    {
+        fusable[op.output] = (op.type == OpType::Upsample && op.output != m_outputTensor);
+    }
+    for (const OpDesc& op : m_ops)
+    {
+        const bool add = (op.type == OpType::Add || op.type == OpType::ConvolutionAdd) &&
+            op.inputs[0] != op.inputs[1] && op.addendUpsampleFactor == 1;
+        for (uint32_t k = 0; k < GetInputCount(op); k++)
+        {
+            if (!add || (k == 0 && (op.type == OpType::ConvolutionAdd || fusable[op.inputs[1]])))
+            {
+                fusable[op.inputs[k]] = false;
+            }
+        }
+    }
+
+    // Point the adds at the upsample input, as their second input, and drop the upsamples and their results
+    std::vector<uint32_t> producer(tensorCount, c_noTensor);
+    for (uint32_t i = 0; i < m_ops.size(); i++)
+    {
+        producer[m_ops[i].output] = i;
+    }
+
+    for (OpDesc& op : m_ops)
+    {
+        if (op.type != OpType::Add && op.type != OpType::ConvolutionAdd)
+        {
+            continue;
+        }
+
+        if (fusable[op.inputs[0]])
+        {
+            std::swap(op.inputs[0], op.inputs[1]);
+        }
+        if (fusable[op.inputs[1]])
+        {
+            const OpDesc& upsample = m_ops[producer[op.inputs[1]]];
+            op.addendUpsampleFactor = upsample.upsampleFactor;
+            op.inputs[1] = upsample.inputs[0];
+        }
+    }
+
+    return RemoveTensors(fusable);
+}
+
+bool Graph::SplitResidualOutput()
+{
+    if (m_ops.empty() || m_ops.back().type != OpType::Add || m_ops.back().output != m_outputTensor)
+    {
+        return false;
+    }
+
+    // One input of the final add must be the model input, upsampled to the output size, either by an upsample or as
+    // the add reads it
+    const OpDesc& add = m_ops.back();
+    uint32_t residual = c_noTensor;
+    uint32_t base = c_noTensor;
+    if (add.addendUpsampleFactor > 1)
+    {
+        if (add.inputs[1] == m_inputTensor && add.addendUpsampleFactor == GetUpscaleFactor())
+        {
+            residual = add.inputs[0];
+        }
+    }
+    else
+    {
+        for (uint32_t k = 0; k < 2; k++)
+        {
+            for (const OpDesc& op : m_ops)
+            {
+                if (op.output == add.inputs[k] && op.type == OpType::Upsample && op.inputs[0] == m_inputTensor &&
+                    m_tensors[op.output].scale == GetUpscaleFactor())
+                {
+                    base = add.inputs[k];
+                    residual = add.inputs[1 - k];
+                }
+            }
+        }
+    }
+    if (residual == c_noTensor || residual == base || m_tensors[residual].channels != GetInput().channels)
+    {
+        return false;
+    }
+
+    // Drop the add, and the upsample unless something else reads it
+    std::vector<bool> removed(m_tensors.size(), false);
+    removed[m_outputTensor] = true;
+    if (base != c_noTensor)
+    {
+        removed[base] = true;
+        for (size_t i = 0; i + 1 < m_ops.size(); i++)
+        {
+            for (uint32_t k = 0; k < GetInputCount(m_ops[i]); k++)
+            {
+                removed[base] = removed[base] && (m_ops[i].inputs[k] != base);
+            }
+        }
+    }
+
+    m_outputTensor = residual;
+    RemoveTensors(removed);
+    return true;
+}
+
+uint32_t Graph::RemoveTensors(const std::vector<bool>& removed)
+{
+    const uint32_t tensorCount = static_cast<uint32_t>(m_tensors.size());
+
+    std::vector<uint32_t> newIndex(tensorCount, c_noTensor);
+    std::vector<TensorDesc> tensors;
+    for (uint32_t t = 0; t < tensorCount; t++)
+    {
+        if (!removed[t])
+        {
+            newIndex[t] = static_cast<uint32_t>(tensors.size());
+            tensors.push_back(m_tensors[t]);
+        }
+    }
+
+    uint32_t removedCount = 0;
+    std::vector<OpDesc> ops;
+    for (OpDesc op : m_ops)
+    {
+        if (removed[op.output])
+        {
+            removedCount++;
+            continue;
+        }
+
+        for (uint32_t k = 0; k < GetInputCount(op); k++)
+        {
+            op.inputs[k] = newIndex[op.inputs[k]];
+        }
+        op.output = newIndex[op.output];
+        ops.push_back(op);
+    }
+
+    m_tensors.swap(tensors);
+    m_ops.swap(ops);
+    m_inputTensor = newIndex[m_inputTensor];
+    m_outputTensor = newIndex[m_outputTensor];
+
+    AssignBuffers();
+    AssignBarriers();
+    return removedCount;
+}
+
+OpCost SuperResolutionModel::GetOpCost(const Graph& graph, uint32_t opIndex, uint32_t height, uint32_t width, uint32_t bytesPerElement)
+{
+    const OpDesc& op = graph.GetOps()[opIndex];
+    const std::vector<TensorDesc>& tensors = graph.GetTensors();
+
+    auto getElementCount = [&](uint32_t tensor)
+    {
+        return uint64_t(tensors[tensor].channels) * height * width * tensors[tensor].scale * tensors[tensor].scale;
+    };
+
+    OpCost cost = {};
+    for (uint32_t k = 0; k < GetInputCount(op); k++)
+    {
+        cost.bytes += getElementCount(op.inputs[k]) * bytesPerElement;
+    }
+    cost.bytes += getElementCount(op.output) * bytesPerElement;
+
+    switch (op.type)
+    {
+    case OpType::Upsample:
+        break;
+
+    case OpType::Convolution:
+    case OpType::ConvolutionAdd:
+    {
+        const uint32_t* filterSizes = graph.GetConvLayers()[op.convLayer].filterSizes;
+        uint64_t taps = uint64_t(filterSizes[1]) * filterSizes[2] * filterSizes[3];
+
+        if (op.upsampleFactor > 1)
+        {
+            // Every phase runs the smaller filter at every input pixel, which costs the same as running it once per
+            // output pixel.
+            uint32_t subpixelSize[2];
+            GetSubpixelFilterSize(filterSizes, op.upsampleFactor, subpixelSize);
+            taps = uint64_t(filterSizes[1]) * subpixelSize[0] * subpixelSize[1];
+            cost.bytes += 2 * getElementCount(op.output) * bytesPerElement;
+        }
+
+        cost.flops = 2 * taps * getElementCount(op.output);
+        if (op.type == OpType::ConvolutionAdd)
+        {
+            cost.flops += getElementCount(op.output);
+        }
+        break;
+    }
+
+    case OpType::Add:
+        cost.flops = getElementCount(op.output);
+        break;
+    }
+
+    return cost;
+}
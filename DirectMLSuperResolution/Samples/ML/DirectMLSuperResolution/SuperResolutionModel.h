@@ -0,0 +1,217 @@
+//--------------------------------------------------------------------------------------
+// SuperResolutionModel.h
+//
+// Description of the super-resolution model, shared by the DirectML and CPU paths. The
+// layers are read from a text graph description (see Assets/model.txt), which also gives
+// the buffer each intermediate result is stored in, how long that buffer is live, and the
+// order the layers run in.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SuperResolutionModel
+{
+    enum class OpType
+    {
+        Upsample,       // Nearest neighbor
+        Convolution,    // Optionally with premultiplied batch normalization, followed by ReLU
+        Add,
+        ConvolutionAdd  // Convolution of the first input, plus the second (see Graph::FuseConvolutionAdds)
+    };
+
+    struct ConvLayerDesc
+    {
+        std::string name;
+        uint32_t    filterSizes[4];     // Output filters, input channels, filter height, filter width
+        std::string weightsName;
+        std::string scaleName;          // Empty if the layer has no batch normalization, bias or activation
+        std::string shiftName;
+    };
+
+    // Every tensor of the graph has the batch size of the model input, and a height and width that are a
+    // multiple of the input's.
+    struct TensorDesc
+    {
+        std::string name;
+        uint32_t    channels;
+        uint32_t    scale;
+        uint32_t    buffer;             // c_inputBuffer, c_outputBuffer or an intermediate buffer
+    };
+
+    struct OpDesc
+    {
+        OpType      type;
+        uint32_t    inputs[2];          // Tensor indices. Only Add and ConvolutionAdd use the second one.
+        uint32_t    output;
+        uint32_t    upsampleFactor;     // Upsample, or a convolution of its input upsampled by this factor (1 if not)
+        uint32_t    convLayer;          // Convolutions only, index into Graph::GetConvLayers()
+
+        // Add and ConvolutionAdd read their second input upsampled by this factor with nearest neighbor sampling, so
+        // it is 1 / factor the size of the output (1 if not, see Graph::FuseUpsampleAdds)
+        uint32_t    addendUpsampleFactor;
+
+        // The op reads a buffer written since the previous barrier, or overwrites one read or written since then.
+        // Ops between two barriers are independent of each other.
+        bool        barrierBefore;
+    };
+
+    // The model input and output are stored in buffers of their own. Every other tensor is stored in one of the
+    // intermediate buffers, which start at c_firstIntermediateBuffer. Tensors only share a buffer when an add writes
+    // over one of its inputs, or a ConvolutionAdd over the tensor it adds; intermediate buffers that are not live at
+    // the same time share memory instead, as planned by MemoryPlanner.
+    static const uint32_t c_inputBuffer = 0;
+    static const uint32_t c_outputBuffer = 1;
+    static const uint32_t c_firstIntermediateBuffer = 2;
+
+    class Graph
+    {
+    public:
+        // Parses and validates a graph description, then assigns buffers and barriers. Reports errors to stderr.
+        bool Load(const std::string& path);
+        bool Parse(const std::string& text, const std::string& sourceName);
+
+        // Ops are in dispatch order.
+        const std::vector<TensorDesc>& GetTensors() const { return m_tensors; }
+        const std::vector<OpDesc>& GetOps() const { return m_ops; }
+        const std::vector<ConvLayerDesc>& GetConvLayers() const { return m_convLayers; }
+
+        const TensorDesc& GetInput() const { return m_tensors[m_inputTensor]; }
+        const TensorDesc& GetOutput() const { return m_tensors[m_outputTensor]; }
+        uint32_t GetUpscaleFactor() const { return GetOutput().scale; }
+        uint32_t GetBufferCount() const { return m_bufferCount; }
+
+        // Number of input pixels on each side of a region that contribute to its output, i.e. the receptive field
+        // of the model measured at the input resolution. A tile extended by this much context produces exactly
+        // the same output as the whole frame.
+        uint32_t GetInputHalo() const;
+
+        // Rewrites each nearest neighbor upsample that is only read by convolutions into those convolutions, which
+        // then run at the input resolution (see GetSubpixelFilterSize), and assigns buffers and barriers again.
+        // Returns the number of upsamples removed. The results are equal up to rounding.
+        uint32_t FuseUpsampleConvolutions();
+
+        // If the output is the model input, upsampled with nearest neighbor sampling, plus a residual image, makes
+        // the residual the output and drops the add, along with the upsample unless something else reads it. The
+        // caller adds the upsampled input itself, fused with its conversion of the output (see
+        // ColorConversion::TensorToImage). Returns false, leaving the graph unchanged, if the output is not a
+        // residual add. Call it before FuseConvolutionAdds(), which would take the add.
+        bool SplitResidualOutput();
+
+        // Rewrites each add of a convolution result that nothing else reads into a ConvolutionAdd, which adds the
+        // other input as it stores the convolution's output, after any activation, and assigns buffers and
+        // barriers again. The result can then be written over the added tensor, so the convolution result needs no
+        // buffer of its own. Convolutions of an upsampled input are left alone. Returns the number of adds removed.
+        // The results are the same. Only the CPU engine runs ConvolutionAdd, since DirectML has no convolution that
+        // adds a tensor.
+        uint32_t FuseConvolutionAdds();
+
+        // Rewrites each nearest neighbor upsample that is only read by adds, as the tensor they add, into those adds,
+        // which then read the upsample input through an index transform (see OpDesc::addendUpsampleFactor), and
+        // assigns buffers and barriers again. The upsampled tensor is never stored, and an add no longer writes over
+        // it. Returns the number of upsamples removed. The results are the same.
+        uint32_t FuseUpsampleAdds();
+
+        // First and last op, inclusive, during which a buffer may be accessed. Memory that is not in use by a buffer
+        // during that time can be reused for it.
+        void GetBufferLifetime(uint32_t buffer, uint32_t& firstOpOut, uint32_t& lastOpOut) const;
+
+        // First and last op, inclusive, of the ops that may run at the same time as an op, i.e. that have no
+        // barrier between them. Storage the op uses while it runs must not be shared with these.
+        void GetConcurrentOps(uint32_t op, uint32_t& firstOpOut, uint32_t& lastOpOut) const;
+
+    private:
+        // Drops the tensors and the ops that produce them, and assigns buffers and barriers again. Returns the
+        // number of ops removed.
+        uint32_t RemoveTensors(const std::vector<bool>& removed);
+
+        void AssignBuffers();
+        void AssignBarriers();
+
+        std::vector<TensorDesc>     m_tensors;
+        std::vector<OpDesc>         m_ops;
+        std::vector<ConvLayerDesc>  m_convLayers;
+        uint32_t                    m_inputTensor = 0;
+        uint32_t                    m_outputTensor = 0;
+        uint32_t                    m_bufferCount = 0;
+        std::vector<uint32_t>       m_bufferFirstOp;    // First write and last read of each buffer
+        std::vector<uint32_t>       m_bufferLastOp;
+    };
+
+    inline uint32_t GetInputCount(const OpDesc& op)
+    {
+        return (op.type == OpType::Add || op.type == OpType::ConvolutionAdd) ? 2 : 1;
+    }
+
+    inline bool IsConvolution(const OpDesc& op)
+    {
+        return op.type == OpType::Convolution || op.type == OpType::ConvolutionAdd;
+    }
+
+    inline bool UsesBiasAndActivation(const ConvLayerDesc& layer)
+    {
+        return !layer.scaleName.empty();
+    }
+
+    // The output size of a convolution operation is given by:
+    //  height = (inputHeight - filterHeight + 2*paddingHeight) / filterStride + 1
+    //  width  = (inputWidth  - filterWidth  + 2*paddingWidth ) / filterStride + 1
+    //
+    // We want to preserve the height and width, so assuming stride is 1, we get:
+    //  paddingHeight = (filterHeight - 1) / 2
+    //  paddingWidth  = (filterWidth  - 1) / 2
+    // If padding is fractional, we pad unevenly with ceil/floor.
+    inline void GetConvPadding(
+        const uint32_t* filterSizes,
+        uint32_t* startPaddingOut,      // Top, left
+        uint32_t* endPaddingOut)        // Bottom, right
+    {
+        startPaddingOut[0] = filterSizes[2] / 2;
+        startPaddingOut[1] = filterSizes[3] / 2;
+        endPaddingOut[0] = (filterSizes[2] - 1) / 2;
+        endPaddingOut[1] = (filterSizes[3] - 1) / 2;
+    }
+
+    // A convolution of an input upsampled by nearest neighbor is the same as factor x factor convolutions of the
+    // original input, one per phase (output position within each factor x factor block), followed by a depth to
+    // space shuffle. Every tap of the original filter falls on one input pixel, and taps that fall on the same
+    // pixel are summed. With padding P, output phase p reads input offsets floor((p - P) / factor) to
+    // floor((p - P + filterSize - 1) / factor).
+    //
+    // This gives the filter height and width at the input resolution that covers the offsets of all phases and is
+    // padded as in GetConvPadding, e.g. 3x3 for a 5x5 filter after a 2x upsample. Unused taps are zero.
+    inline void GetSubpixelFilterSize(
+        const uint32_t* filterSizes,
+        uint32_t factor,
+        uint32_t* sizeOut)              // Height, width
+    {
+        uint32_t startPadding[2], endPadding[2];
+        GetConvPadding(filterSizes, startPadding, endPadding);
+
+        for (int i = 0; i < 2; i++)
+        {
+            const uint32_t before = (startPadding[i] + factor - 1) / factor;
+            const uint32_t after = (factor - 1 + endPadding[i]) / factor;
+            sizeOut[i] = (2 * before > 2 * after + 1) ? 2 * before : 2 * after + 1;
+        }
+    }
+
+    // Arithmetic and memory traffic of one op, for a batch of one at the given model input size. A multiply-add
+    // counts as two operations. Traffic assumes each input is read and the output written once, plus the phase
+    // results of a fused upsample and convolution, which are written and read again by the shuffle.
+    struct OpCost
+    {
+        uint64_t    flops;
+        uint64_t    bytes;
+    };
+
+    OpCost GetOpCost(const Graph& graph, uint32_t op, uint32_t height, uint32_t width, uint32_t bytesPerElement);
+}
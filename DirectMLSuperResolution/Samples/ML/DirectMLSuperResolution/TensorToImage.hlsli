@@ -12,6 +12,7 @@ cbuffer cbCS : register(b0)
     uint g_height;
     uint g_width;
     bool g_nhwc;
+    uint g_batchIndex;  // Image within the batch to read
 };
 
 float4 VsTensorToSurf(float4 position : POSITION) : SV_POSITION
@@ -22,7 +23,7 @@ float4 VsTensorToSurf(float4 position : POSITION) : SV_POSITION
 float4 PsTensorRGB8ToSurf(float4 pos : SV_POSITION) : SV_TARGET
 {
     float4 color;
-    uint index = ((uint)pos.y)*g_width + (uint)pos.x;
+    uint index = (g_height * g_batchIndex + (uint)pos.y)*g_width + (uint)pos.x;
 
     if (g_nhwc)
     {
@@ -34,6 +35,7 @@ float4 PsTensorRGB8ToSurf(float4 pos : SV_POSITION) : SV_TARGET
     else
     {
         uint blockSize = g_height * g_width;
+        index = blockSize * g_batchIndex * 3 + ((uint)pos.y)*g_width + (uint)pos.x;
 
         color.r = input[index];
         color.g = input[index + blockSize];
@@ -47,7 +49,7 @@ float4 PsTensorRGB8ToSurf(float4 pos : SV_POSITION) : SV_TARGET
 float4 PsTensorBGR8ToSurf(float4 pos : SV_POSITION) : SV_TARGET
 {
     float4 color;
-    uint index = ((uint)pos.y)*g_width + (uint)pos.x;
+    uint index = (g_height * g_batchIndex + (uint)pos.y)*g_width + (uint)pos.x;
 
     if (g_nhwc)
     {
@@ -59,6 +61,7 @@ float4 PsTensorBGR8ToSurf(float4 pos : SV_POSITION) : SV_TARGET
     else
     {
         uint blockSize = g_height * g_width;
+        index = blockSize * g_batchIndex * 3 + ((uint)pos.y)*g_width + (uint)pos.x;
 
         color.b = input[index];
         color.g = input[index + blockSize];
@@ -72,7 +75,7 @@ float4 PsTensorBGR8ToSurf(float4 pos : SV_POSITION) : SV_TARGET
 float4 PsTensorGRAY8ToSurf(float4 pos : SV_POSITION) : SV_TARGET
 {
     float4 color;
-    uint yOffset = ((uint)pos.y)*g_width;
+    uint yOffset = (g_height * g_batchIndex * 3 + (uint)pos.y)*g_width;
 
     color.b = input[((uint)pos.x + yOffset)];
     color.g = color.b;
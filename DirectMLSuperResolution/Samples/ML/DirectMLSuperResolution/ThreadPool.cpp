@@ -0,0 +1,456 @@
+//--------------------------------------------------------------------------------------
+// ThreadPool.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <cstdio>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+namespace
+{
+    // Index of the current thread in the pool it belongs to. Other threads are thread 0 of every pool.
+    thread_local const ThreadPool* t_pool = nullptr;
+    thread_local uint32_t t_thread = 0;
+
+    struct Processor
+    {
+        uint32_t    id;
+        uint32_t    node;
+    };
+
+#if defined(__linux__)
+    // Parses a sysfs list such as "0-3,8,10-11"
+    std::vector<uint32_t> ParseList(const std::string& text)
+    {
+        std::vector<uint32_t> values;
+        std::istringstream items(text);
+        for (std::string item; std::getline(items, item, ','); )
+        {
+            unsigned first = 0, last = 0;
+            const int fields = sscanf(item.c_str(), "%u-%u", &first, &last);
+            if (fields == 1)
+            {
+                last = first;
+            }
+            for (unsigned value = first; fields >= 1 && value <= last; value++)
+            {
+                values.push_back(value);
+            }
+        }
+        return values;
+    }
+
+    std::string ReadLine(const std::string& path)
+    {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+    std::vector<Processor> GetAllowedProcessors()
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        {
+            return {};
+        }
+
+        std::vector<uint32_t> nodeOfProcessor(CPU_SETSIZE, 0);
+        for (uint32_t node : ParseList(ReadLine("/sys/devices/system/node/online")))
+        {
+            for (uint32_t processor : ParseList(ReadLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")))
+            {
+                if (processor < CPU_SETSIZE)
+                {
+                    nodeOfProcessor[processor] = node;
+                }
+            }
+        }
+
+        std::vector<Processor> processors;
+        for (uint32_t processor = 0; processor < CPU_SETSIZE; processor++)
+        {
+            if (CPU_ISSET(processor, &allowed))
+            {
+                processors.push_back({ processor, nodeOfProcessor[processor] });
+            }
+        }
+        return processors;
+    }
+
+    void PinCurrentThread(uint32_t processor)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(processor, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#elif defined(_WIN32)
+    // Only the processor group the process runs in, which has up to 64 processors
+    std::vector<Processor> GetAllowedProcessors()
+    {
+        DWORD_PTR processMask = 0, systemMask = 0;
+        if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+        {
+            return {};
+        }
+
+        std::vector<Processor> processors;
+        for (uint32_t processor = 0; processor < sizeof(DWORD_PTR) * 8; processor++)
+        {
+            if ((processMask >> processor) & 1)
+            {
+                UCHAR node = 0;
+                if (!GetNumaProcessorNode(static_cast<UCHAR>(processor), &node) || node == 0xFF)
+                {
+                    node = 0;
+                }
+                processors.push_back({ processor, node });
+            }
+        }
+        return processors;
+    }
+
+    void PinCurrentThread(uint32_t processor)
+    {
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << processor);
+    }
+#else
+    std::vector<Processor> GetAllowedProcessors()
+    {
+        std::vector<Processor> processors;
+        for (uint32_t processor = 0; processor < std::thread::hardware_concurrency(); processor++)
+        {
+            processors.push_back({ processor, 0 });
+        }
+        return processors;
+    }
+
+    void PinCurrentThread(uint32_t)
+    {
+    }
+#endif
+}
+
+ThreadPool::ThreadPool(uint32_t threadCount, Affinity affinity) :
+    m_pendingTasks(0),
+    m_profiling(false)
+{
+    std::vector<Processor> processors = GetAllowedProcessors();
+    if (processors.empty())
+    {
+        processors.push_back({ 0, 0 });
+    }
+    if (threadCount == 0)
+    {
+        threadCount = static_cast<uint32_t>(processors.size());
+    }
+
+    // Order the processors the way threads are pinned to them
+    std::stable_sort(processors.begin(), processors.end(), [](const Processor& a, const Processor& b) { return a.node < b.node; });
+    if (affinity == Affinity::Scatter)
+    {
+        std::vector<std::vector<Processor>> nodes;
+        for (const Processor& processor : processors)
+        {
+            if (nodes.empty() || nodes.back()[0].node != processor.node)
+            {
+                nodes.emplace_back();
+            }
+            nodes.back().push_back(processor);
+        }
+
+        const size_t processorCount = processors.size();
+        processors.clear();
+        for (size_t i = 0; processors.size() < processorCount; i++)
+        {
+            for (const auto& node : nodes)
+            {
+                if (i < node.size())
+                {
+                    processors.push_back(node[i]);
+                }
+            }
+        }
+    }
+
+    for (uint32_t thread = 0; thread < threadCount; thread++)
+    {
+        m_threads.emplace_back(new ThreadState);
+        ThreadState& state = *m_threads.back();
+        state.node = (affinity == Affinity::None) ? 0 : processors[thread % processors.size()].node;
+        state.busy = (thread == 0);
+        state.busyNanoseconds = 0;
+    }
+
+    // Distribute work by node, and steal from the same node first. Each thread starts looking at the thread after
+    // it, so that thieves spread out.
+    for (uint32_t thread = 0; thread < threadCount; thread++)
+    {
+        m_distributionOrder.push_back(thread);
+
+        ThreadState& state = *m_threads[thread];
+        for (int sameNode = 1; sameNode >= 0; sameNode--)
+        {
+            for (uint32_t step = 1; step < threadCount; step++)
+            {
+                const uint32_t victim = (thread + step) % threadCount;
+                if ((m_threads[victim]->node == state.node) == (sameNode != 0))
+                {
+                    state.victims.push_back(victim);
+                }
+            }
+        }
+    }
+    std::stable_sort(m_distributionOrder.begin(), m_distributionOrder.end(),
+        [&](uint32_t a, uint32_t b) { return m_threads[a]->node < m_threads[b]->node; });
+
+    for (uint32_t thread = 0; thread < threadCount; thread++)
+    {
+        m_nodeCount = std::max(m_nodeCount, m_threads[thread]->node + 1);
+    }
+
+    if (affinity != Affinity::None)
+    {
+        PinCurrentThread(processors[0].id);
+    }
+    for (uint32_t thread = 1; thread < threadCount; thread++)
+    {
+        const int32_t processor = (affinity == Affinity::None) ? -1 : static_cast<int32_t>(processors[thread % processors.size()].id);
+        m_workers.emplace_back(&ThreadPool::WorkerMain, this, thread, processor);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const Task& task)
+{
+    const uint32_t self = GetThreadIndex();
+
+    Job job;
+    job.task = &task;
+    job.remaining = count;
+
+    if (count <= 1 || m_threads.size() == 1)
+    {
+        for (uint32_t index = 0; index < count; index++)
+        {
+            RunTask(self, job, index);
+        }
+        return;
+    }
+
+    // One contiguous chunk per thread, in NUMA node order. Chunks go to the front of each queue, so a thread first
+    // finishes the tasks of the innermost ParallelFor() it was given.
+    const uint32_t chunkCount = std::min(count, GetThreadCount());
+    m_pendingTasks += count;
+    for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+    {
+        ThreadState& state = *m_threads[m_distributionOrder[chunk]];
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.ranges.push_front({ &job, uint32_t(uint64_t(count) * chunk / chunkCount), uint32_t(uint64_t(count) * (chunk + 1) / chunkCount) });
+    }
+
+    // A worker checks for tasks and goes to sleep while holding the mutex, so it can't miss the notification
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_all();
+
+    // Help until every task of the job is done, which may include tasks of other jobs
+    ThreadState& state = *m_threads[self];
+    const bool wasBusy = state.busy;
+    SetBusy(state, false);
+    while (job.remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (!RunOneTask(self))
+        {
+            std::this_thread::yield();
+        }
+    }
+    SetBusy(state, wasBusy);
+}
+
+void ThreadPool::SetProfiling(bool enable)
+{
+    const auto now = std::chrono::steady_clock::now();
+    for (const auto& state : m_threads)
+    {
+        state->busySince = now;
+        state->busyNanoseconds = 0;
+    }
+    m_profiling = enable;
+}
+
+double ThreadPool::GetBusySeconds()
+{
+    ThreadState& state = *m_threads[GetThreadIndex()];
+    SetBusy(state, state.busy);
+
+    uint64_t busyNanoseconds = 0;
+    for (const auto& other : m_threads)
+    {
+        busyNanoseconds += other->busyNanoseconds.load(std::memory_order_relaxed);
+    }
+    return busyNanoseconds * 1e-9;
+}
+
+void ThreadPool::WorkerMain(uint32_t thread, int32_t processor)
+{
+    t_pool = this;
+    t_thread = thread;
+    if (processor >= 0)
+    {
+        PinCurrentThread(static_cast<uint32_t>(processor));
+    }
+
+    for (;;)
+    {
+        if (RunOneTask(thread))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this] { return m_stop || m_pendingTasks > 0; });
+        if (m_stop)
+        {
+            return;
+        }
+    }
+}
+
+uint32_t ThreadPool::GetThreadIndex() const
+{
+    return (t_pool == this) ? t_thread : 0;
+}
+
+bool ThreadPool::RunOneTask(uint32_t thread)
+{
+    ThreadState& state = *m_threads[thread];
+    Job* job = nullptr;
+    uint32_t index = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.ranges.empty())
+        {
+            Range& range = state.ranges.front();
+            job = range.job;
+            index = range.begin++;
+            if (range.begin == range.end)
+            {
+                state.ranges.pop_front();
+            }
+        }
+    }
+
+    // Steal the second half of the oldest range of another thread. The rest of the stolen half is queued here,
+    // after the victim's lock is released, since two thieves could otherwise wait on each other.
+    for (size_t i = 0; !job && i < state.victims.size(); i++)
+    {
+        Range stolen = {};
+        {
+            ThreadState& victim = *m_threads[state.victims[i]];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.ranges.empty())
+            {
+                continue;
+            }
+
+            Range& range = victim.ranges.back();
+            const uint32_t middle = range.begin + (range.end - range.begin) / 2;
+            stolen = { range.job, middle, range.end };
+            if (middle == range.begin)
+            {
+                victim.ranges.pop_back();
+            }
+            else
+            {
+                range.end = middle;
+            }
+        }
+
+        job = stolen.job;
+        index = stolen.begin++;
+        if (stolen.begin < stolen.end)
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.ranges.push_front(stolen);
+        }
+    }
+
+    if (!job)
+    {
+        return false;
+    }
+
+    m_pendingTasks--;
+    RunTask(thread, *job, index);
+    return true;
+}
+
+void ThreadPool::RunTask(uint32_t thread, Job& job, uint32_t index)
+{
+    ThreadState& state = *m_threads[thread];
+    const bool wasBusy = state.busy;
+    SetBusy(state, true);
+
+    (*job.task)(index, thread);
+
+    SetBusy(state, wasBusy);
+
+    // The job may be gone as soon as its last task is done
+    job.remaining.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+// Accounts for the time since the thread last changed state
+void ThreadPool::SetBusy(ThreadState& state, bool busy)
+{
+    if (m_profiling.load(std::memory_order_relaxed))
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (state.busy)
+        {
+            state.busyNanoseconds.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - state.busySince).count(), std::memory_order_relaxed);
+        }
+        state.busySince = now;
+    }
+    state.busy = busy;
+}
@@ -0,0 +1,110 @@
+//--------------------------------------------------------------------------------------
+// ThreadPool.h
+//
+// Work-stealing thread pool for the CPU engine. ParallelFor() splits a range of tasks into
+// one contiguous chunk per thread, with the threads in NUMA node order, so neighboring tasks
+// run on the same node. The kernels number their tasks by output row, so each node keeps
+// working on the same part of the image. A thread that runs out of tasks steals the second
+// half of another thread's remaining chunk, trying the threads of its own node first.
+//
+// ParallelFor() may be called from inside a task. The calling thread runs tasks until its
+// own are done, which lets independent operators run side by side.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    enum class Affinity
+    {
+        None,       // Threads are not pinned, and are treated as being on one NUMA node
+        Compact,    // Thread i is pinned to the i-th allowed processor, filling one NUMA node before the next
+        Scatter     // Threads are pinned to the NUMA nodes in turn
+    };
+
+    // The thread count includes the thread that constructs the pool, which becomes thread 0 and is the one that
+    // should call ParallelFor() from outside a task. Zero uses one thread per allowed processor. With an affinity,
+    // thread 0 is pinned as well.
+    explicit ThreadPool(uint32_t threadCount = 0, Affinity affinity = Affinity::None);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+    uint32_t GetNumaNodeCount() const { return m_nodeCount; }
+
+    // Runs task(index, thread) for every index in [0, count), and returns when all of them are done. thread is the
+    // index of the thread that runs the task, so per-thread storage can be indexed by it. A task that calls
+    // ParallelFor() may run other tasks on its thread before that returns, so it must not hold on to per-thread
+    // storage across the call.
+    using Task = std::function<void(uint32_t index, uint32_t thread)>;
+    void ParallelFor(uint32_t count, const Task& task);
+
+    // Time spent running tasks, summed over the threads, plus the time thread 0 spends outside ParallelFor().
+    // Compared to the wall time multiplied by the thread count, this gives the parallel efficiency. Profiling must
+    // be switched while no task is running.
+    void SetProfiling(bool enable);
+    double GetBusySeconds();
+
+private:
+    struct Job
+    {
+        const Task*             task;
+        std::atomic<uint32_t>   remaining;
+    };
+
+    // Tasks [begin, end) of a job
+    struct Range
+    {
+        Job*        job;
+        uint32_t    begin;
+        uint32_t    end;
+    };
+
+    struct ThreadState
+    {
+        std::mutex              mutex;
+        std::deque<Range>       ranges;         // The owner takes tasks from the front, thieves from the back
+        uint32_t                node;
+        std::vector<uint32_t>   victims;        // Threads to steal from, those on the same node first
+
+        // Only accessed by the thread itself, except for the busy time, which is read once its tasks are done
+        bool                    busy;
+        std::chrono::steady_clock::time_point busySince;
+        std::atomic<uint64_t>   busyNanoseconds;
+    };
+
+    void WorkerMain(uint32_t thread, int32_t processor);
+    uint32_t GetThreadIndex() const;
+    bool RunOneTask(uint32_t thread);
+    void RunTask(uint32_t thread, Job& job, uint32_t index);
+    void SetBusy(ThreadState& state, bool busy);
+
+    std::vector<std::unique_ptr<ThreadState>>   m_threads;
+    std::vector<std::thread>                    m_workers;
+    std::vector<uint32_t>                       m_distributionOrder;    // Threads in NUMA node order
+    uint32_t                                    m_nodeCount = 1;
+
+    std::atomic<uint32_t>                       m_pendingTasks;         // Queued and not started yet
+    std::atomic<bool>                           m_profiling;
+    std::mutex                                  m_sleepMutex;
+    std::condition_variable                     m_wake;
+    bool                                        m_stop = false;
+};
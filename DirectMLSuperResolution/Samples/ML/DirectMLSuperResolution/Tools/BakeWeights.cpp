@@ -0,0 +1,70 @@
+//--------------------------------------------------------------------------------------
+// BakeWeights.cpp
+//
+// Offline converter from the original weights file to the pre-baked model container
+// (see ModelContainer.h).
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "LoadWeights.h"
+#include "ModelContainer.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    if (argc > 4)
+    {
+        std::cerr << "Usage: BakeWeights [weights.bin] [weights.srm] [model.txt]" << std::endl;
+        return 1;
+    }
+
+    const std::string inputPath = (argc > 1) ? argv[1] : "Assets/weights.bin";
+    const std::string outputPath = (argc > 2) ? argv[2] : "Assets/weights.srm";
+    const std::string graphPath = (argc > 3) ? argv[3] : "Assets/model.txt";
+
+    SuperResolutionModel::Graph graph;
+    if (!graph.Load(graphPath))
+    {
+        return 1;
+    }
+
+    WeightMapType weights;
+    if (!LoadWeights(inputPath, weights))
+    {
+        return 1;
+    }
+
+    std::vector<ModelContainer::TensorData> tensors;
+    std::vector<uint8_t> bytes;
+    if (!ModelContainer::Bake(graph, weights, tensors) || !ModelContainer::Serialize(tensors, bytes))
+    {
+        return 1;
+    }
+
+    std::ofstream output(outputPath, std::ofstream::binary);
+    output.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    output.close();
+    if (!output)
+    {
+        std::cerr << "Unable to write model container: " << outputPath << std::endl;
+        return 1;
+    }
+
+    // Read the file back, so a bad write is caught here rather than at startup
+    ModelContainer::Reader reader;
+    if (!reader.Open(outputPath))
+    {
+        return 1;
+    }
+
+    std::cout << inputPath << " -> " << outputPath << ": " << tensors.size() << " tensors, "
+              << bytes.size() << " bytes (container version " << ModelContainer::c_version << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,278 @@
+//--------------------------------------------------------------------------------------
+// ConversionBenchmark.cpp
+//
+// Measures the bandwidth of the ColorConversion image <-> tensor conversions against
+// memcpy on the same machine, and checks them against a scalar reference. Bandwidth counts
+// the bytes read plus the bytes written, so a conversion that ran as fast as memcpy would
+// show the same GB/s. TensorToImage is also compared with what it replaces in the CPU
+// engine: upsampling the input, adding the residual to it, and converting the sum.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "ColorConversion.h"
+#include "CpuKernels.h"
+#include "CpuSimd.h"
+#include "Float16Compressor.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace ColorConversion;
+
+namespace
+{
+    // Returns the best time per call in seconds
+    template<typename Func>
+    double Measure(Func func, int repeat)
+    {
+        double best = 1e30;
+        for (int r = 0; r < repeat; r++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            func();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    // What ImageToTensor.hlsl computes, one element at a time
+    void ReferenceImageToTensor(const uint8_t* image, uint32_t width, uint32_t height, TensorLayout layout, uint16_t* tensor)
+    {
+        const size_t planeSize = size_t(width) * height;
+        for (size_t i = 0; i < planeSize; i++)
+        {
+            for (uint32_t channel = 0; channel < 3; channel++)
+            {
+                const uint16_t value = Float16Compressor::compressRoundToNearest(image[i * 4 + 2 - channel] / 255.0f);
+                tensor[(layout == TensorLayout::Nchw) ? channel * planeSize + i : i * 3 + channel] = value;
+            }
+        }
+    }
+
+    inline float ToFloat(float value)      { return value; }
+    inline float ToFloat(uint16_t value)   { return Float16Compressor::decompress(value); }
+
+    // What the TensorToImage.hlsli shaders compute, after the final add of the model, one element at a time. sRGB
+    // is encoded in double precision.
+    template<typename Element>
+    void ReferenceTensorToImage(const Element* tensor, const Element* base, uint32_t baseScale, uint32_t width, uint32_t height,
+        TensorLayout layout, PixelFormat format, bool srgb, uint8_t* image)
+    {
+        const uint32_t channels = (format == PixelFormat::Gray8) ? 1 : 3;
+        const uint32_t bytesPerPixel = (format == PixelFormat::Gray8) ? 1 : (format == PixelFormat::Rgb8) ? 3 : 4;
+        const uint32_t baseWidth = width / baseScale;
+        const uint32_t baseHeight = height / baseScale;
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                uint8_t* pixel = image + (size_t(y) * width + x) * bytesPerPixel;
+                for (uint32_t channel = 0; channel < channels; channel++)
+                {
+                    const bool planar = (layout == TensorLayout::Nchw) || (channels == 1);
+                    const size_t index = planar ? (size_t(channel) * height + y) * width + x : (size_t(y) * width + x) * 3 + channel;
+                    const size_t baseIndex = planar ? (size_t(channel) * baseHeight + y / baseScale) * baseWidth + x / baseScale :
+                        (size_t(y / baseScale) * baseWidth + x / baseScale) * 3 + channel;
+
+                    const float value = std::min(std::max(0.0f, ToFloat(tensor[index]) + ToFloat(base[baseIndex])), 1.0f);
+                    uint8_t code;
+                    if (srgb)
+                    {
+                        const double encoded = (value <= 0.0031308) ? 12.92 * value : 1.055 * std::pow(double(value), 1.0 / 2.4) - 0.055;
+                        code = static_cast<uint8_t>(std::floor(encoded * 255.0 + 0.5));
+                    }
+                    else
+                    {
+                        code = static_cast<uint8_t>(std::nearbyint(value * 255.0f));
+                    }
+
+                    const uint32_t byte = (format == PixelFormat::Bgra8) ? 2 - channel : channel;
+                    pixel[byte] = code;
+                }
+                if (bytesPerPixel == 4)
+                {
+                    pixel[3] = 255;
+                }
+            }
+        }
+    }
+
+    // Values around [0, 1] that add to values around it, some out of range
+    void FillTensor(std::vector<float>& tensor, std::mt19937& rng, float low, float high)
+    {
+        std::uniform_real_distribution<float> distribution(low, high);
+        for (auto& value : tensor)
+        {
+            value = distribution(rng);
+        }
+    }
+
+    const char* GetLayoutName(TensorLayout layout)
+    {
+        return (layout == TensorLayout::Nchw) ? "NCHW" : "NHWC";
+    }
+
+    const char* GetFormatName(PixelFormat format)
+    {
+        const char* const names[] = { "RGBA8", "BGRA8", "RGB8", "Gray8" };
+        return names[static_cast<int>(format)];
+    }
+
+    void PrintResult(const char* name, size_t bytes, double seconds, bool match)
+    {
+        std::cout << "  " << name << ": " << seconds * 1e3 << " ms, " << bytes / seconds * 1e-9 << " GB/s"
+                  << (match ? "" : " (MISMATCH)") << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+    uint32_t threadCount = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            threadCount = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+        }
+        else if (sscanf(argv[i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0)
+        {
+            std::cerr << "Usage: ConversionBenchmark [-j threads] [WIDTHxHEIGHT]" << std::endl;
+            return 1;
+        }
+    }
+    const int repeat = 20;
+
+    std::unique_ptr<ThreadPool> threadPool;
+    if (threadCount != 1)
+    {
+        threadPool.reset(new ThreadPool(threadCount));
+        threadCount = threadPool->GetThreadCount();
+    }
+
+    const size_t pixelCount = size_t(width) * height;
+    std::vector<uint8_t> image(pixelCount * 4);
+    std::mt19937 rng(1);
+    for (auto& value : image)
+    {
+        value = static_cast<uint8_t>(rng());
+    }
+
+    std::cout << width << "x" << height << ", " << CpuSimd::c_name << ", " << threadCount << " thread(s), best of " << repeat << std::endl;
+
+    // Copying as many bytes as the conversion writes
+    const size_t tensorBytes = pixelCount * 3 * sizeof(uint16_t);
+    std::vector<uint8_t> copySource(tensorBytes, 1), copyDestination(tensorBytes);
+    const double copyTime = Measure([&]() { memcpy(copyDestination.data(), copySource.data(), tensorBytes); }, repeat);
+    std::cout << "memcpy of " << tensorBytes << " bytes" << std::endl;
+    PrintResult("memcpy", tensorBytes * 2, copyTime, true);
+
+    bool ok = true;
+    std::vector<uint16_t> reference(pixelCount * 3), tensor(pixelCount * 3);
+    const TensorLayout layouts[] = { TensorLayout::Nchw, TensorLayout::Nhwc };
+    for (TensorLayout layout : layouts)
+    {
+        const size_t bytes = image.size() + tensorBytes;
+        std::cout << "BGRA8 to FP16 " << GetLayoutName(layout) << std::endl;
+
+        const double referenceTime = Measure([&]() { ReferenceImageToTensor(image.data(), width, height, layout, reference.data()); }, repeat);
+        PrintResult("scalar", bytes, referenceTime, true);
+
+        std::fill(tensor.begin(), tensor.end(), uint16_t(0xFFFF));
+        const double time = Measure([&]() { ImageToTensor(image.data(), width * 4, width, height, layout, tensor.data(), threadPool.get()); }, repeat);
+        const bool match = tensor == reference;
+        ok &= match;
+        PrintResult("ImageToTensor", bytes, time, match);
+    }
+
+    // The residual and the input it is added to, at half the size if the size is even
+    const uint32_t baseScale = (width % 2 == 0 && height % 2 == 0) ? 2 : 1;
+    const uint32_t baseWidth = width / baseScale;
+    const uint32_t baseHeight = height / baseScale;
+    std::vector<float> residual(pixelCount * 3), base(size_t(baseWidth) * baseHeight * 3);
+    FillTensor(residual, rng, -0.2f, 0.2f);
+    FillTensor(base, rng, -0.05f, 1.05f);
+
+    std::vector<uint16_t> halfResidual(residual.size()), halfBase(base.size());
+    Float16Compressor::compress(residual.data(), halfResidual.data(), residual.size());
+    Float16Compressor::compress(base.data(), halfBase.data(), base.size());
+
+    std::vector<uint8_t> referencePixels(pixelCount * 4), pixels(pixelCount * 4);
+    const PixelFormat formats[] = { PixelFormat::Rgba8, PixelFormat::Bgra8, PixelFormat::Rgb8, PixelFormat::Gray8 };
+    for (TensorLayout layout : layouts)
+    {
+        std::cout << "FP32 " << GetLayoutName(layout) << " plus " << baseWidth << "x" << baseHeight << " base to RGBA8" << std::endl;
+        const size_t bytes = (residual.size() + base.size()) * sizeof(float) + pixelCount * 4;
+
+        // The CPU engine's planar output, with the upsample and add as separate passes
+        if (layout == TensorLayout::Nchw)
+        {
+            std::vector<float> upsampled(residual.size());
+            const double unfusedTime = Measure([&]()
+            {
+                CpuKernels::Upsample(base.data(), 3, baseHeight, baseWidth, baseScale, upsampled.data(), threadPool.get());
+                CpuKernels::Add(residual.data(), upsampled.data(), upsampled.size(), upsampled.data(), threadPool.get());
+                TensorToImage(upsampled.data(), nullptr, 1, width, height, layout, PixelFormat::Rgba8, false, pixels.data(), width * 4, threadPool.get());
+            }, repeat);
+            PrintResult("upsample, add, convert", bytes, unfusedTime, true);
+        }
+
+        for (int srgb = 0; srgb < 2; srgb++)
+        {
+            ReferenceTensorToImage(residual.data(), base.data(), baseScale, width, height, layout, PixelFormat::Rgba8, srgb != 0, referencePixels.data());
+            const double time = Measure([&]()
+            {
+                TensorToImage(residual.data(), base.data(), baseScale, width, height, layout, PixelFormat::Rgba8, srgb != 0, pixels.data(), width * 4, threadPool.get());
+            }, repeat);
+            const bool match = pixels == referencePixels;
+            ok &= match;
+            PrintResult(srgb ? "TensorToImage sRGB" : "TensorToImage", bytes, time, match);
+        }
+    }
+
+    // Every format from both element types, checked once
+    bool allMatch = true;
+    for (TensorLayout layout : layouts)
+    {
+        for (PixelFormat format : formats)
+        {
+            for (int srgb = 0; srgb < 2; srgb++)
+            {
+                const size_t imageSize = pixelCount * ((format == PixelFormat::Gray8) ? 1 : (format == PixelFormat::Rgb8) ? 3 : 4);
+                const uint32_t rowPitch = static_cast<uint32_t>(imageSize / height);
+
+                ReferenceTensorToImage(residual.data(), base.data(), baseScale, width, height, layout, format, srgb != 0, referencePixels.data());
+                TensorToImage(residual.data(), base.data(), baseScale, width, height, layout, format, srgb != 0, pixels.data(), rowPitch, threadPool.get());
+                bool match = std::equal(pixels.begin(), pixels.begin() + imageSize, referencePixels.begin());
+
+                ReferenceTensorToImage(halfResidual.data(), halfBase.data(), baseScale, width, height, layout, format, srgb != 0, referencePixels.data());
+                TensorToImage(halfResidual.data(), halfBase.data(), baseScale, width, height, layout, format, srgb != 0, pixels.data(), rowPitch, threadPool.get());
+                match &= std::equal(pixels.begin(), pixels.begin() + imageSize, referencePixels.begin());
+
+                if (!match)
+                {
+                    std::cout << "TensorToImage " << GetLayoutName(layout) << " to " << GetFormatName(format) << (srgb ? " sRGB" : "") << " (MISMATCH)" << std::endl;
+                }
+                allMatch &= match;
+            }
+        }
+    }
+    std::cout << "TensorToImage from FP32 and FP16, all layouts and formats: " << (allMatch ? "match" : "MISMATCH") << std::endl;
+    ok &= allMatch;
+
+    return ok ? 0 : 1;
+}
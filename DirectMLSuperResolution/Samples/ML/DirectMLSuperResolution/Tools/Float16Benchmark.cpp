@@ -0,0 +1,106 @@
+//--------------------------------------------------------------------------------------
+// Float16Benchmark.cpp
+//
+// Measures the element throughput of each bulk FP32 <-> FP16 conversion path compiled
+// into Float16Compressor.h, and checks that every path matches the scalar one.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "Float16Compressor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+    typedef void (*CompressFunc)(const float*, uint16_t*, size_t);
+    typedef void (*DecompressFunc)(const uint16_t*, float*, size_t);
+
+    struct ConversionPath
+    {
+        const char* name;
+        CompressFunc compress;
+        DecompressFunc decompress;
+    };
+
+    const ConversionPath c_paths[] =
+    {
+        { "scalar", Float16Compressor::compressScalar, Float16Compressor::decompressScalar },
+#if FLOAT16_F16C
+        { "F16C", Float16Compressor::compressF16C, Float16Compressor::decompressF16C },
+#endif
+#if FLOAT16_AVX512
+        { "AVX-512", Float16Compressor::compressAvx512, Float16Compressor::decompressAvx512 },
+#endif
+#if FLOAT16_NEON
+        { "NEON", Float16Compressor::compressNeon, Float16Compressor::decompressNeon },
+#endif
+    };
+
+    // Returns the best time per call in seconds
+    template<typename Func>
+    double Measure(Func func, int repeat)
+    {
+        double best = 1e30;
+        for (int r = 0; r < repeat; r++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            func();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // Default to roughly the size of the model's weights. Pass a larger count to measure streaming throughput.
+    size_t count = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 128 * 1024;
+    const int repeat = 20;
+
+    // Weight-like values, plus the special cases the paths must agree on
+    std::vector<float> source(count);
+    std::mt19937 rng(1);
+    std::normal_distribution<float> distribution(0.0f, 0.5f);
+    for (auto& value : source)
+    {
+        value = distribution(rng);
+    }
+    const float specials[] = { 0.0f, -0.0f, 65504.0f, 65520.0f, 1e-8f, -6.1e-5f, 3e38f, INFINITY, NAN };
+    for (size_t i = 0; i < sizeof(specials) / sizeof(specials[0]) && i < count; i++)
+    {
+        source[i] = specials[i];
+    }
+
+    std::vector<uint16_t> reference(count), halves(count);
+    std::vector<float> referenceFloats(count), floats(count);
+    Float16Compressor::compressScalar(source.data(), reference.data(), count);
+    Float16Compressor::decompressScalar(reference.data(), referenceFloats.data(), count);
+
+    std::cout << count << " elements, best of " << repeat << std::endl;
+
+    bool ok = true;
+    for (const ConversionPath& path : c_paths)
+    {
+        double compressTime = Measure([&]() { path.compress(source.data(), halves.data(), count); }, repeat);
+        double decompressTime = Measure([&]() { path.decompress(halves.data(), floats.data(), count); }, repeat);
+
+        bool match = memcmp(halves.data(), reference.data(), count * sizeof(uint16_t)) == 0 &&
+                     memcmp(floats.data(), referenceFloats.data(), count * sizeof(float)) == 0;
+        ok &= match;
+
+        std::cout << path.name << ": compress " << count / compressTime * 1e-9 << " G elements/s, decompress "
+                  << count / decompressTime * 1e-9 << " G elements/s" << (match ? "" : " (MISMATCH)") << std::endl;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,440 @@
+//--------------------------------------------------------------------------------------
+// FrameLoop.cpp
+//
+// Runs the sample's frame loop headless, with the CPU implementation of the model in place
+// of DirectML. A StepTimer ticks as in Sample::Tick, and each tick renders the frame of a
+// Y4M video that is due at the timer's time: the frame is converted to the model's input,
+// upscaled, and converted to a BGRA image with the residual added, as the sample renders it
+// to the screen.
+//
+// On the steady clock, the loop runs as fast as it can, for throughput. On the virtual
+// clock (-v), each tick advances the time by 1 / rate seconds, however long the frame took,
+// so every run makes the same updates and renders the same video frames, for latency tests
+// and replay. The fixed-timestep catch-up of StepTimer (-x) works the same on both.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "ColorConversion.h"
+#include "CpuInference.h"
+#include "FrameStatistics.h"
+#include "LoadWeights.h"
+#include "StepTimer.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "VideoStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Size of the tiles -D compares, if -t doesn't give one. Each is compared and run with the model's halo around it.
+    const uint32_t c_defaultReuseTileSize = 96;
+
+    void PrintUsage()
+    {
+        std::cerr << "Usage: FrameLoop [-m model.txt] [-w weights.bin] [-c bt601|bt709] [-v rate] [-x updateRate] [-n ticks] [-t WIDTHxHEIGHT] [-D threshold] [-s] [-a direct|f2|f4] [-j threads] [-k none|compact|scatter] [-T trace.json] [-H statistics.json] input.y4m" << std::endl
+                  << "-v ticks on a virtual clock at the given rate instead of the steady clock, and -x updates at a fixed rate." << std::endl
+                  << "The loop ends after -n ticks, or at the end of the video." << std::endl
+                  << "-D only runs the tiles whose input, with the halo, changed by more than threshold since their last run." << std::endl;
+    }
+
+    // The stages the sample keeps statistics of
+    enum class Statistic
+    {
+        Frame,
+        Convert,
+        Inference,
+        Present,
+    };
+
+    bool ParseConvAlgorithm(const char* name, CpuKernels::ConvAlgorithm& algorithmOut)
+    {
+        const struct { const char* name; CpuKernels::ConvAlgorithm algorithm; } algorithms[] =
+        {
+            { "direct", CpuKernels::ConvAlgorithm::Direct },
+            { "f2", CpuKernels::ConvAlgorithm::Winograd2x2 },
+            { "f4", CpuKernels::ConvAlgorithm::Winograd4x4 },
+        };
+
+        for (const auto& entry : algorithms)
+        {
+            if (!strcmp(name, entry.name))
+            {
+                algorithmOut = entry.algorithm;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ParseAffinity(const char* name, ThreadPool::Affinity& affinityOut)
+    {
+        const struct { const char* name; ThreadPool::Affinity affinity; } affinities[] =
+        {
+            { "none", ThreadPool::Affinity::None },
+            { "compact", ThreadPool::Affinity::Compact },
+            { "scatter", ThreadPool::Affinity::Scatter },
+        };
+
+        for (const auto& entry : affinities)
+        {
+            if (!strcmp(name, entry.name))
+            {
+                affinityOut = entry.affinity;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Frames per second from the F parameter of a Y4M stream, 30 if it has none
+    double GetFrameRate(const VideoStream::StreamInfo& info)
+    {
+        for (const std::string& parameter : info.parameters)
+        {
+            unsigned int numerator = 0, denominator = 0;
+            if (sscanf(parameter.c_str(), "F%u:%u", &numerator, &denominator) == 2 && numerator > 0 && denominator > 0)
+            {
+                return double(numerator) / double(denominator);
+            }
+        }
+        return 30.0;
+    }
+
+    double GetSeconds(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string graphPath = "Assets/model.txt";
+    std::string weightsPath = "Assets/weights.bin";
+    ColorConversion::YuvMatrix matrix = ColorConversion::YuvMatrix::Bt709;
+    double virtualRate = 0.0;
+    double updateRate = 0.0;
+    uint32_t tickCount = 0;
+    uint32_t tileWidth = 0;
+    uint32_t tileHeight = 0;
+    bool subpixel = false;
+    bool temporalReuse = false;
+    float reuseThreshold = 0.0f;
+    CpuKernels::ConvAlgorithm convAlgorithm = CpuKernels::ConvAlgorithm::Winograd4x4;
+    uint32_t threadCount = 1;
+    ThreadPool::Affinity affinity = ThreadPool::Affinity::None;
+    std::string tracePath;
+    std::string statisticsPath;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+        {
+            graphPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+        {
+            weightsPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            if (!strcmp(name, "bt601"))
+            {
+                matrix = ColorConversion::YuvMatrix::Bt601;
+            }
+            else if (!strcmp(name, "bt709"))
+            {
+                matrix = ColorConversion::YuvMatrix::Bt709;
+            }
+            else
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-v") && i + 1 < argc)
+        {
+            virtualRate = atof(argv[++i]);
+            if (!(virtualRate > 0.0))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-x") && i + 1 < argc)
+        {
+            updateRate = atof(argv[++i]);
+            if (!(updateRate > 0.0))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+        {
+            tickCount = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &tileWidth, &tileHeight) != 2)
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-D") && i + 1 < argc)
+        {
+            temporalReuse = true;
+            reuseThreshold = static_cast<float>(atof(argv[++i]));
+        }
+        else if (!strcmp(argv[i], "-s"))
+        {
+            subpixel = true;
+        }
+        else if (!strcmp(argv[i], "-a") && i + 1 < argc)
+        {
+            if (!ParseConvAlgorithm(argv[++i], convAlgorithm))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            threadCount = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+        {
+            if (!ParseAffinity(argv[++i], affinity))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-T") && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-H") && i + 1 < argc)
+        {
+            statisticsPath = argv[++i];
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (paths.size() != 1)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    SuperResolutionModel::Graph graph;
+    WeightMapType weights;
+    if (!graph.Load(graphPath) || !LoadWeights(weightsPath, weights))
+    {
+        return 1;
+    }
+    if (graph.GetInput().channels != 3)
+    {
+        std::cerr << "The model must take RGB images: " << graphPath << std::endl;
+        return 1;
+    }
+    if (subpixel)
+    {
+        graph.FuseUpsampleConvolutions();
+    }
+
+    // As in the sample, the conversion to the screen adds the upsampled input
+    const bool residualSplit = graph.SplitResidualOutput();
+    graph.FuseConvolutionAdds();
+
+    CpuInference model;
+    model.SetConvAlgorithm(convAlgorithm);
+    if (!model.Initialize(graph, weights))
+    {
+        return 1;
+    }
+    if (temporalReuse && tileWidth == 0 && tileHeight == 0)
+    {
+        tileWidth = c_defaultReuseTileSize;
+        tileHeight = c_defaultReuseTileSize;
+    }
+    model.SetTileSize(tileWidth, tileHeight);
+    model.SetTemporalReuse(temporalReuse, reuseThreshold);
+    const uint32_t upscaleFactor = graph.GetUpscaleFactor();
+
+    std::unique_ptr<ThreadPool> threadPool;
+    if (threadCount != 1)
+    {
+        threadPool.reset(new ThreadPool(threadCount, affinity));
+        threadCount = threadPool->GetThreadCount();
+        model.SetThreadPool(threadPool.get());
+    }
+
+    VideoStream::Reader reader;
+    if (!reader.OpenY4m(paths[0], matrix))
+    {
+        return 1;
+    }
+    const VideoStream::StreamInfo& info = reader.GetInfo();
+    const double videoFrameRate = GetFrameRate(info);
+    const uint32_t outputWidth = info.width * upscaleFactor;
+    const uint32_t outputHeight = info.height * upscaleFactor;
+
+    std::vector<uint8_t> videoFrame;
+    std::vector<float> input(size_t(3) * info.width * info.height);
+    std::vector<float> output(input.size() * upscaleFactor * upscaleFactor);
+    std::vector<uint8_t> screen(size_t(4) * outputWidth * outputHeight);
+    if (!reader.ReadFrame(videoFrame))
+    {
+        std::cerr << "The video has no frames: " << paths[0] << std::endl;
+        return 1;
+    }
+
+    std::cerr << "Rendering " << info.width << "x" << info.height << " video at " << videoFrameRate << " frames/s to "
+              << outputWidth << "x" << outputHeight << " on " << threadCount << " thread(s), ";
+    if (virtualRate > 0.0)
+    {
+        std::cerr << "virtual clock at " << virtualRate << " ticks/s";
+    }
+    else
+    {
+        std::cerr << "steady clock";
+    }
+    if (updateRate > 0.0)
+    {
+        std::cerr << ", fixed updates at " << updateRate << "/s";
+    }
+    std::cerr << std::endl;
+
+    if (!tracePath.empty())
+    {
+        Trace::Enable();
+    }
+
+    // Times are of the timer, virtual or real
+    FrameStatistics statistics({ "frame", "convert", "inference", "present" });
+    if (!statisticsPath.empty() && !statistics.OpenExport(statisticsPath, 1.0, 0.0))
+    {
+        return 1;
+    }
+
+    DX::VirtualClock virtualClock;
+    DX::StepTimer timer(virtualRate > 0.0 ? static_cast<const DX::StepClock&>(virtualClock) : DX::SteadyClock::Get());
+    if (updateRate > 0.0)
+    {
+        timer.SetFixedTimeStep(true);
+        timer.SetTargetElapsedSeconds(1.0 / updateRate);
+    }
+
+    // The video frame in videoFrame, and the number of frames read past without being rendered
+    uint64_t videoFrameIndex = 0;
+    uint64_t skippedFrameCount = 0;
+    uint64_t renderCount = 0;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t tick = 0; tickCount == 0 || tick < tickCount; tick++)
+    {
+        Trace::Scope frameScope("Frame");
+        if (virtualRate > 0.0)
+        {
+            virtualClock.AdvanceSeconds(1.0 / virtualRate);
+        }
+
+        timer.Tick([&]()
+        {
+            Trace::Scope updateScope("Update");
+            statistics.Record(size_t(Statistic::Frame), timer.GetElapsedSeconds());
+        });
+
+        // Like Render(), nothing is drawn before the first update
+        if (timer.GetFrameCount() == 0)
+        {
+            continue;
+        }
+
+        // The video plays on the timer's time, as the media engine plays on real time in the sample
+        const uint64_t dueFrameIndex = static_cast<uint64_t>(timer.GetTotalSeconds() * videoFrameRate);
+        bool ended = false;
+        while (videoFrameIndex < dueFrameIndex)
+        {
+            if (!reader.ReadFrame(videoFrame))
+            {
+                ended = true;
+                break;
+            }
+            skippedFrameCount += (videoFrameIndex + 1 < dueFrameIndex) ? 1 : 0;
+            videoFrameIndex++;
+        }
+        if (reader.HasFailed())
+        {
+            return 1;
+        }
+        if (ended)
+        {
+            break;
+        }
+
+        {
+            Trace::Scope renderScope("Render");
+            std::chrono::steady_clock::time_point stageStart = std::chrono::steady_clock::now();
+            ColorConversion::YuvToTensor(videoFrame.data(), info.format, info.width, info.height, input.data(), threadPool.get());
+            statistics.Record(size_t(Statistic::Convert), GetSeconds(stageStart));
+
+            stageStart = std::chrono::steady_clock::now();
+            model.Run(input.data(), 1, info.height, info.width, output.data());
+            statistics.Record(size_t(Statistic::Inference), GetSeconds(stageStart));
+
+            stageStart = std::chrono::steady_clock::now();
+            ColorConversion::TensorToImage(output.data(), residualSplit ? input.data() : nullptr, upscaleFactor, outputWidth, outputHeight,
+                ColorConversion::TensorLayout::Nchw, ColorConversion::PixelFormat::Bgra8, false, screen.data(), outputWidth * 4, threadPool.get());
+            statistics.Record(size_t(Statistic::Present), GetSeconds(stageStart));
+        }
+        renderCount++;
+
+        if (!statistics.ExportIfDue(timer.GetTotalSeconds()))
+        {
+            return 1;
+        }
+    }
+    const double wallSeconds = GetSeconds(start);
+
+    if (!statistics.Export(timer.GetTotalSeconds()))
+    {
+        return 1;
+    }
+
+    std::cerr << renderCount << " render(s) of " << (videoFrameIndex + 1) << " video frame(s), " << skippedFrameCount
+              << " skipped, and " << timer.GetFrameCount() << " update(s), in " << timer.GetTotalSeconds() << " s of timer time and "
+              << wallSeconds << " s of wall time: " << double(renderCount) / wallSeconds << " renders/s" << std::endl;
+    statistics.PrintSummary(std::cerr);
+    if (temporalReuse)
+    {
+        const CpuInference::ReuseCounts& counts = model.GetReuseCounts();
+        std::cerr << "Reused " << counts.reusedTileCount << " of " << counts.tileCount << " tiles ("
+                  << 100.0 * double(counts.reusedTileCount) / double(std::max<uint64_t>(counts.tileCount, 1)) << "%)" << std::endl;
+    }
+
+    if (!tracePath.empty() && !Trace::WriteChromeTrace(tracePath))
+    {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,624 @@
+//--------------------------------------------------------------------------------------
+// LayerBenchmark.cpp
+//
+// Times each layer shape of the model on its own, at several input sizes, with every CPU
+// kernel that can run it: direct convolution in each tensor layout, Winograd, INT8, and the
+// sub-pixel form of a convolution after an upsample. Reports the spread of the times, and
+// the achieved GFLOP/s and GB/s against the peak FMA rate and memory bandwidth measured on
+// the machine. Results can also be written as JSON, one line per measurement, to compare
+// runs with diff.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "CpuKernels.h"
+#include "CpuSimd.h"
+#include "LayoutTuning.h"
+#include "Quantization.h"
+#include "SuperResolutionModel.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace SuperResolutionModel;
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::cerr << "Usage: LayerBenchmark [-m model.txt] [-r 540p,720p,1080p,WIDTHxHEIGHT,...] [-l layer,layer,...] [-u warmups] [-n repetitions] [-o results.json] [-j threads] [-k none|compact|scatter]" << std::endl;
+    }
+
+    const struct { const char* name; uint32_t width; uint32_t height; } c_resolutions[] =
+    {
+        { "540p", 960, 540 },
+        { "720p", 1280, 720 },
+        { "1080p", 1920, 1080 },
+    };
+
+    // The FMA loop of the roofline runs this many independent chains per thread, enough to cover the latency of
+    // two FMA units, and this many iterations. The chains are separate variables, so they stay in registers at any
+    // optimization level, rather than in an array the compiler may or may not unroll.
+    const uint32_t c_fmaChains = 8;
+    const uint32_t c_fmaIterations = 1 << 24;
+
+    // The bandwidth is measured by copying this much, several times the size of any last-level cache
+    const size_t c_bandwidthBytes = size_t(256) << 20;
+
+    struct Resolution
+    {
+        std::string name;
+        uint32_t    width;
+        uint32_t    height;
+    };
+
+    // One shape of the graph, with the names of the layers that have it
+    struct LayerShape
+    {
+        std::string name;
+        OpType      type;
+        uint32_t    filterSizes[4];     // Convolutions only
+        uint32_t    channels;           // Input channels
+        uint32_t    scale;              // Of the input, relative to the model input
+        uint32_t    upsampleFactor;     // Upsamples, and convolutions of an upsample's output, which have a sub-pixel form
+        bool        relu;
+    };
+
+    struct Roofline
+    {
+        double  flopsPerSecond;
+        double  bytesPerSecond;
+    };
+
+    struct Timing
+    {
+        double  mean;
+        double  deviation;
+        double  best;
+    };
+
+    template<typename Func>
+    void ParallelFor(ThreadPool* threadPool, uint32_t count, const Func& func)
+    {
+        if (threadPool)
+        {
+            threadPool->ParallelFor(count, func);
+            return;
+        }
+        for (uint32_t index = 0; index < count; index++)
+        {
+            func(index, 0);
+        }
+    }
+
+    // Runs warmups times untimed, then repetitions times. The deviation is that of the sample.
+    Timing Measure(const std::function<void()>& func, uint32_t warmups, uint32_t repetitions)
+    {
+        for (uint32_t r = 0; r < warmups; r++)
+        {
+            func();
+        }
+
+        std::vector<double> times(repetitions);
+        for (double& time : times)
+        {
+            auto start = std::chrono::steady_clock::now();
+            func();
+            time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        Timing timing = {};
+        for (double time : times)
+        {
+            timing.mean += time / repetitions;
+        }
+        for (double time : times)
+        {
+            timing.deviation += (repetitions > 1) ? (time - timing.mean) * (time - timing.mean) / (repetitions - 1) : 0.0;
+        }
+        timing.deviation = std::sqrt(timing.deviation);
+        timing.best = *std::min_element(times.begin(), times.end());
+        return timing;
+    }
+
+    // Peak FP32 rate of the vector FMAs the kernels are built with, and copy bandwidth to and from memory, both on
+    // every thread of the pool. Each is the best of a few runs.
+    Roofline MeasureRoofline(ThreadPool* threadPool, uint32_t threadCount)
+    {
+        std::vector<float> sinks(threadCount * CpuSimd::c_width);
+        const Timing fmaTiming = Measure([&]()
+        {
+            ParallelFor(threadPool, threadCount, [&](uint32_t index, uint32_t)
+            {
+                static_assert(c_fmaChains == 8, "The FMA loop has a variable per chain");
+                const CpuSimd::Float a = CpuSimd::Set(0.999999f);
+                const CpuSimd::Float b = CpuSimd::Set(1e-7f);
+                CpuSimd::Float sum0 = CpuSimd::Set(0.0f), sum1 = CpuSimd::Set(1.0f), sum2 = CpuSimd::Set(2.0f), sum3 = CpuSimd::Set(3.0f);
+                CpuSimd::Float sum4 = CpuSimd::Set(4.0f), sum5 = CpuSimd::Set(5.0f), sum6 = CpuSimd::Set(6.0f), sum7 = CpuSimd::Set(7.0f);
+                for (uint32_t i = 0; i < c_fmaIterations; i++)
+                {
+                    sum0 = CpuSimd::MultiplyAdd(sum0, a, b);
+                    sum1 = CpuSimd::MultiplyAdd(sum1, a, b);
+                    sum2 = CpuSimd::MultiplyAdd(sum2, a, b);
+                    sum3 = CpuSimd::MultiplyAdd(sum3, a, b);
+                    sum4 = CpuSimd::MultiplyAdd(sum4, a, b);
+                    sum5 = CpuSimd::MultiplyAdd(sum5, a, b);
+                    sum6 = CpuSimd::MultiplyAdd(sum6, a, b);
+                    sum7 = CpuSimd::MultiplyAdd(sum7, a, b);
+                }
+                const CpuSimd::Float sum = CpuSimd::Add(CpuSimd::Add(CpuSimd::Add(sum0, sum1), CpuSimd::Add(sum2, sum3)),
+                    CpuSimd::Add(CpuSimd::Add(sum4, sum5), CpuSimd::Add(sum6, sum7)));
+                CpuSimd::Store(&sinks[index * CpuSimd::c_width], sum);
+            });
+        }, 1, 3);
+
+        // Each thread copies its own chunk, so first touch places it on the thread's node
+        const size_t chunkSize = c_bandwidthBytes / threadCount;
+        std::vector<char> source(c_bandwidthBytes, 1), destination(c_bandwidthBytes, 0);
+        const Timing copyTiming = Measure([&]()
+        {
+            ParallelFor(threadPool, threadCount, [&](uint32_t index, uint32_t)
+            {
+                memcpy(&destination[index * chunkSize], &source[index * chunkSize], chunkSize);
+            });
+        }, 1, 5);
+
+        Roofline roofline;
+        roofline.flopsPerSecond = 2.0 * CpuSimd::c_width * c_fmaChains * c_fmaIterations * threadCount / fmaTiming.best;
+        roofline.bytesPerSecond = 2.0 * chunkSize * threadCount / copyTiming.best;
+        return roofline;
+    }
+
+    // The distinct shapes among the graph's convolutions and upsamples, in graph order
+    std::vector<LayerShape> GetLayerShapes(const Graph& graph)
+    {
+        const std::vector<TensorDesc>& tensors = graph.GetTensors();
+        std::vector<uint32_t> producers(tensors.size(), UINT32_MAX);
+        for (uint32_t i = 0; i < graph.GetOps().size(); i++)
+        {
+            producers[graph.GetOps()[i].output] = i;
+        }
+
+        std::vector<LayerShape> shapes;
+        for (const OpDesc& op : graph.GetOps())
+        {
+            if (op.type != OpType::Upsample && !IsConvolution(op))
+            {
+                continue;
+            }
+
+            const TensorDesc& input = tensors[op.inputs[0]];
+            LayerShape shape = {};
+            shape.type = IsConvolution(op) ? OpType::Convolution : OpType::Upsample;
+            shape.channels = input.channels;
+            shape.scale = input.scale;
+            shape.upsampleFactor = (op.type == OpType::Upsample) ? op.upsampleFactor : 1;
+            if (IsConvolution(op))
+            {
+                const ConvLayerDesc& desc = graph.GetConvLayers()[op.convLayer];
+                std::copy(desc.filterSizes, desc.filterSizes + 4, shape.filterSizes);
+                shape.relu = UsesBiasAndActivation(desc);
+                shape.name = desc.name;
+
+                const uint32_t producer = producers[op.inputs[0]];
+                if (producer != UINT32_MAX && graph.GetOps()[producer].type == OpType::Upsample)
+                {
+                    shape.upsampleFactor = graph.GetOps()[producer].upsampleFactor;
+                }
+            }
+            else
+            {
+                shape.name = tensors[op.output].name;
+            }
+
+            auto same = std::find_if(shapes.begin(), shapes.end(), [&](const LayerShape& other)
+            {
+                return other.type == shape.type && other.channels == shape.channels && other.scale == shape.scale &&
+                       other.upsampleFactor == shape.upsampleFactor && other.relu == shape.relu &&
+                       std::equal(shape.filterSizes, shape.filterSizes + 4, other.filterSizes);
+            });
+            if (same != shapes.end())
+            {
+                same->name += "/" + shape.name;
+            }
+            else
+            {
+                shapes.push_back(shape);
+            }
+        }
+        return shapes;
+    }
+
+    bool ParseResolutions(const std::string& list, std::vector<Resolution>& resolutionsOut)
+    {
+        resolutionsOut.clear();
+        std::istringstream names(list);
+        for (std::string name; std::getline(names, name, ','); )
+        {
+            Resolution resolution = { name, 0, 0 };
+            for (const auto& entry : c_resolutions)
+            {
+                if (name == entry.name)
+                {
+                    resolution.width = entry.width;
+                    resolution.height = entry.height;
+                }
+            }
+            if (resolution.width == 0 && (sscanf(name.c_str(), "%ux%u", &resolution.width, &resolution.height) != 2 ||
+                resolution.width == 0 || resolution.height == 0))
+            {
+                return false;
+            }
+            resolutionsOut.push_back(resolution);
+        }
+        return !resolutionsOut.empty();
+    }
+
+    bool ParseAffinity(const char* name, ThreadPool::Affinity& affinityOut)
+    {
+        const struct { const char* name; ThreadPool::Affinity affinity; } affinities[] =
+        {
+            { "none", ThreadPool::Affinity::None },
+            { "compact", ThreadPool::Affinity::Compact },
+            { "scatter", ThreadPool::Affinity::Scatter },
+        };
+
+        for (const auto& entry : affinities)
+        {
+            if (!strcmp(name, entry.name))
+            {
+                affinityOut = entry.affinity;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string EscapeJson(const std::string& text)
+    {
+        std::string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string graphPath = "Assets/model.txt";
+    std::vector<Resolution> resolutions;
+    std::vector<std::string> layerNames;
+    uint32_t warmups = 1;
+    uint32_t repetitions = 5;
+    std::string jsonPath;
+    uint32_t threadCount = 1;
+    ThreadPool::Affinity affinity = ThreadPool::Affinity::None;
+
+    ParseResolutions("540p,720p,1080p", resolutions);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+        {
+            graphPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+        {
+            if (!ParseResolutions(argv[++i], resolutions))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+        {
+            std::istringstream names(argv[++i]);
+            for (std::string name; std::getline(names, name, ','); )
+            {
+                layerNames.push_back(name);
+            }
+        }
+        else if (!strcmp(argv[i], "-u") && i + 1 < argc)
+        {
+            warmups = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+        {
+            repetitions = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+        {
+            jsonPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            threadCount = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+        {
+            if (!ParseAffinity(argv[++i], affinity))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    Graph graph;
+    if (!graph.Load(graphPath))
+    {
+        return 1;
+    }
+
+    std::vector<LayerShape> shapes = GetLayerShapes(graph);
+    if (!layerNames.empty())
+    {
+        // A shape is kept if any of its layers is named
+        shapes.erase(std::remove_if(shapes.begin(), shapes.end(), [&](const LayerShape& shape)
+        {
+            const std::string names = "/" + shape.name + "/";
+            return std::none_of(layerNames.begin(), layerNames.end(), [&](const std::string& name)
+            {
+                return names.find("/" + name + "/") != std::string::npos;
+            });
+        }), shapes.end());
+    }
+
+    std::unique_ptr<ThreadPool> threadPool;
+    if (threadCount != 1)
+    {
+        threadPool.reset(new ThreadPool(threadCount, affinity));
+        threadCount = threadPool->GetThreadCount();
+    }
+
+    const Roofline roofline = MeasureRoofline(threadPool.get(), threadCount);
+    const std::string device = LayoutTuning::GetCpuDevice(threadCount);
+
+    std::cout << device << ": peak " << std::fixed << std::setprecision(1) << roofline.flopsPerSecond * 1e-9
+              << " GFLOP/s, copy bandwidth " << roofline.bytesPerSecond * 1e-9 << " GB/s, ridge at "
+              << roofline.flopsPerSecond / roofline.bytesPerSecond << " FLOP/byte" << std::endl
+              << warmups << " warm-up run(s), " << repetitions << " timed" << std::endl;
+
+    std::ofstream json;
+    if (!jsonPath.empty())
+    {
+        json.open(jsonPath);
+        if (!json)
+        {
+            std::cerr << "Unable to create file: " << jsonPath << std::endl;
+            return 1;
+        }
+        json << std::setprecision(6) << "{" << std::endl
+             << "\"device\": \"" << EscapeJson(device) << "\"," << std::endl
+             << "\"threads\": " << threadCount << "," << std::endl
+             << "\"peakGflops\": " << roofline.flopsPerSecond * 1e-9 << "," << std::endl
+             << "\"bandwidthGBs\": " << roofline.bytesPerSecond * 1e-9 << "," << std::endl
+             << "\"warmups\": " << warmups << "," << std::endl
+             << "\"repetitions\": " << repetitions << "," << std::endl
+             << "\"results\": [";
+    }
+    bool firstResult = true;
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    std::uniform_real_distribution<float> weightDistribution(-0.1f, 0.1f);
+    std::vector<float> filter, bias, packedFilter, packedBias, subpixelFilter, subpixelBias, packedScales, input, output, phases, scratch;
+    std::vector<int8_t> packedInt8Filter;
+
+    for (const Resolution& resolution : resolutions)
+    {
+        const std::string size = std::to_string(resolution.width) + "x" + std::to_string(resolution.height);
+        std::cout << std::endl << "Input " << resolution.name << ((resolution.name != size) ? " (" + size + ")" : "") << std::endl
+                  << "  layer            variant            size     mean ms   +/-%   best ms   GFLOP/s     GB/s  of roof" << std::endl;
+
+        for (const LayerShape& shape : shapes)
+        {
+            const uint32_t height = resolution.height * shape.scale;
+            const uint32_t width = resolution.width * shape.scale;
+            const bool isConvolution = shape.type == OpType::Convolution;
+            const uint32_t outputChannels = isConvolution ? shape.filterSizes[0] : shape.channels;
+            const uint32_t outputScale = isConvolution ? 1 : shape.upsampleFactor;
+
+            // Nominal work of the layer as the graph describes it. Winograd and sub-pixel convolutions do fewer
+            // multiplies, so their effective rate can be above the roofline.
+            const size_t inputCount = size_t(shape.channels) * height * width;
+            const size_t outputCount = size_t(outputChannels) * height * width * outputScale * outputScale;
+            const size_t filterCount = isConvolution ? size_t(shape.filterSizes[0]) * shape.filterSizes[1] * shape.filterSizes[2] * shape.filterSizes[3] : 0;
+            const double flops = 2.0 * filterCount / outputChannels * outputCount;
+
+            const uint32_t inputSizes[4] = { 1, shape.channels, height, width };
+            const std::string shapeKey = isConvolution ? LayoutTuning::GetConvShape(inputSizes, shape.filterSizes, shape.relu) :
+                "upsample:1x" + std::to_string(shape.channels) + "x" + std::to_string(height) + "x" + std::to_string(width) + ":" + std::to_string(shape.upsampleFactor);
+
+            input.resize(inputCount);
+            for (float& value : input)
+            {
+                value = distribution(rng);
+            }
+            output.assign(outputCount, 0.0f);
+
+            if (isConvolution)
+            {
+                filter.resize(filterCount);
+                for (float& value : filter)
+                {
+                    value = weightDistribution(rng);
+                }
+                bias.assign(outputChannels, 0.01f);
+                CpuKernels::PackConvBias(shape.relu ? bias.data() : nullptr, outputChannels, packedBias);
+            }
+
+            auto report = [&](const std::string& variant, uint32_t runWidth, uint32_t runHeight, double bytes, const std::function<void()>& run)
+            {
+                const Timing timing = Measure(run, warmups, repetitions);
+                const double gflops = flops / timing.mean * 1e-9;
+                const double gbs = bytes / timing.mean * 1e-9;
+                const double intensity = flops / bytes;
+                const double roof = std::min(roofline.flopsPerSecond, intensity * roofline.bytesPerSecond);
+                const double ofRoof = (flops > 0.0) ? flops / timing.mean / roof : bytes / timing.mean / roofline.bytesPerSecond;
+                const std::string size = std::to_string(runWidth) + "x" + std::to_string(runHeight);
+
+                std::cout << "  " << std::left << std::setw(16) << shape.name << " " << std::setw(16) << variant << std::right
+                          << std::setw(11) << size << std::setprecision(2) << std::setw(12) << timing.mean * 1e3
+                          << std::setprecision(1) << std::setw(7) << timing.deviation / timing.mean * 100.0
+                          << std::setprecision(2) << std::setw(10) << timing.best * 1e3 << std::setprecision(1)
+                          << std::setw(10) << gflops << std::setw(9) << gbs << std::setw(8) << ofRoof * 100.0 << "%" << std::endl;
+
+                // Direct FP32 convolutions do every multiply the graph describes with the FMAs the peak was measured
+                // with, so they can't beat it, unless the peak was measured wrong
+                if (variant.compare(0, 7, "direct-") == 0 && flops / timing.mean > roofline.flopsPerSecond)
+                {
+                    std::cerr << "Warning: " << shape.name << " " << variant << " ran above the measured peak, which is unreliable" << std::endl;
+                }
+
+                if (json.is_open())
+                {
+                    json << (firstResult ? "" : ",") << std::endl
+                         << "{\"input\": \"" << resolution.name << "\", \"layer\": \"" << EscapeJson(shape.name)
+                         << "\", \"shape\": \"" << shapeKey << "\", \"variant\": \"" << variant << "\", \"size\": \"" << size
+                         << "\", \"meanMs\": " << timing.mean * 1e3 << ", \"deviationMs\": " << timing.deviation * 1e3
+                         << ", \"bestMs\": " << timing.best * 1e3 << ", \"gflops\": " << gflops << ", \"gbs\": " << gbs
+                         << ", \"flopPerByte\": " << intensity << ", \"ofRoofline\": " << ofRoof << "}";
+                    firstResult = false;
+                }
+            };
+
+            const double bytes = 4.0 * (inputCount + outputCount + filterCount);
+
+            if (!isConvolution)
+            {
+                report("nearest", width, height, bytes, [&]()
+                {
+                    CpuKernels::Upsample(input.data(), shape.channels, height, width, shape.upsampleFactor, output.data(), threadPool.get());
+                });
+                continue;
+            }
+
+            for (CpuKernels::ConvLayout layout : CpuKernels::c_convLayouts)
+            {
+                CpuKernels::PackConvFilter(filter.data(), shape.filterSizes, layout, packedFilter);
+                scratch.resize(CpuKernels::GetConv2DScratchSize(1, height, width, shape.filterSizes, layout));
+                report(std::string("direct-") + CpuKernels::GetConvLayoutName(layout), width, height, bytes, [&]()
+                {
+                    CpuKernels::Conv2D(input.data(), 1, height, width, packedFilter.data(), packedBias.data(), shape.filterSizes,
+                        layout, shape.relu, nullptr, output.data(), scratch.data(), threadPool.get());
+                });
+            }
+
+            for (CpuKernels::ConvAlgorithm algorithm : { CpuKernels::ConvAlgorithm::Winograd2x2, CpuKernels::ConvAlgorithm::Winograd4x4 })
+            {
+                if (!CpuKernels::SupportsConvAlgorithm(shape.filterSizes, algorithm))
+                {
+                    continue;
+                }
+                CpuKernels::PackWinogradFilter(filter.data(), shape.filterSizes, algorithm, packedFilter);
+                scratch.resize(CpuKernels::GetWinogradConv2DScratchSize(width, shape.filterSizes, algorithm) * threadCount);
+                report((algorithm == CpuKernels::ConvAlgorithm::Winograd2x2) ? "winograd-f2" : "winograd-f4", width, height, bytes, [&]()
+                {
+                    CpuKernels::WinogradConv2D(input.data(), 1, height, width, packedFilter.data(), packedBias.data(),
+                        shape.filterSizes, algorithm, shape.relu, nullptr, output.data(), scratch.data(), threadPool.get());
+                });
+            }
+
+            // The input is in [0, 1), so it quantizes with the scale of that range
+            {
+                const float inputScale = Quantization::GetUnsignedScale({ 0.0f, 1.0f });
+                CpuKernels::PackInt8ConvFilter(filter.data(), shape.filterSizes, packedInt8Filter, packedScales);
+                for (float& scale : packedScales)
+                {
+                    scale *= inputScale;
+                }
+                scratch.resize(CpuKernels::GetInt8Conv2DScratchSize(1, height, width, shape.filterSizes));
+                report("int8", width, height, bytes, [&]()
+                {
+                    CpuKernels::Int8Conv2D(input.data(), 1, height, width, inputScale, packedInt8Filter.data(), packedScales.data(),
+                        packedBias.data(), shape.filterSizes, shape.relu, nullptr, output.data(), scratch.data(), threadPool.get());
+                });
+            }
+
+            // After an upsample, the phases of the filter run on the upsample's input and are interleaved into the
+            // output, which replaces both layers (see Graph::FuseUpsampleConvolutions)
+            if (shape.upsampleFactor > 1)
+            {
+                const uint32_t factor = shape.upsampleFactor;
+                const uint32_t lowHeight = height / factor;
+                const uint32_t lowWidth = width / factor;
+                uint32_t subpixelSizes[4];
+                CpuKernels::MakeSubpixelFilter(filter.data(), shape.relu ? bias.data() : nullptr, shape.filterSizes, factor,
+                    subpixelFilter, subpixelBias, subpixelSizes);
+                CpuKernels::PackConvBias(subpixelBias.empty() ? nullptr : subpixelBias.data(), subpixelSizes[0], packedBias);
+                phases.resize(outputCount);
+
+                const double subpixelBytes = 4.0 * (inputCount / (factor * factor) + outputCount * 3 + subpixelFilter.size());
+                const bool winograd = CpuKernels::SupportsConvAlgorithm(subpixelSizes, CpuKernels::ConvAlgorithm::Winograd4x4);
+                if (winograd)
+                {
+                    CpuKernels::PackWinogradFilter(subpixelFilter.data(), subpixelSizes, CpuKernels::ConvAlgorithm::Winograd4x4, packedFilter);
+                    scratch.resize(CpuKernels::GetWinogradConv2DScratchSize(lowWidth, subpixelSizes, CpuKernels::ConvAlgorithm::Winograd4x4) * threadCount);
+                }
+                else
+                {
+                    CpuKernels::PackConvFilter(subpixelFilter.data(), subpixelSizes, CpuKernels::ConvLayout::NCHW, packedFilter);
+                    scratch.resize(CpuKernels::GetConv2DScratchSize(1, lowHeight, lowWidth, subpixelSizes, CpuKernels::ConvLayout::NCHW));
+                }
+
+                report(winograd ? "subpixel-f4" : "subpixel-direct", lowWidth, lowHeight, subpixelBytes, [&]()
+                {
+                    if (winograd)
+                    {
+                        CpuKernels::WinogradConv2D(input.data(), 1, lowHeight, lowWidth, packedFilter.data(), packedBias.data(),
+                            subpixelSizes, CpuKernels::ConvAlgorithm::Winograd4x4, shape.relu, nullptr, phases.data(), scratch.data(), threadPool.get());
+                    }
+                    else
+                    {
+                        CpuKernels::Conv2D(input.data(), 1, lowHeight, lowWidth, packedFilter.data(), packedBias.data(), subpixelSizes,
+                            CpuKernels::ConvLayout::NCHW, shape.relu, nullptr, phases.data(), scratch.data(), threadPool.get());
+                    }
+                    CpuKernels::DepthToSpace(phases.data(), 1, outputChannels, lowHeight, lowWidth, factor, output.data(), threadPool.get());
+                });
+            }
+
+            // Free the largest buffers before the next layer
+            std::vector<float>().swap(scratch);
+            std::vector<float>().swap(phases);
+        }
+    }
+
+    if (json.is_open())
+    {
+        json << std::endl << "]" << std::endl << "}" << std::endl;
+        if (!json)
+        {
+            std::cerr << "Unable to write file: " << jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,700 @@
+//--------------------------------------------------------------------------------------
+// QualityCheck.cpp
+//
+// Quality regression check for the fast paths of the CPU implementation of the
+// super-resolution model. Runs a plain FP32 reference of the model graph on the sample
+// frames and any others given, then runs each fast path (Winograd, the tensor layouts,
+// sub-pixel convolutions, tiling, FP16 as in the DirectML path, and INT8) and compares it
+// with the reference by PSNR, SSIM and largest error. Fails if any path crosses its
+// thresholds.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "CpuInference.h"
+#include "ImageFile.h"
+#include "LoadWeights.h"
+#include "ModelContainer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace SuperResolutionModel;
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::cerr << "Usage: QualityCheck [-m model.txt] [-w weights.bin] [-q calibration.txt] [-c WIDTHxHEIGHT] [-p path,path,...] [-j threads] [frame.png|ppm ...]" << std::endl
+                  << "Checks Assets/FH3_1_540p.png, Assets/FH3_2_540p.png and the frames given. Without -q, INT8 is calibrated on the checked frames." << std::endl;
+    }
+
+    const char* const c_sampleFrames[] = { "Assets/FH3_1_540p.png", "Assets/FH3_2_540p.png" };
+
+    // How a fast path runs the model, and how far from the reference its output may be. PSNR and SSIM are minimums
+    // and the error a maximum, of the output clamped to [0, 1] as it is displayed. The FP32 paths only differ from
+    // the reference in the order of their sums, and get the tolerance of SuperResolutionCpu -v. FP16 stays within
+    // an 8-bit step; INT8 is a few steps off at strong edges, and gets the INT8 tolerance of -v.
+    struct FastPath
+    {
+        const char*                 name;
+        CpuKernels::ConvAlgorithm   algorithm;
+        CpuKernels::ConvLayout      layout;
+        CpuInference::Precision     precision;
+        bool                        subpixel;
+        bool                        tiled;
+        double                      minPsnr;
+        double                      minSsim;
+        float                       maxError;
+    };
+
+    const CpuInference::Precision c_fp32 = CpuInference::Precision::Float32;
+    const CpuKernels::ConvAlgorithm c_direct = CpuKernels::ConvAlgorithm::Direct;
+    const CpuKernels::ConvAlgorithm c_winograd4 = CpuKernels::ConvAlgorithm::Winograd4x4;
+
+    const FastPath c_fastPaths[] =
+    {
+        { "f4",       c_winograd4,                            CpuKernels::ConvLayout::NCHW,    c_fp32,                            false, false, 100.0, 0.9999, 1e-4f },
+        { "f2",       CpuKernels::ConvAlgorithm::Winograd2x2, CpuKernels::ConvLayout::NCHW,    c_fp32,                            false, false, 100.0, 0.9999, 1e-4f },
+        { "nchw",     c_direct,                               CpuKernels::ConvLayout::NCHW,    c_fp32,                            false, false, 100.0, 0.9999, 1e-4f },
+        { "nhwc",     c_direct,                               CpuKernels::ConvLayout::NHWC,    c_fp32,                            false, false, 100.0, 0.9999, 1e-4f },
+        { "nchwc8",   c_direct,                               CpuKernels::ConvLayout::NCHWc8,  c_fp32,                            false, false, 100.0, 0.9999, 1e-4f },
+        { "nchwc16",  c_direct,                               CpuKernels::ConvLayout::NCHWc16, c_fp32,                            false, false, 100.0, 0.9999, 1e-4f },
+        { "subpixel", c_winograd4,                            CpuKernels::ConvLayout::NCHW,    c_fp32,                            true,  false, 100.0, 0.9999, 1e-4f },
+        { "tiled",    c_winograd4,                            CpuKernels::ConvLayout::NCHW,    c_fp32,                            true,  true,  100.0, 0.9999, 1e-4f },
+        { "fp16",     c_direct,                               CpuKernels::ConvLayout::NCHW,    CpuInference::Precision::Float16,  false, false, 65.0,  0.9995, 2.0f / 255.0f },
+        { "int8",     c_winograd4,                            CpuKernels::ConvLayout::NCHW,    CpuInference::Precision::Int8,     true,  false, 42.0,  0.99,   32.0f / 255.0f },
+    };
+
+    // Input pixels per tile of the tiled path
+    const uint32_t c_tileWidth = 128;
+    const uint32_t c_tileHeight = 64;
+
+    void ImageToPlanar(const ImageRGB8& image, std::vector<float>& planar)
+    {
+        const size_t planeSize = size_t(image.width) * image.height;
+        planar.resize(planeSize * 3);
+
+        for (size_t i = 0; i < planeSize; i++)
+        {
+            for (size_t c = 0; c < 3; c++)
+            {
+                planar[i + planeSize * c] = image.pixels[i * 3 + c] / 255.0f;
+            }
+        }
+    }
+
+    // Keeps the middle width x height pixels, or the whole image where it is smaller
+    void CropImage(ImageRGB8& image, uint32_t width, uint32_t height)
+    {
+        width = std::min(width, image.width);
+        height = std::min(height, image.height);
+        const uint32_t left = (image.width - width) / 2;
+        const uint32_t top = (image.height - height) / 2;
+
+        std::vector<uint8_t> pixels(size_t(width) * height * 3);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            memcpy(&pixels[size_t(y) * width * 3], &image.pixels[(size_t(top + y) * image.width + left) * 3], size_t(width) * 3);
+        }
+        image.width = width;
+        image.height = height;
+        image.pixels.swap(pixels);
+    }
+
+    template<typename Func>
+    void ParallelFor(ThreadPool* threadPool, uint32_t count, const Func& func)
+    {
+        if (threadPool)
+        {
+            threadPool->ParallelFor(count, func);
+            return;
+        }
+        for (uint32_t index = 0; index < count; index++)
+        {
+            func(index, 0);
+        }
+    }
+
+    // The model as the graph describes it, in FP32 with plain loops and no fused ops, for one image. Each output
+    // value of a convolution starts from the bias and sums its taps over input channels, then filter rows and
+    // columns. Only the weights are shared with the fast paths, folded as ModelContainer does for all of them.
+    // Tensors are freed after the last op that reads them.
+    class ReferenceModel
+    {
+    public:
+        bool Initialize(const Graph& graph, const WeightMapType& weights)
+        {
+            m_graph = graph;
+            m_filters.resize(graph.GetConvLayers().size());
+            m_biases.resize(graph.GetConvLayers().size());
+
+            for (size_t i = 0; i < graph.GetConvLayers().size(); i++)
+            {
+                if (!ModelContainer::FoldConvLayer(weights, graph.GetConvLayers()[i], ModelContainer::Layout::NCHW, m_filters[i], m_biases[i]))
+                {
+                    return false;
+                }
+            }
+
+            m_lastReaders.assign(graph.GetTensors().size(), 0);
+            for (uint32_t i = 0; i < graph.GetOps().size(); i++)
+            {
+                const OpDesc& op = graph.GetOps()[i];
+                for (uint32_t input = 0; input < GetInputCount(op); input++)
+                {
+                    m_lastReaders[op.inputs[input]] = i;
+                }
+                if (op.type == OpType::ConvolutionAdd || (op.type == OpType::Convolution && op.upsampleFactor != 1) || op.addendUpsampleFactor != 1)
+                {
+                    std::cerr << "The reference only runs the ops of a graph description, not fused ones" << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void Run(const float* input, uint32_t height, uint32_t width, std::vector<float>& output, ThreadPool* threadPool)
+        {
+            const std::vector<TensorDesc>& tensors = m_graph.GetTensors();
+            std::vector<std::vector<float>> values(tensors.size());
+
+            auto getSize = [&](uint32_t tensor)
+            {
+                return size_t(tensors[tensor].channels) * height * width * tensors[tensor].scale * tensors[tensor].scale;
+            };
+
+            for (uint32_t t = 0; t < tensors.size(); t++)
+            {
+                if (&tensors[t] == &m_graph.GetInput())
+                {
+                    values[t].assign(input, input + getSize(t));
+                }
+            }
+
+            for (uint32_t i = 0; i < m_graph.GetOps().size(); i++)
+            {
+                const OpDesc& op = m_graph.GetOps()[i];
+                const TensorDesc& inputTensor = tensors[op.inputs[0]];
+                const float* src = values[op.inputs[0]].data();
+                const uint32_t layerHeight = height * inputTensor.scale;
+                const uint32_t layerWidth = width * inputTensor.scale;
+
+                std::vector<float>& dst = values[op.output];
+                dst.resize(getSize(op.output));
+
+                switch (op.type)
+                {
+                case OpType::Upsample:
+                    Upsample(src, inputTensor.channels, layerHeight, layerWidth, op.upsampleFactor, dst.data());
+                    break;
+
+                case OpType::Convolution:
+                    Convolve(src, layerHeight, layerWidth, op.convLayer, dst.data(), threadPool);
+                    break;
+
+                case OpType::Add:
+                {
+                    const float* other = values[op.inputs[1]].data();
+                    for (size_t i = 0; i < dst.size(); i++)
+                    {
+                        dst[i] = src[i] + other[i];
+                    }
+                    break;
+                }
+
+                case OpType::ConvolutionAdd:
+                    break;
+                }
+
+                for (uint32_t input = 0; input < GetInputCount(op); input++)
+                {
+                    if (m_lastReaders[op.inputs[input]] == i)
+                    {
+                        std::vector<float>().swap(values[op.inputs[input]]);
+                    }
+                }
+            }
+
+            for (uint32_t t = 0; t < tensors.size(); t++)
+            {
+                if (&tensors[t] == &m_graph.GetOutput())
+                {
+                    output.swap(values[t]);
+                }
+            }
+        }
+
+    private:
+        static void Upsample(const float* input, uint32_t channels, uint32_t height, uint32_t width, uint32_t factor, float* output)
+        {
+            const uint32_t outputWidth = width * factor;
+            for (uint32_t c = 0; c < channels; c++)
+            {
+                for (uint32_t y = 0; y < height * factor; y++)
+                {
+                    for (uint32_t x = 0; x < outputWidth; x++)
+                    {
+                        output[(size_t(c) * height * factor + y) * outputWidth + x] = input[(size_t(c) * height + y / factor) * width + x / factor];
+                    }
+                }
+            }
+        }
+
+        // One task per output channel, which accumulates a row at a time
+        void Convolve(const float* input, uint32_t height, uint32_t width, uint32_t convLayer, float* output, ThreadPool* threadPool) const
+        {
+            const ConvLayerDesc& layer = m_graph.GetConvLayers()[convLayer];
+            const float* filter = m_filters[convLayer].data();
+            const std::vector<float>& bias = m_biases[convLayer];
+            const bool relu = UsesBiasAndActivation(layer);
+
+            const uint32_t C = layer.filterSizes[1];
+            const uint32_t KH = layer.filterSizes[2];
+            const uint32_t KW = layer.filterSizes[3];
+
+            uint32_t startPadding[2], endPadding[2];
+            GetConvPadding(layer.filterSizes, startPadding, endPadding);
+
+            ParallelFor(threadPool, layer.filterSizes[0], [&](uint32_t k, uint32_t)
+            {
+                for (uint32_t y = 0; y < height; y++)
+                {
+                    float* row = output + (size_t(k) * height + y) * width;
+                    std::fill_n(row, width, bias.empty() ? 0.0f : bias[k]);
+
+                    for (uint32_t c = 0; c < C; c++)
+                    {
+                        for (uint32_t ky = 0; ky < KH; ky++)
+                        {
+                            const int iy = int(y + ky) - int(startPadding[0]);
+                            if (iy < 0 || iy >= int(height))
+                            {
+                                continue;
+                            }
+                            const float* inputRow = input + (size_t(c) * height + iy) * width;
+
+                            for (uint32_t kx = 0; kx < KW; kx++)
+                            {
+                                const float w = filter[((size_t(k) * C + c) * KH + ky) * KW + kx];
+                                const int offset = int(kx) - int(startPadding[1]);
+                                const int begin = std::max(0, -offset);
+                                const int count = std::min(int(width), int(width) - offset) - begin;
+                                float* destination = row + begin;
+                                const float* source = inputRow + begin + offset;
+                                for (int x = 0; x < count; x++)
+                                {
+                                    destination[x] += w * source[x];
+                                }
+                            }
+                        }
+                    }
+
+                    if (relu)
+                    {
+                        for (uint32_t x = 0; x < width; x++)
+                        {
+                            row[x] = std::max(row[x], 0.0f);
+                        }
+                    }
+                }
+            });
+        }
+
+        Graph                           m_graph;
+        std::vector<std::vector<float>> m_filters;
+        std::vector<std::vector<float>> m_biases;
+        std::vector<uint32_t>           m_lastReaders;      // Per tensor, the last op reading it
+    };
+
+    struct Quality
+    {
+        double  psnr;
+        double  ssim;
+        float   maxError;
+    };
+
+    // Gaussian window of the SSIM paper (Wang et al., "Image Quality Assessment: From Error Visibility to Structural
+    // Similarity"), applied separably where it fits in the plane
+    const int c_ssimRadius = 5;
+    const double c_ssimSigma = 1.5;
+
+    void BlurValid(const std::vector<double>& plane, uint32_t height, uint32_t width, const double* weights, std::vector<double>& out)
+    {
+        const uint32_t diameter = 2 * c_ssimRadius + 1;
+        const uint32_t outWidth = width - diameter + 1;
+        const uint32_t outHeight = height - diameter + 1;
+
+        std::vector<double> rows(size_t(height) * outWidth, 0.0);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < outWidth; x++)
+            {
+                double sum = 0.0;
+                for (uint32_t i = 0; i < diameter; i++)
+                {
+                    sum += weights[i] * plane[size_t(y) * width + x + i];
+                }
+                rows[size_t(y) * outWidth + x] = sum;
+            }
+        }
+
+        out.assign(size_t(outHeight) * outWidth, 0.0);
+        for (uint32_t y = 0; y < outHeight; y++)
+        {
+            for (uint32_t i = 0; i < diameter; i++)
+            {
+                for (uint32_t x = 0; x < outWidth; x++)
+                {
+                    out[size_t(y) * outWidth + x] += weights[i] * rows[size_t(y + i) * outWidth + x];
+                }
+            }
+        }
+    }
+
+    // Mean SSIM of the planes, with the constants of the paper for a dynamic range of 1
+    double GetSsim(const float* a, const float* b, uint32_t channels, uint32_t height, uint32_t width)
+    {
+        const uint32_t diameter = 2 * c_ssimRadius + 1;
+        if (height < diameter || width < diameter)
+        {
+            return 1.0;
+        }
+
+        double weights[2 * c_ssimRadius + 1];
+        double weightSum = 0.0;
+        for (int i = -c_ssimRadius; i <= c_ssimRadius; i++)
+        {
+            weights[i + c_ssimRadius] = std::exp(-0.5 * i * i / (c_ssimSigma * c_ssimSigma));
+            weightSum += weights[i + c_ssimRadius];
+        }
+        for (double& weight : weights)
+        {
+            weight /= weightSum;
+        }
+
+        const double c1 = 0.01 * 0.01;
+        const double c2 = 0.03 * 0.03;
+        const size_t planeSize = size_t(height) * width;
+
+        std::vector<double> x(planeSize), y(planeSize), xx(planeSize), yy(planeSize), xy(planeSize);
+        std::vector<double> meanX, meanY, meanXX, meanYY, meanXY;
+        double sum = 0.0;
+        size_t count = 0;
+
+        for (uint32_t c = 0; c < channels; c++)
+        {
+            for (size_t i = 0; i < planeSize; i++)
+            {
+                x[i] = a[c * planeSize + i];
+                y[i] = b[c * planeSize + i];
+                xx[i] = x[i] * x[i];
+                yy[i] = y[i] * y[i];
+                xy[i] = x[i] * y[i];
+            }
+            BlurValid(x, height, width, weights, meanX);
+            BlurValid(y, height, width, weights, meanY);
+            BlurValid(xx, height, width, weights, meanXX);
+            BlurValid(yy, height, width, weights, meanYY);
+            BlurValid(xy, height, width, weights, meanXY);
+
+            for (size_t i = 0; i < meanX.size(); i++)
+            {
+                const double mx = meanX[i];
+                const double my = meanY[i];
+                const double varianceX = meanXX[i] - mx * mx;
+                const double varianceY = meanYY[i] - my * my;
+                const double covariance = meanXY[i] - mx * my;
+                sum += ((2.0 * mx * my + c1) * (2.0 * covariance + c2)) /
+                       ((mx * mx + my * my + c1) * (varianceX + varianceY + c2));
+            }
+            count += meanX.size();
+        }
+        return sum / count;
+    }
+
+    Quality Compare(const std::vector<float>& output, const std::vector<float>& reference, uint32_t channels, uint32_t height, uint32_t width)
+    {
+        std::vector<float> a(output.size()), b(reference.size());
+        double squaredError = 0.0;
+        float maxError = 0.0f;
+        for (size_t i = 0; i < output.size(); i++)
+        {
+            a[i] = std::min(std::max(output[i], 0.0f), 1.0f);
+            b[i] = std::min(std::max(reference[i], 0.0f), 1.0f);
+            const float difference = std::abs(a[i] - b[i]);
+            squaredError += double(difference) * difference;
+            maxError = std::max(maxError, difference);
+        }
+
+        Quality quality;
+        quality.psnr = (squaredError > 0.0) ? 10.0 * std::log10(output.size() / squaredError) : INFINITY;
+        quality.ssim = GetSsim(a.data(), b.data(), channels, height, width);
+        quality.maxError = maxError;
+        return quality;
+    }
+
+    bool ParsePathNames(const std::string& list, std::vector<const FastPath*>& pathsOut)
+    {
+        pathsOut.clear();
+        size_t start = 0;
+        while (start <= list.size())
+        {
+            const size_t end = std::min(list.find(',', start), list.size());
+            const std::string name = list.substr(start, end - start);
+
+            const FastPath* found = nullptr;
+            for (const FastPath& path : c_fastPaths)
+            {
+                found = (name == path.name) ? &path : found;
+            }
+            if (!found)
+            {
+                std::cerr << "Unknown fast path: " << name << std::endl;
+                return false;
+            }
+            pathsOut.push_back(found);
+            start = end + 1;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string graphPath = "Assets/model.txt";
+    std::string weightsPath = "Assets/weights.bin";
+    std::string rangesPath;
+    uint32_t cropWidth = 0;
+    uint32_t cropHeight = 0;
+    uint32_t threadCount = 1;
+    std::vector<const FastPath*> paths;
+    std::vector<std::string> files(std::begin(c_sampleFrames), std::end(c_sampleFrames));
+
+    for (const FastPath& path : c_fastPaths)
+    {
+        paths.push_back(&path);
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+        {
+            graphPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+        {
+            weightsPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-q") && i + 1 < argc)
+        {
+            rangesPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &cropWidth, &cropHeight) != 2 || cropWidth == 0 || cropHeight == 0)
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+        {
+            if (!ParsePathNames(argv[++i], paths))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            threadCount = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+        }
+        else if (argv[i][0] == '-')
+        {
+            PrintUsage();
+            return 1;
+        }
+        else
+        {
+            files.push_back(argv[i]);
+        }
+    }
+
+    Graph graph;
+    WeightMapType weights;
+    if (!graph.Load(graphPath) || !LoadWeights(weightsPath, weights))
+    {
+        return 1;
+    }
+    if (graph.GetInput().channels != 3)
+    {
+        std::cerr << "The model must take RGB images: " << graphPath << std::endl;
+        return 1;
+    }
+    const uint32_t upscaleFactor = graph.GetUpscaleFactor();
+
+    std::vector<ImageRGB8> images(files.size());
+    std::vector<std::vector<float>> inputs(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (!LoadImageFile(files[i], images[i]))
+        {
+            return 1;
+        }
+        if (cropWidth != 0)
+        {
+            CropImage(images[i], cropWidth, cropHeight);
+        }
+        ImageToPlanar(images[i], inputs[i]);
+    }
+
+    std::unique_ptr<ThreadPool> threadPool;
+    if (threadCount != 1)
+    {
+        threadPool.reset(new ThreadPool(threadCount));
+        threadCount = threadPool->GetThreadCount();
+    }
+
+    ReferenceModel reference;
+    if (!reference.Initialize(graph, weights))
+    {
+        return 1;
+    }
+
+    // INT8 needs the range of each convolution input. Without a calibration file, they are recorded on the frames
+    // being checked, which is the best case for INT8.
+    Quantization::ActivationRanges ranges;
+    bool usesInt8 = false;
+    for (const FastPath* path : paths)
+    {
+        usesInt8 = usesInt8 || path->precision == CpuInference::Precision::Int8;
+    }
+    if (usesInt8 && !rangesPath.empty() && !Quantization::LoadActivationRanges(rangesPath, ranges))
+    {
+        return 1;
+    }
+    if (usesInt8 && rangesPath.empty())
+    {
+        CpuInference calibrationModel;
+        if (!calibrationModel.Initialize(graph, weights))
+        {
+            return 1;
+        }
+        calibrationModel.SetThreadPool(threadPool.get());
+        calibrationModel.SetRecordActivationRanges(true);
+
+        std::vector<float> output;
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            output.resize(inputs[i].size() * upscaleFactor * upscaleFactor);
+            calibrationModel.Run(inputs[i].data(), 1, images[i].height, images[i].width, output.data());
+        }
+        ranges = calibrationModel.GetActivationRanges();
+        std::cout << "Calibrated INT8 on the " << images.size() << " checked frame(s)" << std::endl;
+    }
+
+    std::cout << "Checking " << paths.size() << " fast path(s) on " << images.size() << " frame(s), " << threadCount << " thread(s)" << std::endl;
+
+    std::vector<std::vector<float>> referenceOutputs(images.size());
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        reference.Run(inputs[i].data(), images[i].height, images[i].width, referenceOutputs[i], threadPool.get());
+        std::cout << "Reference for " << files[i] << " in " << std::fixed << std::setprecision(1)
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+
+    // Each path runs the graph as the tools do, with the adds fused into the convolutions. Only one is initialized
+    // at a time, since each holds the working set of a full frame.
+    std::vector<std::vector<Quality>> qualities(images.size(), std::vector<Quality>(paths.size()));
+    std::vector<float> output;
+    for (size_t p = 0; p < paths.size(); p++)
+    {
+        const FastPath& path = *paths[p];
+        Graph fastGraph = graph;
+        if (path.subpixel)
+        {
+            fastGraph.FuseUpsampleConvolutions();
+        }
+        fastGraph.FuseConvolutionAdds();
+        fastGraph.FuseUpsampleAdds();
+
+        CpuInference model;
+        model.SetConvAlgorithm(path.algorithm);
+        model.SetConvLayout(path.layout);
+        model.SetPrecision(path.precision);
+        model.SetActivationRanges(ranges);
+        if (!model.Initialize(fastGraph, weights))
+        {
+            return 1;
+        }
+        if (path.tiled)
+        {
+            model.SetTileSize(c_tileWidth, c_tileHeight);
+        }
+        model.SetThreadPool(threadPool.get());
+
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            output.resize(referenceOutputs[i].size());
+            model.Run(inputs[i].data(), 1, images[i].height, images[i].width, output.data());
+            qualities[i][p] = Compare(output, referenceOutputs[i], 3, images[i].height * upscaleFactor, images[i].width * upscaleFactor);
+        }
+    }
+
+    uint32_t failureCount = 0;
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        std::cout << files[i] << " (" << images[i].width << "x" << images[i].height << "):" << std::endl
+                  << "  path        PSNR dB      SSIM   max error" << std::endl;
+
+        for (size_t p = 0; p < paths.size(); p++)
+        {
+            const FastPath& path = *paths[p];
+            const Quality& quality = qualities[i][p];
+
+            std::string failures;
+            if (!(quality.psnr >= path.minPsnr))
+            {
+                failures += " PSNR";
+            }
+            if (!(quality.ssim >= path.minSsim))
+            {
+                failures += " SSIM";
+            }
+            if (!(quality.maxError <= path.maxError))
+            {
+                failures += " error";
+            }
+            failureCount += failures.empty() ? 0 : 1;
+
+            std::cout << "  " << std::left << std::setw(9) << path.name << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(10) << quality.psnr << std::setprecision(6) << std::setw(10) << quality.ssim
+                      << std::scientific << std::setprecision(2) << std::setw(12) << quality.maxError
+                      << (failures.empty() ? "" : "  FAILED:" + failures) << std::endl;
+        }
+        std::cout.unsetf(std::ios::floatfield);
+    }
+
+    if (failureCount > 0)
+    {
+        std::cout << failureCount << " of " << paths.size() * images.size() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All " << paths.size() * images.size() << " check(s) passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,241 @@
+//--------------------------------------------------------------------------------------
+// QuantizeModel.cpp
+//
+// Calibrates the activation ranges of the super-resolution model on sample frames and
+// writes them for CpuInference to run in INT8 (see Quantization.h). Then compares the
+// throughput and quality of the INT8 model against FP32, and against FP16 as run by the
+// DirectML path.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "CpuInference.h"
+#include "ImageFile.h"
+#include "LoadWeights.h"
+#include "Quantization.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::cerr << "Usage: QuantizeModel [-m model.txt] [-w weights.bin] [-o calibration.txt] [-c calibrationCount] [-r repeat] [-s] frame.ppm [frame.ppm ...]" << std::endl;
+    }
+
+    const char* const c_precisionNames[] = { "FP32", "FP16", "INT8" };
+
+    void ImageToPlanar(const ImageRGB8& image, std::vector<float>& planar)
+    {
+        const size_t planeSize = size_t(image.width) * image.height;
+        planar.resize(planeSize * 3);
+
+        for (size_t i = 0; i < planeSize; i++)
+        {
+            for (size_t c = 0; c < 3; c++)
+            {
+                planar[i + planeSize * c] = image.pixels[i * 3 + c] / 255.0f;
+            }
+        }
+    }
+
+    // Of the output clamped to [0, 1], as it is displayed
+    double GetSquaredError(const std::vector<float>& output, const std::vector<float>& reference)
+    {
+        double sum = 0.0;
+        for (size_t i = 0; i < output.size(); i++)
+        {
+            const double difference = std::min(std::max(output[i], 0.0f), 1.0f) - std::min(std::max(reference[i], 0.0f), 1.0f);
+            sum += difference * difference;
+        }
+        return sum;
+    }
+
+    double GetPsnr(double squaredError, double count)
+    {
+        return (squaredError > 0.0) ? 10.0 * std::log10(count / squaredError) : INFINITY;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string graphPath = "Assets/model.txt";
+    std::string weightsPath = "Assets/weights.bin";
+    std::string rangesPath = "calibration.txt";
+    size_t calibrationCount = SIZE_MAX;
+    int repeat = 3;
+    bool subpixel = false;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+        {
+            graphPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+        {
+            weightsPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+        {
+            rangesPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+        {
+            calibrationCount = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+        {
+            repeat = std::max(1, atoi(argv[++i]));
+        }
+        else if (!strcmp(argv[i], "-s"))
+        {
+            subpixel = true;
+        }
+        else
+        {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (files.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    SuperResolutionModel::Graph graph;
+    WeightMapType weights;
+    if (!graph.Load(graphPath) || !LoadWeights(weightsPath, weights))
+    {
+        return 1;
+    }
+    if (graph.GetInput().channels != 3)
+    {
+        std::cerr << "The model must take RGB images: " << graphPath << std::endl;
+        return 1;
+    }
+    if (subpixel)
+    {
+        graph.FuseUpsampleConvolutions();
+    }
+
+    std::vector<ImageRGB8> images(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (!LoadImageFile(files[i], images[i]))
+        {
+            return 1;
+        }
+    }
+
+    // Calibrate on the first frames with the FP32 model. The ranges cover every tensor, although only those of the
+    // convolution inputs are used.
+    CpuInference calibrationModel;
+    if (!calibrationModel.Initialize(graph, weights))
+    {
+        return 1;
+    }
+    calibrationModel.SetRecordActivationRanges(true);
+
+    std::vector<float> input, output;
+    calibrationCount = std::min(calibrationCount, images.size());
+    for (size_t i = 0; i < calibrationCount; i++)
+    {
+        ImageToPlanar(images[i], input);
+        output.resize(input.size() * graph.GetUpscaleFactor() * graph.GetUpscaleFactor());
+        calibrationModel.Run(input.data(), 1, images[i].height, images[i].width, output.data());
+    }
+
+    const Quantization::ActivationRanges& ranges = calibrationModel.GetActivationRanges();
+    if (!Quantization::SaveActivationRanges(rangesPath, ranges))
+    {
+        return 1;
+    }
+    std::cout << "Calibrated on " << calibrationCount << " frame(s), wrote " << rangesPath << ":" << std::endl;
+    for (const auto& entry : ranges)
+    {
+        std::cout << "  " << std::left << std::setw(10) << entry.first << std::right << " [" << entry.second.min << ", "
+                  << entry.second.max << "]" << std::endl;
+    }
+
+    // Compare the three precisions on every frame
+    const CpuInference::Precision precisions[] =
+    {
+        CpuInference::Precision::Float32,
+        CpuInference::Precision::Float16,
+        CpuInference::Precision::Int8,
+    };
+    const size_t precisionCount = sizeof(precisions) / sizeof(precisions[0]);
+
+    CpuInference models[precisionCount];
+    for (size_t p = 0; p < precisionCount; p++)
+    {
+        models[p].SetPrecision(precisions[p]);
+        models[p].SetActivationRanges(ranges);
+        if (!models[p].Initialize(graph, weights))
+        {
+            return 1;
+        }
+    }
+
+    std::cout << "INT8 convolutions:";
+    for (uint32_t layer = 0; layer < graph.GetConvLayers().size(); layer++)
+    {
+        std::cout << " " << graph.GetConvLayers()[layer].name << (models[2].IsQuantized(layer) ? "" : " (FP32)");
+    }
+    std::cout << std::endl;
+
+    double seconds[precisionCount] = {};
+    double squaredError[precisionCount] = {};
+    double squaredErrorFromFp16 = 0.0;
+    double elementCount = 0.0;
+    std::vector<float> outputs[precisionCount];
+
+    for (const ImageRGB8& image : images)
+    {
+        ImageToPlanar(image, input);
+
+        for (size_t p = 0; p < precisionCount; p++)
+        {
+            outputs[p].resize(input.size() * graph.GetUpscaleFactor() * graph.GetUpscaleFactor());
+
+            double best = 1e30;
+            for (int r = 0; r < repeat; r++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                models[p].Run(input.data(), 1, image.height, image.width, outputs[p].data());
+                best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            seconds[p] += best;
+            squaredError[p] += GetSquaredError(outputs[p], outputs[0]);
+        }
+
+        squaredErrorFromFp16 += GetSquaredError(outputs[2], outputs[1]);
+        elementCount += double(outputs[0].size());
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << images.size() << " frame(s), best of " << repeat << ":" << std::endl;
+    for (size_t p = 0; p < precisionCount; p++)
+    {
+        std::cout << "  " << c_precisionNames[p] << ": " << std::setw(7) << images.size() / seconds[p] << " frames/s ("
+                  << seconds[0] / seconds[p] << "x FP32), PSNR from FP32 " << GetPsnr(squaredError[p], elementCount) << " dB" << std::endl;
+    }
+    std::cout << "INT8 PSNR from FP16 " << GetPsnr(squaredErrorFromFp16, elementCount) << " dB; INT8 - FP16 PSNR from FP32 "
+              << GetPsnr(squaredError[2], elementCount) - GetPsnr(squaredError[1], elementCount) << " dB" << std::endl;
+    std::cout << "FP16 only emulates the rounding of the DirectML path, so its time is not representative" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,556 @@
+//--------------------------------------------------------------------------------------
+// SuperResolutionCpu.cpp
+//
+// Headless command-line front end for the CPU implementation of the super-resolution
+// model. Upscales one or more PPM/PGM frames and reports the achieved throughput.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "CpuInference.h"
+#include "ImageFile.h"
+#include "LoadWeights.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::cerr << "Usage: SuperResolutionCpu [-m model.txt] [-w weights.bin] [-r repeat] [-b batchSize] [-t WIDTHxHEIGHT] [-p] [-s] [-a direct|f2|f4] [-q calibration.txt] [-v] [-j threads] [-k none|compact|scatter] [-e] [-l nchw|nhwc|nchwc8|nchwc16|tune] [-c layouts.txt] [-T trace.json] input.ppm output.ppm [input.ppm output.ppm ...]" << std::endl;
+    }
+
+    double ToMiB(uint64_t bytes)
+    {
+        return bytes / (1024.0 * 1024.0);
+    }
+
+    // Largest difference tolerated by -v from the original graph with direct FP32 convolutions, for values in
+    // [0, 1]. Pixels are quantized in steps of 1/255. INT8 convolutions are typically within a step, but the
+    // error reaches several steps at a few pixels of strong edges.
+    const float c_verifyTolerance = 1e-4f;
+    const float c_int8VerifyTolerance = 32.0f / 255.0f;
+
+    bool ParseConvAlgorithm(const char* name, CpuKernels::ConvAlgorithm& algorithmOut)
+    {
+        const struct { const char* name; CpuKernels::ConvAlgorithm algorithm; } algorithms[] =
+        {
+            { "direct", CpuKernels::ConvAlgorithm::Direct },
+            { "f2", CpuKernels::ConvAlgorithm::Winograd2x2 },
+            { "f4", CpuKernels::ConvAlgorithm::Winograd4x4 },
+        };
+
+        for (const auto& entry : algorithms)
+        {
+            if (!strcmp(name, entry.name))
+            {
+                algorithmOut = entry.algorithm;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ParseConvLayout(const char* name, CpuKernels::ConvLayout& layoutOut)
+    {
+        for (CpuKernels::ConvLayout layout : CpuKernels::c_convLayouts)
+        {
+            if (!strcmp(name, CpuKernels::GetConvLayoutName(layout)))
+            {
+                layoutOut = layout;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ParseAffinity(const char* name, ThreadPool::Affinity& affinityOut)
+    {
+        const struct { const char* name; ThreadPool::Affinity affinity; } affinities[] =
+        {
+            { "none", ThreadPool::Affinity::None },
+            { "compact", ThreadPool::Affinity::Compact },
+            { "scatter", ThreadPool::Affinity::Scatter },
+        };
+
+        for (const auto& entry : affinities)
+        {
+            if (!strcmp(name, entry.name))
+            {
+                affinityOut = entry.affinity;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Parallel efficiency is the busy time of the threads over the wall time of the whole pool. Layers where it
+    // drops are where adding threads stops paying off.
+    void PrintLayerProfiles(const std::vector<CpuInference::LayerProfile>& profiles, uint32_t threadCount)
+    {
+        double totalSeconds = 0.0;
+        for (const auto& profile : profiles)
+        {
+            totalSeconds += profile.seconds;
+        }
+
+        std::cout << "Per layer on " << threadCount << " thread(s) (time, share and parallel efficiency):" << std::endl
+                  << std::fixed << std::setprecision(1);
+        for (const auto& profile : profiles)
+        {
+            const double efficiency = (profile.seconds > 0.0) ? profile.busySeconds / (profile.seconds * threadCount) : 0.0;
+            std::cout << "  " << std::setw(9) << profile.seconds * 1000.0 << " ms  " << std::setw(5)
+                      << 100.0 * profile.seconds / totalSeconds << "%  " << std::setw(5) << 100.0 * efficiency << "%  "
+                      << profile.name << std::endl;
+        }
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout << std::setprecision(6);
+    }
+
+    SuperResolutionModel::OpCost GetFrameCost(const SuperResolutionModel::Graph& graph, uint32_t height, uint32_t width)
+    {
+        SuperResolutionModel::OpCost frameCost = {};
+        for (uint32_t op = 0; op < graph.GetOps().size(); op++)
+        {
+            const SuperResolutionModel::OpCost cost = SuperResolutionModel::GetOpCost(graph, op, height, width, sizeof(float));
+            frameCost.flops += cost.flops;
+            frameCost.bytes += cost.bytes;
+        }
+        return frameCost;
+    }
+
+    // Lists where each intermediate buffer and op temporary is placed in the arena
+    void PrintArenaLayout(const SuperResolutionModel::Graph& graph, const MemoryPlanner::ArenaLayout& layout)
+    {
+        const auto& tensors = graph.GetTensors();
+        const auto& ops = graph.GetOps();
+
+        std::cout << "Memory plan (offset, size and lifetime in ops):" << std::endl << std::fixed << std::setprecision(2);
+
+        for (uint32_t buffer = SuperResolutionModel::c_firstIntermediateBuffer; buffer < graph.GetBufferCount(); buffer++)
+        {
+            std::string names;
+            for (const auto& tensor : tensors)
+            {
+                if (tensor.buffer == buffer)
+                {
+                    names += (names.empty() ? "" : ", ") + tensor.name;
+                }
+            }
+
+            uint32_t firstOp, lastOp;
+            graph.GetBufferLifetime(buffer, firstOp, lastOp);
+            std::cout << "  " << std::setw(8) << ToMiB(layout.bufferOffsets[buffer]) << " MiB  " << std::setw(8)
+                      << ToMiB(layout.bufferSizes[buffer]) << " MiB  ops " << firstOp << "-" << lastOp << "  " << names << std::endl;
+        }
+
+        for (uint32_t op = 0; op < ops.size(); op++)
+        {
+            if (layout.temporarySizes[op] > 0)
+            {
+                uint32_t firstOp, lastOp;
+                graph.GetConcurrentOps(op, firstOp, lastOp);
+                std::cout << "  " << std::setw(8) << ToMiB(layout.temporaryOffsets[op]) << " MiB  " << std::setw(8)
+                          << ToMiB(layout.temporarySizes[op]) << " MiB  ops " << firstOp << "-" << lastOp << "  temporary of "
+                          << tensors[ops[op].output].name << std::endl;
+            }
+        }
+
+        std::cout << "Arena " << ToMiB(layout.arenaSize) << " MiB, peak live " << ToMiB(layout.peakLiveSize) << " MiB, "
+                  << ToMiB(layout.GetUnpackedSize()) << " MiB without sharing" << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout << std::setprecision(6);
+    }
+
+    // Writes one image of a batch
+    void ImageToPlanar(const ImageRGB8& image, float* planar)
+    {
+        const size_t planeSize = size_t(image.width) * image.height;
+
+        // RGB plane order since model was trained on this
+        for (size_t i = 0; i < planeSize; i++)
+        {
+            planar[i] = image.pixels[i * 3] / 255.0f;
+            planar[i + planeSize] = image.pixels[i * 3 + 1] / 255.0f;
+            planar[i + planeSize * 2] = image.pixels[i * 3 + 2] / 255.0f;
+        }
+    }
+
+    void PlanarToImage(const float* planar, ImageRGB8& image)
+    {
+        const size_t planeSize = size_t(image.width) * image.height;
+        image.pixels.resize(planeSize * 3);
+
+        for (size_t i = 0; i < planeSize; i++)
+        {
+            for (size_t c = 0; c < 3; c++)
+            {
+                float value = std::min(std::max(planar[i + planeSize * c], 0.0f), 1.0f);
+                image.pixels[i * 3 + c] = static_cast<uint8_t>(std::lround(value * 255.0f));
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string graphPath = "Assets/model.txt";
+    std::string weightsPath = "Assets/weights.bin";
+    int repeat = 1;
+    uint32_t batchSize = 1;
+    uint32_t tileWidth = 0;
+    uint32_t tileHeight = 0;
+    bool printPlan = false;
+    bool subpixel = false;
+    bool verify = false;
+    bool profile = false;
+    uint32_t threadCount = 1;
+    ThreadPool::Affinity affinity = ThreadPool::Affinity::None;
+    CpuKernels::ConvLayout convLayout = CpuKernels::ConvLayout::NCHW;
+    bool tuneLayouts = false;
+    std::string layoutCachePath = "layouts.txt";
+    std::string rangesPath;
+    std::string tracePath;
+    CpuKernels::ConvAlgorithm convAlgorithm = CpuKernels::ConvAlgorithm::Winograd4x4;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+        {
+            graphPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+        {
+            weightsPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+        {
+            repeat = std::max(1, atoi(argv[++i]));
+        }
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+        {
+            batchSize = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &tileWidth, &tileHeight) != 2)
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-p"))
+        {
+            printPlan = true;
+        }
+        else if (!strcmp(argv[i], "-s"))
+        {
+            subpixel = true;
+        }
+        else if (!strcmp(argv[i], "-a") && i + 1 < argc)
+        {
+            if (!ParseConvAlgorithm(argv[++i], convAlgorithm))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-q") && i + 1 < argc)
+        {
+            rangesPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-v"))
+        {
+            verify = true;
+        }
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            threadCount = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+        {
+            if (!ParseAffinity(argv[++i], affinity))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-e"))
+        {
+            profile = true;
+        }
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+        {
+            tuneLayouts = !strcmp(argv[++i], "tune");
+            if (!tuneLayouts && !ParseConvLayout(argv[i], convLayout))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+        {
+            layoutCachePath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-T") && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else
+        {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (files.empty() || files.size() % 2 != 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    auto loadStart = std::chrono::steady_clock::now();
+
+    SuperResolutionModel::Graph graph;
+    if (!graph.Load(graphPath))
+    {
+        return 1;
+    }
+    if (graph.GetInput().channels != 3)
+    {
+        std::cerr << "The model must take RGB images: " << graphPath << std::endl;
+        return 1;
+    }
+
+    WeightMapType weights;
+    if (!LoadWeights(weightsPath, weights))
+    {
+        return 1;
+    }
+
+    // INT8 convolutions need the activation ranges calibrated by QuantizeModel
+    Quantization::ActivationRanges ranges;
+    if (!rangesPath.empty() && !Quantization::LoadActivationRanges(rangesPath, ranges))
+    {
+        return 1;
+    }
+
+    // Sub-pixel execution runs the convolutions after an upsample at the lower resolution. The original graph is
+    // kept to compare against, with direct convolutions.
+    const SuperResolutionModel::Graph originalGraph = graph;
+    if (subpixel)
+    {
+        std::cout << "Fused " << graph.FuseUpsampleConvolutions() << " upsample(s) into sub-pixel convolutions" << std::endl;
+    }
+
+    // Convolutions add the residual as they store their output, reading the upsampled input in place of the
+    // upsample, which gives the same results
+    std::cout << "Fused " << graph.FuseConvolutionAdds() << " add(s) into convolutions" << std::endl;
+    std::cout << "Fused " << graph.FuseUpsampleAdds() << " upsample(s) into adds" << std::endl;
+
+    // Times measured by earlier runs with -l tune
+    LayoutTuning::MeasuredTimes layoutTimes;
+    if (tuneLayouts && !LayoutTuning::LoadMeasuredTimes(layoutCachePath, layoutTimes))
+    {
+        return 1;
+    }
+
+    CpuInference model, originalModel;
+    model.SetConvAlgorithm(convAlgorithm);
+    model.SetConvLayout(convLayout);
+    if (!rangesPath.empty())
+    {
+        model.SetPrecision(CpuInference::Precision::Int8);
+        model.SetActivationRanges(ranges);
+    }
+    originalModel.SetConvAlgorithm(CpuKernels::ConvAlgorithm::Direct);
+    if (!model.Initialize(graph, weights) || (verify && !originalModel.Initialize(originalGraph, weights)))
+    {
+        return 1;
+    }
+    const uint32_t upscaleFactor = graph.GetUpscaleFactor();
+    model.SetTileSize(tileWidth, tileHeight);
+    originalModel.SetTileSize(tileWidth, tileHeight);
+
+    // One thread (the default) runs without a pool, and zero uses every allowed processor
+    std::unique_ptr<ThreadPool> threadPool;
+    if (threadCount != 1)
+    {
+        threadPool.reset(new ThreadPool(threadCount, affinity));
+        threadCount = threadPool->GetThreadCount();
+        model.SetThreadPool(threadPool.get());
+        originalModel.SetThreadPool(threadPool.get());
+        std::cout << "Running on " << threadCount << " threads, " << threadPool->GetNumaNodeCount() << " NUMA node(s)" << std::endl;
+    }
+    model.SetProfiling(profile);
+
+    std::cout << "Loaded " << weights.size() << " weight tensors in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count() << " ms" << std::endl;
+
+    std::vector<float> input, output, originalOutput;
+    double inferenceSeconds = 0.0;
+    float maxDifference = 0.0f;
+    int frameCount = 0;
+    uint32_t printedWidth = 0, printedHeight = 0, printedBatchCount = 0;
+
+    if (!tracePath.empty())
+    {
+        Trace::Enable();
+    }
+
+    // Consecutive input files of the same size are upscaled together as one batch
+    for (size_t batchStart = 0; batchStart < files.size(); batchStart += 2 * batchSize)
+    {
+        const size_t batchEnd = std::min(files.size(), batchStart + 2 * batchSize);
+        const uint32_t batchCount = static_cast<uint32_t>((batchEnd - batchStart) / 2);
+
+        std::vector<ImageRGB8> images(batchCount);
+        Trace::Begin("Load");
+        for (uint32_t n = 0; n < batchCount; n++)
+        {
+            if (!LoadImageFile(files[batchStart + 2 * n], images[n]))
+            {
+                return 1;
+            }
+            if (images[n].width != images[0].width || images[n].height != images[0].height)
+            {
+                std::cerr << "All images in a batch must be the same size: " << files[batchStart + 2 * n] << std::endl;
+                return 1;
+            }
+        }
+        Trace::End();
+
+        const uint32_t width = images[0].width;
+        const uint32_t height = images[0].height;
+        const size_t imageSize = size_t(3) * width * height;
+
+        input.resize(imageSize * batchCount);
+        output.resize(input.size() * upscaleFactor * upscaleFactor);
+        for (uint32_t n = 0; n < batchCount; n++)
+        {
+            ImageToPlanar(images[n], &input[n * imageSize]);
+        }
+
+        // The best layouts depend on the size, so tune for each batch of a new size before timing it
+        const bool newSize = (batchStart == 0 || width != printedWidth || height != printedHeight || batchCount != printedBatchCount);
+        if (tuneLayouts && newSize)
+        {
+            const uint32_t measurementCount = model.TuneConvLayouts(batchCount, height, width, layoutTimes);
+            if (measurementCount > 0 && !LayoutTuning::SaveMeasuredTimes(layoutCachePath, layoutTimes))
+            {
+                return 1;
+            }
+
+            std::cout << "Layouts for " << width << "x" << height << " (" << measurementCount << " measured, the rest from "
+                      << layoutCachePath << "):";
+            for (uint32_t layer = 0; layer < graph.GetConvLayers().size(); layer++)
+            {
+                if (model.GetConvAlgorithm(layer) == CpuKernels::ConvAlgorithm::Direct && !model.IsQuantized(layer))
+                {
+                    std::cout << " " << graph.GetConvLayers()[layer].name << " " << CpuKernels::GetConvLayoutName(model.GetConvLayout(layer));
+                }
+            }
+            std::cout << std::endl;
+        }
+
+        for (int r = 0; r < repeat; r++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            model.Run(input.data(), batchCount, height, width, output.data());
+            inferenceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            frameCount += batchCount;
+        }
+
+        if (verify)
+        {
+            originalOutput.resize(output.size());
+            originalModel.Run(input.data(), batchCount, height, width, originalOutput.data());
+            for (size_t i = 0; i < output.size(); i++)
+            {
+                maxDifference = std::max(maxDifference, std::abs(output[i] - originalOutput[i]));
+            }
+        }
+
+        // The plan and cost depend on the input size, so print them for each batch of a new size. With tiling, the
+        // plan is the one of the last tile.
+        if (newSize)
+        {
+            if (printPlan)
+            {
+                PrintArenaLayout(graph, model.GetArenaLayout());
+            }
+            if (subpixel)
+            {
+                const SuperResolutionModel::OpCost originalCost = GetFrameCost(originalGraph, height, width);
+                const SuperResolutionModel::OpCost cost = GetFrameCost(graph, height, width);
+                std::cout << "Per " << width << "x" << height << " frame: " << originalCost.flops * 1e-9 << " -> "
+                          << cost.flops * 1e-9 << " GFLOP (" << double(originalCost.flops) / cost.flops << "x), "
+                          << ToMiB(originalCost.bytes) << " -> " << ToMiB(cost.bytes) << " MiB of FP32 tensor traffic ("
+                          << double(originalCost.bytes) / cost.bytes << "x)" << std::endl;
+            }
+            printedWidth = width;
+            printedHeight = height;
+            printedBatchCount = batchCount;
+        }
+
+        Trace::Scope saveScope("Save");
+        for (uint32_t n = 0; n < batchCount; n++)
+        {
+            const std::string& outputPath = files[batchStart + 2 * n + 1];
+
+            ImageRGB8 result;
+            result.width = width * upscaleFactor;
+            result.height = height * upscaleFactor;
+            PlanarToImage(&output[n * imageSize * upscaleFactor * upscaleFactor], result);
+
+            if (!SaveImageFile(outputPath, result))
+            {
+                return 1;
+            }
+
+            std::cout << files[batchStart + 2 * n] << " (" << width << "x" << height << ") -> " << outputPath
+                      << " (" << result.width << "x" << result.height << ")" << std::endl;
+        }
+    }
+
+    std::cout << frameCount << " frame(s) in " << inferenceSeconds << " s: "
+              << frameCount / inferenceSeconds << " frames/s, "
+              << model.GetWorkingSetSize() / (1024.0 * 1024.0) << " MiB working set" << std::endl;
+
+    if (profile)
+    {
+        PrintLayerProfiles(model.GetLayerProfiles(), threadCount);
+    }
+
+    if (!tracePath.empty() && !Trace::WriteChromeTrace(tracePath))
+    {
+        return 1;
+    }
+
+    if (verify)
+    {
+        const float tolerance = rangesPath.empty() ? c_verifyTolerance : c_int8VerifyTolerance;
+        std::cout << "Largest difference from the original graph: " << maxDifference << std::endl;
+        if (!(maxDifference <= tolerance))
+        {
+            std::cerr << "The result differs by more than " << tolerance << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
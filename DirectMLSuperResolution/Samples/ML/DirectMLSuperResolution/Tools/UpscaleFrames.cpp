@@ -0,0 +1,456 @@
+//--------------------------------------------------------------------------------------
+// UpscaleFrames.cpp
+//
+// Headless batch upscaler for the CPU implementation of the super-resolution model. Takes
+// directories and lists of PNG/PPM/PGM frames and writes the upscaled results to an output
+// directory. Decoding, inference and encoding run on their own threads, connected by
+// bounded queues, so that frame N+1 is decoded and frame N-1 encoded while frame N runs
+// through the model. Reports the end-to-end throughput and how busy each stage was.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "ColorConversion.h"
+#include "CpuInference.h"
+#include "FramePipeline.h"
+#include "FrameStatistics.h"
+#include "ImageFile.h"
+#include "LoadWeights.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::cerr << "Usage: UpscaleFrames [-m model.txt] [-w weights.bin] [-o outputDirectory] [-f png|ppm] [-d decodeQueueDepth] [-n encodeQueueDepth] [-t WIDTHxHEIGHT] [-s] [-a direct|f2|f4] [-q calibration.txt] [-j threads] [-k none|compact|scatter] [-T trace.json] [-H statistics.json] input [input ...]" << std::endl
+                  << "Each input is a frame or a directory of frames (.png, .ppm or .pgm), processed in name order." << std::endl;
+    }
+
+    // A frame on its way through the pipeline, as a planar RGB tensor
+    struct Frame
+    {
+        size_t              index = 0;
+        uint32_t            width = 0;
+        uint32_t            height = 0;
+        std::vector<float>  tensor;
+        std::vector<float>  base;           // Model input, added to the output by the encoder if the model leaves it out
+    };
+
+    bool ParseConvAlgorithm(const char* name, CpuKernels::ConvAlgorithm& algorithmOut)
+    {
+        const struct { const char* name; CpuKernels::ConvAlgorithm algorithm; } algorithms[] =
+        {
+            { "direct", CpuKernels::ConvAlgorithm::Direct },
+            { "f2", CpuKernels::ConvAlgorithm::Winograd2x2 },
+            { "f4", CpuKernels::ConvAlgorithm::Winograd4x4 },
+        };
+
+        for (const auto& entry : algorithms)
+        {
+            if (!strcmp(name, entry.name))
+            {
+                algorithmOut = entry.algorithm;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ParseAffinity(const char* name, ThreadPool::Affinity& affinityOut)
+    {
+        const struct { const char* name; ThreadPool::Affinity affinity; } affinities[] =
+        {
+            { "none", ThreadPool::Affinity::None },
+            { "compact", ThreadPool::Affinity::Compact },
+            { "scatter", ThreadPool::Affinity::Scatter },
+        };
+
+        for (const auto& entry : affinities)
+        {
+            if (!strcmp(name, entry.name))
+            {
+                affinityOut = entry.affinity;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool IsImageFileName(const std::string& name)
+    {
+        const size_t dot = name.rfind('.');
+        if (dot == std::string::npos)
+        {
+            return false;
+        }
+
+        std::string extension = name.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+        return extension == "png" || extension == "ppm" || extension == "pgm";
+    }
+
+    // Appends the image files of a directory in name order. Returns false if the path is not a directory.
+    bool ListDirectory(const std::string& path, std::vector<std::string>& filesOut)
+    {
+        std::vector<std::string> names;
+#if defined(_WIN32)
+        WIN32_FIND_DATAA findData;
+        HANDLE find = FindFirstFileA((path + "\\*").c_str(), &findData);
+        if (find == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        do
+        {
+            if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && IsImageFileName(findData.cFileName))
+            {
+                names.push_back(findData.cFileName);
+            }
+        } while (FindNextFileA(find, &findData));
+        FindClose(find);
+#else
+        DIR* directory = opendir(path.c_str());
+        if (!directory)
+        {
+            return false;
+        }
+        while (const dirent* entry = readdir(directory))
+        {
+            const std::string name = entry->d_name;
+            struct stat status;
+            if (IsImageFileName(name) && stat((path + "/" + name).c_str(), &status) == 0 && S_ISREG(status.st_mode))
+            {
+                names.push_back(name);
+            }
+        }
+        closedir(directory);
+#endif
+
+        std::sort(names.begin(), names.end());
+        for (const std::string& name : names)
+        {
+            filesOut.push_back(path + "/" + name);
+        }
+        return true;
+    }
+
+    bool CreateOutputDirectory(const std::string& path)
+    {
+#if defined(_WIN32)
+        if (_mkdir(path.c_str()) == 0 || errno == EEXIST)
+#else
+        if (mkdir(path.c_str(), 0777) == 0 || errno == EEXIST)
+#endif
+        {
+            return true;
+        }
+        std::cerr << "Unable to create output directory: " << path << std::endl;
+        return false;
+    }
+
+    // The file name without its directory and extension
+    std::string GetStem(const std::string& path)
+    {
+        const size_t slash = path.find_last_of("/\\");
+        const std::string name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+        const size_t dot = name.rfind('.');
+        return (dot == std::string::npos || dot == 0) ? name : name.substr(0, dot);
+    }
+
+    void ImageToPlanar(const ImageRGB8& image, float* planar)
+    {
+        const size_t planeSize = size_t(image.width) * image.height;
+
+        // RGB plane order since model was trained on this
+        for (size_t i = 0; i < planeSize; i++)
+        {
+            planar[i] = image.pixels[i * 3] / 255.0f;
+            planar[i + planeSize] = image.pixels[i * 3 + 1] / 255.0f;
+            planar[i + planeSize * 2] = image.pixels[i * 3 + 2] / 255.0f;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string graphPath = "Assets/model.txt";
+    std::string weightsPath = "Assets/weights.bin";
+    std::string outputDirectory = "upscaled";
+    std::string outputFormat;
+    size_t decodeQueueDepth = 2;
+    size_t encodeQueueDepth = 2;
+    uint32_t tileWidth = 0;
+    uint32_t tileHeight = 0;
+    bool subpixel = false;
+    CpuKernels::ConvAlgorithm convAlgorithm = CpuKernels::ConvAlgorithm::Winograd4x4;
+    std::string rangesPath;
+    uint32_t threadCount = 1;
+    ThreadPool::Affinity affinity = ThreadPool::Affinity::None;
+    std::string tracePath;
+    std::string statisticsPath;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+        {
+            graphPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+        {
+            weightsPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+        {
+            outputDirectory = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+        {
+            outputFormat = argv[++i];
+            if (outputFormat != "png" && outputFormat != "ppm")
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+        {
+            decodeQueueDepth = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+        {
+            encodeQueueDepth = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &tileWidth, &tileHeight) != 2)
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-s"))
+        {
+            subpixel = true;
+        }
+        else if (!strcmp(argv[i], "-a") && i + 1 < argc)
+        {
+            if (!ParseConvAlgorithm(argv[++i], convAlgorithm))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-q") && i + 1 < argc)
+        {
+            rangesPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            threadCount = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+        {
+            if (!ParseAffinity(argv[++i], affinity))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-T") && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-H") && i + 1 < argc)
+        {
+            statisticsPath = argv[++i];
+        }
+        else
+        {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    // Expand directories into their frames
+    std::vector<std::string> inputFiles;
+    for (const std::string& input : inputs)
+    {
+        if (!ListDirectory(input, inputFiles))
+        {
+            inputFiles.push_back(input);
+        }
+    }
+
+    if (inputFiles.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    // Results keep the name of their input, and its format unless -f is given
+    std::vector<std::string> outputFiles;
+    for (const std::string& input : inputFiles)
+    {
+        const bool png = outputFormat.empty() ? IsPngFileName(input) : (outputFormat == "png");
+        outputFiles.push_back(outputDirectory + "/" + GetStem(input) + (png ? ".png" : ".ppm"));
+    }
+    if (!CreateOutputDirectory(outputDirectory))
+    {
+        return 1;
+    }
+
+    SuperResolutionModel::Graph graph;
+    WeightMapType weights;
+    if (!graph.Load(graphPath) || !LoadWeights(weightsPath, weights))
+    {
+        return 1;
+    }
+    if (graph.GetInput().channels != 3)
+    {
+        std::cerr << "The model must take RGB images: " << graphPath << std::endl;
+        return 1;
+    }
+    if (subpixel)
+    {
+        graph.FuseUpsampleConvolutions();
+    }
+
+    // The encoder adds the upsampled input as it converts the output, rather than the model writing the sum
+    const bool residualSplit = graph.SplitResidualOutput();
+    graph.FuseConvolutionAdds();
+
+    Quantization::ActivationRanges ranges;
+    if (!rangesPath.empty() && !Quantization::LoadActivationRanges(rangesPath, ranges))
+    {
+        return 1;
+    }
+
+    CpuInference model;
+    model.SetConvAlgorithm(convAlgorithm);
+    if (!rangesPath.empty())
+    {
+        model.SetPrecision(CpuInference::Precision::Int8);
+        model.SetActivationRanges(ranges);
+    }
+    if (!model.Initialize(graph, weights))
+    {
+        return 1;
+    }
+    model.SetTileSize(tileWidth, tileHeight);
+    const uint32_t upscaleFactor = graph.GetUpscaleFactor();
+
+    // The pool belongs to the inference stage, which runs on this thread. The decode and encode threads are not part
+    // of it, so with -j 0 they compete with the pool for the processors.
+    std::unique_ptr<ThreadPool> threadPool;
+    if (threadCount != 1)
+    {
+        threadPool.reset(new ThreadPool(threadCount, affinity));
+        threadCount = threadPool->GetThreadCount();
+        model.SetThreadPool(threadPool.get());
+    }
+
+    std::cout << "Upscaling " << inputFiles.size() << " frame(s) into " << outputDirectory << " on " << threadCount
+              << " inference thread(s), queue depths " << decodeQueueDepth << " and " << encodeQueueDepth << std::endl;
+
+    if (!tracePath.empty())
+    {
+        Trace::Enable();
+    }
+
+    FrameStatistics statistics(FramePipeline::GetStatisticNames());
+    if (!statisticsPath.empty() && !statistics.OpenExport(statisticsPath, FramePipeline::c_statisticsIntervalSeconds, 0.0))
+    {
+        return 1;
+    }
+
+    // Inference runs on this thread, which is thread 0 of the pool
+    size_t nextIndex = 0;
+    FramePipeline::Summary summary;
+    const bool succeeded = FramePipeline::Run<Frame>(decodeQueueDepth, encodeQueueDepth,
+        [&](Frame& frame)
+        {
+            if (nextIndex == inputFiles.size())
+            {
+                return FramePipeline::DecodeResult::End;
+            }
+
+            ImageRGB8 image;
+            if (!LoadImageFile(inputFiles[nextIndex], image))
+            {
+                return FramePipeline::DecodeResult::Failed;
+            }
+            frame.index = nextIndex++;
+            frame.width = image.width;
+            frame.height = image.height;
+            frame.tensor.resize(size_t(3) * image.width * image.height);
+            ImageToPlanar(image, frame.tensor.data());
+            return FramePipeline::DecodeResult::Frame;
+        },
+        [&](Frame& frame, Frame& upscaled)
+        {
+            upscaled.index = frame.index;
+            upscaled.width = frame.width * upscaleFactor;
+            upscaled.height = frame.height * upscaleFactor;
+            upscaled.tensor.resize(frame.tensor.size() * upscaleFactor * upscaleFactor);
+            model.Run(frame.tensor.data(), 1, frame.height, frame.width, upscaled.tensor.data());
+            if (residualSplit)
+            {
+                upscaled.base.swap(frame.tensor);
+            }
+            return true;
+        },
+        [&](const Frame& frame)
+        {
+            ImageRGB8 result;
+            result.width = frame.width;
+            result.height = frame.height;
+            result.pixels.resize(size_t(3) * frame.width * frame.height);
+            ColorConversion::TensorToImage(frame.tensor.data(), frame.base.empty() ? nullptr : frame.base.data(), upscaleFactor,
+                frame.width, frame.height, ColorConversion::TensorLayout::Nchw, ColorConversion::PixelFormat::Rgb8, false,
+                result.pixels.data(), frame.width * 3, nullptr);
+            return SaveImageFile(outputFiles[frame.index], result);
+        },
+        summary, &statistics);
+
+    if (!succeeded)
+    {
+        return 1;
+    }
+    FramePipeline::PrintSummary(std::cout, summary);
+    statistics.PrintSummary(std::cout);
+
+    if (!tracePath.empty() && !Trace::WriteChromeTrace(tracePath))
+    {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,407 @@
+//--------------------------------------------------------------------------------------
+// UpscaleVideo.cpp
+//
+// Streams uncompressed 4:2:0 video through the CPU implementation of the super-resolution
+// model, from a Y4M or raw NV12/P010/I420 file or standard input to a Y4M file or standard
+// output, for use in a pipe between ffmpeg commands. Frames are converted from YUV straight
+// to the model's planar FP32 input, and the output straight back to YUV, without an 8-bit
+// RGB image in between, so 10-bit video keeps its precision. Reading, inference and
+// writing overlap as in UpscaleFrames. Messages go to stderr, since stdout may carry video.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "ColorConversion.h"
+#include "CpuInference.h"
+#include "FramePipeline.h"
+#include "FrameStatistics.h"
+#include "LoadWeights.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "VideoStream.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Size of the tiles -D compares, if -t doesn't give one. Each is compared and run with the model's halo around it.
+    const uint32_t c_defaultReuseTileSize = 96;
+
+    void PrintUsage()
+    {
+        std::cerr << "Usage: UpscaleVideo [-m model.txt] [-w weights.bin] [-c bt601|bt709] [-r i420|nv12|p010 -S WIDTHxHEIGHT [-F rate] [-R]] [-d decodeQueueDepth] [-n encodeQueueDepth] [-t WIDTHxHEIGHT] [-D threshold] [-s] [-a direct|f2|f4] [-q calibration.txt] [-j threads] [-k none|compact|scatter] [-T trace.json] [-H statistics.json] input.y4m|- output.y4m|-" << std::endl
+                  << "Without -r, the input is Y4M. -R marks raw input as full range. The output is always Y4M." << std::endl
+                  << "-D only runs the tiles whose input, with the halo, changed by more than threshold since their last run." << std::endl;
+    }
+
+    struct Frame
+    {
+        uint32_t            width = 0;
+        uint32_t            height = 0;
+        std::vector<float>  tensor;
+    };
+
+    bool ParseConvAlgorithm(const char* name, CpuKernels::ConvAlgorithm& algorithmOut)
+    {
+        const struct { const char* name; CpuKernels::ConvAlgorithm algorithm; } algorithms[] =
+        {
+            { "direct", CpuKernels::ConvAlgorithm::Direct },
+            { "f2", CpuKernels::ConvAlgorithm::Winograd2x2 },
+            { "f4", CpuKernels::ConvAlgorithm::Winograd4x4 },
+        };
+
+        for (const auto& entry : algorithms)
+        {
+            if (!strcmp(name, entry.name))
+            {
+                algorithmOut = entry.algorithm;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ParseAffinity(const char* name, ThreadPool::Affinity& affinityOut)
+    {
+        const struct { const char* name; ThreadPool::Affinity affinity; } affinities[] =
+        {
+            { "none", ThreadPool::Affinity::None },
+            { "compact", ThreadPool::Affinity::Compact },
+            { "scatter", ThreadPool::Affinity::Scatter },
+        };
+
+        for (const auto& entry : affinities)
+        {
+            if (!strcmp(name, entry.name))
+            {
+                affinityOut = entry.affinity;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ParseRawFormat(const char* name, ColorConversion::YuvFormat& formatOut)
+    {
+        if (!strcmp(name, "i420"))
+        {
+            formatOut.bitDepth = 8;
+        }
+        else if (!strcmp(name, "nv12"))
+        {
+            formatOut.bitDepth = 8;
+            formatOut.interleavedChroma = true;
+        }
+        else if (!strcmp(name, "p010"))
+        {
+            formatOut.bitDepth = 10;
+            formatOut.interleavedChroma = true;
+            formatOut.msbAligned = true;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string graphPath = "Assets/model.txt";
+    std::string weightsPath = "Assets/weights.bin";
+    ColorConversion::YuvMatrix matrix = ColorConversion::YuvMatrix::Bt709;
+    bool raw = false;
+    ColorConversion::YuvFormat rawFormat;
+    uint32_t rawWidth = 0;
+    uint32_t rawHeight = 0;
+    std::string rawFrameRate = "30:1";
+    size_t decodeQueueDepth = 2;
+    size_t encodeQueueDepth = 2;
+    uint32_t tileWidth = 0;
+    uint32_t tileHeight = 0;
+    bool subpixel = false;
+    bool temporalReuse = false;
+    float reuseThreshold = 0.0f;
+    CpuKernels::ConvAlgorithm convAlgorithm = CpuKernels::ConvAlgorithm::Winograd4x4;
+    std::string rangesPath;
+    uint32_t threadCount = 1;
+    ThreadPool::Affinity affinity = ThreadPool::Affinity::None;
+    std::string tracePath;
+    std::string statisticsPath;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+        {
+            graphPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+        {
+            weightsPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            if (!strcmp(name, "bt601"))
+            {
+                matrix = ColorConversion::YuvMatrix::Bt601;
+            }
+            else if (!strcmp(name, "bt709"))
+            {
+                matrix = ColorConversion::YuvMatrix::Bt709;
+            }
+            else
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+        {
+            raw = true;
+            if (!ParseRawFormat(argv[++i], rawFormat))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-S") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &rawWidth, &rawHeight) != 2)
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-F") && i + 1 < argc)
+        {
+            rawFrameRate = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-R"))
+        {
+            rawFormat.fullRange = true;
+        }
+        else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+        {
+            decodeQueueDepth = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+        {
+            encodeQueueDepth = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &tileWidth, &tileHeight) != 2)
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-D") && i + 1 < argc)
+        {
+            temporalReuse = true;
+            reuseThreshold = static_cast<float>(atof(argv[++i]));
+        }
+        else if (!strcmp(argv[i], "-s"))
+        {
+            subpixel = true;
+        }
+        else if (!strcmp(argv[i], "-a") && i + 1 < argc)
+        {
+            if (!ParseConvAlgorithm(argv[++i], convAlgorithm))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-q") && i + 1 < argc)
+        {
+            rangesPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            threadCount = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+        }
+        else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+        {
+            if (!ParseAffinity(argv[++i], affinity))
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-T") && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-H") && i + 1 < argc)
+        {
+            statisticsPath = argv[++i];
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (paths.size() != 2 || (raw && (rawWidth == 0 || rawHeight == 0)))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    SuperResolutionModel::Graph graph;
+    WeightMapType weights;
+    if (!graph.Load(graphPath) || !LoadWeights(weightsPath, weights))
+    {
+        return 1;
+    }
+    if (graph.GetInput().channels != 3)
+    {
+        std::cerr << "The model must take RGB images: " << graphPath << std::endl;
+        return 1;
+    }
+    if (subpixel)
+    {
+        graph.FuseUpsampleConvolutions();
+    }
+    graph.FuseConvolutionAdds();
+    graph.FuseUpsampleAdds();
+
+    Quantization::ActivationRanges ranges;
+    if (!rangesPath.empty() && !Quantization::LoadActivationRanges(rangesPath, ranges))
+    {
+        return 1;
+    }
+
+    CpuInference model;
+    model.SetConvAlgorithm(convAlgorithm);
+    if (!rangesPath.empty())
+    {
+        model.SetPrecision(CpuInference::Precision::Int8);
+        model.SetActivationRanges(ranges);
+    }
+    if (!model.Initialize(graph, weights))
+    {
+        return 1;
+    }
+    if (temporalReuse && tileWidth == 0 && tileHeight == 0)
+    {
+        tileWidth = c_defaultReuseTileSize;
+        tileHeight = c_defaultReuseTileSize;
+    }
+    model.SetTileSize(tileWidth, tileHeight);
+    model.SetTemporalReuse(temporalReuse, reuseThreshold);
+    const uint32_t upscaleFactor = graph.GetUpscaleFactor();
+
+    std::unique_ptr<ThreadPool> threadPool;
+    if (threadCount != 1)
+    {
+        threadPool.reset(new ThreadPool(threadCount, affinity));
+        threadCount = threadPool->GetThreadCount();
+        model.SetThreadPool(threadPool.get());
+    }
+
+    rawFormat.matrix = matrix;
+    VideoStream::Reader reader;
+    if (raw ? !reader.OpenRaw(paths[0], rawWidth, rawHeight, rawFormat, rawFrameRate) : !reader.OpenY4m(paths[0], matrix))
+    {
+        return 1;
+    }
+    const VideoStream::StreamInfo& inputInfo = reader.GetInfo();
+
+    // The output has the bit depth, range and matrix of the input, in planar layout with the samples in the low bits
+    VideoStream::StreamInfo outputInfo = inputInfo;
+    outputInfo.width *= upscaleFactor;
+    outputInfo.height *= upscaleFactor;
+    outputInfo.format.msbAligned = false;
+    outputInfo.format.interleavedChroma = false;
+    if (raw)
+    {
+        outputInfo.colorspace = VideoStream::GetY4mColorspace(outputInfo.format);
+    }
+
+    VideoStream::Y4mWriter writer;
+    if (!writer.Open(paths[1], outputInfo))
+    {
+        return 1;
+    }
+
+    std::cerr << "Upscaling " << inputInfo.width << "x" << inputInfo.height << " C" << inputInfo.colorspace << " to "
+              << outputInfo.width << "x" << outputInfo.height << " C" << outputInfo.colorspace << " on " << threadCount
+              << " inference thread(s), queue depths " << decodeQueueDepth << " and " << encodeQueueDepth << std::endl;
+
+    if (!tracePath.empty())
+    {
+        Trace::Enable();
+    }
+
+    FrameStatistics statistics(FramePipeline::GetStatisticNames());
+    if (!statisticsPath.empty() && !statistics.OpenExport(statisticsPath, FramePipeline::c_statisticsIntervalSeconds, 0.0))
+    {
+        return 1;
+    }
+
+    // The conversions run on the decode and encode threads, which are not part of the pool
+    std::vector<uint8_t> inputFrame, outputFrame;
+    FramePipeline::Summary summary;
+    const bool succeeded = FramePipeline::Run<Frame>(decodeQueueDepth, encodeQueueDepth,
+        [&](Frame& frame)
+        {
+            if (!reader.ReadFrame(inputFrame))
+            {
+                return reader.HasFailed() ? FramePipeline::DecodeResult::Failed : FramePipeline::DecodeResult::End;
+            }
+            frame.width = inputInfo.width;
+            frame.height = inputInfo.height;
+            frame.tensor.resize(size_t(3) * frame.width * frame.height);
+            ColorConversion::YuvToTensor(inputFrame.data(), inputInfo.format, frame.width, frame.height, frame.tensor.data(), nullptr);
+            return FramePipeline::DecodeResult::Frame;
+        },
+        [&](const Frame& frame, Frame& upscaled)
+        {
+            upscaled.width = frame.width * upscaleFactor;
+            upscaled.height = frame.height * upscaleFactor;
+            upscaled.tensor.resize(frame.tensor.size() * upscaleFactor * upscaleFactor);
+            model.Run(frame.tensor.data(), 1, frame.height, frame.width, upscaled.tensor.data());
+            return true;
+        },
+        [&](const Frame& frame)
+        {
+            outputFrame.resize(ColorConversion::GetYuvFrameSize(outputInfo.format, frame.width, frame.height));
+            ColorConversion::TensorToYuv(frame.tensor.data(), frame.width, frame.height, outputInfo.format, outputFrame.data(), nullptr);
+            return writer.WriteFrame(outputFrame.data(), outputFrame.size());
+        },
+        summary, &statistics);
+
+    if (!writer.Close() || !succeeded)
+    {
+        return 1;
+    }
+    FramePipeline::PrintSummary(std::cerr, summary);
+    statistics.PrintSummary(std::cerr);
+    if (temporalReuse)
+    {
+        const CpuInference::ReuseCounts& counts = model.GetReuseCounts();
+        std::cerr << "Reused " << counts.reusedTileCount << " of " << counts.tileCount << " tiles ("
+                  << 100.0 * double(counts.reusedTileCount) / double(std::max<uint64_t>(counts.tileCount, 1)) << "%)" << std::endl;
+    }
+
+    if (!tracePath.empty() && !Trace::WriteChromeTrace(tracePath))
+    {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,398 @@
+//--------------------------------------------------------------------------------------
+// WinogradBenchmark.cpp
+//
+// Times each convolution layer of the model with the direct and the Winograd CPU kernels,
+// and measures how much accuracy the Winograd transforms lose in FP32 and in FP16.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "CpuKernels.h"
+#include "Float16Compressor.h"
+#include "LoadWeights.h"
+#include "ModelContainer.h"
+#include "SuperResolutionModel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace SuperResolutionModel;
+
+namespace
+{
+    const CpuKernels::ConvAlgorithm c_winogradAlgorithms[] =
+    {
+        CpuKernels::ConvAlgorithm::Winograd2x2,
+        CpuKernels::ConvAlgorithm::Winograd4x4,
+    };
+
+    const char* GetAlgorithmName(CpuKernels::ConvAlgorithm algorithm)
+    {
+        return (algorithm == CpuKernels::ConvAlgorithm::Winograd2x2) ? "F(2x2,3x3)" : "F(4x4,3x3)";
+    }
+
+    // Largest FP32 difference from the direct convolution tolerated, relative to the largest output
+    const float c_fp32Tolerance = 1e-4f;
+
+    // FP16 accuracy is checked on a crop of this size, with scalar code
+    const uint32_t c_fp16CropSize = 16;
+
+    // Returns the best time per call in seconds
+    template<typename Func>
+    double Measure(Func func, int repeat)
+    {
+        double best = 1e30;
+        for (int r = 0; r < repeat; r++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            func();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    float RoundToHalf(float value)
+    {
+        uint16_t half;
+        Float16Compressor::compressScalar(&value, &half, 1);
+        Float16Compressor::decompressScalar(&half, &value, 1);
+        return value;
+    }
+
+    float Identity(float value)
+    {
+        return value;
+    }
+
+    // Zero-padded 3x3 convolution without bias, for one image. Inputs and filters are rounded by round, and sums
+    // are accumulated in double or float.
+    template<typename Accumulator>
+    void ReferenceConv3x3(
+        const float* input, uint32_t height, uint32_t width, const float* filter, const uint32_t* filterSizes,
+        float (*round)(float), float* output)
+    {
+        const uint32_t K = filterSizes[0];
+        const uint32_t C = filterSizes[1];
+
+        for (uint32_t k = 0; k < K; k++)
+        {
+            for (uint32_t y = 0; y < height; y++)
+            {
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    Accumulator sum = 0;
+                    for (uint32_t c = 0; c < C; c++)
+                    {
+                        for (uint32_t ky = 0; ky < 3; ky++)
+                        {
+                            for (uint32_t kx = 0; kx < 3; kx++)
+                            {
+                                const int iy = int(y + ky) - 1;
+                                const int ix = int(x + kx) - 1;
+                                if (iy >= 0 && iy < int(height) && ix >= 0 && ix < int(width))
+                                {
+                                    sum += Accumulator(round(input[(size_t(c) * height + iy) * width + ix])) *
+                                           round(filter[(size_t(k) * C + c) * 9 + ky * 3 + kx]);
+                                }
+                            }
+                        }
+                    }
+                    output[(size_t(k) * height + y) * width + x] = round(float(sum));
+                }
+            }
+        }
+    }
+
+    // L in L^T for an n x n tile and an r x n matrix, rounding the result
+    void TransformTile(const float* L, uint32_t r, uint32_t n, const float* in, float* out)
+    {
+        float rows[6 * 6];
+        for (uint32_t i = 0; i < r; i++)
+        {
+            for (uint32_t s = 0; s < n; s++)
+            {
+                float sum = 0.0f;
+                for (uint32_t t = 0; t < n; t++)
+                {
+                    sum += L[i * n + t] * in[t * n + s];
+                }
+                rows[i * n + s] = sum;
+            }
+        }
+        for (uint32_t i = 0; i < r; i++)
+        {
+            for (uint32_t j = 0; j < r; j++)
+            {
+                float sum = 0.0f;
+                for (uint32_t t = 0; t < n; t++)
+                {
+                    sum += L[j * n + t] * rows[i * n + t];
+                }
+                out[i * r + j] = sum;
+            }
+        }
+    }
+
+    // Winograd convolution without bias for one image, rounding the input, the transformed filters and tiles, the
+    // products summed over the channels, and the output with round. Arithmetic within a step is FP32, as in a GPU
+    // kernel that stores FP16 and computes in FP32.
+    void ReferenceWinograd(
+        const float* input, uint32_t height, uint32_t width, const float* filter, const uint32_t* filterSizes,
+        CpuKernels::ConvAlgorithm algorithm, float (*round)(float), float* output)
+    {
+        const uint32_t K = filterSizes[0];
+        const uint32_t C = filterSizes[1];
+
+        const float *BT, *G, *AT;
+        const uint32_t m = CpuKernels::GetWinogradTransforms(algorithm, &BT, &G, &AT);
+        const uint32_t t = m + 2;
+
+        // U = G g G^T for each filter, via G g = (g^T G^T)^T
+        std::vector<float> U(size_t(K) * C * t * t);
+        for (size_t f = 0; f < size_t(K) * C; f++)
+        {
+            float Gg[6 * 3];
+            for (uint32_t i = 0; i < t; i++)
+            {
+                for (uint32_t x = 0; x < 3; x++)
+                {
+                    Gg[i * 3 + x] = G[i * 3] * filter[f * 9 + x] + G[i * 3 + 1] * filter[f * 9 + 3 + x] + G[i * 3 + 2] * filter[f * 9 + 6 + x];
+                }
+            }
+            for (uint32_t i = 0; i < t; i++)
+            {
+                for (uint32_t j = 0; j < t; j++)
+                {
+                    U[f * t * t + i * t + j] = round(Gg[i * 3] * G[j * 3] + Gg[i * 3 + 1] * G[j * 3 + 1] + Gg[i * 3 + 2] * G[j * 3 + 2]);
+                }
+            }
+        }
+
+        std::vector<float> V(size_t(C) * t * t);
+        float d[6 * 6], sums[6 * 6], y[4 * 4];
+
+        for (uint32_t by = 0; by < height; by += m)
+        {
+            for (uint32_t bx = 0; bx < width; bx += m)
+            {
+                for (uint32_t c = 0; c < C; c++)
+                {
+                    for (uint32_t i = 0; i < t; i++)
+                    {
+                        for (uint32_t j = 0; j < t; j++)
+                        {
+                            const int iy = int(by + i) - 1;
+                            const int ix = int(bx + j) - 1;
+                            const bool inside = iy >= 0 && iy < int(height) && ix >= 0 && ix < int(width);
+                            d[i * t + j] = inside ? round(input[(size_t(c) * height + iy) * width + ix]) : 0.0f;
+                        }
+                    }
+                    TransformTile(BT, t, t, d, &V[size_t(c) * t * t]);
+                    std::transform(&V[size_t(c) * t * t], &V[size_t(c + 1) * t * t], &V[size_t(c) * t * t], round);
+                }
+
+                for (uint32_t k = 0; k < K; k++)
+                {
+                    for (uint32_t e = 0; e < t * t; e++)
+                    {
+                        float sum = 0.0f;
+                        for (uint32_t c = 0; c < C; c++)
+                        {
+                            sum += U[(size_t(k) * C + c) * t * t + e] * V[size_t(c) * t * t + e];
+                        }
+                        sums[e] = round(sum);
+                    }
+                    TransformTile(AT, m, t, sums, y);
+
+                    for (uint32_t i = 0; i < m && by + i < height; i++)
+                    {
+                        for (uint32_t j = 0; j < m && bx + j < width; j++)
+                        {
+                            output[(size_t(k) * height + by + i) * width + bx + j] = round(y[i * m + j]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Largest difference from the reference, relative to the reference's largest magnitude
+    float GetRelativeError(const std::vector<float>& values, const std::vector<float>& reference)
+    {
+        float maxError = 0.0f, maxMagnitude = 0.0f;
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            maxError = std::max(maxError, std::abs(values[i] - reference[i]));
+            maxMagnitude = std::max(maxMagnitude, std::abs(reference[i]));
+        }
+        return (maxMagnitude > 0.0f) ? maxError / maxMagnitude : maxError;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string graphPath = "Assets/model.txt";
+    std::string weightsPath = "Assets/weights.bin";
+    uint32_t width = 240, height = 136;
+    const int repeat = 5;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+        {
+            graphPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+        {
+            weightsPath = argv[++i];
+        }
+        else if (sscanf(argv[i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0)
+        {
+            std::cerr << "Usage: WinogradBenchmark [-m model.txt] [-w weights.bin] [WIDTHxHEIGHT]" << std::endl;
+            return 1;
+        }
+    }
+
+    Graph graph;
+    WeightMapType weights;
+    if (!graph.Load(graphPath) || !LoadWeights(weightsPath, weights))
+    {
+        return 1;
+    }
+
+    // Time the layers the way SuperResolutionCpu runs them, with sub-pixel convolutions
+    graph.FuseUpsampleConvolutions();
+
+    std::cout << "Model input " << width << "x" << height << ", best of " << repeat << std::endl << std::fixed;
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    std::vector<float> filter, bias, subpixelFilter, subpixelBias, packedFilter, packedBias, input, scratch, direct, winograd;
+    double totalDirect = 0.0, totalBest = 0.0;
+    bool ok = true;
+
+    for (const OpDesc& op : graph.GetOps())
+    {
+        if (!IsConvolution(op))
+        {
+            continue;
+        }
+
+        const ConvLayerDesc& desc = graph.GetConvLayers()[op.convLayer];
+        uint32_t filterSizes[4];
+        std::copy(desc.filterSizes, desc.filterSizes + 4, filterSizes);
+
+        if (!ModelContainer::FoldConvLayer(weights, desc, ModelContainer::Layout::NCHW, filter, bias))
+        {
+            return 1;
+        }
+        if (op.upsampleFactor > 1)
+        {
+            CpuKernels::MakeSubpixelFilter(filter.data(), bias.empty() ? nullptr : bias.data(), desc.filterSizes,
+                op.upsampleFactor, subpixelFilter, subpixelBias, filterSizes);
+            filter.swap(subpixelFilter);
+            bias.swap(subpixelBias);
+        }
+        CpuKernels::PackConvBias(bias.empty() ? nullptr : bias.data(), filterSizes[0], packedBias);
+
+        const uint32_t scale = graph.GetTensors()[op.inputs[0]].scale;
+        const uint32_t layerHeight = height * scale;
+        const uint32_t layerWidth = width * scale;
+        const bool relu = UsesBiasAndActivation(desc);
+
+        input.resize(size_t(filterSizes[1]) * layerHeight * layerWidth);
+        for (auto& value : input)
+        {
+            value = distribution(rng);
+        }
+        direct.resize(size_t(filterSizes[0]) * layerHeight * layerWidth);
+        winograd.resize(direct.size());
+
+        CpuKernels::PackConvFilter(filter.data(), filterSizes, CpuKernels::ConvLayout::NCHW, packedFilter);
+        scratch.resize(CpuKernels::GetConv2DScratchSize(1, layerHeight, layerWidth, filterSizes, CpuKernels::ConvLayout::NCHW));
+        const double directTime = Measure([&]()
+        {
+            CpuKernels::Conv2D(input.data(), 1, layerHeight, layerWidth, packedFilter.data(), packedBias.data(), filterSizes,
+                CpuKernels::ConvLayout::NCHW, relu, nullptr, direct.data(), scratch.data(), nullptr);
+        }, repeat);
+
+        std::cout << std::setw(9) << desc.name << "  " << filterSizes[0] << "x" << filterSizes[1] << "x" << filterSizes[2] << "x"
+                  << filterSizes[3] << " at " << layerWidth << "x" << layerHeight << ": direct " << std::setprecision(2)
+                  << directTime * 1e3 << " ms";
+
+        totalDirect += directTime;
+        double bestTime = directTime;
+
+        if (!CpuKernels::SupportsConvAlgorithm(filterSizes, CpuKernels::ConvAlgorithm::Winograd4x4))
+        {
+            std::cout << ", no Winograd" << std::endl;
+            totalBest += bestTime;
+            continue;
+        }
+
+        for (CpuKernels::ConvAlgorithm algorithm : c_winogradAlgorithms)
+        {
+            CpuKernels::PackWinogradFilter(filter.data(), filterSizes, algorithm, packedFilter);
+            scratch.resize(CpuKernels::GetWinogradConv2DScratchSize(layerWidth, filterSizes, algorithm));
+            const double time = Measure([&]()
+            {
+                CpuKernels::WinogradConv2D(input.data(), 1, layerHeight, layerWidth, packedFilter.data(), packedBias.data(),
+                    filterSizes, algorithm, relu, nullptr, winograd.data(), scratch.data(), nullptr);
+            }, repeat);
+
+            const float error = GetRelativeError(winograd, direct);
+            ok &= error <= c_fp32Tolerance;
+            bestTime = std::min(bestTime, time);
+
+            std::cout << ", " << GetAlgorithmName(algorithm) << " " << std::setprecision(2) << time * 1e3 << " ms ("
+                      << directTime / time << "x, error " << std::scientific << std::setprecision(1) << error
+                      << std::fixed << ")";
+        }
+        std::cout << std::endl;
+        totalBest += bestTime;
+
+        // FP16 storage between the steps of each algorithm, against an FP64 direct convolution of the same crop
+        const uint32_t cropHeight = std::min(c_fp16CropSize, layerHeight);
+        const uint32_t cropWidth = std::min(c_fp16CropSize, layerWidth);
+        std::vector<float> crop(size_t(filterSizes[1]) * cropHeight * cropWidth);
+        for (uint32_t c = 0; c < filterSizes[1]; c++)
+        {
+            for (uint32_t y = 0; y < cropHeight; y++)
+            {
+                std::copy_n(&input[(size_t(c) * layerHeight + y) * layerWidth], cropWidth, &crop[(size_t(c) * cropHeight + y) * cropWidth]);
+            }
+        }
+
+        std::vector<float> reference(size_t(filterSizes[0]) * cropHeight * cropWidth), result(reference.size());
+        ReferenceConv3x3<double>(crop.data(), cropHeight, cropWidth, filter.data(), filterSizes, Identity, reference.data());
+        ReferenceConv3x3<float>(crop.data(), cropHeight, cropWidth, filter.data(), filterSizes, RoundToHalf, result.data());
+
+        std::cout << "             FP16 error: direct " << std::scientific << std::setprecision(1)
+                  << GetRelativeError(result, reference);
+        for (CpuKernels::ConvAlgorithm algorithm : c_winogradAlgorithms)
+        {
+            ReferenceWinograd(crop.data(), cropHeight, cropWidth, filter.data(), filterSizes, algorithm, RoundToHalf, result.data());
+            std::cout << ", " << GetAlgorithmName(algorithm) << " " << GetRelativeError(result, reference);
+        }
+        std::cout << std::fixed << std::endl;
+    }
+
+    std::cout << "All convolutions: direct " << std::setprecision(2) << totalDirect * 1e3 << " ms, fastest per layer "
+              << totalBest * 1e3 << " ms (" << totalDirect / totalBest << "x)" << std::endl;
+
+    if (!ok)
+    {
+        std::cerr << "A Winograd convolution differs from the direct one by more than " << c_fp32Tolerance << std::endl;
+    }
+    return ok ? 0 : 1;
+}
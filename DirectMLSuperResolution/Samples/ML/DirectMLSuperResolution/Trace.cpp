@@ -0,0 +1,232 @@
+//--------------------------------------------------------------------------------------
+// Trace.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+using namespace Trace;
+
+std::atomic<bool> Trace::Detail::g_enabled(false);
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // The fields are atomic so that WriteChromeTrace() may read them while the owning thread writes, but only the
+    // owning thread writes, so relaxed order is enough; the head publishes them. A null name ends a scope.
+    struct Event
+    {
+        std::atomic<const char*>    name;
+        std::atomic<int64_t>        nanoseconds;    // Since the trace epoch
+    };
+
+    struct Ring
+    {
+        explicit Ring(size_t capacity) : events(new Event[capacity]), capacity(capacity) {}
+
+        std::unique_ptr<Event[]>    events;
+        const size_t                capacity;
+        std::atomic<uint64_t>       head{ 0 };      // Events written so far
+        std::string                 threadName;     // Guarded by the registry mutex
+        uint32_t                    threadId = 0;
+    };
+
+    // Rings outlive their threads, so the trace can be written after a thread pool is gone
+    struct Registry
+    {
+        std::mutex                          mutex;
+        std::vector<std::unique_ptr<Ring>>  rings;
+        std::unordered_set<std::string>     names;          // Interned; the nodes don't move as the set grows
+        std::atomic<size_t>                 capacity{ c_defaultCapacity };
+        const Clock::time_point             epoch = Clock::now();
+    };
+
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    thread_local Ring* t_ring = nullptr;
+    thread_local std::string t_threadName;
+
+    Ring& GetThreadRing()
+    {
+        if (!t_ring)
+        {
+            Registry& registry = GetRegistry();
+            std::unique_ptr<Ring> ring(new Ring(std::max<size_t>(registry.capacity, 2)));
+
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            ring->threadId = static_cast<uint32_t>(registry.rings.size()) + 1;
+            ring->threadName = t_threadName;
+            t_ring = ring.get();
+            registry.rings.push_back(std::move(ring));
+        }
+        return *t_ring;
+    }
+
+    std::string EscapeJson(const std::string& text)
+    {
+        std::string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                escaped += '\\';
+                escaped += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                escaped += ' ';
+            }
+            else
+            {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    struct CopiedEvent
+    {
+        const char* name;
+        int64_t     nanoseconds;
+    };
+
+    // The events of the ring that were not written over while they were read, oldest first
+    void CopyEvents(const Ring& ring, std::vector<CopiedEvent>& eventsOut)
+    {
+        const uint64_t end = ring.head.load(std::memory_order_acquire);
+        const uint64_t begin = (end > ring.capacity) ? end - ring.capacity : 0;
+
+        eventsOut.clear();
+        for (uint64_t i = begin; i < end; i++)
+        {
+            const Event& event = ring.events[i % ring.capacity];
+            eventsOut.push_back({ event.name.load(std::memory_order_relaxed), event.nanoseconds.load(std::memory_order_relaxed) });
+        }
+
+        // The owner may have lapped the copy since; drop what it could have written over
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t newEnd = ring.head.load(std::memory_order_relaxed);
+        const uint64_t valid = (newEnd > ring.capacity) ? newEnd - ring.capacity : 0;
+        if (valid > begin)
+        {
+            eventsOut.erase(eventsOut.begin(), eventsOut.begin() + static_cast<ptrdiff_t>(std::min<uint64_t>(valid - begin, eventsOut.size())));
+        }
+    }
+}
+
+void Trace::Detail::Record(const char* name)
+{
+    Ring& ring = GetThreadRing();
+    const int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - GetRegistry().epoch).count();
+
+    const uint64_t head = ring.head.load(std::memory_order_relaxed);
+    Event& event = ring.events[head % ring.capacity];
+    event.name.store(name, std::memory_order_relaxed);
+    event.nanoseconds.store(nanoseconds, std::memory_order_relaxed);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void Trace::Enable(size_t capacity)
+{
+    GetRegistry().capacity = capacity;
+    Detail::g_enabled = true;
+}
+
+void Trace::Disable()
+{
+    Detail::g_enabled = false;
+}
+
+const char* Trace::Intern(const std::string& name)
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.names.insert(name).first->c_str();
+}
+
+void Trace::SetThreadName(const std::string& name)
+{
+    t_threadName = name;
+    if (t_ring)
+    {
+        std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+        t_ring->threadName = name;
+    }
+}
+
+bool Trace::WriteChromeTrace(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Unable to create trace file: " << path << std::endl;
+        return false;
+    }
+
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    // Timestamps are in microseconds
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::fixed << std::setprecision(3);
+    bool first = true;
+    std::vector<CopiedEvent> events;
+    std::vector<const char*> openScopes;
+
+    for (const std::unique_ptr<Ring>& ring : registry.rings)
+    {
+        const std::string threadName = ring->threadName.empty() ? "Thread " + std::to_string(ring->threadId) : ring->threadName;
+        file << (first ? "" : ",") << "\n{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << ring->threadId
+             << ", \"args\": {\"name\": \"" << EscapeJson(threadName) << "\"}}";
+        first = false;
+
+        CopyEvents(*ring, events);
+        openScopes.clear();
+        for (const CopiedEvent& event : events)
+        {
+            if (!event.name && openScopes.empty())
+            {
+                continue;
+            }
+
+            const char* name = event.name ? event.name : openScopes.back();
+            if (event.name)
+            {
+                openScopes.push_back(event.name);
+            }
+            else
+            {
+                openScopes.pop_back();
+            }
+
+            file << ",\n{\"ph\": \"" << (event.name ? "B" : "E") << "\", \"name\": \"" << EscapeJson(name)
+                 << "\", \"pid\": 1, \"tid\": " << ring->threadId << ", \"ts\": " << event.nanoseconds * 1e-3 << "}";
+        }
+    }
+    file << "\n]}\n";
+
+    if (!file)
+    {
+        std::cerr << "Unable to write trace file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
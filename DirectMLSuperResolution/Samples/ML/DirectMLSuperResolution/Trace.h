@@ -0,0 +1,83 @@
+//--------------------------------------------------------------------------------------
+// Trace.h
+//
+// Portable timeline tracing, for the phases that PIX events mark on Windows and for the
+// layers of the CPU engine. Each thread records timestamped begin and end events into its
+// own ring buffer, without locks, keeping the most recent ones. WriteChromeTrace() writes
+// what the rings hold in the Chrome trace_event JSON format, which Perfetto
+// (ui.perfetto.dev) and chrome://tracing open.
+//
+// Recording is off until Enable() is called, and then costs a clock read and two stores
+// per event.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+namespace Trace
+{
+    // Events each thread keeps by default, the most recent ones
+    static const size_t c_defaultCapacity = size_t(1) << 16;
+
+    namespace Detail
+    {
+        extern std::atomic<bool> g_enabled;
+        void Record(const char* name);
+    }
+
+    // A thread's ring is made the first time it records an event, with the capacity given to the last Enable().
+    void Enable(size_t capacity = c_defaultCapacity);
+    void Disable();
+
+    inline bool IsEnabled()
+    {
+        return Detail::g_enabled.load(std::memory_order_relaxed);
+    }
+
+    // Names are not copied, so they must stay valid until the trace is written, as string literals and the
+    // names Intern() returns do. End() closes the latest Begin() of the same thread.
+    inline void Begin(const char* name)
+    {
+        if (IsEnabled())
+        {
+            Detail::Record(name);
+        }
+    }
+
+    inline void End()
+    {
+        if (IsEnabled())
+        {
+            Detail::Record(nullptr);
+        }
+    }
+
+    // A copy of the name that lives until exit, the same one for equal names, for names whose strings may be freed
+    // while their events are in a ring, such as those of a model graph. It takes a lock, so intern names before
+    // recording rather than for each event.
+    const char* Intern(const std::string& name);
+
+    // Shown for the calling thread's track. Threads without a name are numbered.
+    void SetThreadName(const std::string& name);
+
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name) { Begin(name); }
+        ~Scope() { End(); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // Writes the events every thread's ring holds. Threads may keep recording meanwhile; events they write over
+    // while they are copied are left out, as are ends whose begin was written over. Reports errors to stderr.
+    bool WriteChromeTrace(const std::string& path);
+}
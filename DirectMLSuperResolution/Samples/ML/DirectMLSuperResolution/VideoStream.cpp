@@ -0,0 +1,344 @@
+//--------------------------------------------------------------------------------------
+// VideoStream.cpp
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "VideoStream.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+using namespace VideoStream;
+
+namespace
+{
+    const char c_y4mSignature[] = "YUV4MPEG2";
+
+    // Longest stream or frame header line accepted
+    const size_t c_maxHeaderLength = 4096;
+
+    FILE* OpenFile(const std::string& path, const char* mode)
+    {
+#ifdef _MSC_VER
+        FILE* file = nullptr;
+        return (fopen_s(&file, path.c_str(), mode) == 0) ? file : nullptr;
+#else
+        return fopen(path.c_str(), mode);
+#endif
+    }
+
+    // Standard input and output are opened in text mode on Windows, which would translate line endings in the frames
+    void SetBinaryMode(FILE* file)
+    {
+#ifdef _WIN32
+        (void)_setmode(_fileno(file), _O_BINARY);
+#else
+        (void)file;
+#endif
+    }
+
+    // A width or height of the Y4M header, digits only, from 1 to c_maxFrameSize
+    bool ParseFrameSize(const char* text, uint32_t& sizeOut)
+    {
+        if (*text < '0' || *text > '9')
+        {
+            return false;
+        }
+        char* end;
+        errno = 0;
+        const unsigned long size = strtoul(text, &end, 10);
+        if (*end != '\0' || errno == ERANGE || size == 0 || size > c_maxFrameSize)
+        {
+            return false;
+        }
+        sizeOut = static_cast<uint32_t>(size);
+        return true;
+    }
+
+    // Reads up to the next newline, which is dropped. Returns false at the end of the file if nothing was read.
+    bool ReadLine(FILE* file, std::string& lineOut, bool& tooLongOut)
+    {
+        lineOut.clear();
+        tooLongOut = false;
+        for (;;)
+        {
+            const int c = fgetc(file);
+            if (c == EOF)
+            {
+                return !lineOut.empty();
+            }
+            if (c == '\n')
+            {
+                return true;
+            }
+            if (lineOut.size() == c_maxHeaderLength)
+            {
+                tooLongOut = true;
+                return true;
+            }
+            lineOut += static_cast<char>(c);
+        }
+    }
+
+    bool ParseColorspace(const std::string& colorspace, ColorConversion::YuvFormat& formatOut)
+    {
+        if (colorspace == "420" || colorspace == "420jpeg" || colorspace == "420mpeg2" || colorspace == "420paldv")
+        {
+            formatOut.bitDepth = 8;
+            return true;
+        }
+
+        unsigned bitDepth = 0;
+        char extra = 0;
+        if (sscanf(colorspace.c_str(), "420p%u%c", &bitDepth, &extra) == 1 && bitDepth > 8 && bitDepth <= 16)
+        {
+            formatOut.bitDepth = bitDepth;
+            return true;
+        }
+        return false;
+    }
+}
+
+std::string VideoStream::GetY4mColorspace(const ColorConversion::YuvFormat& format)
+{
+    return (format.bitDepth > 8) ? "420p" + std::to_string(format.bitDepth) : "420jpeg";
+}
+
+Reader::~Reader()
+{
+    if (m_ownsFile)
+    {
+        fclose(m_file);
+    }
+}
+
+bool Reader::Open(const std::string& path)
+{
+    m_path = path;
+    if (path == "-")
+    {
+        m_file = stdin;
+        SetBinaryMode(m_file);
+        return true;
+    }
+
+    m_file = OpenFile(path, "rb");
+    if (!m_file)
+    {
+        std::cerr << "Unable to open video file: " << path << std::endl;
+        return false;
+    }
+    m_ownsFile = true;
+    return true;
+}
+
+bool Reader::OpenY4m(const std::string& path, ColorConversion::YuvMatrix matrix)
+{
+    if (!Open(path))
+    {
+        return false;
+    }
+    m_y4m = true;
+
+    std::string header;
+    bool tooLong;
+    if (!ReadLine(m_file, header, tooLong) || tooLong || header.compare(0, sizeof(c_y4mSignature) - 1, c_y4mSignature) != 0)
+    {
+        std::cerr << "Not a YUV4MPEG2 stream: " << path << std::endl;
+        return false;
+    }
+
+    m_info = StreamInfo();
+    m_info.colorspace = "420jpeg";
+    m_info.format.matrix = matrix;
+
+    std::istringstream tokens(header.substr(sizeof(c_y4mSignature) - 1));
+    for (std::string token; tokens >> token; )
+    {
+        switch (token[0])
+        {
+        case 'W':
+        case 'H':
+            if (!ParseFrameSize(token.c_str() + 1, (token[0] == 'W') ? m_info.width : m_info.height))
+            {
+                std::cerr << "Invalid YUV4MPEG2 frame size " << token << " (from 1 to " << c_maxFrameSize << "): " << path << std::endl;
+                return false;
+            }
+            break;
+        case 'C':
+            m_info.colorspace = token.substr(1);
+            break;
+        case 'X':
+            if (token == "XCOLORRANGE=FULL")
+            {
+                m_info.format.fullRange = true;
+            }
+            m_info.parameters.push_back(token);
+            break;
+        default:
+            m_info.parameters.push_back(token);
+            break;
+        }
+    }
+
+    if (m_info.width == 0 || m_info.height == 0)
+    {
+        std::cerr << "Missing frame size in YUV4MPEG2 header: " << path << std::endl;
+        return false;
+    }
+    if (!ParseColorspace(m_info.colorspace, m_info.format))
+    {
+        std::cerr << "Unsupported YUV4MPEG2 colorspace C" << m_info.colorspace << " (only 4:2:0 is supported): " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Reader::OpenRaw(const std::string& path, uint32_t width, uint32_t height, const ColorConversion::YuvFormat& format, const std::string& frameRate)
+{
+    if (width == 0 || height == 0 || width > c_maxFrameSize || height > c_maxFrameSize)
+    {
+        std::cerr << "Invalid raw frame size " << width << "x" << height << " (from 1 to " << c_maxFrameSize << "): " << path << std::endl;
+        return false;
+    }
+    if (!Open(path))
+    {
+        return false;
+    }
+    m_y4m = false;
+
+    m_info = StreamInfo();
+    m_info.width = width;
+    m_info.height = height;
+    m_info.format = format;
+    m_info.colorspace = GetY4mColorspace(format);
+    m_info.parameters.push_back("F" + frameRate);
+    if (format.fullRange)
+    {
+        m_info.parameters.push_back("XCOLORRANGE=FULL");
+    }
+    return true;
+}
+
+bool Reader::ReadFrame(std::vector<uint8_t>& frameOut)
+{
+    if (m_y4m)
+    {
+        std::string header;
+        bool tooLong;
+        if (!ReadLine(m_file, header, tooLong))
+        {
+            m_failed = ferror(m_file) != 0;
+            return false;
+        }
+        if (tooLong || header.compare(0, 5, "FRAME") != 0)
+        {
+            std::cerr << "Invalid YUV4MPEG2 frame header: " << m_path << std::endl;
+            m_failed = true;
+            return false;
+        }
+    }
+
+    // Samples of more than 8 bits are little-endian, as on the processors this runs on
+    frameOut.resize(ColorConversion::GetYuvFrameSize(m_info.format, m_info.width, m_info.height));
+    const size_t size = fread(frameOut.data(), 1, frameOut.size(), m_file);
+    if (size == frameOut.size())
+    {
+        return true;
+    }
+
+    // A raw stream ends between frames, but a Y4M one never right after a frame header
+    if (size > 0 || m_y4m || ferror(m_file))
+    {
+        std::cerr << "Truncated video frame: " << m_path << std::endl;
+        m_failed = true;
+    }
+    return false;
+}
+
+Y4mWriter::~Y4mWriter()
+{
+    if (m_ownsFile)
+    {
+        fclose(m_file);
+    }
+}
+
+bool Y4mWriter::Open(const std::string& path, const StreamInfo& info)
+{
+    m_path = path;
+    if (path == "-")
+    {
+        m_file = stdout;
+        SetBinaryMode(m_file);
+    }
+    else
+    {
+        m_file = OpenFile(path, "wb");
+        if (!m_file)
+        {
+            std::cerr << "Unable to create video file: " << path << std::endl;
+            return false;
+        }
+        m_ownsFile = true;
+    }
+
+    std::string header = std::string(c_y4mSignature) + " W" + std::to_string(info.width) + " H" + std::to_string(info.height) + " C" + info.colorspace;
+    for (const std::string& parameter : info.parameters)
+    {
+        header += " " + parameter;
+    }
+    header += "\n";
+
+    if (fwrite(header.data(), 1, header.size(), m_file) != header.size())
+    {
+        std::cerr << "Unable to write video file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Y4mWriter::WriteFrame(const uint8_t* frame, size_t size)
+{
+    static const char c_frameHeader[] = "FRAME\n";
+    if (fwrite(c_frameHeader, 1, sizeof(c_frameHeader) - 1, m_file) != sizeof(c_frameHeader) - 1 ||
+        fwrite(frame, 1, size, m_file) != size)
+    {
+        std::cerr << "Unable to write video file: " << m_path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Y4mWriter::Close()
+{
+    if (!m_file)
+    {
+        return true;
+    }
+
+    bool succeeded = (fflush(m_file) == 0) && !ferror(m_file);
+    if (m_ownsFile)
+    {
+        succeeded = (fclose(m_file) == 0) && succeeded;
+        m_ownsFile = false;
+    }
+    m_file = nullptr;
+
+    if (!succeeded)
+    {
+        std::cerr << "Unable to write video file: " << m_path << std::endl;
+    }
+    return succeeded;
+}
@@ -0,0 +1,101 @@
+//--------------------------------------------------------------------------------------
+// VideoStream.h
+//
+// Reading and writing uncompressed 4:2:0 video for the headless tools, as YUV4MPEG2 (Y4M)
+// streams or as raw frames of a known size, from files or standard input and output. This
+// is what ffmpeg produces and takes with "-f yuv4mpegpipe" and "-f rawvideo".
+//
+// Y4M streams hold planar 8-bit I420 (C420, C420jpeg, C420mpeg2, C420paldv) or 9- to 16-bit
+// samples (C420p10 and the like) in the low bits of little-endian words. Raw frames can also
+// be NV12 or P010, whose chroma is interleaved. Frames are read as-is and described by a
+// ColorConversion::YuvFormat; the chroma siting of the C420 variants is not used.
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. Copyright (C) NVIDIA Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ColorConversion.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace VideoStream
+{
+    // Largest width or height read, so that a corrupt header can't ask for a frame larger than memory
+    const uint32_t c_maxFrameSize = 16384;
+
+    struct StreamInfo
+    {
+        uint32_t                    width = 0;
+        uint32_t                    height = 0;
+        ColorConversion::YuvFormat  format;
+        std::string                 colorspace;     // Y4M C parameter, e.g. "420jpeg"
+        std::vector<std::string>    parameters;     // Other Y4M parameters as given, e.g. "F30000:1001"
+    };
+
+    // The Y4M colorspace of planar frames in the format
+    std::string GetY4mColorspace(const ColorConversion::YuvFormat& format);
+
+    // "-" is standard input, or standard output for the writer. Errors are reported to stderr.
+    class Reader
+    {
+    public:
+        Reader() = default;
+        ~Reader();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // Reads the stream header. XCOLORRANGE=FULL selects full range, as written by ffmpeg. The matrix is taken from
+        // the format passed in, since Y4M does not record it.
+        bool OpenY4m(const std::string& path, ColorConversion::YuvMatrix matrix);
+
+        // Raw frames have no header, so the caller describes them. frameRate is a Y4M rate such as "30:1". The width
+        // and height are at most c_maxFrameSize, as in Y4M headers.
+        bool OpenRaw(const std::string& path, uint32_t width, uint32_t height, const ColorConversion::YuvFormat& format, const std::string& frameRate);
+
+        const StreamInfo& GetInfo() const { return m_info; }
+
+        // Reads the next frame, laid out as ColorConversion expects. Returns false at the end of the stream, and
+        // HasFailed() tells whether it ended with an error, such as a truncated frame.
+        bool ReadFrame(std::vector<uint8_t>& frameOut);
+        bool HasFailed() const { return m_failed; }
+
+    private:
+        bool Open(const std::string& path);
+
+        FILE*       m_file = nullptr;
+        bool        m_ownsFile = false;
+        bool        m_y4m = false;
+        bool        m_failed = false;
+        std::string m_path;
+        StreamInfo  m_info;
+    };
+
+    // Writes planar frames in the format of the stream info, with the samples in the low bits
+    class Y4mWriter
+    {
+    public:
+        Y4mWriter() = default;
+        ~Y4mWriter();
+
+        Y4mWriter(const Y4mWriter&) = delete;
+        Y4mWriter& operator=(const Y4mWriter&) = delete;
+
+        bool Open(const std::string& path, const StreamInfo& info);
+        bool WriteFrame(const uint8_t* frame, size_t size);
+
+        // Flushes, and reports whether everything was written
+        bool Close();
+
+    private:
+        FILE*       m_file = nullptr;
+        bool        m_ownsFile = false;
+        std::string m_path;
+    };
+}
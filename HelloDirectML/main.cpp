@@ -251,8 +251,8 @@ namespace DML
 		DML_BUFFER_BINDING m_BufferBinding;
 
 	public:
-		BufferBindingDesc(com_ptr<ID3D12Resource> const& Buffer, UINT64 Size) :
-			m_BufferBinding { Buffer.get(), 0, Size }
+		BufferBindingDesc(com_ptr<ID3D12Resource> const& Buffer, UINT64 Size, UINT64 Offset = 0) :
+			m_BufferBinding { Buffer.get(), Offset, Size }
 		{
 			Type = DML_BINDING_TYPE_BUFFER;
 			Desc = &m_BufferBinding;
@@ -272,6 +272,8 @@ namespace DML
 			com_ptr<IDMLCompiledOperator> m_CompiledOperator;
 			DML_BINDING_PROPERTIES m_ExecuteProperties;
 			UINT m_DescriptorOffset;
+			UINT64 m_TemporaryResourceOffset;
+			UINT64 m_PersistentResourceOffset;
 
 		public:
 			VOID Reset(BindingTable& BindingTable) const
@@ -290,21 +292,32 @@ namespace DML
 			com_ptr<ID3D12Resource> m_PersistentBuffer;
 
 		public:
-			void BindToInitialize(BindingTable const& BindingTable) const
+			void BindToInitialize(BindingTable const& BindingTable, Item const (&Items)[t_Count]) const
 			{
 				WINRT_ASSERT(BindingTable.m_Value);
 				if(m_TemporaryResourceSize)
 					BindingTable->BindTemporaryResource(&DML::BufferBindingDesc(m_TemporaryBuffer, m_TemporaryResourceSize));
 				if(m_PersistentResourceSize)
-					BindingTable.BindOutput(DML::BufferBindingDesc(m_PersistentBuffer, m_PersistentResourceSize)); // Persistent is Initializer Output
+				{
+					// Persistent is Initializer Output, one per operator
+					DML_BUFFER_BINDING BufferBindings[t_Count];
+					DML_BINDING_DESC Outputs[t_Count];
+					for(SIZE_T Index = 0; Index < t_Count; Index++)
+					{
+						Item const& Item = Items[Index];
+						BufferBindings[Index] = { m_PersistentBuffer.get(), Item.m_PersistentResourceOffset, Item.m_ExecuteProperties.PersistentResourceSize };
+						Outputs[Index] = Item.m_ExecuteProperties.PersistentResourceSize ? DML_BINDING_DESC { DML_BINDING_TYPE_BUFFER, &BufferBindings[Index] } : DML_BINDING_DESC { DML_BINDING_TYPE_NONE, nullptr };
+					}
+					BindingTable->BindOutputs(static_cast<UINT>(t_Count), Outputs);
+				}
 			}
-			void BindToExecute(BindingTable const& BindingTable) const
+			void BindToExecute(BindingTable const& BindingTable, Item const& Item) const
 			{
 				WINRT_ASSERT(BindingTable.m_Value);
-				if(m_TemporaryResourceSize)
-					BindingTable->BindTemporaryResource(&DML::BufferBindingDesc(m_TemporaryBuffer, m_TemporaryResourceSize));
-				if(m_PersistentResourceSize)
-					BindingTable->BindPersistentResource(&DML::BufferBindingDesc(m_PersistentBuffer, m_PersistentResourceSize));
+				if(Item.m_ExecuteProperties.TemporaryResourceSize)
+					BindingTable->BindTemporaryResource(&DML::BufferBindingDesc(m_TemporaryBuffer, Item.m_ExecuteProperties.TemporaryResourceSize, Item.m_TemporaryResourceOffset));
+				if(Item.m_ExecuteProperties.PersistentResourceSize)
+					BindingTable->BindPersistentResource(&DML::BufferBindingDesc(m_PersistentBuffer, Item.m_ExecuteProperties.PersistentResourceSize, Item.m_PersistentResourceOffset));
 			}
 		};
 
@@ -350,16 +363,21 @@ namespace DML
 		{
 			// The temporary resource is scratch memory (used internally by DirectML), whose contents you don't need to define.
 			// The persistent resource is long-lived, and you need to initialize it using the IDMLOperatorInitializer.
-			m_Buffers.m_TemporaryResourceSize = m_InitializeProperties.TemporaryResourceSize;
+			// Each operator gets a range of its own in both buffers: the persistent contents have to survive between dispatches, and the operators are
+			// recorded without a barrier on the temporary buffer, so they may run concurrently. Initialization completes before any operator executes
+			// and shares the temporary buffer with them.
+			auto const Align = [] (UINT64 Value, UINT64 Alignment) { return (Value + Alignment - 1) & ~(Alignment - 1); };
+			UINT64 TemporaryResourceSize = 0;
 			m_Buffers.m_PersistentResourceSize = 0;
 			for(SIZE_T Index = 0; Index < t_Count; Index++)
 			{
-				const Item& Item = m_Items[Index];
-				// TODO: This is probably wrong; this could have worked out in original asmple with just initialize/execute resource sharing but here different operators
-				//       are likely to have dedicated resources which do not collide
-				m_Buffers.m_TemporaryResourceSize = std::max(m_Buffers.m_TemporaryResourceSize, Item.m_ExecuteProperties.TemporaryResourceSize);
-				m_Buffers.m_PersistentResourceSize = std::max(m_Buffers.m_PersistentResourceSize, Item.m_ExecuteProperties.PersistentResourceSize);
+				Item& Item = m_Items[Index];
+				Item.m_TemporaryResourceOffset = TemporaryResourceSize;
+				TemporaryResourceSize = Align(TemporaryResourceSize + Item.m_ExecuteProperties.TemporaryResourceSize, DML_TEMPORARY_BUFFER_ALIGNMENT);
+				Item.m_PersistentResourceOffset = m_Buffers.m_PersistentResourceSize;
+				m_Buffers.m_PersistentResourceSize = Align(m_Buffers.m_PersistentResourceSize + Item.m_ExecuteProperties.PersistentResourceSize, DML_PERSISTENT_BUFFER_ALIGNMENT);
 			}
+			m_Buffers.m_TemporaryResourceSize = std::max(m_InitializeProperties.TemporaryResourceSize, TemporaryResourceSize);
 			if(m_Buffers.m_TemporaryResourceSize)
 				m_Buffers.m_TemporaryBuffer = Context.CreateBufferResource(D3D12_HEAP_TYPE_DEFAULT, m_Buffers.m_TemporaryResourceSize);
 			if(m_Buffers.m_PersistentResourceSize)
@@ -433,9 +451,11 @@ int wmain(int argc, char** argv)
 	DML::BindingTable BindingTable(D3dContext, DescriptorHeap, Operators.m_DescriptorCount, DmlDevice, Operators.m_OperatorInitializer.get());
 	DML::CommandRecorder CommandRecorder(DmlDevice);
 
-	Operators.m_Buffers.BindToInitialize(BindingTable);
+	Operators.m_Buffers.BindToInitialize(BindingTable, Operators.m_Items);
 	DescriptorHeap.Set(D3dContext);
 	CommandRecorder.RecordDispatch(BindingTable, D3dContext);
+	// Execution reads the persistent resources written by initialization, and reuses its temporary resource
+	D3dContext.ResourceBarrier(CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
 
 	// Close the Direct3D 12 command list, and submit it for execution as you would any other command list. You could in principle record the execution into the same command list as the initialization, 
 	// but you need only to Initialize once, and typically you want to Execute an operator more frequently than that.
@@ -466,11 +486,11 @@ int wmain(int argc, char** argv)
 	}
 	#pragma endregion
 
-	Operators.m_Buffers.BindToExecute(BindingTable);
 	DescriptorHeap.Set(D3dContext);
 	{
 		auto const& Operator = Operators.m_Items[0]; // Add
 		Operator.Reset(BindingTable);
+		Operators.m_Buffers.BindToExecute(BindingTable, Operator);
 		DML::BufferBindingDesc Inputs[] { DML::BufferBindingDesc(InputBuffer, TensorBufferSize), DML::BufferBindingDesc(InputBuffer, TensorBufferSize) };
 		BindingTable.BindInputs(Inputs);
 		DML::BufferBindingDesc Outputs[] { DML::BufferBindingDesc(IntermediateBuffer, TensorBufferSize) };
@@ -481,6 +501,7 @@ int wmain(int argc, char** argv)
 	{
 		auto const& Operator = Operators.m_Items[1]; // Multiply
 		Operator.Reset(BindingTable);
+		Operators.m_Buffers.BindToExecute(BindingTable, Operator);
 		DML::BufferBindingDesc Inputs[] { DML::BufferBindingDesc(IntermediateBuffer, TensorBufferSize), DML::BufferBindingDesc(IntermediateBuffer, TensorBufferSize) };
 		BindingTable.BindInputs(Inputs);
 		DML::BufferBindingDesc Outputs[] { DML::BufferBindingDesc(OutputBuffer, TensorBufferSize) };